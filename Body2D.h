@@ -0,0 +1,28 @@
+#ifndef _H_BODY_2D_
+#define _H_BODY_2D_
+
+#include "Geometry2D.h"
+
+/* Dynamic state of a 2D rigid body. Rotations are in degrees like
+ * OrientedRectangle::rotation; static bodies have zero inverse mass and
+ * inertia.
+ */
+typedef struct Body2D
+{
+    Point2D position;
+    vec2 velocity;
+    float rotation;
+    float angularVelocity; // degrees per second
+    float inverseMass;
+    float inverseInertia;
+
+    inline Body2D() :
+        rotation(0.0f), angularVelocity(0.0f), inverseMass(1.0f),
+        inverseInertia(1.0f) {}
+    inline Body2D(const Point2D& _position, float mass, float inertia) :
+        position(_position), rotation(0.0f), angularVelocity(0.0f),
+        inverseMass(mass > 0.0f ? 1.0f / mass : 0.0f),
+        inverseInertia(inertia > 0.0f ? 1.0f / inertia : 0.0f) {}
+} Body2D;
+
+#endif
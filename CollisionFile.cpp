@@ -0,0 +1,761 @@
+#include "CollisionFile.h"
+#include "Profiler.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define COLLISION_FILE_ALIGN 16
+
+/* On-disk layout: this header, then the line, rectangle and oriented
+ * rectangle arrays, the cell start table (columns * rows + 1 entries, the
+ * refs of cell i are cellRefs[cellStart[i] .. cellStart[i + 1])) and the
+ * cell refs. Offsets are in bytes from the start of the file.
+ */
+struct CollisionFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t fileSize;
+
+    uint32_t lineCount;
+    uint32_t rectangleCount;
+    uint32_t orientedRectangleCount;
+    uint32_t refCount;
+
+    float gridMinX;
+    float gridMinY;
+    float cellSize;
+    float invCellSize;
+    uint32_t columns;
+    uint32_t rows;
+
+    uint64_t linesOffset;
+    uint64_t rectanglesOffset;
+    uint64_t orientedRectanglesOffset;
+    uint64_t cellStartOffset;
+    uint64_t cellRefsOffset;
+};
+
+// The shapes are baked as their in-memory structs
+static_assert(sizeof(Line2D) == 4 * sizeof(float), "Line2D layout");
+static_assert(sizeof(Rectangle2D) == 4 * sizeof(float), "Rectangle2D layout");
+static_assert(sizeof(OrientedRectangle) == 5 * sizeof(float),
+              "OrientedRectangle layout");
+static_assert(sizeof(CollisionFileHeader) % COLLISION_FILE_ALIGN == 0,
+              "CollisionFileHeader size");
+
+/* The format is little endian and baked as in-memory structs, so only
+ * little endian hosts bake or open it */
+static bool IsLittleEndian()
+{
+    const uint32_t one = 1;
+    unsigned char first;
+    memcpy(&first, &one, 1);
+    return first == 1;
+}
+
+static uint64_t AlignOffset(uint64_t offset)
+{
+    return (offset + COLLISION_FILE_ALIGN - 1) &
+        ~(uint64_t)(COLLISION_FILE_ALIGN - 1);
+}
+
+static uint32_t MakeRef(SweptTargetType type, int index)
+{
+    return ((uint32_t)type << COLLISION_REF_SHIFT) | (uint32_t)index;
+}
+
+static StaticShapeRef ToShapeRef(uint32_t ref)
+{
+    StaticShapeRef result;
+    result.type = (SweptTargetType)(ref >> COLLISION_REF_SHIFT);
+    result.index = (int)(ref & COLLISION_REF_INDEX_MASK);
+    return result;
+}
+
+/* Bake */
+
+typedef struct BakeGrid
+{
+    vec2 min;
+    float cellSize;
+    float invCellSize;
+    int columns;
+    int rows;
+} BakeGrid;
+
+static void CellRange(const BakeGrid& grid, const vec2& min, const vec2& max,
+                      int* x0, int* y0, int* x1, int* y1)
+{
+    *x0 = std::max(0, (int)floorf((min.x - grid.min.x) * grid.invCellSize));
+    *y0 = std::max(0, (int)floorf((min.y - grid.min.y) * grid.invCellSize));
+    *x1 = std::min(grid.columns - 1,
+                   (int)floorf((max.x - grid.min.x) * grid.invCellSize));
+    *y1 = std::min(grid.rows - 1,
+                   (int)floorf((max.y - grid.min.y) * grid.invCellSize));
+}
+
+static Rectangle2D CellRectangle(const BakeGrid& grid, int x, int y)
+{
+    // Slightly grown so shapes lying on a cell border land in both cells
+    float border = grid.cellSize * 1.0e-4f;
+    return Rectangle2D(grid.min + vec2(x * grid.cellSize - border,
+                                       y * grid.cellSize - border),
+                       vec2(grid.cellSize + 2.0f * border,
+                            grid.cellSize + 2.0f * border));
+}
+
+/* Calls visit(cell) for every cell the shape touches. Shapes spanning a
+ * single cell skip the exact test. */
+template<typename Touches, typename Visit>
+static void VisitCells(const BakeGrid& grid, const vec2& min, const vec2& max,
+                       const Touches& touches, const Visit& visit)
+{
+    int x0, y0, x1, y1;
+    CellRange(grid, min, max, &x0, &y0, &x1, &y1);
+    bool single = (x0 == x1 && y0 == y1);
+    for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) {
+            if (single || touches(CellRectangle(grid, x, y))) {
+                visit(y * grid.columns + x);
+            }
+        }
+    }
+}
+
+static bool WritePadded(FILE* file, const void* data, size_t size,
+                        uint64_t* offset)
+{
+    static const char zeros[COLLISION_FILE_ALIGN] = { 0 };
+    uint64_t aligned = AlignOffset(*offset);
+    if (aligned != *offset &&
+        fwrite(zeros, 1, (size_t)(aligned - *offset), file) !=
+            (size_t)(aligned - *offset)) {
+        return false;
+    }
+    if (size > 0 && fwrite(data, 1, size, file) != size) {
+        return false;
+    }
+    *offset = aligned + size;
+    return true;
+}
+
+/* Builds the grid and fills in the header, shared by the file and memory
+ * bakes. Without `exactCells` shapes go to every cell their bounds cover. */
+static bool BakeLayout(const SweptTargets& shapes, float cellSize,
+                       bool exactCells, CollisionFileHeader& header,
+                       std::vector<uint32_t>& cellStart,
+                       std::vector<uint32_t>& cellRefs)
+{
+    int shapeCount = shapes.lineCount + shapes.rectangleCount +
+        shapes.orientedRectangleCount;
+    if (!IsLittleEndian() || shapes.lineCount < 0 || shapes.rectangleCount < 0 ||
+        shapes.orientedRectangleCount < 0 ||
+        (uint32_t)std::max(shapes.lineCount,
+                           std::max(shapes.rectangleCount,
+                                    shapes.orientedRectangleCount)) >
+            COLLISION_REF_INDEX_MASK) {
+        return false;
+    }
+
+    // Bounds of every shape, lines first, then rectangles and oriented
+    // rectangles, and of the whole level
+    std::vector<vec2> mins(shapeCount);
+    std::vector<vec2> maxs(shapeCount);
+    int s = 0;
+    for (int i = 0; i < shapes.lineCount; i++, s++) {
+        Rectangle2D bounds = ContainingRectangle(shapes.lines[i]);
+        mins[s] = GetMin(bounds);
+        maxs[s] = GetMax(bounds);
+    }
+    for (int i = 0; i < shapes.rectangleCount; i++, s++) {
+        mins[s] = GetMin(shapes.rectangles[i]);
+        maxs[s] = GetMax(shapes.rectangles[i]);
+    }
+    for (int i = 0; i < shapes.orientedRectangleCount; i++, s++) {
+        Rectangle2D bounds = ContainingRectangle(shapes.orientedRectangles[i]);
+        mins[s] = GetMin(bounds);
+        maxs[s] = GetMax(bounds);
+    }
+
+    vec2 levelMin(FLT_MAX, FLT_MAX);
+    vec2 levelMax(-FLT_MAX, -FLT_MAX);
+    float extentSum = 0.0f;
+    for (int i = 0; i < shapeCount; i++) {
+        levelMin = vec2(fminf(levelMin.x, mins[i].x),
+                        fminf(levelMin.y, mins[i].y));
+        levelMax = vec2(fmaxf(levelMax.x, maxs[i].x),
+                        fmaxf(levelMax.y, maxs[i].y));
+        extentSum += fmaxf(maxs[i].x - mins[i].x, maxs[i].y - mins[i].y);
+    }
+    if (shapeCount == 0) {
+        levelMin = levelMax = vec2();
+    }
+    vec2 levelSize = levelMax - levelMin;
+
+    // Aim for a few shapes per cell, but keep cells at least as large as
+    // an average shape so big pieces don't land in dozens of cells
+    if (cellSize <= 0.0f && shapeCount > 0) {
+        cellSize = fmaxf(sqrtf(4.0f * levelSize.x * levelSize.y / shapeCount),
+                         extentSum / shapeCount);
+    }
+    if (cellSize <= 0.0f) {
+        cellSize = fmaxf(1.0f, fmaxf(levelSize.x, levelSize.y));
+    }
+
+    BakeGrid grid;
+    grid.min = levelMin;
+    for (;;) {
+        double columns = floor(levelSize.x / cellSize) + 1.0;
+        double rows = floor(levelSize.y / cellSize) + 1.0;
+        if (columns * rows <= (double)COLLISION_FILE_MAX_CELLS) {
+            grid.columns = (int)columns;
+            grid.rows = (int)rows;
+            break;
+        }
+        cellSize *= 1.5f;
+    }
+    grid.cellSize = cellSize;
+    grid.invCellSize = 1.0f / cellSize;
+    int cellCount = grid.columns * grid.rows;
+
+    // Counting pass, then a fill pass into the prefix sums
+    std::vector<Polygon2D> polygons(exactCells ?
+                                    shapes.orientedRectangleCount : 0);
+    for (size_t i = 0; i < polygons.size(); i++) {
+        polygons[i] = ToPolygon2D(shapes.orientedRectangles[i]);
+    }
+    cellStart.assign(cellCount + 1, 0);
+    cellRefs.clear();
+    for (int pass = 0; pass < 2; pass++) {
+        std::vector<uint32_t> cursor;
+        if (pass == 1) {
+            for (int i = 0; i < cellCount; i++) {
+                cellStart[i + 1] += cellStart[i];
+            }
+            cellRefs.resize(cellStart[cellCount]);
+            cursor.assign(cellStart.begin(), cellStart.end() - 1);
+        }
+        uint32_t ref = 0;
+        auto visit = [&](int cell) {
+            if (pass == 0) {
+                cellStart[cell + 1]++;
+            } else {
+                cellRefs[cursor[cell]++] = ref;
+            }
+        };
+
+        s = 0;
+        for (int i = 0; i < shapes.lineCount; i++, s++) {
+            const Line2D& line = shapes.lines[i];
+            ref = MakeRef(SWEPT_LINE, i);
+            VisitCells(grid, mins[s], maxs[s], [&](const Rectangle2D& cell) {
+                return !exactCells || LineRectangle(line, cell);
+            }, visit);
+        }
+        for (int i = 0; i < shapes.rectangleCount; i++, s++) {
+            ref = MakeRef(SWEPT_RECTANGLE, i);
+            VisitCells(grid, mins[s], maxs[s], [](const Rectangle2D&) {
+                return true;
+            }, visit);
+        }
+        for (int i = 0; i < shapes.orientedRectangleCount; i++, s++) {
+            ref = MakeRef(SWEPT_ORIENTED_RECTANGLE, i);
+            VisitCells(grid, mins[s], maxs[s], [&](const Rectangle2D& cell) {
+                return !exactCells || RectanglePolygon2D(cell, polygons[i]);
+            }, visit);
+        }
+    }
+
+    memset(&header, 0, sizeof(header));
+    header.magic = COLLISION_FILE_MAGIC;
+    header.version = COLLISION_FILE_VERSION;
+    header.lineCount = (uint32_t)shapes.lineCount;
+    header.rectangleCount = (uint32_t)shapes.rectangleCount;
+    header.orientedRectangleCount = (uint32_t)shapes.orientedRectangleCount;
+    header.refCount = (uint32_t)cellRefs.size();
+    header.gridMinX = grid.min.x;
+    header.gridMinY = grid.min.y;
+    header.cellSize = grid.cellSize;
+    header.invCellSize = grid.invCellSize;
+    header.columns = (uint32_t)grid.columns;
+    header.rows = (uint32_t)grid.rows;
+
+    uint64_t offset = sizeof(header);
+    header.linesOffset = AlignOffset(offset);
+    offset = header.linesOffset + sizeof(Line2D) * header.lineCount;
+    header.rectanglesOffset = AlignOffset(offset);
+    offset = header.rectanglesOffset +
+        sizeof(Rectangle2D) * header.rectangleCount;
+    header.orientedRectanglesOffset = AlignOffset(offset);
+    offset = header.orientedRectanglesOffset +
+        sizeof(OrientedRectangle) * header.orientedRectangleCount;
+    header.cellStartOffset = AlignOffset(offset);
+    offset = header.cellStartOffset + sizeof(uint32_t) * cellStart.size();
+    header.cellRefsOffset = AlignOffset(offset);
+    header.fileSize = header.cellRefsOffset +
+        sizeof(uint32_t) * cellRefs.size();
+    return true;
+}
+
+bool BakeCollisionFile(const char* path, const SweptTargets& shapes,
+                       float cellSize)
+{
+    PROFILE_FUNCTION();
+    CollisionFileHeader header;
+    std::vector<uint32_t> cellStart;
+    std::vector<uint32_t> cellRefs;
+    if (!BakeLayout(shapes, cellSize, true, header, cellStart, cellRefs)) {
+        return false;
+    }
+
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        return false;
+    }
+    uint64_t offset = 0;
+    bool ok = WritePadded(file, &header, sizeof(header), &offset) &&
+        WritePadded(file, shapes.lines,
+                    sizeof(Line2D) * header.lineCount, &offset) &&
+        WritePadded(file, shapes.rectangles,
+                    sizeof(Rectangle2D) * header.rectangleCount, &offset) &&
+        WritePadded(file, shapes.orientedRectangles,
+                    sizeof(OrientedRectangle) * header.orientedRectangleCount,
+                    &offset) &&
+        WritePadded(file, &cellStart[0],
+                    sizeof(uint32_t) * cellStart.size(), &offset) &&
+        WritePadded(file, cellRefs.empty() ? 0 : &cellRefs[0],
+                    sizeof(uint32_t) * cellRefs.size(), &offset);
+    ok = (fclose(file) == 0) && ok;
+    return ok && offset == header.fileSize;
+}
+
+static void CopySection(uint8_t* image, uint64_t offset, const void* data,
+                        size_t size)
+{
+    if (size > 0) {
+        memcpy(image + offset, data, size);
+    }
+}
+
+bool BakeCollisionMemory(const SweptTargets& shapes,
+                         std::vector<uint8_t>& buffer, const void** image,
+                         size_t* size, float cellSize, bool exactCells)
+{
+    PROFILE_FUNCTION();
+    CollisionFileHeader header;
+    std::vector<uint32_t> cellStart;
+    std::vector<uint32_t> cellRefs;
+    if (!BakeLayout(shapes, cellSize, exactCells, header, cellStart,
+                    cellRefs)) {
+        return false;
+    }
+
+    buffer.resize((size_t)header.fileSize + COLLISION_FILE_ALIGN - 1);
+    uint8_t* base = &buffer[0];
+    base += AlignOffset((uint64_t)(uintptr_t)base) - (uint64_t)(uintptr_t)base;
+    memset(base, 0, (size_t)header.fileSize);
+    CopySection(base, 0, &header, sizeof(header));
+    CopySection(base, header.linesOffset, shapes.lines,
+                sizeof(Line2D) * header.lineCount);
+    CopySection(base, header.rectanglesOffset, shapes.rectangles,
+                sizeof(Rectangle2D) * header.rectangleCount);
+    CopySection(base, header.orientedRectanglesOffset,
+                shapes.orientedRectangles,
+                sizeof(OrientedRectangle) * header.orientedRectangleCount);
+    CopySection(base, header.cellStartOffset, &cellStart[0],
+                sizeof(uint32_t) * cellStart.size());
+    CopySection(base, header.cellRefsOffset,
+                cellRefs.empty() ? 0 : &cellRefs[0],
+                sizeof(uint32_t) * cellRefs.size());
+    *image = base;
+    *size = (size_t)header.fileSize;
+    return true;
+}
+
+/* CollisionFile */
+
+CollisionFile::CollisionFile() :
+    m_data(0), m_size(0), m_mapped(false), m_header(0), m_lines(0),
+    m_rectangles(0), m_orientedRectangles(0), m_cellStart(0), m_cellRefs(0)
+{
+}
+
+CollisionFile::~CollisionFile()
+{
+    Close();
+}
+
+bool CollisionFile::Open(const char* path)
+{
+    PROFILE_FUNCTION();
+    Close();
+    void* data = 0;
+    size_t size = 0;
+
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) {
+        HANDLE mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+        if (mapping) {
+            data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            size = (size_t)fileSize.QuadPart;
+            CloseHandle(mapping);
+        }
+    }
+    CloseHandle(file);
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        size = (size_t)info.st_size;
+        data = mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED) {
+            data = 0;
+        }
+    }
+    close(fd);
+#endif
+
+    if (!data) {
+        return false;
+    }
+    m_mapped = true;
+    if (!Bind(data, size)) {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+bool CollisionFile::OpenMemory(const void* data, size_t size)
+{
+    Close();
+    if (!data || ((uintptr_t)data & (COLLISION_FILE_ALIGN - 1)) != 0) {
+        return false;
+    }
+    if (!Bind(data, size)) {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void CollisionFile::Close()
+{
+    if (m_mapped && m_data) {
+#if defined(_WIN32)
+        UnmapViewOfFile(m_data);
+#else
+        munmap((void*)m_data, m_size);
+#endif
+    }
+    m_data = 0;
+    m_size = 0;
+    m_mapped = false;
+    m_header = 0;
+    m_lines = 0;
+    m_rectangles = 0;
+    m_orientedRectangles = 0;
+    m_cellStart = 0;
+    m_cellRefs = 0;
+}
+
+static bool SectionFits(uint64_t offset, uint64_t count, uint64_t stride,
+                        uint64_t size)
+{
+    return (offset & (COLLISION_FILE_ALIGN - 1)) == 0 && offset <= size &&
+        count <= (size - offset) / stride;
+}
+
+// Validates the header and section bounds only; the payload is trusted,
+// reading it all would defeat mapping the file
+bool CollisionFile::Bind(const void* data, size_t size)
+{
+    m_data = data;
+    m_size = size;
+    if (!IsLittleEndian() || size < sizeof(CollisionFileHeader)) {
+        return false;
+    }
+
+    const CollisionFileHeader* header = (const CollisionFileHeader*)data;
+    uint64_t cellCount = (uint64_t)header->columns * header->rows;
+    if (header->magic != COLLISION_FILE_MAGIC ||
+        header->version != COLLISION_FILE_VERSION ||
+        header->fileSize != size ||
+        header->columns == 0 || header->rows == 0 ||
+        cellCount > COLLISION_FILE_MAX_CELLS ||
+        !(header->cellSize > 0.0f) ||
+        !SectionFits(header->linesOffset, header->lineCount,
+                     sizeof(Line2D), size) ||
+        !SectionFits(header->rectanglesOffset, header->rectangleCount,
+                     sizeof(Rectangle2D), size) ||
+        !SectionFits(header->orientedRectanglesOffset,
+                     header->orientedRectangleCount,
+                     sizeof(OrientedRectangle), size) ||
+        !SectionFits(header->cellStartOffset, cellCount + 1,
+                     sizeof(uint32_t), size) ||
+        !SectionFits(header->cellRefsOffset, header->refCount,
+                     sizeof(uint32_t), size)) {
+        return false;
+    }
+
+    const char* base = (const char*)data;
+    m_header = header;
+    m_lines = (const Line2D*)(base + header->linesOffset);
+    m_rectangles = (const Rectangle2D*)(base + header->rectanglesOffset);
+    m_orientedRectangles =
+        (const OrientedRectangle*)(base + header->orientedRectanglesOffset);
+    m_cellStart = (const uint32_t*)(base + header->cellStartOffset);
+    m_cellRefs = (const uint32_t*)(base + header->cellRefsOffset);
+    return m_cellStart[cellCount] == header->refCount;
+}
+
+int CollisionFile::LineCount() const
+{
+    return m_header ? (int)m_header->lineCount : 0;
+}
+
+int CollisionFile::RectangleCount() const
+{
+    return m_header ? (int)m_header->rectangleCount : 0;
+}
+
+int CollisionFile::OrientedRectangleCount() const
+{
+    return m_header ? (int)m_header->orientedRectangleCount : 0;
+}
+
+SweptTargets CollisionFile::Targets() const
+{
+    SweptTargets result;
+    result.lines = m_lines;
+    result.lineCount = LineCount();
+    result.rectangles = m_rectangles;
+    result.rectangleCount = RectangleCount();
+    result.orientedRectangles = m_orientedRectangles;
+    result.orientedRectangleCount = OrientedRectangleCount();
+    return result;
+}
+
+// Sorted, unique refs of every cell overlapping min/max
+void CollisionFile::GatherRefs(const vec2& min, const vec2& max,
+                               ArenaVector<uint32_t>& refs) const
+{
+    if (!m_header) {
+        return;
+    }
+    const CollisionFileHeader& h = *m_header;
+    float fx0 = floorf((min.x - h.gridMinX) * h.invCellSize);
+    float fy0 = floorf((min.y - h.gridMinY) * h.invCellSize);
+    float fx1 = floorf((max.x - h.gridMinX) * h.invCellSize);
+    float fy1 = floorf((max.y - h.gridMinY) * h.invCellSize);
+    if (fx1 < 0.0f || fy1 < 0.0f ||
+        fx0 >= (float)h.columns || fy0 >= (float)h.rows) {
+        return;
+    }
+    int x0 = std::max(0, (int)fx0);
+    int y0 = std::max(0, (int)fy0);
+    int x1 = std::min((int)h.columns - 1, (int)fx1);
+    int y1 = std::min((int)h.rows - 1, (int)fy1);
+
+    for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) {
+            int cell = y * (int)h.columns + x;
+            refs.insert(refs.end(), m_cellRefs + m_cellStart[cell],
+                        m_cellRefs + m_cellStart[cell + 1]);
+        }
+    }
+    if (x0 != x1 || y0 != y1) {
+        std::sort(refs.begin(), refs.end());
+        refs.erase(std::unique(refs.begin(), refs.end()), refs.end());
+    }
+}
+
+ArenaVector<StaticShapeRef> CollisionFile::QueryCandidates(
+        const Rectangle2D& area, FrameArena* arena) const
+{
+    PROFILE_FUNCTION();
+    ArenaVector<uint32_t> refs((ArenaAllocator<uint32_t>(arena)));
+    GatherRefs(GetMin(area), GetMax(area), refs);
+
+    ArenaVector<StaticShapeRef> result((ArenaAllocator<StaticShapeRef>(arena)));
+    result.reserve(refs.size());
+    for (size_t i = 0; i < refs.size(); i++) {
+        result.push_back(ToShapeRef(refs[i]));
+    }
+    return result;
+}
+
+ArenaVector<StaticShapeRef> CollisionFile::QueryPoint(const Point2D& point,
+                                                      FrameArena* arena) const
+{
+    PROFILE_FUNCTION();
+    ArenaVector<uint32_t> refs((ArenaAllocator<uint32_t>(arena)));
+    GatherRefs(point, point, refs);
+
+    ArenaVector<StaticShapeRef> result((ArenaAllocator<StaticShapeRef>(arena)));
+    for (size_t i = 0; i < refs.size(); i++) {
+        StaticShapeRef ref = ToShapeRef(refs[i]);
+        if ((ref.type == SWEPT_RECTANGLE &&
+             PointInRectangle2D(point, m_rectangles[ref.index])) ||
+            (ref.type == SWEPT_ORIENTED_RECTANGLE &&
+             PointInOrientedRectangle(point,
+                                      m_orientedRectangles[ref.index]))) {
+            result.push_back(ref);
+        }
+    }
+    return result;
+}
+
+ArenaVector<StaticShapeRef> CollisionFile::QueryLine(const Line2D& line,
+                                                     FrameArena* arena) const
+{
+    PROFILE_FUNCTION();
+    Rectangle2D bounds = ContainingRectangle(line);
+    ArenaVector<uint32_t> refs((ArenaAllocator<uint32_t>(arena)));
+    GatherRefs(GetMin(bounds), GetMax(bounds), refs);
+
+    ArenaVector<StaticShapeRef> result((ArenaAllocator<StaticShapeRef>(arena)));
+    for (size_t i = 0; i < refs.size(); i++) {
+        StaticShapeRef ref = ToShapeRef(refs[i]);
+        bool hit = false;
+        switch (ref.type) {
+        case SWEPT_LINE:
+            hit = LineLine(m_lines[ref.index], line);
+            break;
+        case SWEPT_RECTANGLE:
+            hit = LineRectangle(line, m_rectangles[ref.index]);
+            break;
+        case SWEPT_ORIENTED_RECTANGLE:
+            hit = LineOrientedRectangle(line, m_orientedRectangles[ref.index]);
+            break;
+        }
+        if (hit) {
+            result.push_back(ref);
+        }
+    }
+    return result;
+}
+
+ArenaVector<StaticShapeRef> CollisionFile::QueryCircle(const Circle& circle,
+                                                       FrameArena* arena) const
+{
+    PROFILE_FUNCTION();
+    vec2 extent(circle.radius, circle.radius);
+    ArenaVector<uint32_t> refs((ArenaAllocator<uint32_t>(arena)));
+    GatherRefs(circle.center - extent, circle.center + extent, refs);
+
+    ArenaVector<StaticShapeRef> result((ArenaAllocator<StaticShapeRef>(arena)));
+    for (size_t i = 0; i < refs.size(); i++) {
+        StaticShapeRef ref = ToShapeRef(refs[i]);
+        bool hit = false;
+        switch (ref.type) {
+        case SWEPT_LINE:
+            hit = CircleLine(m_lines[ref.index], circle);
+            break;
+        case SWEPT_RECTANGLE:
+            hit = CircleRectangle(circle, m_rectangles[ref.index]);
+            break;
+        case SWEPT_ORIENTED_RECTANGLE:
+            hit = CircleOrientedRectangle(circle,
+                                          m_orientedRectangles[ref.index]);
+            break;
+        }
+        if (hit) {
+            result.push_back(ref);
+        }
+    }
+    return result;
+}
+
+ArenaVector<SweptHit> CollisionFile::QuerySweptCircles(
+        const Circle* movers, const vec2* velocities, int count,
+        FrameArena* arena) const
+{
+    PROFILE_FUNCTION();
+    ArenaVector<SweptHit> hits((ArenaAllocator<SweptHit>(arena)));
+    hits.reserve(count);
+
+    // The candidate lists are scratch, rewind the arena past them once done
+    size_t marker = arena ? arena->GetMarker() : 0;
+    {
+        ArenaVector<uint32_t> refs((ArenaAllocator<uint32_t>(arena)));
+        for (int i = 0; i < count; i++) {
+            const Circle& mover = movers[i];
+            const vec2& velocity = velocities[i];
+            vec2 end = mover.center + velocity;
+            vec2 reach(mover.radius, mover.radius);
+            vec2 sweepMin = vec2(fminf(mover.center.x, end.x),
+                                 fminf(mover.center.y, end.y)) - reach;
+            vec2 sweepMax = vec2(fmaxf(mover.center.x, end.x),
+                                 fmaxf(mover.center.y, end.y)) + reach;
+            refs.clear();
+            GatherRefs(sweepMin, sweepMax, refs);
+
+            // Ties go to the lowest reference, the order SweptCircles
+            // visits the shapes in
+            SweptHit best;
+            best.mover = i;
+            best.type = SWEPT_LINE;
+            best.target = -1;
+            best.toi = 2.0f;
+            uint32_t bestRef = 0;
+            for (size_t j = 0; j < refs.size(); j++) {
+                StaticShapeRef ref = ToShapeRef(refs[j]);
+                float t = 2.0f;
+                bool hit = false;
+                switch (ref.type) {
+                case SWEPT_LINE:
+                    hit = SweptCircleLine(mover, velocity,
+                                          m_lines[ref.index], &t);
+                    break;
+                case SWEPT_RECTANGLE:
+                    hit = SweptCircleRectangle(mover, velocity,
+                                               m_rectangles[ref.index], &t);
+                    break;
+                case SWEPT_ORIENTED_RECTANGLE:
+                    hit = SweptCircleOrientedRectangle(
+                            mover, velocity,
+                            m_orientedRectangles[ref.index], &t);
+                    break;
+                }
+                if (hit && (t < best.toi ||
+                            (t == best.toi && refs[j] < bestRef))) {
+                    best.type = ref.type;
+                    best.target = ref.index;
+                    best.toi = t;
+                    bestRef = refs[j];
+                }
+            }
+            if (best.target >= 0) {
+                hits.push_back(best);
+            }
+        }
+    }
+    if (arena) {
+        arena->FreeToMarker(marker);
+    }
+    return hits;
+}
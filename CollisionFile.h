@@ -0,0 +1,129 @@
+#ifndef _H_COLLISION_FILE_
+#define _H_COLLISION_FILE_
+
+#include "Geometry2D.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/* Baked static level geometry.
+ *
+ * BakeCollisionFile runs offline (or once per map change) and writes the
+ * static lines and rectangles of a level together with a uniform grid
+ * over them. The file holds no pointers: every section is addressed by
+ * its byte offset from the start of the file and is 16 byte aligned, so
+ * CollisionFile::Open maps it read-only and queries it in place. Opening
+ * a map costs a header check, and every process that opens the same file
+ * shares one copy of it in the page cache.
+ *
+ * The format is little endian and versioned by COLLISION_FILE_VERSION;
+ * Open rejects files written by another version, so bump it whenever the
+ * layout or any baked struct changes. Baking and opening fail on big
+ * endian hosts, and a file read with the wrong byte order fails the magic
+ * check.
+ */
+
+#define COLLISION_FILE_MAGIC 0x46435047u // "GPCF"
+#define COLLISION_FILE_VERSION 1u
+#define COLLISION_FILE_MAX_CELLS (1 << 22)
+
+/* Baked shape reference: the shape type in the top two bits, its index in
+ * the shape array of that type below */
+#define COLLISION_REF_SHIFT 30
+#define COLLISION_REF_INDEX_MASK ((1u << COLLISION_REF_SHIFT) - 1u)
+
+typedef struct StaticShapeRef
+{
+    SweptTargetType type;
+    int index;
+} StaticShapeRef;
+
+/* `cellSize` of 0 picks one from the density of the shapes */
+bool BakeCollisionFile(const char* path, const SweptTargets& shapes,
+                       float cellSize = 0.0f);
+/* The same bake into `buffer`, reusing its capacity. The image starts at
+ * the first 16 byte aligned byte of the buffer and is returned in `image`
+ * and `size`, ready for CollisionFile::OpenMemory.
+ *
+ * With `exactCells` false a shape is listed in every grid cell its bounds
+ * cover rather than only the cells it touches. Queries then test a few
+ * more candidates and give the same results, and the bake skips the
+ * overlap test per shape and cell, for images rebuilt every step. */
+bool BakeCollisionMemory(const SweptTargets& shapes,
+                         std::vector<uint8_t>& buffer, const void** image,
+                         size_t* size, float cellSize = 0.0f,
+                         bool exactCells = true);
+
+struct CollisionFileHeader;
+
+class CollisionFile {
+public:
+    CollisionFile();
+    ~CollisionFile();
+
+    /* Maps a baked file, false if it is missing or fails validation */
+    bool Open(const char* path);
+    /* Uses baked data already in memory; it must outlive the queries */
+    bool OpenMemory(const void* data, size_t size);
+    void Close();
+    bool IsOpen() const { return m_data != 0; }
+    const void* Data() const { return m_data; }
+    size_t Size() const { return m_size; }
+
+    const Line2D* Lines() const { return m_lines; }
+    int LineCount() const;
+    const Rectangle2D* Rectangles() const { return m_rectangles; }
+    int RectangleCount() const;
+    const OrientedRectangle* OrientedRectangles() const
+    {
+        return m_orientedRectangles;
+    }
+    int OrientedRectangleCount() const;
+
+    /* The baked shapes as SweptCircles targets. For sweeps against a
+     * whole level prefer QuerySweptCircles. */
+    SweptTargets Targets() const;
+
+    /* Every shape sharing a grid cell with `area`, without duplicates */
+    ArenaVector<StaticShapeRef> QueryCandidates(const Rectangle2D& area,
+                                                FrameArena* arena = 0) const;
+
+    /* Shapes touching the query shape. Lines have no area, so QueryPoint
+     * only reports rectangles. */
+    ArenaVector<StaticShapeRef> QueryPoint(const Point2D& point,
+                                           FrameArena* arena = 0) const;
+    ArenaVector<StaticShapeRef> QueryLine(const Line2D& line,
+                                          FrameArena* arena = 0) const;
+    ArenaVector<StaticShapeRef> QueryCircle(const Circle& circle,
+                                            FrameArena* arena = 0) const;
+    /* SweptCircles against the baked shapes, with the same hits. Each
+     * mover only tests the shapes in the grid cells its swept bounds
+     * cover, so the cost follows the shapes near the sweeps rather than
+     * the size of the level. */
+    ArenaVector<SweptHit> QuerySweptCircles(const Circle* movers,
+                                            const vec2* velocities,
+                                            int count,
+                                            FrameArena* arena = 0) const;
+
+private:
+    CollisionFile(const CollisionFile&);
+    CollisionFile& operator=(const CollisionFile&);
+
+    bool Bind(const void* data, size_t size);
+    void GatherRefs(const vec2& min, const vec2& max,
+                    ArenaVector<uint32_t>& refs) const;
+
+    const void* m_data;
+    size_t m_size;
+    bool m_mapped;
+
+    const CollisionFileHeader* m_header;
+    const Line2D* m_lines;
+    const Rectangle2D* m_rectangles;
+    const OrientedRectangle* m_orientedRectangles;
+    const uint32_t* m_cellStart;
+    const uint32_t* m_cellRefs;
+};
+
+#endif
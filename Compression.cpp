@@ -0,0 +1,474 @@
+#include "Compression.h"
+#include "Profiler.h"
+
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+static_assert(sizeof(vec3) == 3 * sizeof(float), "vec3 must be packed");
+static_assert(sizeof(QuantizedPosition) == 3 * sizeof(uint16_t),
+              "QuantizedPosition must be packed");
+
+#define NORMAL_COMPONENT_MAX 32767.0f
+#define ROTATION_COMPONENT_MAX 1023
+#define ROTATION_COMPONENT_RANGE 0.70710678f // 1 / sqrt(2)
+
+/* The SSE2 paths round with the default round-to-nearest-even mode, the
+ * scalar paths use lrintf for the same rounding so both agree bit for
+ * bit.
+ */
+
+static inline float ClampPositionStep(float value)
+{
+    return fminf(fmaxf(value, 0.0f), QUANTIZED_POSITION_STEPS);
+}
+
+QuantizedPosition QuantizePosition(const vec3& position, const vec3& origin,
+                                   float cellSize)
+{
+    float scale = QUANTIZED_POSITION_STEPS / cellSize;
+    return QuantizedPosition(
+        (uint16_t)lrintf(ClampPositionStep((position.x - origin.x) * scale)),
+        (uint16_t)lrintf(ClampPositionStep((position.y - origin.y) * scale)),
+        (uint16_t)lrintf(ClampPositionStep((position.z - origin.z) * scale)));
+}
+
+vec3 DequantizePosition(const QuantizedPosition& position,
+                        const vec3& origin, float cellSize)
+{
+    float step = cellSize / QUANTIZED_POSITION_STEPS;
+    return vec3((float)position.x * step + origin.x,
+                (float)position.y * step + origin.y,
+                (float)position.z * step + origin.z);
+}
+
+/* Octahedral mapping: project onto the octahedron |x| + |y| + |z| = 1,
+ * then fold the lower half over the diagonals of the upper half.
+ */
+uint32_t EncodeNormal(const vec3& normal)
+{
+    float invL1 = 1.0f / (fabsf(normal.x) + fabsf(normal.y) +
+                          fabsf(normal.z));
+    float x = normal.x * invL1;
+    float y = normal.y * invL1;
+    if (normal.z < 0.0f) {
+        float fx = copysignf(1.0f - fabsf(y), x);
+        float fy = copysignf(1.0f - fabsf(x), y);
+        x = fx;
+        y = fy;
+    }
+    uint32_t ex = (uint16_t)(int16_t)lrintf(x * NORMAL_COMPONENT_MAX);
+    uint32_t ey = (uint16_t)(int16_t)lrintf(y * NORMAL_COMPONENT_MAX);
+    return ex | (ey << 16);
+}
+
+vec3 DecodeNormal(uint32_t normal)
+{
+    float x = fmaxf((float)(int16_t)(normal & 0xFFFF) *
+                    (1.0f / NORMAL_COMPONENT_MAX), -1.0f);
+    float y = fmaxf((float)(int16_t)(normal >> 16) *
+                    (1.0f / NORMAL_COMPONENT_MAX), -1.0f);
+    float z = 1.0f - fabsf(x) - fabsf(y);
+    float t = fmaxf(-z, 0.0f);
+    x -= copysignf(t, x);
+    y -= copysignf(t, y);
+    float invLen = 1.0f / sqrtf(x * x + y * y + z * z);
+    return vec3(x * invLen, y * invLen, z * invLen);
+}
+
+/* Quaternions here are float[4] as x, y, z, w. Matrices transform row
+ * vectors, so they hold the transpose of the usual column vector form.
+ */
+static void ToQuaternion(const mat3& m, float* q)
+{
+    float trace = m._11 + m._22 + m._33;
+    if (trace > 0.0f) {
+        float s = 0.5f / sqrtf(1.0f + trace);
+        q[0] = (m._23 - m._32) * s;
+        q[1] = (m._31 - m._13) * s;
+        q[2] = (m._12 - m._21) * s;
+        q[3] = 0.25f / s;
+    }
+    else if (m._11 > m._22 && m._11 > m._33) {
+        float s = 0.5f / sqrtf(1.0f + m._11 - m._22 - m._33);
+        q[0] = 0.25f / s;
+        q[1] = (m._12 + m._21) * s;
+        q[2] = (m._13 + m._31) * s;
+        q[3] = (m._23 - m._32) * s;
+    }
+    else if (m._22 > m._33) {
+        float s = 0.5f / sqrtf(1.0f - m._11 + m._22 - m._33);
+        q[0] = (m._12 + m._21) * s;
+        q[1] = 0.25f / s;
+        q[2] = (m._23 + m._32) * s;
+        q[3] = (m._31 - m._13) * s;
+    }
+    else {
+        float s = 0.5f / sqrtf(1.0f - m._11 - m._22 + m._33);
+        q[0] = (m._13 + m._31) * s;
+        q[1] = (m._23 + m._32) * s;
+        q[2] = 0.25f / s;
+        q[3] = (m._12 - m._21) * s;
+    }
+}
+
+static mat3 FromQuaternion(const float* q)
+{
+    float x = q[0], y = q[1], z = q[2], w = q[3];
+    return mat3(
+        1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + w * z),
+        2.0f * (x * z - w * y),
+        2.0f * (x * y - w * z), 1.0f - 2.0f * (x * x + z * z),
+        2.0f * (y * z + w * x),
+        2.0f * (x * z + w * y), 2.0f * (y * z - w * x),
+        1.0f - 2.0f * (x * x + y * y)
+        );
+}
+
+uint32_t EncodeRotation(const mat3& rotation)
+{
+    float q[4];
+    ToQuaternion(rotation, q);
+
+    int largest = 0;
+    for (int i = 1; i < 4; i++) {
+        if (fabsf(q[i]) > fabsf(q[largest])) {
+            largest = i;
+        }
+    }
+    // q and -q are the same rotation, keep the largest one positive
+    float sign = (q[largest] < 0.0f) ? -1.0f : 1.0f;
+    float invLen = sign / sqrtf(q[0] * q[0] + q[1] * q[1] +
+                                q[2] * q[2] + q[3] * q[3]);
+
+    uint32_t result = (uint32_t)largest << 30;
+    int shift = 20;
+    for (int i = 0; i < 4; i++) {
+        if (i == largest) {
+            continue;
+        }
+        float v = q[i] * invLen * (1.0f / ROTATION_COMPONENT_RANGE);
+        long k = lrintf((v + 1.0f) * 0.5f * ROTATION_COMPONENT_MAX);
+        k = (k < 0) ? 0 : (k > ROTATION_COMPONENT_MAX ?
+                           ROTATION_COMPONENT_MAX : k);
+        result |= (uint32_t)k << shift;
+        shift -= 10;
+    }
+    return result;
+}
+
+uint32_t EncodeRotation(const mat4& rotation)
+{
+    return EncodeRotation(mat3(rotation._11, rotation._12, rotation._13,
+                               rotation._21, rotation._22, rotation._23,
+                               rotation._31, rotation._32, rotation._33));
+}
+
+mat3 DecodeRotation(uint32_t rotation)
+{
+    int largest = (int)(rotation >> 30);
+    float q[4];
+    float sumSq = 0.0f;
+    int shift = 20;
+    for (int i = 0; i < 4; i++) {
+        if (i == largest) {
+            continue;
+        }
+        uint32_t k = (rotation >> shift) & ROTATION_COMPONENT_MAX;
+        q[i] = ((float)k * (2.0f / ROTATION_COMPONENT_MAX) - 1.0f) *
+               ROTATION_COMPONENT_RANGE;
+        sumSq += q[i] * q[i];
+        shift -= 10;
+    }
+    q[largest] = sqrtf(fmaxf(1.0f - sumSq, 0.0f));
+
+    // Rounding can leave the three stored components slightly too long
+    float invLen = 1.0f / sqrtf(sumSq + q[largest] * q[largest]);
+    for (int i = 0; i < 4; i++) {
+        q[i] *= invLen;
+    }
+    return FromQuaternion(q);
+}
+
+PackedTransform PackTransform(const mat4& transform, const vec3& origin,
+                              float cellSize)
+{
+    PackedTransform result;
+    result.rotation = EncodeRotation(transform);
+    result.position = QuantizePosition(
+            vec3(transform._41, transform._42, transform._43),
+            origin, cellSize);
+    return result;
+}
+
+mat4 UnpackTransform(const PackedTransform& transform, const vec3& origin,
+                     float cellSize)
+{
+    mat3 r = DecodeRotation(transform.rotation);
+    vec3 t = DequantizePosition(transform.position, origin, cellSize);
+    return mat4(
+        r._11, r._12, r._13, 0.0f,
+        r._21, r._22, r._23, 0.0f,
+        r._31, r._32, r._33, 0.0f,
+        t.x, t.y, t.z, 1.0f
+        );
+}
+
+Affine3x4 ToAffine(const mat4& matrix)
+{
+    Affine3x4 result;
+    for (int i = 0; i < 4; i++) {
+        result.asArray[i * 3 + 0] = matrix.asArray[i * 4 + 0];
+        result.asArray[i * 3 + 1] = matrix.asArray[i * 4 + 1];
+        result.asArray[i * 3 + 2] = matrix.asArray[i * 4 + 2];
+    }
+    return result;
+}
+
+mat4 ToMat4(const Affine3x4& affine)
+{
+    return mat4(
+        affine._11, affine._12, affine._13, 0.0f,
+        affine._21, affine._22, affine._23, 0.0f,
+        affine._31, affine._32, affine._33, 0.0f,
+        affine._41, affine._42, affine._43, 1.0f
+        );
+}
+
+Affine3x4 operator*(const Affine3x4& m1, const Affine3x4& m2)
+{
+    Affine3x4 result;
+    for (int i = 0; i < 4; i++) {
+        const float* row = &m1.asArray[i * 3];
+        for (int j = 0; j < 3; j++) {
+            result.asArray[i * 3 + j] = row[0] * m2.asArray[j] +
+                                        row[1] * m2.asArray[3 + j] +
+                                        row[2] * m2.asArray[6 + j];
+        }
+    }
+    // The last row of m1 is a point, so it picks up m2's translation
+    result._41 += m2._41;
+    result._42 += m2._42;
+    result._43 += m2._43;
+    return result;
+}
+
+vec3 MultiplyPoint(const vec3& point, const Affine3x4& affine)
+{
+    vec3 result = MultiplyVector(point, affine);
+    result.x += affine._41;
+    result.y += affine._42;
+    result.z += affine._43;
+    return result;
+}
+
+vec3 MultiplyVector(const vec3& vec, const Affine3x4& affine)
+{
+    return vec3(vec.x * affine._11 + vec.y * affine._21 + vec.z * affine._31,
+                vec.x * affine._12 + vec.y * affine._22 + vec.z * affine._32,
+                vec.x * affine._13 + vec.y * affine._23 + vec.z * affine._33);
+}
+
+/* Batch versions
+ *
+ * Four vec3 are twelve consecutive floats, so positions are processed as
+ * three registers against the origin rotated to match each one, without
+ * any shuffles.
+ */
+
+void QuantizePositions(const vec3* positions, const vec3& origin,
+                       float cellSize, QuantizedPosition* out, int count)
+{
+    PROFILE_FUNCTION();
+    int i = 0;
+#if defined(__SSE2__)
+    const __m128 scale = _mm_set1_ps(QUANTIZED_POSITION_STEPS / cellSize);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 steps = _mm_set1_ps(QUANTIZED_POSITION_STEPS);
+    const __m128 o0 = _mm_setr_ps(origin.x, origin.y, origin.z, origin.x);
+    const __m128 o1 = _mm_setr_ps(origin.y, origin.z, origin.x, origin.y);
+    const __m128 o2 = _mm_setr_ps(origin.z, origin.x, origin.y, origin.z);
+    // packs is signed, so bias into int16 range and flip the top bit back
+    const __m128i bias = _mm_set1_epi32(32768);
+    const __m128i flip = _mm_set1_epi16((short)0x8000);
+
+    for (; i + 4 <= count; i += 4) {
+        const float* in = positions[i].asArray;
+        __m128 a = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(in), o0), scale);
+        __m128 b = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(in + 4), o1), scale);
+        __m128 c = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(in + 8), o2), scale);
+        a = _mm_min_ps(_mm_max_ps(a, zero), steps);
+        b = _mm_min_ps(_mm_max_ps(b, zero), steps);
+        c = _mm_min_ps(_mm_max_ps(c, zero), steps);
+
+        __m128i ia = _mm_sub_epi32(_mm_cvtps_epi32(a), bias);
+        __m128i ib = _mm_sub_epi32(_mm_cvtps_epi32(b), bias);
+        __m128i ic = _mm_sub_epi32(_mm_cvtps_epi32(c), bias);
+        __m128i ab = _mm_xor_si128(_mm_packs_epi32(ia, ib), flip);
+        __m128i cc = _mm_xor_si128(_mm_packs_epi32(ic, ic), flip);
+
+        uint16_t* dest = &out[i].x;
+        _mm_storeu_si128((__m128i*)dest, ab);
+        _mm_storel_epi64((__m128i*)(dest + 8), cc);
+    }
+#endif
+    for (; i < count; i++) {
+        out[i] = QuantizePosition(positions[i], origin, cellSize);
+    }
+}
+
+void DequantizePositions(const QuantizedPosition* positions,
+                         const vec3& origin, float cellSize,
+                         vec3* out, int count)
+{
+    PROFILE_FUNCTION();
+    int i = 0;
+#if defined(__SSE2__)
+    const __m128 step = _mm_set1_ps(cellSize / QUANTIZED_POSITION_STEPS);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 o0 = _mm_setr_ps(origin.x, origin.y, origin.z, origin.x);
+    const __m128 o1 = _mm_setr_ps(origin.y, origin.z, origin.x, origin.y);
+    const __m128 o2 = _mm_setr_ps(origin.z, origin.x, origin.y, origin.z);
+
+    for (; i + 4 <= count; i += 4) {
+        const uint16_t* in = &positions[i].x;
+        __m128i ab = _mm_loadu_si128((const __m128i*)in);
+        __m128i cc = _mm_loadl_epi64((const __m128i*)(in + 8));
+        __m128 a = _mm_cvtepi32_ps(_mm_unpacklo_epi16(ab, zero));
+        __m128 b = _mm_cvtepi32_ps(_mm_unpackhi_epi16(ab, zero));
+        __m128 c = _mm_cvtepi32_ps(_mm_unpacklo_epi16(cc, zero));
+
+        float* dest = out[i].asArray;
+        _mm_storeu_ps(dest, _mm_add_ps(_mm_mul_ps(a, step), o0));
+        _mm_storeu_ps(dest + 4, _mm_add_ps(_mm_mul_ps(b, step), o1));
+        _mm_storeu_ps(dest + 8, _mm_add_ps(_mm_mul_ps(c, step), o2));
+    }
+#endif
+    for (; i < count; i++) {
+        out[i] = DequantizePosition(positions[i], origin, cellSize);
+    }
+}
+
+void EncodeNormals(const vec3* normals, uint32_t* out, int count)
+{
+    PROFILE_FUNCTION();
+    int i = 0;
+#if defined(__SSE2__)
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 scale = _mm_set1_ps(NORMAL_COMPONENT_MAX);
+
+    for (; i + 4 <= count; i += 4) {
+        const vec3* n = normals + i;
+        __m128 x = _mm_setr_ps(n[0].x, n[1].x, n[2].x, n[3].x);
+        __m128 y = _mm_setr_ps(n[0].y, n[1].y, n[2].y, n[3].y);
+        __m128 z = _mm_setr_ps(n[0].z, n[1].z, n[2].z, n[3].z);
+
+        __m128 l1 = _mm_add_ps(_mm_add_ps(_mm_andnot_ps(sign, x),
+                                          _mm_andnot_ps(sign, y)),
+                               _mm_andnot_ps(sign, z));
+        __m128 invL1 = _mm_div_ps(one, l1);
+        x = _mm_mul_ps(x, invL1);
+        y = _mm_mul_ps(y, invL1);
+
+        // Fold the lanes in the lower hemisphere
+        __m128 fx = _mm_or_ps(_mm_sub_ps(one, _mm_andnot_ps(sign, y)),
+                              _mm_and_ps(sign, x));
+        __m128 fy = _mm_or_ps(_mm_sub_ps(one, _mm_andnot_ps(sign, x)),
+                              _mm_and_ps(sign, y));
+        __m128 lower = _mm_cmplt_ps(z, zero);
+        x = _mm_or_ps(_mm_and_ps(lower, fx), _mm_andnot_ps(lower, x));
+        y = _mm_or_ps(_mm_and_ps(lower, fy), _mm_andnot_ps(lower, y));
+
+        __m128i qx = _mm_cvtps_epi32(_mm_mul_ps(x, scale));
+        __m128i qy = _mm_cvtps_epi32(_mm_mul_ps(y, scale));
+        __m128i packed = _mm_unpacklo_epi16(_mm_packs_epi32(qx, qx),
+                                            _mm_packs_epi32(qy, qy));
+        _mm_storeu_si128((__m128i*)(out + i), packed);
+    }
+#endif
+    for (; i < count; i++) {
+        out[i] = EncodeNormal(normals[i]);
+    }
+}
+
+void DecodeNormals(const uint32_t* normals, vec3* out, int count)
+{
+    PROFILE_FUNCTION();
+    int i = 0;
+#if defined(__SSE2__)
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 minusOne = _mm_set1_ps(-1.0f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 scale = _mm_set1_ps(1.0f / NORMAL_COMPONENT_MAX);
+
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(normals + i));
+        __m128i qx = _mm_srai_epi32(_mm_slli_epi32(v, 16), 16);
+        __m128i qy = _mm_srai_epi32(v, 16);
+        __m128 x = _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(qx), scale),
+                              minusOne);
+        __m128 y = _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(qy), scale),
+                              minusOne);
+        __m128 z = _mm_sub_ps(_mm_sub_ps(one, _mm_andnot_ps(sign, x)),
+                              _mm_andnot_ps(sign, y));
+        __m128 t = _mm_max_ps(_mm_sub_ps(zero, z), zero);
+        x = _mm_sub_ps(x, _mm_or_ps(t, _mm_and_ps(sign, x)));
+        y = _mm_sub_ps(y, _mm_or_ps(t, _mm_and_ps(sign, y)));
+
+        __m128 lenSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x),
+                                             _mm_mul_ps(y, y)),
+                                  _mm_mul_ps(z, z));
+        __m128 invLen = _mm_div_ps(one, _mm_sqrt_ps(lenSq));
+
+        float ox[4], oy[4], oz[4];
+        _mm_storeu_ps(ox, _mm_mul_ps(x, invLen));
+        _mm_storeu_ps(oy, _mm_mul_ps(y, invLen));
+        _mm_storeu_ps(oz, _mm_mul_ps(z, invLen));
+        for (int j = 0; j < 4; j++) {
+            out[i + j] = vec3(ox[j], oy[j], oz[j]);
+        }
+    }
+#endif
+    for (; i < count; i++) {
+        out[i] = DecodeNormal(normals[i]);
+    }
+}
+
+void EncodeRotations(const mat3* rotations, uint32_t* out, int count)
+{
+    PROFILE_FUNCTION();
+    for (int i = 0; i < count; i++) {
+        out[i] = EncodeRotation(rotations[i]);
+    }
+}
+
+void DecodeRotations(const uint32_t* rotations, mat3* out, int count)
+{
+    PROFILE_FUNCTION();
+    for (int i = 0; i < count; i++) {
+        out[i] = DecodeRotation(rotations[i]);
+    }
+}
+
+void PackTransforms(const mat4* transforms, const vec3& origin,
+                    float cellSize, PackedTransform* out, int count)
+{
+    PROFILE_FUNCTION();
+    for (int i = 0; i < count; i++) {
+        out[i] = PackTransform(transforms[i], origin, cellSize);
+    }
+}
+
+void UnpackTransforms(const PackedTransform* transforms, const vec3& origin,
+                      float cellSize, mat4* out, int count)
+{
+    PROFILE_FUNCTION();
+    for (int i = 0; i < count; i++) {
+        out[i] = UnpackTransform(transforms[i], origin, cellSize);
+    }
+}
@@ -0,0 +1,118 @@
+#ifndef _H_COMPRESSION_
+#define _H_COMPRESSION_
+
+#include "vectors.h"
+#include "matrices.h"
+
+#include <stdint.h>
+
+/* Compact storage formats for transform data.
+ *
+ * - Positions are stored as 16 bit fixed point offsets from the origin of
+ *   a cell, 6 bytes instead of 12. The step is cellSize / 65535 and
+ *   positions outside the cell are clamped to its faces.
+ * - Unit normals use the octahedral mapping with two 16 bit signed
+ *   components, 4 bytes instead of 12. The worst case error is well under
+ *   0.01 degrees.
+ * - Rotations are stored as "smallest three" quaternions in 32 bits: the
+ *   index of the largest component in the top 2 bits and the other three
+ *   as 10 bit values in [-1/sqrt(2), 1/sqrt(2)]. The largest component is
+ *   rebuilt from the unit length. Rotation matrices must be orthonormal.
+ * - Affine3x4 drops the constant last column of a mat4, 48 bytes instead
+ *   of 64, and still holds scale and shear.
+ *
+ * The position and normal batch versions work on four elements at a time
+ * with SSE2 when it is available and give the same results as the single
+ * versions.
+ */
+
+#define QUANTIZED_POSITION_STEPS 65535.0f
+
+typedef struct QuantizedPosition
+{
+    uint16_t x;
+    uint16_t y;
+    uint16_t z;
+
+    inline QuantizedPosition() : x(0), y(0), z(0) {}
+    inline QuantizedPosition(uint16_t _x, uint16_t _y, uint16_t _z) :
+        x(_x), y(_y), z(_z) {}
+} QuantizedPosition;
+
+/* A rigid transform: rotation and translation, no scale. 12 bytes. */
+typedef struct PackedTransform
+{
+    uint32_t rotation;
+    QuantizedPosition position;
+} PackedTransform;
+
+/* The first three columns of a mat4. Like mat4 it transforms row vectors,
+ * so the translation is the last row. */
+typedef struct Affine3x4
+{
+    union {
+        struct {
+            float _11, _12, _13,
+                  _21, _22, _23,
+                  _31, _32, _33,
+                  _41, _42, _43;
+        };
+        float asArray[12];
+    };
+
+    inline float* operator[](int i)
+    {
+        return &(asArray[i * 3]);
+    }
+
+    inline Affine3x4()
+    {
+        _11 = _22 = _33 = 1.0f;
+        _12 = _13 = _21 = _23 = _31 = _32 = 0.0f;
+        _41 = _42 = _43 = 0.0f;
+    }
+} Affine3x4;
+
+QuantizedPosition QuantizePosition(const vec3& position, const vec3& origin,
+                                   float cellSize);
+vec3 DequantizePosition(const QuantizedPosition& position,
+                        const vec3& origin, float cellSize);
+
+uint32_t EncodeNormal(const vec3& normal);
+vec3 DecodeNormal(uint32_t normal);
+
+uint32_t EncodeRotation(const mat3& rotation);
+/* Uses the upper 3x3 of the matrix, which must not be scaled */
+uint32_t EncodeRotation(const mat4& rotation);
+mat3 DecodeRotation(uint32_t rotation);
+
+PackedTransform PackTransform(const mat4& transform, const vec3& origin,
+                              float cellSize);
+mat4 UnpackTransform(const PackedTransform& transform, const vec3& origin,
+                     float cellSize);
+
+Affine3x4 ToAffine(const mat4& matrix);
+mat4 ToMat4(const Affine3x4& affine);
+Affine3x4 operator*(const Affine3x4& m1, const Affine3x4& m2);
+vec3 MultiplyPoint(const vec3& point, const Affine3x4& affine);
+vec3 MultiplyVector(const vec3& vec, const Affine3x4& affine);
+
+/* Batch versions of the above over `count` elements */
+void QuantizePositions(const vec3* positions, const vec3& origin,
+                       float cellSize, QuantizedPosition* out, int count);
+void DequantizePositions(const QuantizedPosition* positions,
+                         const vec3& origin, float cellSize,
+                         vec3* out, int count);
+
+void EncodeNormals(const vec3* normals, uint32_t* out, int count);
+void DecodeNormals(const uint32_t* normals, vec3* out, int count);
+
+void EncodeRotations(const mat3* rotations, uint32_t* out, int count);
+void DecodeRotations(const uint32_t* rotations, mat3* out, int count);
+
+void PackTransforms(const mat4* transforms, const vec3& origin,
+                    float cellSize, PackedTransform* out, int count);
+void UnpackTransforms(const PackedTransform* transforms, const vec3& origin,
+                      float cellSize, mat4* out, int count);
+
+#endif
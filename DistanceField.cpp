@@ -0,0 +1,299 @@
+#include "DistanceField.h"
+#include "Parallel.h"
+#include "Profiler.h"
+
+#include <math.h>
+#include <float.h>
+#include <algorithm>
+
+// Rows per pool task in the flood passes
+#define DISTANCE_FIELD_ROWS 8
+
+/* The shapes flattened into one index space: circles, lines, rectangles,
+ * oriented rectangles, then polygons */
+typedef struct FieldShapes
+{
+    const DistanceFieldShapes* shapes;
+    int lineStart;
+    int rectangleStart;
+    int orientedStart;
+    int polygonStart;
+    int count;
+} FieldShapes;
+
+static FieldShapes Flatten(const DistanceFieldShapes& shapes)
+{
+    FieldShapes result;
+    result.shapes = &shapes;
+    result.lineStart = shapes.circleCount;
+    result.rectangleStart = result.lineStart + shapes.lineCount;
+    result.orientedStart = result.rectangleStart + shapes.rectangleCount;
+    result.polygonStart = result.orientedStart +
+                          shapes.orientedRectangleCount;
+    result.count = result.polygonStart + shapes.polygonCount;
+    return result;
+}
+
+static float ShapeDistance(const FieldShapes& f, int shape,
+                           const Point2D& point)
+{
+    const DistanceFieldShapes& s = *f.shapes;
+    if (shape < f.lineStart) {
+        return SignedDistance(point, s.circles[shape]);
+    }
+    if (shape < f.rectangleStart) {
+        return SignedDistance(point, s.lines[shape - f.lineStart]);
+    }
+    if (shape < f.orientedStart) {
+        return SignedDistance(point, s.rectangles[shape - f.rectangleStart]);
+    }
+    if (shape < f.polygonStart) {
+        return SignedDistance(point,
+                              s.orientedRectangles[shape - f.orientedStart]);
+    }
+    return SignedDistance(point, s.polygons[shape - f.polygonStart]);
+}
+
+static Rectangle2D ShapeBounds(const FieldShapes& f, int shape)
+{
+    const DistanceFieldShapes& s = *f.shapes;
+    if (shape < f.lineStart) {
+        const Circle& circle = s.circles[shape];
+        vec2 extent(circle.radius, circle.radius);
+        return FromMinMax(circle.center - extent, circle.center + extent);
+    }
+    if (shape < f.rectangleStart) {
+        return ContainingRectangle(s.lines[shape - f.lineStart]);
+    }
+    if (shape < f.orientedStart) {
+        return s.rectangles[shape - f.rectangleStart];
+    }
+    if (shape < f.polygonStart) {
+        return ContainingRectangle(
+                s.orientedRectangles[shape - f.orientedStart]);
+    }
+    const Polygon2D& polygon = s.polygons[shape - f.polygonStart];
+    vec2 extent(polygon.bounds.radius, polygon.bounds.radius);
+    return FromMinMax(polygon.bounds.center - extent,
+                      polygon.bounds.center + extent);
+}
+
+DistanceField2D::DistanceField2D() :
+    m_cellSize(1.0f), m_columns(0), m_rows(0)
+{
+}
+
+bool DistanceField2D::Bake(const DistanceFieldShapes& shapes,
+                           const Rectangle2D& area, float cellSize)
+{
+    PROFILE_FUNCTION();
+    if (!(cellSize > 0.0f) || !(area.size.x > 0.0f) ||
+        !(area.size.y > 0.0f)) {
+        return false;
+    }
+    double columns = ceil(area.size.x / cellSize);
+    double rows = ceil(area.size.y / cellSize);
+    if (columns * rows > (double)DISTANCE_FIELD_MAX_CELLS) {
+        return false;
+    }
+    m_origin = GetMin(area);
+    m_cellSize = cellSize;
+    m_columns = (int)columns;
+    m_rows = (int)rows;
+    int cellCount = m_columns * m_rows;
+    FieldShapes f = Flatten(shapes);
+
+    // Seeds: cells within half a diagonal of a shape, or inside it, take
+    // the nearest such shape. Any shape nearer to a seeded cell is within
+    // the same reach, so seeds are exact and the flood skips them. A shape
+    // that reaches no cell center lies (partly) off the grid and seeds the
+    // whole edge rows and columns facing it instead, since the segment
+    // from any cell to its nearest point on the shape crosses one of them.
+    std::vector<int> ids(cellCount, -1);
+    std::vector<float> distances(cellCount, FLT_MAX);
+    auto center = [&](int x, int y) {
+        return m_origin + vec2((x + 0.5f) * cellSize, (y + 0.5f) * cellSize);
+    };
+    auto seed = [&](int shape, int x, int y, float reach) {
+        float d = ShapeDistance(f, shape, center(x, y));
+        int cell = y * m_columns + x;
+        if (d <= reach && d < distances[cell]) {
+            distances[cell] = d;
+            ids[cell] = shape;
+        }
+        return d <= reach;
+    };
+    float reach = cellSize * 0.7072f;
+    float invCellSize = 1.0f / cellSize;
+    for (int shape = 0; shape < f.count; shape++) {
+        // Bounds in cell center coordinates
+        Rectangle2D bounds = ShapeBounds(f, shape);
+        vec2 half(0.5f, 0.5f);
+        vec2 min = (GetMin(bounds) - m_origin) * invCellSize - half;
+        vec2 max = (GetMax(bounds) - m_origin) * invCellSize - half;
+        int x0 = std::max(0, (int)floorf(min.x));
+        int y0 = std::max(0, (int)floorf(min.y));
+        int x1 = std::min(m_columns - 1, (int)floorf(max.x) + 1);
+        int y1 = std::min(m_rows - 1, (int)floorf(max.y) + 1);
+        bool seeded = false;
+        for (int y = y0; y <= y1; y++) {
+            for (int x = x0; x <= x1; x++) {
+                seeded |= seed(shape, x, y, reach);
+            }
+        }
+        if (seeded) {
+            continue;
+        }
+        if (min.x < 0.0f || max.x > m_columns - 1) {
+            int x = (min.x < 0.0f) ? 0 : m_columns - 1;
+            for (int y = 0; y < m_rows; y++) {
+                seed(shape, x, y, FLT_MAX);
+            }
+        }
+        if (min.y < 0.0f || max.y > m_rows - 1) {
+            int y = (min.y < 0.0f) ? 0 : m_rows - 1;
+            for (int x = 0; x < m_columns; x++) {
+                seed(shape, x, y, FLT_MAX);
+            }
+        }
+    }
+
+    // Jump flood, with a second pass at offset 1 to fix the rare cell the
+    // large offsets got wrong
+    std::vector<int> steps;
+    int largest = 1;
+    while (largest * 2 < std::max(m_columns, m_rows)) {
+        largest *= 2;
+    }
+    for (int step = largest; step >= 1; step /= 2) {
+        steps.push_back(step);
+    }
+    steps.push_back(1);
+
+    std::vector<int> nextIds(cellCount);
+    std::vector<float> nextDistances(cellCount);
+    for (size_t pass = 0; pass < steps.size() && f.count > 0; pass++) {
+        int step = steps[pass];
+        ParallelFor(m_rows, DISTANCE_FIELD_ROWS, [&](int begin, int end) {
+            for (int y = begin; y < end; y++) {
+                for (int x = 0; x < m_columns; x++) {
+                    int cell = y * m_columns + x;
+                    int best = ids[cell];
+                    float bestDistance = distances[cell];
+                    if (bestDistance <= reach) {
+                        nextIds[cell] = best;
+                        nextDistances[cell] = bestDistance;
+                        continue;
+                    }
+                    Point2D p = center(x, y);
+                    // Neighbors mostly share a shape, evaluate each once
+                    int tried[9];
+                    int triedCount = 0;
+                    for (int dy = -step; dy <= step; dy += step) {
+                        int ny = y + dy;
+                        if (ny < 0 || ny >= m_rows) {
+                            continue;
+                        }
+                        for (int dx = -step; dx <= step; dx += step) {
+                            int nx = x + dx;
+                            if (nx < 0 || nx >= m_columns) {
+                                continue;
+                            }
+                            int candidate = ids[ny * m_columns + nx];
+                            if (candidate < 0 || candidate == best ||
+                                std::find(tried, tried + triedCount,
+                                          candidate) != tried + triedCount) {
+                                continue;
+                            }
+                            tried[triedCount++] = candidate;
+                            float d = ShapeDistance(f, candidate, p);
+                            if (d < bestDistance) {
+                                bestDistance = d;
+                                best = candidate;
+                            }
+                        }
+                    }
+                    nextIds[cell] = best;
+                    nextDistances[cell] = bestDistance;
+                }
+            }
+        });
+        ids.swap(nextIds);
+        distances.swap(nextDistances);
+    }
+
+    m_values.swap(distances);
+    return true;
+}
+
+Rectangle2D DistanceField2D::Area() const
+{
+    return Rectangle2D(m_origin, vec2(m_columns * m_cellSize,
+                                      m_rows * m_cellSize));
+}
+
+void DistanceField2D::Locate(const Point2D& point, Point2D* clamped, int* x,
+                             int* y, float* fx, float* fy) const
+{
+    float half = 0.5f * m_cellSize;
+    vec2 min = m_origin + vec2(half, half);
+    vec2 max = m_origin + vec2(m_columns * m_cellSize - half,
+                               m_rows * m_cellSize - half);
+    *clamped = Point2D(fmaxf(min.x, fminf(max.x, point.x)),
+                       fmaxf(min.y, fminf(max.y, point.y)));
+    float u = (clamped->x - min.x) / m_cellSize;
+    float v = (clamped->y - min.y) / m_cellSize;
+    *x = std::min((int)u, std::max(0, m_columns - 2));
+    *y = std::min((int)v, std::max(0, m_rows - 2));
+    *fx = (m_columns > 1) ? u - *x : 0.0f;
+    *fy = (m_rows > 1) ? v - *y : 0.0f;
+}
+
+float DistanceField2D::Sample(const Point2D& point) const
+{
+    PROFILE_FUNCTION();
+    if (m_values.empty()) {
+        return FLT_MAX;
+    }
+    Point2D clamped;
+    int x, y;
+    float fx, fy;
+    Locate(point, &clamped, &x, &y, &fx, &fy);
+    int x1 = std::min(x + 1, m_columns - 1);
+    int y1 = std::min(y + 1, m_rows - 1);
+    const float* row0 = &m_values[y * m_columns];
+    const float* row1 = &m_values[y1 * m_columns];
+    float bottom = row0[x] + (row0[x1] - row0[x]) * fx;
+    float top = row1[x] + (row1[x1] - row1[x]) * fx;
+    return bottom + (top - bottom) * fy + Magnitude(point - clamped);
+}
+
+vec2 DistanceField2D::Gradient(const Point2D& point) const
+{
+    PROFILE_FUNCTION();
+    if (m_values.empty()) {
+        return vec2();
+    }
+    Point2D clamped;
+    int x, y;
+    float fx, fy;
+    Locate(point, &clamped, &x, &y, &fx, &fy);
+
+    // Beyond the grid the distance to it dominates
+    vec2 outside = point - clamped;
+    float outsideLength = Magnitude(outside);
+    if (outsideLength > 0.0f) {
+        return outside * (1.0f / outsideLength);
+    }
+
+    int x1 = std::min(x + 1, m_columns - 1);
+    int y1 = std::min(y + 1, m_rows - 1);
+    const float* row0 = &m_values[y * m_columns];
+    const float* row1 = &m_values[y1 * m_columns];
+    float invCellSize = 1.0f / m_cellSize;
+    float dx = ((row0[x1] - row0[x]) * (1.0f - fy) +
+                (row1[x1] - row1[x]) * fy) * invCellSize;
+    float dy = ((row1[x] - row0[x]) * (1.0f - fx) +
+                (row1[x1] - row0[x1]) * fx) * invCellSize;
+    return vec2(dx, dy);
+}
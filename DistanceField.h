@@ -0,0 +1,93 @@
+#ifndef _H_DISTANCE_FIELD_
+#define _H_DISTANCE_FIELD_
+
+#include "Geometry2D.h"
+
+#include <vector>
+
+/* Baked 2D signed distance field over a set of shapes, for distance
+ * queries that have to be cheap per agent (avoidance, soft collision).
+ *
+ * Bake() covers `area` with square cells and stores the signed distance
+ * from every cell center to the nearest shape, the union of the shapes
+ * being the inside. Cells near a shape are seeded with it, then a jump
+ * flood spreads the nearest shape across the grid in log2(size) passes,
+ * each cell trying the shapes of its 8 neighbors at halving offsets with
+ * the exact SignedDistance(). Passes run in parallel over rows. Values
+ * are exact near the shapes; farther out, a few cells where several
+ * shapes compete may keep one up to about a cell farther than the
+ * nearest, as with any jump flood.
+ *
+ * Sample() and Gradient() interpolate bilinearly between cell centers.
+ * Beyond the area they continue from the nearest edge of the grid,
+ * adding the distance to it.
+ */
+
+#define DISTANCE_FIELD_MAX_CELLS (1 << 24)
+
+typedef struct DistanceFieldShapes
+{
+    const Circle* circles;
+    int circleCount;
+    const Line2D* lines;
+    int lineCount;
+    const Rectangle2D* rectangles;
+    int rectangleCount;
+    const OrientedRectangle* orientedRectangles;
+    int orientedRectangleCount;
+    const Polygon2D* polygons;
+    int polygonCount;
+
+    inline DistanceFieldShapes() :
+        circles(0), circleCount(0), lines(0), lineCount(0), rectangles(0),
+        rectangleCount(0), orientedRectangles(0), orientedRectangleCount(0),
+        polygons(0), polygonCount(0) {}
+    inline explicit DistanceFieldShapes(const SweptTargets& targets) :
+        circles(0), circleCount(0), lines(targets.lines),
+        lineCount(targets.lineCount), rectangles(targets.rectangles),
+        rectangleCount(targets.rectangleCount),
+        orientedRectangles(targets.orientedRectangles),
+        orientedRectangleCount(targets.orientedRectangleCount),
+        polygons(0), polygonCount(0) {}
+} DistanceFieldShapes;
+
+class DistanceField2D {
+public:
+    DistanceField2D();
+
+    /* False if the area or cell size is empty or the grid would exceed
+     * DISTANCE_FIELD_MAX_CELLS. Cells are FLT_MAX without shapes. */
+    bool Bake(const DistanceFieldShapes& shapes, const Rectangle2D& area,
+              float cellSize);
+
+    float Sample(const Point2D& point) const;
+    /* Gradient of Sample(), pointing away from the nearest surface */
+    vec2 Gradient(const Point2D& point) const;
+
+    int Columns() const { return m_columns; }
+    int Rows() const { return m_rows; }
+    float CellSize() const { return m_cellSize; }
+    Rectangle2D Area() const;
+    /* Row by row, Columns() * Rows() values */
+    const float* Values() const
+    {
+        return m_values.empty() ? 0 : &m_values[0];
+    }
+
+private:
+    DistanceField2D(const DistanceField2D&);
+    DistanceField2D& operator=(const DistanceField2D&);
+
+    /* Clamps `point` to the cell centers and finds the cell whose
+     * center is below and left of it, with the fractions to the next */
+    void Locate(const Point2D& point, Point2D* clamped, int* x, int* y,
+                float* fx, float* fy) const;
+
+    std::vector<float> m_values;
+    vec2 m_origin;
+    float m_cellSize;
+    int m_columns;
+    int m_rows;
+};
+
+#endif
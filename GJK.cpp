@@ -0,0 +1,988 @@
+#include "GJK.h"
+#include "Profiler.h"
+
+#include <cmath>
+#include <cfloat>
+
+#define EPA_MAX_FACES (EPA_MAX_VERTICES * 2)
+#define EPA_TOLERANCE 1.0e-4f
+
+/* Support functions */
+
+static vec2 SupportPoint2D(const void* shape, const float*, const vec2&)
+{
+    return ((const Circle*)shape)->center;
+}
+
+static vec2 SupportRectangle2D(const void*, const float* params,
+                               const vec2& direction)
+{
+    // params = min.x, min.y, max.x, max.y
+    return vec2(direction.x >= 0.0f ? params[2] : params[0],
+                direction.y >= 0.0f ? params[3] : params[1]);
+}
+
+static vec2 SupportOrientedRectangle(const void* shape, const float* params,
+                                     const vec2& direction)
+{
+    // params = cos and sin of the rotation
+    const OrientedRectangle* rect = (const OrientedRectangle*)shape;
+    vec2 axisX(params[0], params[1]);
+    vec2 axisY(-params[1], params[0]);
+    float sx = Dot(direction, axisX) >= 0.0f ? 1.0f : -1.0f;
+    float sy = Dot(direction, axisY) >= 0.0f ? 1.0f : -1.0f;
+    return rect->origin + axisX * (sx * rect->halfExtents.x) +
+           axisY * (sy * rect->halfExtents.y);
+}
+
+static vec2 SupportHull2D(const void* shape, const float*,
+                          const vec2& direction)
+{
+    const ConvexHull2D* hull = (const ConvexHull2D*)shape;
+    int best = 0;
+    float bestDot = Dot(hull->points[0], direction);
+    for (int i = 1; i < hull->count; i++) {
+        float d = Dot(hull->points[i], direction);
+        if (d > bestDot) {
+            bestDot = d;
+            best = i;
+        }
+    }
+    return hull->points[best];
+}
+
+static vec2 SupportPolygon2D(const void* shape, const float*,
+                             const vec2& direction)
+{
+    const Polygon2D* polygon = (const Polygon2D*)shape;
+    int best = 0;
+    float bestDot = Dot(polygon->vertices[0], direction);
+    for (int i = 1; i < polygon->count; i++) {
+        float d = Dot(polygon->vertices[i], direction);
+        if (d > bestDot) {
+            bestDot = d;
+            best = i;
+        }
+    }
+    return polygon->vertices[best];
+}
+
+static vec2 SupportCapsule2D(const void* shape, const float*,
+                             const vec2& direction)
+{
+    const Capsule2D* capsule = (const Capsule2D*)shape;
+    return Dot(capsule->end - capsule->start, direction) >= 0.0f ?
+        capsule->end : capsule->start;
+}
+
+static vec3 SupportSphere(const void* shape, const float*, const vec3&)
+{
+    return ((const Sphere*)shape)->position;
+}
+
+static vec3 SupportAABB(const void* shape, const float*,
+                        const vec3& direction)
+{
+    const AABB* aabb = (const AABB*)shape;
+    return vec3(
+        aabb->position.x + (direction.x >= 0.0f ? aabb->size.x : -aabb->size.x),
+        aabb->position.y + (direction.y >= 0.0f ? aabb->size.y : -aabb->size.y),
+        aabb->position.z + (direction.z >= 0.0f ? aabb->size.z : -aabb->size.z));
+}
+
+static vec3 SupportOBB(const void* shape, const float*, const vec3& direction)
+{
+    const OBB* obb = (const OBB*)shape;
+    const float* o = obb->orientation.asArray;
+    vec3 result = obb->position;
+    for (int i = 0; i < 3; i++) {
+        vec3 axis(o[i * 3 + 0], o[i * 3 + 1], o[i * 3 + 2]);
+        float extent = obb->size.asArray[i];
+        result = result + axis * (Dot(direction, axis) >= 0.0f ?
+                                  extent : -extent);
+    }
+    return result;
+}
+
+static vec3 SupportHull3D(const void* shape, const float*,
+                          const vec3& direction)
+{
+    const ConvexHull3D* hull = (const ConvexHull3D*)shape;
+    int best = 0;
+    float bestDot = Dot(hull->points[0], direction);
+    for (int i = 1; i < hull->count; i++) {
+        float d = Dot(hull->points[i], direction);
+        if (d > bestDot) {
+            bestDot = d;
+            best = i;
+        }
+    }
+    return hull->points[best];
+}
+
+ConvexShape2D MakeConvexShape(const Circle& circle)
+{
+    ConvexShape2D result;
+    result.shape = &circle;
+    result.support = SupportPoint2D;
+    result.radius = circle.radius;
+    result.center = circle.center;
+    return result;
+}
+
+ConvexShape2D MakeConvexShape(const Rectangle2D& rect)
+{
+    vec2 min = GetMin(rect);
+    vec2 max = GetMax(rect);
+
+    ConvexShape2D result;
+    result.shape = &rect;
+    result.support = SupportRectangle2D;
+    result.radius = 0.0f;
+    result.center = (min + max) * 0.5f;
+    result.params[0] = min.x;
+    result.params[1] = min.y;
+    result.params[2] = max.x;
+    result.params[3] = max.y;
+    return result;
+}
+
+ConvexShape2D MakeConvexShape(const OrientedRectangle& rect)
+{
+    float theta = DEG2RAD(rect.rotation);
+
+    ConvexShape2D result;
+    result.shape = &rect;
+    result.support = SupportOrientedRectangle;
+    result.radius = 0.0f;
+    result.center = rect.origin;
+    result.params[0] = cosf(theta);
+    result.params[1] = sinf(theta);
+    return result;
+}
+
+ConvexShape2D MakeConvexShape(const ConvexHull2D& hull, float radius)
+{
+    vec2 center;
+    for (int i = 0; i < hull.count; i++) {
+        center = center + hull.points[i];
+    }
+
+    ConvexShape2D result;
+    result.shape = &hull;
+    result.support = SupportHull2D;
+    result.radius = radius;
+    result.center = center * (1.0f / (float)hull.count);
+    return result;
+}
+
+ConvexShape2D MakeConvexShape(const Polygon2D& polygon)
+{
+    ConvexShape2D result;
+    result.shape = &polygon;
+    result.support = SupportPolygon2D;
+    result.radius = 0.0f;
+    result.center = polygon.bounds.center;
+    return result;
+}
+
+ConvexShape2D MakeConvexShape(const Capsule2D& capsule)
+{
+    ConvexShape2D result;
+    result.shape = &capsule;
+    result.support = SupportCapsule2D;
+    result.radius = capsule.radius;
+    result.center = (capsule.start + capsule.end) * 0.5f;
+    return result;
+}
+
+ConvexShape3D MakeConvexShape(const Sphere& sphere)
+{
+    ConvexShape3D result;
+    result.shape = &sphere;
+    result.support = SupportSphere;
+    result.radius = sphere.radius;
+    result.center = sphere.position;
+    return result;
+}
+
+ConvexShape3D MakeConvexShape(const AABB& aabb)
+{
+    ConvexShape3D result;
+    result.shape = &aabb;
+    result.support = SupportAABB;
+    result.radius = 0.0f;
+    result.center = aabb.position;
+    return result;
+}
+
+ConvexShape3D MakeConvexShape(const OBB& obb)
+{
+    ConvexShape3D result;
+    result.shape = &obb;
+    result.support = SupportOBB;
+    result.radius = 0.0f;
+    result.center = obb.position;
+    return result;
+}
+
+ConvexShape3D MakeConvexShape(const ConvexHull3D& hull, float radius)
+{
+    vec3 center;
+    for (int i = 0; i < hull.count; i++) {
+        center = center + hull.points[i];
+    }
+
+    ConvexShape3D result;
+    result.shape = &hull;
+    result.support = SupportHull3D;
+    result.radius = radius;
+    result.center = center * (1.0f / (float)hull.count);
+    return result;
+}
+
+/* Simplex
+ *
+ * Vertices of the Minkowski difference A - B together with the points of
+ * A and B that produced them and the search direction, which is what the
+ * cache stores. The solvers below shrink the simplex to the sub-simplex
+ * closest to the origin and store its barycentric weights.
+ */
+
+template<typename V>
+struct SimplexVertex {
+    V w;
+    V a;
+    V b;
+    V dir;
+};
+
+template<typename V>
+struct Simplex {
+    SimplexVertex<V> v[4];
+    float bary[4];
+    int count;
+};
+
+static inline SimplexVertex<vec2> Support(const ConvexShape2D& a,
+                                          const ConvexShape2D& b,
+                                          const vec2& dir)
+{
+    SimplexVertex<vec2> result;
+    result.a = a.support(a.shape, a.params, dir);
+    result.b = b.support(b.shape, b.params, dir * -1.0f);
+    result.w = result.a - result.b;
+    result.dir = dir;
+    return result;
+}
+
+static inline SimplexVertex<vec3> Support(const ConvexShape3D& a,
+                                          const ConvexShape3D& b,
+                                          const vec3& dir)
+{
+    SimplexVertex<vec3> result;
+    result.a = a.support(a.shape, a.params, dir);
+    result.b = b.support(b.shape, b.params, dir * -1.0f);
+    result.w = result.a - result.b;
+    result.dir = dir;
+    return result;
+}
+
+template<typename V>
+static V SolveSegment(Simplex<V>& s)
+{
+    V a = s.v[0].w;
+    V ab = s.v[1].w - a;
+    float t = -Dot(a, ab);
+    float denom = Dot(ab, ab);
+
+    if (t <= 0.0f || denom <= 0.0f) {
+        s.count = 1;
+        s.bary[0] = 1.0f;
+        return a;
+    }
+    if (t >= denom) {
+        s.v[0] = s.v[1];
+        s.count = 1;
+        s.bary[0] = 1.0f;
+        return s.v[0].w;
+    }
+    t /= denom;
+    s.bary[0] = 1.0f - t;
+    s.bary[1] = t;
+    return a + ab * t;
+}
+
+// Closest point of triangle v[0..2] to the origin by Voronoi regions, see
+// Real-Time Collision Detection 5.1.5
+template<typename V>
+static V SolveTriangle(Simplex<V>& s)
+{
+    V a = s.v[0].w;
+    V b = s.v[1].w;
+    V c = s.v[2].w;
+    V ab = b - a;
+    V ac = c - a;
+
+    float d1 = -Dot(ab, a);
+    float d2 = -Dot(ac, a);
+    if (d1 <= 0.0f && d2 <= 0.0f) {
+        s.count = 1;
+        s.bary[0] = 1.0f;
+        return a;
+    }
+
+    float d3 = -Dot(ab, b);
+    float d4 = -Dot(ac, b);
+    if (d3 >= 0.0f && d4 <= d3) {
+        s.v[0] = s.v[1];
+        s.count = 1;
+        s.bary[0] = 1.0f;
+        return b;
+    }
+
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+        float t = d1 / (d1 - d3);
+        s.count = 2;
+        s.bary[0] = 1.0f - t;
+        s.bary[1] = t;
+        return a + ab * t;
+    }
+
+    float d5 = -Dot(ab, c);
+    float d6 = -Dot(ac, c);
+    if (d6 >= 0.0f && d5 <= d6) {
+        s.v[0] = s.v[2];
+        s.count = 1;
+        s.bary[0] = 1.0f;
+        return c;
+    }
+
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+        float t = d2 / (d2 - d6);
+        s.v[1] = s.v[2];
+        s.count = 2;
+        s.bary[0] = 1.0f - t;
+        s.bary[1] = t;
+        return a + ac * t;
+    }
+
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+        float t = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+        s.v[0] = s.v[1];
+        s.v[1] = s.v[2];
+        s.count = 2;
+        s.bary[0] = 1.0f - t;
+        s.bary[1] = t;
+        return b + (c - b) * t;
+    }
+
+    float denom = 1.0f / (va + vb + vc);
+    float v = vb * denom;
+    float w = vc * denom;
+    s.count = 3;
+    s.bary[0] = 1.0f - v - w;
+    s.bary[1] = v;
+    s.bary[2] = w;
+    return a + ab * v + ac * w;
+}
+
+static vec2 SolveTetrahedron(Simplex<vec2>& s)
+{
+    // Unreachable: GJK stops in 2D once the simplex is a triangle
+    s.count = 3;
+    return vec2();
+}
+
+static vec3 SolveTetrahedron(Simplex<vec3>& s)
+{
+    static const int faces[4][4] = {
+        { 0, 1, 2, 3 }, { 0, 2, 3, 1 }, { 0, 3, 1, 2 }, { 1, 3, 2, 0 }
+    };
+
+    vec3 a = s.v[0].w;
+    float volume = Dot(s.v[1].w - a, Cross(s.v[2].w - a, s.v[3].w - a));
+    float scale = MagnitudeSqr(s.v[1].w - a) + MagnitudeSqr(s.v[2].w - a) +
+                  MagnitudeSqr(s.v[3].w - a);
+    bool flat = fabsf(volume) <= 1.0e-7f * scale * sqrtf(scale);
+
+    bool outsideAny = false;
+    float bestDist = FLT_MAX;
+    vec3 best;
+    Simplex<vec3> bestSimplex;
+    bestSimplex.count = 0;
+
+    for (int f = 0; f < 4; f++) {
+        const SimplexVertex<vec3>& p0 = s.v[faces[f][0]];
+        const SimplexVertex<vec3>& p1 = s.v[faces[f][1]];
+        const SimplexVertex<vec3>& p2 = s.v[faces[f][2]];
+        const SimplexVertex<vec3>& opposite = s.v[faces[f][3]];
+
+        // Origin and opposite vertex on different sides of the face plane
+        vec3 n = Cross(p1.w - p0.w, p2.w - p0.w);
+        float signOrigin = -Dot(p0.w, n);
+        float signOpposite = Dot(opposite.w - p0.w, n);
+        if (!flat && signOrigin * signOpposite >= 0.0f) {
+            continue;
+        }
+        outsideAny = true;
+
+        Simplex<vec3> tri;
+        tri.v[0] = p0;
+        tri.v[1] = p1;
+        tri.v[2] = p2;
+        tri.count = 3;
+        vec3 q = SolveTriangle(tri);
+        float dist = MagnitudeSqr(q);
+        if (dist < bestDist) {
+            bestDist = dist;
+            best = q;
+            bestSimplex = tri;
+        }
+    }
+
+    if (!outsideAny) {
+        return vec3(); // origin inside, keep all four vertices
+    }
+    s = bestSimplex;
+    return best;
+}
+
+template<typename V>
+static V SolveSimplex(Simplex<V>& s)
+{
+    switch (s.count) {
+        case 1:
+            s.bary[0] = 1.0f;
+            return s.v[0].w;
+        case 2:
+            return SolveSegment(s);
+        case 3:
+            return SolveTriangle(s);
+        default:
+            return SolveTetrahedron(s);
+    }
+}
+
+template<typename V>
+static bool SameVertex(const V& a, const V& b)
+{
+    return MagnitudeSqr(a - b) <= 1.0e-12f * (1.0f + MagnitudeSqr(a));
+}
+
+enum GjkStatus {
+    GJK_OVERLAP,    // origin inside the core difference
+    GJK_SEPARATED,  // proven further apart than the stop distance
+    GJK_CONVERGED   // v is the closest point of the core difference
+};
+
+/* Runs GJK on the cores of a and b. Stops early once the distance is
+ * known to be larger than `stopDistance`.
+ */
+template<typename V, typename Shape, typename Cache>
+static GjkStatus GjkSolve(const Shape& a, const Shape& b, Cache* cache,
+                          float stopDistance, Simplex<V>& s, V& v,
+                          int& iterations)
+{
+    const int maxCount = (int)(sizeof(V) / sizeof(float)) + 1;
+
+    s.count = 0;
+    if (cache) {
+        for (int i = 0; i < cache->count; i++) {
+            SimplexVertex<V> w = Support(a, b, cache->directions[i]);
+            bool duplicate = false;
+            for (int j = 0; j < s.count; j++) {
+                duplicate = duplicate || SameVertex(w.w, s.v[j].w);
+            }
+            if (!duplicate) {
+                s.v[s.count++] = w;
+            }
+        }
+    }
+    if (s.count == 0) {
+        V dir = b.center - a.center;
+        if (MagnitudeSqr(dir) == 0.0f) {
+            dir.asArray[0] = 1.0f;
+        }
+        s.v[s.count++] = Support(a, b, dir);
+    }
+
+    GjkStatus status = GJK_CONVERGED;
+    for (iterations = 1; iterations <= GJK_MAX_ITERATIONS; iterations++) {
+        v = SolveSimplex(s);
+        if (s.count == maxCount) {
+            status = GJK_OVERLAP;
+            break;
+        }
+
+        float vv = Dot(v, v);
+        float scale = 0.0f;
+        for (int i = 0; i < s.count; i++) {
+            scale = fmaxf(scale, MagnitudeSqr(s.v[i].w));
+        }
+        if (vv <= 1.0e-10f * scale) {
+            status = GJK_OVERLAP;
+            break;
+        }
+
+        SimplexVertex<V> w = Support(a, b, v * -1.0f);
+        float vw = Dot(v, w.w);
+        if (vw > 0.0f && vw * vw > stopDistance * stopDistance * vv) {
+            status = GJK_SEPARATED;
+            break;
+        }
+        if (vv - vw <= GJK_TOLERANCE * vv) {
+            break;
+        }
+
+        bool duplicate = false;
+        for (int i = 0; i < s.count; i++) {
+            duplicate = duplicate || SameVertex(w.w, s.v[i].w);
+        }
+        if (duplicate) {
+            break;
+        }
+        s.v[s.count++] = w;
+    }
+
+    if (cache) {
+        cache->count = s.count;
+        for (int i = 0; i < s.count; i++) {
+            cache->directions[i] = s.v[i].dir;
+        }
+    }
+    return status;
+}
+
+template<typename V>
+static void Witness(const Simplex<V>& s, V& pointA, V& pointB)
+{
+    pointA = V();
+    pointB = V();
+    for (int i = 0; i < s.count; i++) {
+        pointA = pointA + s.v[i].a * s.bary[i];
+        pointB = pointB + s.v[i].b * s.bary[i];
+    }
+}
+
+/* EPA
+ *
+ * Grows the final GJK simplex into a polytope of the core difference until
+ * the face closest to the origin is on its boundary. The distance to that
+ * face is the penetration depth of the cores, its normal the direction
+ * from A to B.
+ */
+
+static float Cross2D(const vec2& a, const vec2& b)
+{
+    return a.x * b.y - a.y * b.x;
+}
+
+static void Epa(const ConvexShape2D& a, const ConvexShape2D& b,
+                const Simplex<vec2>& simplex, vec2& normal, float& depth,
+                vec2& pointA, vec2& pointB)
+{
+    SimplexVertex<vec2> poly[EPA_MAX_VERTICES];
+    int count = simplex.count;
+    for (int i = 0; i < count; i++) {
+        poly[i] = simplex.v[i];
+    }
+
+    // The shapes may only touch, leaving GJK with a point or a segment.
+    // Blow it up to a triangle first.
+    if (count == 1) {
+        const vec2 dirs[4] = {
+            vec2(1.0f, 0.0f), vec2(-1.0f, 0.0f),
+            vec2(0.0f, 1.0f), vec2(0.0f, -1.0f)
+        };
+        for (int i = 0; i < 4 && count == 1; i++) {
+            SimplexVertex<vec2> w = Support(a, b, dirs[i]);
+            if (!SameVertex(w.w, poly[0].w)) {
+                poly[count++] = w;
+            }
+        }
+    }
+    if (count == 2) {
+        vec2 e = poly[1].w - poly[0].w;
+        vec2 perp(-e.y, e.x);
+        for (int i = 0; i < 2 && count == 2; i++) {
+            SimplexVertex<vec2> w = Support(a, b, perp);
+            float area = Cross2D(e, w.w - poly[0].w);
+            if (area * area > 1.0e-12f * MagnitudeSqr(e) *
+                    (1.0f + MagnitudeSqr(w.w))) {
+                poly[count++] = w;
+            }
+            perp = perp * -1.0f;
+        }
+    }
+    if (count < 3) {
+        // Zero area overlap, the shapes touch
+        vec2 e = (count == 2) ? poly[1].w - poly[0].w : vec2(0.0f, 1.0f);
+        normal = Normalized(vec2(e.y, -e.x));
+        depth = 0.0f;
+        pointA = poly[0].a;
+        pointB = poly[0].b;
+        return;
+    }
+
+    if (Cross2D(poly[1].w - poly[0].w, poly[2].w - poly[0].w) < 0.0f) {
+        SimplexVertex<vec2> tmp = poly[1];
+        poly[1] = poly[2];
+        poly[2] = tmp;
+    }
+
+    int edge = 0;
+    float edgeDist = 0.0f;
+    vec2 edgeNormal;
+    for (int iteration = 0; iteration < EPA_MAX_ITERATIONS; iteration++) {
+        edgeDist = FLT_MAX;
+        for (int i = 0; i < count; i++) {
+            int j = (i + 1) % count;
+            vec2 e = poly[j].w - poly[i].w;
+            float len = Magnitude(e);
+            if (len <= 0.0f) {
+                continue;
+            }
+            // Outward normal of a counter clockwise polygon
+            vec2 n(e.y / len, -e.x / len);
+            float dist = Dot(n, poly[i].w);
+            if (dist < edgeDist) {
+                edgeDist = dist;
+                edgeNormal = n;
+                edge = i;
+            }
+        }
+
+        SimplexVertex<vec2> w = Support(a, b, edgeNormal);
+        float supportDist = Dot(w.w, edgeNormal);
+        if (supportDist - edgeDist <=
+                EPA_TOLERANCE * fmaxf(1.0f, supportDist) ||
+            count == EPA_MAX_VERTICES) {
+            break;
+        }
+
+        for (int i = count; i > edge + 1; i--) {
+            poly[i] = poly[i - 1];
+        }
+        poly[edge + 1] = w;
+        count++;
+    }
+
+    const SimplexVertex<vec2>& p0 = poly[edge];
+    const SimplexVertex<vec2>& p1 = poly[(edge + 1) % count];
+    vec2 e = p1.w - p0.w;
+    float lenSq = Dot(e, e);
+    float t = (lenSq > 0.0f) ? -Dot(p0.w, e) / lenSq : 0.0f;
+    t = fmaxf(0.0f, fminf(1.0f, t));
+
+    normal = edgeNormal;
+    depth = edgeDist;
+    pointA = p0.a + (p1.a - p0.a) * t;
+    pointB = p0.b + (p1.b - p0.b) * t;
+}
+
+struct EpaFace {
+    int v[3];
+    vec3 normal;
+    float dist;
+};
+
+static bool MakeFace(const SimplexVertex<vec3>* verts, int i0, int i1, int i2,
+                     EpaFace& face)
+{
+    vec3 n = Cross(verts[i1].w - verts[i0].w, verts[i2].w - verts[i0].w);
+    float len = Magnitude(n);
+    if (len <= 1.0e-12f) {
+        return false;
+    }
+    face.v[0] = i0;
+    face.v[1] = i1;
+    face.v[2] = i2;
+    face.normal = n * (1.0f / len);
+    face.dist = Dot(face.normal, verts[i0].w);
+    return true;
+}
+
+// Barycentric coordinates of p in triangle abc
+static void Barycentric(const vec3& p, const vec3& a, const vec3& b,
+                        const vec3& c, float& u, float& v, float& w)
+{
+    vec3 v0 = b - a;
+    vec3 v1 = c - a;
+    vec3 v2 = p - a;
+    float d00 = Dot(v0, v0);
+    float d01 = Dot(v0, v1);
+    float d11 = Dot(v1, v1);
+    float d20 = Dot(v2, v0);
+    float d21 = Dot(v2, v1);
+    float denom = d00 * d11 - d01 * d01;
+    if (fabsf(denom) <= 1.0e-20f) {
+        u = 1.0f;
+        v = w = 0.0f;
+        return;
+    }
+    v = (d11 * d20 - d01 * d21) / denom;
+    w = (d00 * d21 - d01 * d20) / denom;
+    u = 1.0f - v - w;
+}
+
+static void Epa(const ConvexShape3D& a, const ConvexShape3D& b,
+                const Simplex<vec3>& simplex, vec3& normal, float& depth,
+                vec3& pointA, vec3& pointB)
+{
+    SimplexVertex<vec3> verts[EPA_MAX_VERTICES];
+    int count = simplex.count;
+    for (int i = 0; i < count; i++) {
+        verts[i] = simplex.v[i];
+    }
+
+    // Blow touching contacts up to a tetrahedron
+    for (int attempt = 0; count < 4 && attempt < 3; attempt++) {
+        vec3 dirs[6];
+        int dirCount = 0;
+        if (count == 1) {
+            dirs[0] = vec3(1, 0, 0); dirs[1] = vec3(-1, 0, 0);
+            dirs[2] = vec3(0, 1, 0); dirs[3] = vec3(0, -1, 0);
+            dirs[4] = vec3(0, 0, 1); dirs[5] = vec3(0, 0, -1);
+            dirCount = 6;
+        } else if (count == 2) {
+            vec3 d = verts[1].w - verts[0].w;
+            vec3 axis = (fabsf(d.x) < fabsf(d.y)) ?
+                vec3(1, 0, 0) : vec3(0, 1, 0);
+            vec3 u = Cross(d, axis);
+            vec3 v = Cross(d, u);
+            dirs[0] = u; dirs[1] = u * -1.0f;
+            dirs[2] = v; dirs[3] = v * -1.0f;
+            dirCount = 4;
+        } else {
+            vec3 n = Cross(verts[1].w - verts[0].w, verts[2].w - verts[0].w);
+            dirs[0] = n; dirs[1] = n * -1.0f;
+            dirCount = 2;
+        }
+
+        for (int i = 0; i < dirCount; i++) {
+            SimplexVertex<vec3> w = Support(a, b, dirs[i]);
+            vec3 rel = w.w - verts[0].w;
+            float scale = 1.0e-10f * (1.0f + MagnitudeSqr(w.w));
+            bool grows;
+            if (count == 1) {
+                grows = MagnitudeSqr(rel) > scale;
+            } else if (count == 2) {
+                grows = MagnitudeSqr(Cross(verts[1].w - verts[0].w, rel)) >
+                    scale * MagnitudeSqr(verts[1].w - verts[0].w);
+            } else {
+                vec3 n = Cross(verts[1].w - verts[0].w,
+                               verts[2].w - verts[0].w);
+                float h = Dot(n, rel);
+                grows = h * h > scale * MagnitudeSqr(n);
+            }
+            if (grows) {
+                verts[count++] = w;
+                break;
+            }
+        }
+    }
+
+    if (count < 4) {
+        // Flat overlap, the shapes only touch
+        vec3 n = (count == 3) ?
+            Cross(verts[1].w - verts[0].w, verts[2].w - verts[0].w) :
+            vec3(0.0f, 1.0f, 0.0f);
+        normal = Normalized(n);
+        depth = 0.0f;
+        pointA = verts[0].a;
+        pointB = verts[0].b;
+        return;
+    }
+
+    EpaFace faces[EPA_MAX_FACES];
+    int faceCount = 0;
+    static const int tetra[4][3] = {
+        { 0, 1, 2 }, { 0, 3, 1 }, { 0, 2, 3 }, { 1, 3, 2 }
+    };
+    vec3 centroid = (verts[0].w + verts[1].w + verts[2].w + verts[3].w) *
+        0.25f;
+    for (int i = 0; i < 4; i++) {
+        EpaFace face;
+        if (!MakeFace(verts, tetra[i][0], tetra[i][1], tetra[i][2], face)) {
+            continue;
+        }
+        if (Dot(face.normal, verts[face.v[0]].w - centroid) < 0.0f) {
+            MakeFace(verts, tetra[i][0], tetra[i][2], tetra[i][1], face);
+        }
+        faces[faceCount++] = face;
+    }
+
+    int closest = 0;
+    for (int iteration = 0; iteration < EPA_MAX_ITERATIONS; iteration++) {
+        closest = 0;
+        for (int i = 1; i < faceCount; i++) {
+            if (faces[i].dist < faces[closest].dist) {
+                closest = i;
+            }
+        }
+
+        EpaFace face = faces[closest];
+        SimplexVertex<vec3> w = Support(a, b, face.normal);
+        float supportDist = Dot(w.w, face.normal);
+        if (supportDist - face.dist <=
+                EPA_TOLERANCE * fmaxf(1.0f, supportDist) ||
+            count == EPA_MAX_VERTICES) {
+            break;
+        }
+        int index = count;
+        verts[count++] = w;
+
+        // Remove every face the new vertex can see and keep the edges on
+        // the border of that region (the horizon)
+        int edges[EPA_MAX_FACES * 3][2];
+        int edgeCount = 0;
+        for (int i = 0; i < faceCount; i++) {
+            if (Dot(faces[i].normal, w.w - verts[faces[i].v[0]].w) <= 0.0f) {
+                continue;
+            }
+            for (int e = 0; e < 3; e++) {
+                int e0 = faces[i].v[e];
+                int e1 = faces[i].v[(e + 1) % 3];
+                bool shared = false;
+                for (int k = 0; k < edgeCount; k++) {
+                    if (edges[k][0] == e1 && edges[k][1] == e0) {
+                        edges[k][0] = edges[edgeCount - 1][0];
+                        edges[k][1] = edges[edgeCount - 1][1];
+                        edgeCount--;
+                        shared = true;
+                        break;
+                    }
+                }
+                if (!shared) {
+                    edges[edgeCount][0] = e0;
+                    edges[edgeCount][1] = e1;
+                    edgeCount++;
+                }
+            }
+            faces[i] = faces[faceCount - 1];
+            faceCount--;
+            i--;
+        }
+
+        for (int i = 0; i < edgeCount && faceCount < EPA_MAX_FACES; i++) {
+            EpaFace newFace;
+            if (MakeFace(verts, edges[i][0], edges[i][1], index, newFace)) {
+                faces[faceCount++] = newFace;
+            }
+        }
+        if (faceCount == 0) {
+            faces[0] = face;
+            faceCount = 1;
+            break;
+        }
+    }
+
+    closest = 0;
+    for (int i = 1; i < faceCount; i++) {
+        if (faces[i].dist < faces[closest].dist) {
+            closest = i;
+        }
+    }
+
+    const EpaFace& face = faces[closest];
+    const SimplexVertex<vec3>& v0 = verts[face.v[0]];
+    const SimplexVertex<vec3>& v1 = verts[face.v[1]];
+    const SimplexVertex<vec3>& v2 = verts[face.v[2]];
+    float u, v, w;
+    Barycentric(face.normal * face.dist, v0.w, v1.w, v2.w, u, v, w);
+
+    normal = face.normal;
+    depth = face.dist;
+    pointA = v0.a * u + v1.a * v + v2.a * w;
+    pointB = v0.b * u + v1.b * v + v2.b * w;
+}
+
+template<typename V, typename Shape, typename Cache>
+static bool OverlapImpl(const Shape& a, const Shape& b, Cache* cache)
+{
+    Simplex<V> s;
+    V v;
+    int iterations;
+    float radius = a.radius + b.radius;
+    GjkStatus status = GjkSolve(a, b, cache, radius, s, v, iterations);
+    if (status == GJK_OVERLAP) {
+        return true;
+    }
+    if (status == GJK_SEPARATED) {
+        return false;
+    }
+    return MagnitudeSqr(v) <= radius * radius;
+}
+
+template<typename V, typename Shape, typename Cache, typename Result>
+static Result CollideImpl(const Shape& a, const Shape& b, Cache* cache)
+{
+    Result result;
+    Simplex<V> s;
+    V v;
+    GjkStatus status = GjkSolve(a, b, cache, FLT_MAX, s, v,
+                                result.iterations);
+
+    if (status != GJK_OVERLAP) {
+        float coreDistance = Magnitude(v);
+        V pointA, pointB;
+        Witness(s, pointA, pointB);
+
+        result.normal = v * (-1.0f / coreDistance);
+        result.pointA = pointA + result.normal * a.radius;
+        result.pointB = pointB - result.normal * b.radius;
+        result.distance = coreDistance - a.radius - b.radius;
+        result.intersecting = result.distance <= 0.0f;
+        result.depth = result.intersecting ? -result.distance : 0.0f;
+        if (result.intersecting) {
+            result.distance = 0.0f;
+        }
+        return result;
+    }
+
+    V normal, pointA, pointB;
+    float depth;
+    Epa(a, b, s, normal, depth, pointA, pointB);
+
+    result.intersecting = true;
+    result.distance = 0.0f;
+    result.depth = depth + a.radius + b.radius;
+    result.normal = normal;
+    result.pointA = pointA + normal * a.radius;
+    result.pointB = pointB - normal * b.radius;
+    return result;
+}
+
+bool GjkOverlap(const ConvexShape2D& a, const ConvexShape2D& b,
+                GjkCache2D* cache)
+{
+    PROFILE_FUNCTION();
+    return OverlapImpl<vec2>(a, b, cache);
+}
+
+bool GjkOverlap(const ConvexShape3D& a, const ConvexShape3D& b,
+                GjkCache3D* cache)
+{
+    PROFILE_FUNCTION();
+    return OverlapImpl<vec3>(a, b, cache);
+}
+
+GjkResult2D GjkCollide(const ConvexShape2D& a, const ConvexShape2D& b,
+                       GjkCache2D* cache)
+{
+    PROFILE_FUNCTION();
+    return CollideImpl<vec2, ConvexShape2D, GjkCache2D, GjkResult2D>(
+            a, b, cache);
+}
+
+GjkResult3D GjkCollide(const ConvexShape3D& a, const ConvexShape3D& b,
+                       GjkCache3D* cache)
+{
+    PROFILE_FUNCTION();
+    return CollideImpl<vec3, ConvexShape3D, GjkCache3D, GjkResult3D>(
+            a, b, cache);
+}
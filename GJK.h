@@ -0,0 +1,142 @@
+#ifndef _H_GJK_
+#define _H_GJK_
+
+#include "Geometry2D.h"
+#include "Geometry3D.h"
+
+/* Support function based collision between convex shapes.
+ *
+ * Every shape is described to GJK by a support function, which returns the
+ * point of the shape furthest along a direction, and a radius that rounds
+ * it. Rounded shapes (circles, spheres, capsules) are run on their core
+ * (a point or a segment) and the radii are applied afterwards, which keeps
+ * GJK exact and fast on them.
+ *
+ * GjkOverlap only answers whether two shapes touch. GjkCollide also
+ * returns the distance and closest points of separated shapes and, using
+ * EPA, the penetration depth and normal of overlapping ones.
+ *
+ * Passing the same GjkCache to every query of a pair warm starts GJK from
+ * the simplex of the previous query, so pairs that moved a little since
+ * the last frame converge in one or two iterations.
+ */
+
+#define GJK_MAX_ITERATIONS 32
+#define EPA_MAX_ITERATIONS 64
+#define EPA_MAX_VERTICES 96
+#define GJK_TOLERANCE 1.0e-5f
+
+typedef vec2 (*SupportFunction2D)(const void* shape, const float* params,
+                                  const vec2& direction);
+typedef vec3 (*SupportFunction3D)(const void* shape, const float* params,
+                                  const vec3& direction);
+
+/* Convex set of points (polygon vertices, a capsule segment, ...) */
+typedef struct ConvexHull2D
+{
+    const vec2* points;
+    int count;
+
+    inline ConvexHull2D() : points(0), count(0) {}
+    inline ConvexHull2D(const vec2* _points, int _count) :
+        points(_points), count(_count) {}
+} ConvexHull2D;
+
+typedef struct ConvexHull3D
+{
+    const vec3* points;
+    int count;
+
+    inline ConvexHull3D() : points(0), count(0) {}
+    inline ConvexHull3D(const vec3* _points, int _count) :
+        points(_points), count(_count) {}
+} ConvexHull3D;
+
+/* The shape is referenced, not copied: it must outlive the queries.
+ * `params` caches per-shape values (e.g. the rotation of an
+ * OrientedRectangle) so the support function doesn't recompute them.
+ */
+typedef struct ConvexShape2D
+{
+    const void* shape;
+    SupportFunction2D support;
+    float radius;
+    vec2 center;
+    float params[4];
+} ConvexShape2D;
+
+typedef struct ConvexShape3D
+{
+    const void* shape;
+    SupportFunction3D support;
+    float radius;
+    vec3 center;
+    float params[4];
+} ConvexShape3D;
+
+ConvexShape2D MakeConvexShape(const Circle& circle);
+ConvexShape2D MakeConvexShape(const Rectangle2D& rect);
+ConvexShape2D MakeConvexShape(const OrientedRectangle& rect);
+ConvexShape2D MakeConvexShape(const ConvexHull2D& hull, float radius = 0.0f);
+ConvexShape2D MakeConvexShape(const Polygon2D& polygon);
+ConvexShape2D MakeConvexShape(const Capsule2D& capsule);
+
+ConvexShape3D MakeConvexShape(const Sphere& sphere);
+ConvexShape3D MakeConvexShape(const AABB& aabb);
+ConvexShape3D MakeConvexShape(const OBB& obb);
+ConvexShape3D MakeConvexShape(const ConvexHull3D& hull, float radius = 0.0f);
+
+/* Support directions of the last simplex of a pair */
+typedef struct GjkCache2D
+{
+    vec2 directions[3];
+    int count;
+
+    inline GjkCache2D() : count(0) {}
+} GjkCache2D;
+
+typedef struct GjkCache3D
+{
+    vec3 directions[4];
+    int count;
+
+    inline GjkCache3D() : count(0) {}
+} GjkCache3D;
+
+/* `normal` points from A to B. For separated shapes `pointA`/`pointB` are
+ * the closest points, for overlapping ones the deepest points of each
+ * shape inside the other.
+ */
+typedef struct GjkResult2D
+{
+    bool intersecting;
+    float distance;
+    float depth;
+    vec2 normal;
+    vec2 pointA;
+    vec2 pointB;
+    int iterations;
+} GjkResult2D;
+
+typedef struct GjkResult3D
+{
+    bool intersecting;
+    float distance;
+    float depth;
+    vec3 normal;
+    vec3 pointA;
+    vec3 pointB;
+    int iterations;
+} GjkResult3D;
+
+bool GjkOverlap(const ConvexShape2D& a, const ConvexShape2D& b,
+                GjkCache2D* cache = 0);
+bool GjkOverlap(const ConvexShape3D& a, const ConvexShape3D& b,
+                GjkCache3D* cache = 0);
+
+GjkResult2D GjkCollide(const ConvexShape2D& a, const ConvexShape2D& b,
+                       GjkCache2D* cache = 0);
+GjkResult3D GjkCollide(const ConvexShape3D& a, const ConvexShape3D& b,
+                       GjkCache3D* cache = 0);
+
+#endif
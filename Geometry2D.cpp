@@ -1,8 +1,12 @@
 #include "Geometry2D.h"
 #include "matrices.h"
+#include "Parallel.h"
+#include "Profiler.h"
 
 #include <cmath>
 #include <cfloat>
+#include <algorithm>
+#include <vector>
 
 /* For details on the float comparison, check
  * http://realtimecollisiondetection.net/pubs/Tolerances/
@@ -15,16 +19,19 @@
 
 float Length(const Line2D& line)
 {
+    PROFILE_FUNCTION();
     return Magnitude(line.end - line.start);
 }
 
 float LengthSqr(const Line2D& line)
 {
+    PROFILE_FUNCTION();
     return MagnitudeSqr(line.end - line.start);
 }
 
 vec2 GetMin(const Rectangle2D& rect)
 {
+    PROFILE_FUNCTION();
     vec2 p1 = rect.origin;
     vec2 p2 = p1 + rect.size;
 
@@ -33,6 +40,7 @@ vec2 GetMin(const Rectangle2D& rect)
 
 vec2 GetMax(const Rectangle2D& rect)
 {
+    PROFILE_FUNCTION();
     vec2 p1 = rect.origin;
     vec2 p2 = p1 + rect.size;
 
@@ -41,11 +49,32 @@ vec2 GetMax(const Rectangle2D& rect)
 
 Rectangle2D FromMinMax(const vec2& min, const vec2& max)
 {
+    PROFILE_FUNCTION();
     return Rectangle2D(min, max - min);
 }
 
+Rectangle2D ContainingRectangle(const Line2D& line)
+{
+    PROFILE_FUNCTION();
+    vec2 min(fminf(line.start.x, line.end.x), fminf(line.start.y, line.end.y));
+    vec2 max(fmaxf(line.start.x, line.end.x), fmaxf(line.start.y, line.end.y));
+    return FromMinMax(min, max);
+}
+
+Rectangle2D ContainingRectangle(const OrientedRectangle& rect)
+{
+    PROFILE_FUNCTION();
+    float theta = DEG2RAD(rect.rotation);
+    float c = fabsf(cosf(theta));
+    float s = fabsf(sinf(theta));
+    vec2 extent(c * rect.halfExtents.x + s * rect.halfExtents.y,
+                s * rect.halfExtents.x + c * rect.halfExtents.y);
+    return Rectangle2D(rect.origin - extent, extent * 2.0f);
+}
+
 bool PointOnLine2D(const Point2D& point, const Line2D& line)
 {
+    PROFILE_FUNCTION();
     float dy = line.end.y - line.start.y;
     float dx = line.end.x - line.start.x;
     float m = (dy * 1.0f) / dx; // slope
@@ -62,6 +91,7 @@ bool PointOnLine2D(const Point2D& point, const Line2D& line)
 
 bool PointInCircle(const Point2D& point, const Circle& circle)
 {
+    PROFILE_FUNCTION();
     return MagnitudeSqr(point - circle.center) <
         (circle.radius * circle.radius);
 }
@@ -69,6 +99,7 @@ bool PointInCircle(const Point2D& point, const Circle& circle)
 bool PointInRectangle2D(const Point2D& point,
         const Rectangle2D& rectangle)
 {
+    PROFILE_FUNCTION();
     vec2 min = GetMin(rectangle);
     vec2 max = GetMax(rectangle);
 
@@ -81,19 +112,18 @@ bool PointInRectangle2D(const Point2D& point,
 bool PointInOrientedRectangle(const Point2D& point,
                               const OrientedRectangle& rectangle)
 {
+    PROFILE_FUNCTION();
     vec2 rotVector = point - rectangle.origin;
-    float theta = rectangle.rotation;
+    float theta = -DEG2RAD(rectangle.rotation);
 
     float zRotation2x2[] = {
         cosf(theta), sinf(theta),
         -sinf(theta), cosf(theta)
     };
 
-    Multiply(
+    Multiply<1, 2, 2, 2>(
             vec2(rotVector.x, rotVector.y).asArray,
-            1, 2,
             zRotation2x2,
-            2, 2,
             rotVector.asArray);
     Rectangle2D localRectangle(Point2D(),
             rectangle.halfExtents * 2.0f);
@@ -103,12 +133,11 @@ bool PointInOrientedRectangle(const Point2D& point,
 
 bool CircleLine(const Line2D& line, const Circle& circle)
 {
+    PROFILE_FUNCTION();
     vec2 ab = line.end - line.start;
     float t = Dot(circle.center - line.start, ab) / Dot(ab, ab);
 
-    if (t < 0.0f || t > 0.0f) {
-        return false;
-    }
+    t = fmaxf(0.0f, fminf(1.0f, t));
 
     Point2D closestPoint = line.start + ab * t;
     Line2D circleToClosest(circle.center, closestPoint);
@@ -118,29 +147,106 @@ bool CircleLine(const Line2D& line, const Circle& circle)
 bool LineRectangle(const Line2D& line,
                    const Rectangle2D& rect)
 {
+    PROFILE_FUNCTION();
     if (PointInRectangle2D(line.start, rect) ||
         PointInRectangle2D(line.end, rect)) {
         return true;
     }
 
-    vec2 norm = Normalized(line.end - line.start);
-    norm.x = (norm.x != 0) ? 1.0f / norm.x : 0;
-    norm.y = (norm.y != 0) ? 1.0f / norm.y : 0;
-    vec2 min = (GetMin(rect) - line.start) * norm;
-    vec2 max = (GetMax(rect) - line.start) * norm;
+    // Clip the segment against the slab of each axis. A segment parallel
+    // to an axis never crosses that slab's sides, so it only has to lie
+    // between them.
+    vec2 min = GetMin(rect);
+    vec2 max = GetMax(rect);
+    vec2 direction = line.end - line.start;
+    float tmin = 0.0f;
+    float tmax = 1.0f;
+    for (int i = 0; i < 2; i++) {
+        float start = line.start.asArray[i];
+        if (direction.asArray[i] == 0.0f) {
+            if (start < min.asArray[i] || start > max.asArray[i]) {
+                return false;
+            }
+            continue;
+        }
+        float inverse = 1.0f / direction.asArray[i];
+        float t0 = (min.asArray[i] - start) * inverse;
+        float t1 = (max.asArray[i] - start) * inverse;
+        tmin = fmaxf(tmin, fminf(t0, t1));
+        tmax = fminf(tmax, fmaxf(t0, t1));
+    }
+    return tmin <= tmax;
+}
 
-    float tmin = fmaxf(fminf(min.x, max.x), fminf(min.y, max.y));
-    float tmax = fminf(fmaxf(min.x, max.x), fmaxf(min.y, max.y));
-    if (tmax < 0 || tmin > tmax) {
-        return false;
+/* Orientation of c against the line a-b, in double so the products of
+ * float differences are exact and only their difference can round */
+static inline int Orientation(const Point2D& a, const Point2D& b,
+                              const Point2D& c)
+{
+    double cross = ((double)b.x - a.x) * ((double)c.y - a.y) -
+                   ((double)b.y - a.y) * ((double)c.x - a.x);
+    return (cross > 0.0) - (cross < 0.0);
+}
+
+// c is collinear with a-b; is it between them?
+static inline bool OnSegment(const Point2D& a, const Point2D& b,
+                             const Point2D& c)
+{
+    return c.x >= fminf(a.x, b.x) && c.x <= fmaxf(a.x, b.x) &&
+           c.y >= fminf(a.y, b.y) && c.y <= fmaxf(a.y, b.y);
+}
+
+bool LineLine(const Line2D& l1, const Line2D& l2, Point2D* point)
+{
+    PROFILE_FUNCTION();
+    const Point2D& p1 = l1.start;
+    const Point2D& q1 = l1.end;
+    const Point2D& p2 = l2.start;
+    const Point2D& q2 = l2.end;
+    int o1 = Orientation(p1, q1, p2);
+    int o2 = Orientation(p1, q1, q2);
+    int o3 = Orientation(p2, q2, p1);
+    int o4 = Orientation(p2, q2, q1);
+
+    if (o1 * o2 < 0 && o3 * o4 < 0) {
+        if (point) {
+            double dx1 = (double)q1.x - p1.x;
+            double dy1 = (double)q1.y - p1.y;
+            double dx2 = (double)q2.x - p2.x;
+            double dy2 = (double)q2.y - p2.y;
+            double t = (((double)p2.x - p1.x) * dy2 -
+                        ((double)p2.y - p1.y) * dx2) /
+                       (dx1 * dy2 - dy1 * dx2);
+            t = std::max(0.0, std::min(1.0, t));
+            *point = Point2D((float)(p1.x + dx1 * t),
+                             (float)(p1.y + dy1 * t));
+        }
+        return true;
     }
-    float t = (tmin < 0.0f) ? tmax : tmin;
-    return t > 0.0f && t * t < LengthSqr(line);
 
+    // Touching or collinear
+    const Point2D* common = 0;
+    if (o1 == 0 && OnSegment(p1, q1, p2)) {
+        common = &p2;
+    }
+    else if (o2 == 0 && OnSegment(p1, q1, q2)) {
+        common = &q2;
+    }
+    else if (o3 == 0 && OnSegment(p2, q2, p1)) {
+        common = &p1;
+    }
+    else if (o4 == 0 && OnSegment(p2, q2, q1)) {
+        common = &q1;
+    }
+    if (common && point) {
+        *point = *common;
+    }
+    return common != 0;
 }
 
 bool LineOrientedRectangle(const Line2D& line,
         const OrientedRectangle& rectangle) {
+    PROFILE_FUNCTION();
     float theta = -DEG2RAD(rectangle.rotation);
     float zRotation2x2[] = {
         cosf(theta), sinf(theta),
@@ -148,16 +254,13 @@ bool LineOrientedRectangle(const Line2D& line,
     Line2D localLine;
 
     vec2 rotVector = line.start - rectangle.origin;
-    Multiply(vec2(rotVector.x, rotVector.y).asArray,
-            1, 2,
+    Multiply<1, 2, 2, 2>(vec2(rotVector.x, rotVector.y).asArray,
             zRotation2x2,
-            2, 2, rotVector.asArray);
+            rotVector.asArray);
     localLine.start  = rotVector + rectangle.halfExtents;
     rotVector = line.end - rectangle.origin;
-    Multiply(vec2(rotVector.x, rotVector.y).asArray,
-             1, 2,
+    Multiply<1, 2, 2, 2>(vec2(rotVector.x, rotVector.y).asArray,
              zRotation2x2,
-             2, 2,
              rotVector.asArray);
     localLine.end = rotVector + rectangle.halfExtents;
     Rectangle2D localRectangle(Point2D(), rectangle.halfExtents * 2.0f);
@@ -166,9 +269,919 @@ bool LineOrientedRectangle(const Line2D& line,
 
 bool CircleCircle(const Circle& c1, const Circle& c2)
 {
+    PROFILE_FUNCTION();
     float center_distance_sq = MagnitudeSqr(c1.center - c2.center);
     float distance_sq = (c1.radius + c2.radius) * (c1.radius + c2.radius);
 
     return (distance_sq >= center_distance_sq);
 }
 
+bool CircleRectangle(const Circle& circle, const Rectangle2D& rect)
+{
+    PROFILE_FUNCTION();
+    vec2 min = GetMin(rect);
+    vec2 max = GetMax(rect);
+
+    Point2D closestPoint = circle.center;
+    closestPoint.x = fmaxf(min.x, fminf(max.x, closestPoint.x));
+    closestPoint.y = fmaxf(min.y, fminf(max.y, closestPoint.y));
+
+    return MagnitudeSqr(circle.center - closestPoint) <=
+        circle.radius * circle.radius;
+}
+
+bool CircleOrientedRectangle(const Circle& circle,
+                             const OrientedRectangle& rectangle)
+{
+    PROFILE_FUNCTION();
+    float theta = -DEG2RAD(rectangle.rotation);
+    float zRotation2x2[] = {
+        cosf(theta), sinf(theta),
+        -sinf(theta), cosf(theta) };
+
+    vec2 rotVector = circle.center - rectangle.origin;
+    Multiply<1, 2, 2, 2>(vec2(rotVector.x, rotVector.y).asArray,
+            zRotation2x2,
+            rotVector.asArray);
+    Circle localCircle(rotVector + rectangle.halfExtents, circle.radius);
+    Rectangle2D localRectangle(Point2D(), rectangle.halfExtents * 2.0f);
+    return CircleRectangle(localCircle, localRectangle);
+}
+
+// Earliest t in [0, 1] at which origin + dir * t comes within `radius`
+// of `center`
+static bool RayCircleToi(const vec2& origin, const vec2& dir,
+                         const vec2& center, float radius, float* toi)
+{
+    vec2 m = origin - center;
+    float c = Dot(m, m) - radius * radius;
+    if (c <= 0.0f) {
+        *toi = 0.0f;
+        return true;
+    }
+
+    float a = Dot(dir, dir);
+    float b = Dot(m, dir);
+    if (b >= 0.0f || a == 0.0f) {
+        return false; // moving away or not moving
+    }
+    float disc = b * b - a * c;
+    if (disc < 0.0f) {
+        return false;
+    }
+    float t = (-b - sqrtf(disc)) / a;
+    if (t > 1.0f) {
+        return false;
+    }
+    *toi = t;
+    return true;
+}
+
+static Point2D ClosestPointOnSegment(const Point2D& point, const Line2D& line)
+{
+    vec2 ab = line.end - line.start;
+    float lenSq = Dot(ab, ab);
+    if (lenSq == 0.0f) {
+        return line.start;
+    }
+    float t = Dot(point - line.start, ab) / lenSq;
+    t = fmaxf(0.0f, fminf(1.0f, t));
+    return line.start + ab * t;
+}
+
+bool SweptCircleCircle(const Circle& c1, const vec2& velocity1,
+                       const Circle& c2, const vec2& velocity2, float* toi)
+{
+    PROFILE_FUNCTION();
+    // Move in the frame of c2, which turns it into a ray against a circle
+    // of the combined radius
+    return RayCircleToi(c1.center, velocity1 - velocity2, c2.center,
+                        c1.radius + c2.radius, toi);
+}
+
+bool SweptCircleLine(const Circle& circle, const vec2& velocity,
+                     const Line2D& line, float* toi)
+{
+    PROFILE_FUNCTION();
+    float rSq = circle.radius * circle.radius;
+    Point2D closest = ClosestPointOnSegment(circle.center, line);
+    if (MagnitudeSqr(circle.center - closest) <= rSq) {
+        *toi = 0.0f;
+        return true;
+    }
+
+    // The center sweeps against a capsule around the segment: two sides
+    // offset by the radius plus a circle at each end.
+    float best = 2.0f;
+    vec2 ab = line.end - line.start;
+    float lenSq = Dot(ab, ab);
+    if (lenSq > 0.0f) {
+        vec2 n = Normalized(vec2(-ab.y, ab.x));
+        float dist = Dot(circle.center - line.start, n);
+        if (dist < 0.0f) {
+            n = n * -1.0f;
+            dist = -dist;
+        }
+        float approach = Dot(velocity, n);
+        if (approach < 0.0f) {
+            float t = (dist - circle.radius) / -approach;
+            if (t >= 0.0f && t <= 1.0f) {
+                Point2D hit = circle.center + velocity * t;
+                float s = Dot(hit - line.start, ab) / lenSq;
+                if (s >= 0.0f && s <= 1.0f) {
+                    best = t;
+                }
+            }
+        }
+    }
+
+    float t;
+    if (RayCircleToi(circle.center, velocity, line.start,
+                     circle.radius, &t) && t < best) {
+        best = t;
+    }
+    if (RayCircleToi(circle.center, velocity, line.end,
+                     circle.radius, &t) && t < best) {
+        best = t;
+    }
+
+    if (best > 1.0f) {
+        return false;
+    }
+    *toi = best;
+    return true;
+}
+
+bool SweptCircleRectangle(const Circle& circle, const vec2& velocity,
+                          const Rectangle2D& rect, float* toi)
+{
+    PROFILE_FUNCTION();
+    vec2 min = GetMin(rect);
+    vec2 max = GetMax(rect);
+
+    vec2 closest(fmaxf(min.x, fminf(circle.center.x, max.x)),
+                 fmaxf(min.y, fminf(circle.center.y, max.y)));
+    if (MagnitudeSqr(circle.center - closest) <=
+            circle.radius * circle.radius) {
+        *toi = 0.0f;
+        return true;
+    }
+
+    // Starting outside, the first contact is with one of the edges
+    Line2D edges[4] = {
+        Line2D(vec2(min.x, min.y), vec2(max.x, min.y)),
+        Line2D(vec2(max.x, min.y), vec2(max.x, max.y)),
+        Line2D(vec2(max.x, max.y), vec2(min.x, max.y)),
+        Line2D(vec2(min.x, max.y), vec2(min.x, min.y))
+    };
+    float best = 2.0f;
+    for (int i = 0; i < 4; i++) {
+        float t;
+        if (SweptCircleLine(circle, velocity, edges[i], &t) && t < best) {
+            best = t;
+        }
+    }
+
+    if (best > 1.0f) {
+        return false;
+    }
+    *toi = best;
+    return true;
+}
+
+bool SweptCircleOrientedRectangle(const Circle& circle, const vec2& velocity,
+                                  const OrientedRectangle& rectangle,
+                                  float* toi)
+{
+    PROFILE_FUNCTION();
+    float theta = -DEG2RAD(rectangle.rotation);
+    float zRotation2x2[] = {
+        cosf(theta), sinf(theta),
+        -sinf(theta), cosf(theta) };
+
+    Circle localCircle(circle.center - rectangle.origin, circle.radius);
+    Multiply<1, 2, 2, 2>(vec2(localCircle.center).asArray,
+            zRotation2x2,
+            localCircle.center.asArray);
+    localCircle.center = localCircle.center + rectangle.halfExtents;
+
+    vec2 localVelocity;
+    Multiply<1, 2, 2, 2>(vec2(velocity).asArray,
+            zRotation2x2,
+            localVelocity.asArray);
+
+    Rectangle2D localRectangle(Point2D(), rectangle.halfExtents * 2.0f);
+    return SweptCircleRectangle(localCircle, localVelocity,
+                                localRectangle, toi);
+}
+
+void SetVertices(Polygon2D& polygon, const vec2* vertices, int count)
+{
+    PROFILE_FUNCTION();
+    if (count > POLYGON2D_MAX_VERTICES) {
+        count = POLYGON2D_MAX_VERTICES;
+    }
+    for (int i = 0; i < count; i++) {
+        polygon.vertices[i] = vertices[i];
+    }
+    polygon.count = count;
+    UpdatePolygon2D(polygon);
+}
+
+void UpdatePolygon2D(Polygon2D& polygon)
+{
+    PROFILE_FUNCTION();
+    int count = polygon.count;
+
+    // Twice the signed area, negative for clockwise input
+    float area = 0.0f;
+    for (int i = 0; i < count; i++) {
+        const vec2& a = polygon.vertices[i];
+        const vec2& b = polygon.vertices[(i + 1) % count];
+        area += a.x * b.y - a.y * b.x;
+    }
+    if (area < 0.0f) {
+        for (int i = 0; i < count / 2; i++) {
+            vec2 tmp = polygon.vertices[i];
+            polygon.vertices[i] = polygon.vertices[count - 1 - i];
+            polygon.vertices[count - 1 - i] = tmp;
+        }
+    }
+
+    vec2 center;
+    for (int i = 0; i < count; i++) {
+        vec2 edge = polygon.vertices[(i + 1) % count] - polygon.vertices[i];
+        vec2 normal(edge.y, -edge.x);
+        float len = Magnitude(normal);
+        polygon.normals[i] = (len > 0.0f) ? normal * (1.0f / len) : vec2();
+        center = center + polygon.vertices[i];
+    }
+    center = (count > 0) ? center * (1.0f / count) : center;
+
+    float radiusSq = 0.0f;
+    for (int i = 0; i < count; i++) {
+        radiusSq = fmaxf(radiusSq, MagnitudeSqr(polygon.vertices[i] - center));
+    }
+    polygon.bounds = Circle(center, sqrtf(radiusSq));
+}
+
+Polygon2D ToPolygon2D(const Rectangle2D& rect)
+{
+    PROFILE_FUNCTION();
+    vec2 min = GetMin(rect);
+    vec2 max = GetMax(rect);
+    vec2 vertices[4] = {
+        vec2(min.x, min.y), vec2(max.x, min.y),
+        vec2(max.x, max.y), vec2(min.x, max.y)
+    };
+    Polygon2D result;
+    SetVertices(result, vertices, 4);
+    return result;
+}
+
+Polygon2D ToPolygon2D(const OrientedRectangle& rect)
+{
+    PROFILE_FUNCTION();
+    float theta = DEG2RAD(rect.rotation);
+    vec2 axisX = vec2(cosf(theta), sinf(theta)) * rect.halfExtents.x;
+    vec2 axisY = vec2(-sinf(theta), cosf(theta)) * rect.halfExtents.y;
+    vec2 vertices[4] = {
+        rect.origin - axisX - axisY, rect.origin + axisX - axisY,
+        rect.origin + axisX + axisY, rect.origin - axisX + axisY
+    };
+    Polygon2D result;
+    SetVertices(result, vertices, 4);
+    return result;
+}
+
+bool PointInPolygon2D(const Point2D& point, const Polygon2D& polygon)
+{
+    PROFILE_FUNCTION();
+    if (MagnitudeSqr(point - polygon.bounds.center) >
+            polygon.bounds.radius * polygon.bounds.radius) {
+        return false;
+    }
+    for (int i = 0; i < polygon.count; i++) {
+        if (Dot(point - polygon.vertices[i], polygon.normals[i]) > 0.0f) {
+            return false;
+        }
+    }
+    return polygon.count > 0;
+}
+
+bool LinePolygon2D(const Line2D& line, const Polygon2D& polygon)
+{
+    PROFILE_FUNCTION();
+    Point2D closest = ClosestPointOnSegment(polygon.bounds.center, line);
+    if (MagnitudeSqr(closest - polygon.bounds.center) >
+            polygon.bounds.radius * polygon.bounds.radius) {
+        return false;
+    }
+
+    // Cyrus-Beck: clip the segment against every edge half-plane
+    vec2 dir = line.end - line.start;
+    float tmin = 0.0f;
+    float tmax = 1.0f;
+    for (int i = 0; i < polygon.count; i++) {
+        float num = Dot(polygon.vertices[i] - line.start, polygon.normals[i]);
+        float denom = Dot(dir, polygon.normals[i]);
+        if (denom == 0.0f) {
+            if (num < 0.0f) {
+                return false; // parallel and outside this edge
+            }
+            continue;
+        }
+        float t = num / denom;
+        if (denom < 0.0f) {
+            tmin = fmaxf(tmin, t);
+        } else {
+            tmax = fminf(tmax, t);
+        }
+        if (tmin > tmax) {
+            return false;
+        }
+    }
+    return polygon.count > 0;
+}
+
+bool CirclePolygon2D(const Circle& circle, const Polygon2D& polygon)
+{
+    PROFILE_FUNCTION();
+    if (!CircleCircle(circle, polygon.bounds)) {
+        return false;
+    }
+
+    float maxSeparation = -FLT_MAX;
+    for (int i = 0; i < polygon.count; i++) {
+        float separation = Dot(circle.center - polygon.vertices[i],
+                               polygon.normals[i]);
+        if (separation > circle.radius) {
+            return false;
+        }
+        maxSeparation = fmaxf(maxSeparation, separation);
+    }
+    if (maxSeparation <= 0.0f) {
+        return true; // center inside
+    }
+
+    // Near a corner the face separation underestimates the distance
+    float rSq = circle.radius * circle.radius;
+    for (int i = 0; i < polygon.count; i++) {
+        Line2D edge(polygon.vertices[i],
+                    polygon.vertices[(i + 1) % polygon.count]);
+        Point2D closest = ClosestPointOnSegment(circle.center, edge);
+        if (MagnitudeSqr(circle.center - closest) <= rSq) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Largest distance of p2 in front of one of p1's edges, positive means a
+// separating axis was found among p1's cached normals
+static float MaxSeparation(const Polygon2D& p1, const Polygon2D& p2)
+{
+    float best = -FLT_MAX;
+    for (int i = 0; i < p1.count; i++) {
+        const vec2& n = p1.normals[i];
+        float deepest = FLT_MAX;
+        for (int j = 0; j < p2.count; j++) {
+            deepest = fminf(deepest, Dot(p2.vertices[j] - p1.vertices[i], n));
+        }
+        if (deepest > 0.0f) {
+            return deepest;
+        }
+        best = fmaxf(best, deepest);
+    }
+    return best;
+}
+
+bool PolygonPolygon2D(const Polygon2D& p1, const Polygon2D& p2)
+{
+    PROFILE_FUNCTION();
+    if (p1.count == 0 || p2.count == 0 ||
+        !CircleCircle(p1.bounds, p2.bounds)) {
+        return false;
+    }
+    return MaxSeparation(p1, p2) <= 0.0f && MaxSeparation(p2, p1) <= 0.0f;
+}
+
+bool RectanglePolygon2D(const Rectangle2D& rect, const Polygon2D& polygon)
+{
+    PROFILE_FUNCTION();
+    return PolygonPolygon2D(ToPolygon2D(rect), polygon);
+}
+
+bool OrientedRectanglePolygon2D(const OrientedRectangle& rect,
+                                const Polygon2D& polygon)
+{
+    PROFILE_FUNCTION();
+    return PolygonPolygon2D(ToPolygon2D(rect), polygon);
+}
+
+// Squared distance between segments p1-q1 and p2-q2, see Real-Time
+// Collision Detection 5.1.9
+static float SegmentSegmentDistanceSq(const Point2D& p1, const Point2D& q1,
+                                      const Point2D& p2, const Point2D& q2)
+{
+    vec2 d1 = q1 - p1;
+    vec2 d2 = q2 - p2;
+    vec2 r = p1 - p2;
+    float a = Dot(d1, d1);
+    float e = Dot(d2, d2);
+    float f = Dot(d2, r);
+    float s, t;
+
+    if (a <= FLT_EPSILON && e <= FLT_EPSILON) {
+        return Dot(r, r);
+    }
+    if (a <= FLT_EPSILON) {
+        s = 0.0f;
+        t = fmaxf(0.0f, fminf(1.0f, f / e));
+    } else {
+        float c = Dot(d1, r);
+        if (e <= FLT_EPSILON) {
+            t = 0.0f;
+            s = fmaxf(0.0f, fminf(1.0f, -c / a));
+        } else {
+            float b = Dot(d1, d2);
+            float denom = a * e - b * b;
+            s = (denom != 0.0f) ?
+                fmaxf(0.0f, fminf(1.0f, (b * f - c * e) / denom)) : 0.0f;
+            t = (b * s + f) / e;
+            if (t < 0.0f) {
+                t = 0.0f;
+                s = fmaxf(0.0f, fminf(1.0f, -c / a));
+            } else if (t > 1.0f) {
+                t = 1.0f;
+                s = fmaxf(0.0f, fminf(1.0f, (b - c) / a));
+            }
+        }
+    }
+
+    // Crossing segments have no gap even if the clamped points differ
+    float side1 = (d1.x * (p2.y - p1.y) - d1.y * (p2.x - p1.x));
+    float side2 = (d1.x * (q2.y - p1.y) - d1.y * (q2.x - p1.x));
+    float side3 = (d2.x * (p1.y - p2.y) - d2.y * (p1.x - p2.x));
+    float side4 = (d2.x * (q1.y - p2.y) - d2.y * (q1.x - p2.x));
+    if (side1 * side2 < 0.0f && side3 * side4 < 0.0f) {
+        return 0.0f;
+    }
+
+    return MagnitudeSqr((p1 + d1 * s) - (p2 + d2 * t));
+}
+
+bool PointInCapsule2D(const Point2D& point, const Capsule2D& capsule)
+{
+    PROFILE_FUNCTION();
+    Point2D closest = ClosestPointOnSegment(point,
+            Line2D(capsule.start, capsule.end));
+    return MagnitudeSqr(point - closest) <= capsule.radius * capsule.radius;
+}
+
+bool LineCapsule2D(const Line2D& line, const Capsule2D& capsule)
+{
+    PROFILE_FUNCTION();
+    return SegmentSegmentDistanceSq(line.start, line.end,
+                                    capsule.start, capsule.end) <=
+        capsule.radius * capsule.radius;
+}
+
+bool CircleCapsule2D(const Circle& circle, const Capsule2D& capsule)
+{
+    PROFILE_FUNCTION();
+    Point2D closest = ClosestPointOnSegment(circle.center,
+            Line2D(capsule.start, capsule.end));
+    float r = circle.radius + capsule.radius;
+    return MagnitudeSqr(circle.center - closest) <= r * r;
+}
+
+bool CapsulePolygon2D(const Capsule2D& capsule, const Polygon2D& polygon)
+{
+    PROFILE_FUNCTION();
+    if (polygon.count == 0) {
+        return false;
+    }
+    Line2D core(capsule.start, capsule.end);
+    Point2D closest = ClosestPointOnSegment(polygon.bounds.center, core);
+    float reach = polygon.bounds.radius + capsule.radius;
+    if (MagnitudeSqr(closest - polygon.bounds.center) > reach * reach) {
+        return false;
+    }
+    if (LinePolygon2D(core, polygon)) {
+        return true;
+    }
+
+    float rSq = capsule.radius * capsule.radius;
+    for (int i = 0; i < polygon.count; i++) {
+        if (SegmentSegmentDistanceSq(capsule.start, capsule.end,
+                    polygon.vertices[i],
+                    polygon.vertices[(i + 1) % polygon.count]) <= rSq) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool RectangleCapsule2D(const Rectangle2D& rect, const Capsule2D& capsule)
+{
+    PROFILE_FUNCTION();
+    return CapsulePolygon2D(capsule, ToPolygon2D(rect));
+}
+
+bool CapsuleCapsule2D(const Capsule2D& c1, const Capsule2D& c2)
+{
+    PROFILE_FUNCTION();
+    float r = c1.radius + c2.radius;
+    return SegmentSegmentDistanceSq(c1.start, c1.end, c2.start, c2.end) <=
+        r * r;
+}
+
+float SignedDistance(const Point2D& point, const Circle& circle)
+{
+    PROFILE_FUNCTION();
+    return Magnitude(point - circle.center) - circle.radius;
+}
+
+// Box of the given half extents centered on the origin
+static float BoxDistance(const vec2& point, const vec2& halfExtents)
+{
+    vec2 d(fabsf(point.x) - halfExtents.x, fabsf(point.y) - halfExtents.y);
+    vec2 outside(fmaxf(d.x, 0.0f), fmaxf(d.y, 0.0f));
+    return Magnitude(outside) + fminf(fmaxf(d.x, d.y), 0.0f);
+}
+
+float SignedDistance(const Point2D& point, const Rectangle2D& rect)
+{
+    PROFILE_FUNCTION();
+    vec2 halfExtents = rect.size * 0.5f;
+    return BoxDistance(point - (rect.origin + halfExtents), halfExtents);
+}
+
+float SignedDistance(const Point2D& point, const OrientedRectangle& rect)
+{
+    PROFILE_FUNCTION();
+    // Same rotation into the rectangle's frame as PointInOrientedRectangle
+    float theta = -DEG2RAD(rect.rotation);
+    float c = cosf(theta);
+    float s = sinf(theta);
+    vec2 d = point - rect.origin;
+    return BoxDistance(vec2(d.x * c - d.y * s, d.x * s + d.y * c),
+                       rect.halfExtents);
+}
+
+float SignedDistance(const Point2D& point, const Line2D& line)
+{
+    PROFILE_FUNCTION();
+    return Magnitude(point - ClosestPointOnSegment(point, line));
+}
+
+float SignedDistance(const Point2D& point, const Polygon2D& polygon)
+{
+    PROFILE_FUNCTION();
+    if (polygon.count == 0) {
+        return FLT_MAX;
+    }
+    // Inside a convex polygon the nearest edge is the nearest plane
+    float plane = -FLT_MAX;
+    for (int i = 0; i < polygon.count; i++) {
+        plane = fmaxf(plane, Dot(point - polygon.vertices[i],
+                                 polygon.normals[i]));
+    }
+    if (plane <= 0.0f) {
+        return plane;
+    }
+    // Outside, only edges the point is in front of can hold the nearest
+    // point
+    float distanceSq = FLT_MAX;
+    for (int i = 0; i < polygon.count; i++) {
+        if (Dot(point - polygon.vertices[i], polygon.normals[i]) <= 0.0f) {
+            continue;
+        }
+        int next = (i + 1 < polygon.count) ? i + 1 : 0;
+        Line2D edge(polygon.vertices[i], polygon.vertices[next]);
+        distanceSq = fminf(distanceSq, MagnitudeSqr(
+                point - ClosestPointOnSegment(point, edge)));
+    }
+    return sqrtf(distanceSq);
+}
+
+typedef struct SweepEntry
+{
+    float min;
+    float max;
+    int index;
+} SweepEntry;
+
+static bool CompareSweepEntry(const SweepEntry& l, const SweepEntry& r)
+{
+    return l.min < r.min;
+}
+
+ArenaVector<CollisionPair> CircleCirclePairs(const Circle* circles, int count,
+                                             FrameArena* arena)
+{
+    PROFILE_FUNCTION();
+    ArenaVector<CollisionPair> pairs((ArenaAllocator<CollisionPair>(arena)));
+
+    // Sort and sweep along x, only circles whose x extents overlap get
+    // the full test.
+    ArenaVector<SweepEntry> sweep((ArenaAllocator<SweepEntry>(arena)));
+    sweep.resize(count);
+    for (int i = 0; i < count; i++) {
+        sweep[i].min = circles[i].center.x - circles[i].radius;
+        sweep[i].max = circles[i].center.x + circles[i].radius;
+        sweep[i].index = i;
+    }
+    std::sort(sweep.begin(), sweep.end(), CompareSweepEntry);
+
+    for (int i = 0; i < count; i++) {
+        for (int j = i + 1; j < count && sweep[j].min <= sweep[i].max; j++) {
+            int a = sweep[i].index;
+            int b = sweep[j].index;
+            if (CircleCircle(circles[a], circles[b])) {
+                CollisionPair pair;
+                pair.a = std::min(a, b);
+                pair.b = std::max(a, b);
+                pairs.push_back(pair);
+            }
+        }
+    }
+    return pairs;
+}
+
+// Segments per strip LineLinePairs aims for
+#define LINE_PAIRS_STRIP_SIZE 1024
+
+typedef struct LineSweepEntry
+{
+    float minY;
+    float maxY;
+    float minX;
+    float maxX;
+    int index;
+} LineSweepEntry;
+
+static bool CompareLineSweepEntry(const LineSweepEntry& l,
+                                  const LineSweepEntry& r)
+{
+    return l.minY < r.minY;
+}
+
+ArenaVector<LineIntersection> LineLinePairs(const Line2D* lines, int count,
+                                            FrameArena* arena)
+{
+    PROFILE_FUNCTION();
+    ArenaVector<LineIntersection> result(
+            (ArenaAllocator<LineIntersection>(arena)));
+    if (count < 2) {
+        return result;
+    }
+
+    float minX = FLT_MAX;
+    float maxX = -FLT_MAX;
+    for (int i = 0; i < count; i++) {
+        minX = fminf(minX, fminf(lines[i].start.x, lines[i].end.x));
+        maxX = fmaxf(maxX, fmaxf(lines[i].start.x, lines[i].end.x));
+    }
+    int strips = std::max(1, count / LINE_PAIRS_STRIP_SIZE);
+    float invWidth = (maxX > minX) ? strips / (maxX - minX) : 0.0f;
+    auto stripOf = [&](float x) {
+        int strip = (int)((x - minX) * invWidth);
+        return std::max(0, std::min(strips - 1, strip));
+    };
+
+    // Every segment goes to each strip its x extent touches
+    std::vector<int> stripStart(strips + 1, 0);
+    for (int i = 0; i < count; i++) {
+        int first = stripOf(fminf(lines[i].start.x, lines[i].end.x));
+        int last = stripOf(fmaxf(lines[i].start.x, lines[i].end.x));
+        for (int s = first; s <= last; s++) {
+            stripStart[s + 1]++;
+        }
+    }
+    for (int s = 0; s < strips; s++) {
+        stripStart[s + 1] += stripStart[s];
+    }
+    std::vector<int> stripLines(stripStart[strips]);
+    std::vector<int> cursor(stripStart.begin(), stripStart.end() - 1);
+    for (int i = 0; i < count; i++) {
+        int first = stripOf(fminf(lines[i].start.x, lines[i].end.x));
+        int last = stripOf(fmaxf(lines[i].start.x, lines[i].end.x));
+        for (int s = first; s <= last; s++) {
+            stripLines[cursor[s]++] = i;
+        }
+    }
+
+    std::vector<std::vector<LineIntersection> > found(strips);
+    ParallelFor(strips, 1, [&](int begin, int end) {
+        std::vector<LineSweepEntry> sweep;
+        for (int s = begin; s < end; s++) {
+            sweep.resize(stripStart[s + 1] - stripStart[s]);
+            for (size_t k = 0; k < sweep.size(); k++) {
+                int i = stripLines[stripStart[s] + k];
+                sweep[k].minY = fminf(lines[i].start.y, lines[i].end.y);
+                sweep[k].maxY = fmaxf(lines[i].start.y, lines[i].end.y);
+                sweep[k].minX = fminf(lines[i].start.x, lines[i].end.x);
+                sweep[k].maxX = fmaxf(lines[i].start.x, lines[i].end.x);
+                sweep[k].index = i;
+            }
+            std::sort(sweep.begin(), sweep.end(), CompareLineSweepEntry);
+
+            for (size_t i = 0; i < sweep.size(); i++) {
+                const LineSweepEntry& e = sweep[i];
+                for (size_t j = i + 1;
+                     j < sweep.size() && sweep[j].minY <= e.maxY; j++) {
+                    const LineSweepEntry& f = sweep[j];
+                    int a = std::min(e.index, f.index);
+                    int b = std::max(e.index, f.index);
+                    Point2D point;
+                    if (f.maxX < e.minX || f.minX > e.maxX ||
+                        !LineLine(lines[a], lines[b], &point)) {
+                        continue;
+                    }
+                    // The strip holding the point, kept inside the x
+                    // extent both segments share, reports the pair
+                    float x = std::max(std::max(e.minX, f.minX),
+                                       std::min(std::min(e.maxX, f.maxX),
+                                                point.x));
+                    if (stripOf(x) != s) {
+                        continue;
+                    }
+                    LineIntersection hit;
+                    hit.a = a;
+                    hit.b = b;
+                    hit.point = point;
+                    found[s].push_back(hit);
+                }
+            }
+        }
+    });
+
+    size_t total = 0;
+    for (int s = 0; s < strips; s++) {
+        total += found[s].size();
+    }
+    result.reserve(total);
+    for (int s = 0; s < strips; s++) {
+        result.insert(result.end(), found[s].begin(), found[s].end());
+    }
+    return result;
+}
+
+ArenaVector<Line2D> LinesToLocal(const Line2D* lines, int count,
+                                 const OrientedRectangle& rectangle,
+                                 FrameArena* arena)
+{
+    PROFILE_FUNCTION();
+    ArenaVector<Line2D> result((ArenaAllocator<Line2D>(arena)));
+    result.reserve(count);
+
+    // Same transform as LineOrientedRectangle, with the rotation built once
+    float theta = -DEG2RAD(rectangle.rotation);
+    float zRotation2x2[] = {
+        cosf(theta), sinf(theta),
+        -sinf(theta), cosf(theta) };
+
+    for (int i = 0; i < count; i++) {
+        Line2D localLine;
+        vec2 rotVector = lines[i].start - rectangle.origin;
+        Multiply<1, 2, 2, 2>(vec2(rotVector.x, rotVector.y).asArray,
+                zRotation2x2,
+                rotVector.asArray);
+        localLine.start = rotVector + rectangle.halfExtents;
+        rotVector = lines[i].end - rectangle.origin;
+        Multiply<1, 2, 2, 2>(vec2(rotVector.x, rotVector.y).asArray,
+                zRotation2x2,
+                rotVector.asArray);
+        localLine.end = rotVector + rectangle.halfExtents;
+        result.push_back(localLine);
+    }
+    return result;
+}
+
+ArenaVector<int> LinesOrientedRectangle(const Line2D* lines, int count,
+                                        const OrientedRectangle& rectangle,
+                                        FrameArena* arena)
+{
+    PROFILE_FUNCTION();
+    ArenaVector<int> hits((ArenaAllocator<int>(arena)));
+    hits.reserve(count);
+    Rectangle2D localRectangle(Point2D(), rectangle.halfExtents * 2.0f);
+
+    // The local copies are scratch, rewind the arena past them once done
+    size_t marker = arena ? arena->GetMarker() : 0;
+    {
+        ArenaVector<Line2D> local = LinesToLocal(lines, count, rectangle,
+                                                 arena);
+        for (int i = 0; i < count; i++) {
+            if (LineRectangle(local[i], localRectangle)) {
+                hits.push_back(i);
+            }
+        }
+    }
+    if (arena) {
+        arena->FreeToMarker(marker);
+    }
+    return hits;
+}
+
+static bool BoundsOverlap(const vec2& minA, const vec2& maxA,
+                          const vec2& minB, const vec2& maxB)
+{
+    return minA.x <= maxB.x && minB.x <= maxA.x &&
+           minA.y <= maxB.y && minB.y <= maxA.y;
+}
+
+ArenaVector<SweptHit> SweptCircles(const Circle* movers,
+                                   const vec2* velocities, int count,
+                                   const SweptTargets& targets,
+                                   FrameArena* arena)
+{
+    PROFILE_FUNCTION();
+    ArenaVector<SweptHit> hits((ArenaAllocator<SweptHit>(arena)));
+    hits.reserve(count);
+
+    // Target bounds are scratch, computed once for every mover and rewound
+    // past once done
+    size_t marker = arena ? arena->GetMarker() : 0;
+    {
+        ArenaVector<Rectangle2D> lineBounds(
+                (ArenaAllocator<Rectangle2D>(arena)));
+        ArenaVector<Rectangle2D> orientedBounds(
+                (ArenaAllocator<Rectangle2D>(arena)));
+        lineBounds.reserve(targets.lineCount);
+        orientedBounds.reserve(targets.orientedRectangleCount);
+        for (int j = 0; j < targets.lineCount; j++) {
+            lineBounds.push_back(ContainingRectangle(targets.lines[j]));
+        }
+        for (int j = 0; j < targets.orientedRectangleCount; j++) {
+            orientedBounds.push_back(
+                    ContainingRectangle(targets.orientedRectangles[j]));
+        }
+
+        for (int i = 0; i < count; i++) {
+            const Circle& mover = movers[i];
+            const vec2& velocity = velocities[i];
+            vec2 end = mover.center + velocity;
+            vec2 reach(mover.radius, mover.radius);
+            vec2 sweepMin = vec2(fminf(mover.center.x, end.x),
+                                 fminf(mover.center.y, end.y)) - reach;
+            vec2 sweepMax = vec2(fmaxf(mover.center.x, end.x),
+                                 fmaxf(mover.center.y, end.y)) + reach;
+
+            SweptHit best;
+            best.mover = i;
+            best.type = SWEPT_LINE;
+            best.target = -1;
+            best.toi = 2.0f;
+            float t;
+
+            for (int j = 0; j < targets.lineCount; j++) {
+                if (BoundsOverlap(sweepMin, sweepMax,
+                                  GetMin(lineBounds[j]),
+                                  GetMax(lineBounds[j])) &&
+                    SweptCircleLine(mover, velocity, targets.lines[j], &t) &&
+                    t < best.toi) {
+                    best.type = SWEPT_LINE;
+                    best.target = j;
+                    best.toi = t;
+                }
+            }
+
+            for (int j = 0; j < targets.rectangleCount; j++) {
+                const Rectangle2D& rect = targets.rectangles[j];
+                if (BoundsOverlap(sweepMin, sweepMax,
+                                  GetMin(rect), GetMax(rect)) &&
+                    SweptCircleRectangle(mover, velocity, rect, &t) &&
+                    t < best.toi) {
+                    best.type = SWEPT_RECTANGLE;
+                    best.target = j;
+                    best.toi = t;
+                }
+            }
+
+            for (int j = 0; j < targets.orientedRectangleCount; j++) {
+                if (BoundsOverlap(sweepMin, sweepMax,
+                                  GetMin(orientedBounds[j]),
+                                  GetMax(orientedBounds[j])) &&
+                    SweptCircleOrientedRectangle(
+                            mover, velocity, targets.orientedRectangles[j],
+                            &t) &&
+                    t < best.toi) {
+                    best.type = SWEPT_ORIENTED_RECTANGLE;
+                    best.target = j;
+                    best.toi = t;
+                }
+            }
+
+            if (best.target >= 0) {
+                hits.push_back(best);
+            }
+        }
+    }
+    if (arena) {
+        arena->FreeToMarker(marker);
+    }
+    return hits;
+}
@@ -3,6 +3,7 @@
 
 #include "vectors.h"
 #include "matrices.h"
+#include "Memory.h"
 
 typedef struct vec2 Point2D;
 
@@ -51,12 +52,50 @@ typedef struct OrientedRectangle
         rotation(_rotation) {}
 } OrientedRectangle;
 
+#define POLYGON2D_MAX_VERTICES 16
+
+/* Convex polygon with counter clockwise vertices. normals[i] is the
+ * outward unit normal of the edge from vertices[i] to vertices[i + 1] and
+ * `bounds` encloses every vertex; both are cached by UpdatePolygon2D and
+ * reused by every query, so call it again after editing the vertices.
+ */
+typedef struct Polygon2D
+{
+    vec2 vertices[POLYGON2D_MAX_VERTICES];
+    vec2 normals[POLYGON2D_MAX_VERTICES];
+    int count;
+    Circle bounds;
+
+    inline Polygon2D() : count(0), bounds(Point2D(), 0.0f) {}
+} Polygon2D;
+
+typedef struct Capsule2D
+{
+    Point2D start;
+    Point2D end;
+    float radius;
+
+    inline Capsule2D() : radius(1.0f) {}
+    inline Capsule2D(const Point2D& _start, const Point2D& _end,
+                     float _radius) :
+        start(_start), end(_end), radius(_radius) {}
+} Capsule2D;
+
 float Length(const Line2D& line);
 float LengthSqr(const Line2D& line);
 
 vec2 GetMin(const Rectangle2D& rect);
 vec2 GetMax(const Rectangle2D& rect);
 Rectangle2D FromMinMax(const vec2& min, const vec2& max);
+Rectangle2D ContainingRectangle(const Line2D& line);
+Rectangle2D ContainingRectangle(const OrientedRectangle& rect);
+
+/* Copies up to POLYGON2D_MAX_VERTICES vertices (either winding) and
+ * builds the cached normals and bounds */
+void SetVertices(Polygon2D& polygon, const vec2* vertices, int count);
+void UpdatePolygon2D(Polygon2D& polygon);
+Polygon2D ToPolygon2D(const Rectangle2D& rect);
+Polygon2D ToPolygon2D(const OrientedRectangle& rect);
 
 bool PointOnLine2D(const Point2D& point, const Line2D& line);
 bool PointInCircle(const Point2D& point, const Circle& circle);
@@ -68,7 +107,138 @@ bool PointInOrientedRectangle(const Point2D& point,
 bool CircleLine(const Line2D& line, const Circle& circle);
 bool LineOrientedRectangle(const Line2D& line, const OrientedRectangle& rectangle);
 bool LineRectangle(const Line2D& line, const Rectangle2D& rect);
+/* Segments touching at an end or overlapping along a shared line count as
+ * intersecting. On a hit `point` gets a point common to both: the crossing
+ * point, or for touching and overlapping segments the first of
+ * l2.start, l2.end, l1.start, l1.end lying on the other segment. */
+bool LineLine(const Line2D& l1, const Line2D& l2, Point2D* point = 0);
 
 bool CircleCircle(const Circle& c1, const Circle& c2);
+bool CircleRectangle(const Circle& circle, const Rectangle2D& rect);
+bool CircleOrientedRectangle(const Circle& circle,
+                             const OrientedRectangle& rectangle);
+
+bool PointInPolygon2D(const Point2D& point, const Polygon2D& polygon);
+bool LinePolygon2D(const Line2D& line, const Polygon2D& polygon);
+bool CirclePolygon2D(const Circle& circle, const Polygon2D& polygon);
+bool RectanglePolygon2D(const Rectangle2D& rect, const Polygon2D& polygon);
+bool OrientedRectanglePolygon2D(const OrientedRectangle& rect,
+                                const Polygon2D& polygon);
+bool PolygonPolygon2D(const Polygon2D& p1, const Polygon2D& p2);
+
+bool PointInCapsule2D(const Point2D& point, const Capsule2D& capsule);
+bool LineCapsule2D(const Line2D& line, const Capsule2D& capsule);
+bool CircleCapsule2D(const Circle& circle, const Capsule2D& capsule);
+bool RectangleCapsule2D(const Rectangle2D& rect, const Capsule2D& capsule);
+bool CapsulePolygon2D(const Capsule2D& capsule, const Polygon2D& polygon);
+bool CapsuleCapsule2D(const Capsule2D& c1, const Capsule2D& c2);
+
+/* Signed distance from a point to the surface of a shape: negative
+ * inside, positive outside. Lines have no inside, their distance is never
+ * negative. Polygons are convex like everywhere in Geometry2D.
+ */
+float SignedDistance(const Point2D& point, const Circle& circle);
+float SignedDistance(const Point2D& point, const Rectangle2D& rect);
+float SignedDistance(const Point2D& point, const OrientedRectangle& rect);
+float SignedDistance(const Point2D& point, const Line2D& line);
+float SignedDistance(const Point2D& point, const Polygon2D& polygon);
+
+/* Continuous collision
+ *
+ * `velocity` is the displacement of the circle over the whole step. On a
+ * hit the time of impact in [0, 1] is written to `toi` (0 when the shapes
+ * already overlap at the start of the step).
+ */
+bool SweptCircleCircle(const Circle& c1, const vec2& velocity1,
+                       const Circle& c2, const vec2& velocity2, float* toi);
+bool SweptCircleLine(const Circle& circle, const vec2& velocity,
+                     const Line2D& line, float* toi);
+bool SweptCircleRectangle(const Circle& circle, const vec2& velocity,
+                          const Rectangle2D& rect, float* toi);
+bool SweptCircleOrientedRectangle(const Circle& circle, const vec2& velocity,
+                                  const OrientedRectangle& rectangle,
+                                  float* toi);
+
+/* Batch queries
+ *
+ * Results (and any scratch space) come from `arena` when one is passed and
+ * stay valid until the arena is reset; without an arena they are heap
+ * allocated like a regular std::vector.
+ */
+typedef struct CollisionPair
+{
+    int a;
+    int b;
+} CollisionPair;
+
+ArenaVector<CollisionPair> CircleCirclePairs(const Circle* circles, int count,
+                                             FrameArena* arena = 0);
+
+/* Every intersecting pair of a set of segments, with a common point as
+ * LineLine gives it, a < b. The bounds of the set are cut into vertical
+ * strips handed to the worker pool. Each strip sorts the segments
+ * touching it by their lowest y, sweeps them testing the pairs whose
+ * bounds overlap, and keeps the intersections whose point falls in the
+ * strip, so every pair is reported once. Pairs come out strip by strip;
+ * only the result uses `arena`.
+ */
+typedef struct LineIntersection
+{
+    int a;
+    int b;
+    Point2D point;
+} LineIntersection;
+
+ArenaVector<LineIntersection> LineLinePairs(const Line2D* lines, int count,
+                                            FrameArena* arena = 0);
+
+/* Swept circles against static geometry. Reports the earliest hit of
+ * every mover that touches something during the step. The bounds of the
+ * targets are computed once, then each mover is culled against all of
+ * them with its swept bounds before any exact test, so the cost still
+ * grows with movers x targets. For a whole level, bake it and use
+ * CollisionFile::QuerySweptCircles, which only visits the grid cells
+ * along each sweep.
+ */
+typedef struct SweptTargets
+{
+    const Line2D* lines;
+    int lineCount;
+    const Rectangle2D* rectangles;
+    int rectangleCount;
+    const OrientedRectangle* orientedRectangles;
+    int orientedRectangleCount;
+
+    inline SweptTargets() :
+        lines(0), lineCount(0), rectangles(0), rectangleCount(0),
+        orientedRectangles(0), orientedRectangleCount(0) {}
+} SweptTargets;
+
+enum SweptTargetType
+{
+    SWEPT_LINE,
+    SWEPT_RECTANGLE,
+    SWEPT_ORIENTED_RECTANGLE
+};
+
+typedef struct SweptHit
+{
+    int mover;
+    SweptTargetType type;
+    int target;
+    float toi;
+} SweptHit;
+
+ArenaVector<SweptHit> SweptCircles(const Circle* movers,
+                                   const vec2* velocities, int count,
+                                   const SweptTargets& targets,
+                                   FrameArena* arena = 0);
+
+ArenaVector<Line2D> LinesToLocal(const Line2D* lines, int count,
+                                 const OrientedRectangle& rectangle,
+                                 FrameArena* arena = 0);
+ArenaVector<int> LinesOrientedRectangle(const Line2D* lines, int count,
+                                        const OrientedRectangle& rectangle,
+                                        FrameArena* arena = 0);
 #endif
 
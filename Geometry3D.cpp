@@ -0,0 +1,169 @@
+#include "Geometry3D.h"
+#include "Profiler.h"
+
+#include <cmath>
+#include <cfloat>
+
+vec3 GetMin(const AABB& aabb)
+{
+    PROFILE_FUNCTION();
+    vec3 p1 = aabb.position + aabb.size;
+    vec3 p2 = aabb.position - aabb.size;
+
+    return vec3(fminf(p1.x, p2.x), fminf(p1.y, p2.y), fminf(p1.z, p2.z));
+}
+
+vec3 GetMax(const AABB& aabb)
+{
+    PROFILE_FUNCTION();
+    vec3 p1 = aabb.position + aabb.size;
+    vec3 p2 = aabb.position - aabb.size;
+
+    return vec3(fmaxf(p1.x, p2.x), fmaxf(p1.y, p2.y), fmaxf(p1.z, p2.z));
+}
+
+AABB FromMinMax(const vec3& min, const vec3& max)
+{
+    PROFILE_FUNCTION();
+    return AABB((min + max) * 0.5f, (max - min) * 0.5f);
+}
+
+// Real-Time Collision Detection 5.1.5
+Point3D ClosestPoint(const Triangle& triangle, const Point3D& point)
+{
+    PROFILE_FUNCTION();
+    const Point3D& a = triangle.a;
+    const Point3D& b = triangle.b;
+    const Point3D& c = triangle.c;
+    vec3 ab = b - a;
+    vec3 ac = c - a;
+
+    vec3 ap = point - a;
+    float d1 = Dot(ab, ap);
+    float d2 = Dot(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f) {
+        return a;
+    }
+
+    vec3 bp = point - b;
+    float d3 = Dot(ab, bp);
+    float d4 = Dot(ac, bp);
+    if (d3 >= 0.0f && d4 <= d3) {
+        return b;
+    }
+
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+        return a + ab * (d1 / (d1 - d3));
+    }
+
+    vec3 cp = point - c;
+    float d5 = Dot(ab, cp);
+    float d6 = Dot(ac, cp);
+    if (d6 >= 0.0f && d5 <= d6) {
+        return c;
+    }
+
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+        return a + ac * (d2 / (d2 - d6));
+    }
+
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+        return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    }
+
+    float denom = 1.0f / (va + vb + vc);
+    return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+bool TriangleSphere(const Triangle& triangle, const Sphere& sphere)
+{
+    PROFILE_FUNCTION();
+    Point3D closest = ClosestPoint(triangle, sphere.position);
+    return MagnitudeSqr(closest - sphere.position) <=
+        sphere.radius * sphere.radius;
+}
+
+// Projects the triangle and the box on `axis` and checks for a gap. The
+// box is centered at the origin.
+static bool OverlapOnAxis(const vec3& v0, const vec3& v1, const vec3& v2,
+                          const vec3& extents, const vec3& axis)
+{
+    float p0 = Dot(v0, axis);
+    float p1 = Dot(v1, axis);
+    float p2 = Dot(v2, axis);
+    float r = extents.x * fabsf(axis.x) + extents.y * fabsf(axis.y) +
+              extents.z * fabsf(axis.z);
+    return fmaxf(p0, fmaxf(p1, p2)) >= -r && fminf(p0, fminf(p1, p2)) <= r;
+}
+
+// Akenine-Moller SAT: the 3 box normals, the triangle normal and the 9
+// edge cross products
+bool TriangleAABB(const Triangle& triangle, const AABB& aabb)
+{
+    PROFILE_FUNCTION();
+    vec3 v0 = triangle.a - aabb.position;
+    vec3 v1 = triangle.b - aabb.position;
+    vec3 v2 = triangle.c - aabb.position;
+    vec3 extents(fabsf(aabb.size.x), fabsf(aabb.size.y), fabsf(aabb.size.z));
+
+    for (int i = 0; i < 3; i++) {
+        float lo = fminf(v0.asArray[i], fminf(v1.asArray[i], v2.asArray[i]));
+        float hi = fmaxf(v0.asArray[i], fmaxf(v1.asArray[i], v2.asArray[i]));
+        if (lo > extents.asArray[i] || hi < -extents.asArray[i]) {
+            return false;
+        }
+    }
+
+    vec3 edges[3] = { v1 - v0, v2 - v1, v0 - v2 };
+    if (!OverlapOnAxis(v0, v1, v2, extents, Cross(edges[0], edges[1]))) {
+        return false;
+    }
+
+    vec3 boxAxes[3] = {
+        vec3(1.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f), vec3(0.0f, 0.0f, 1.0f)
+    };
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            if (!OverlapOnAxis(v0, v1, v2, extents,
+                               Cross(boxAxes[i], edges[j]))) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Moller-Trumbore
+bool Raycast(const Triangle& triangle, const Ray& ray, float* t)
+{
+    PROFILE_FUNCTION();
+    vec3 e1 = triangle.b - triangle.a;
+    vec3 e2 = triangle.c - triangle.a;
+    vec3 p = Cross(ray.direction, e2);
+    float det = Dot(e1, p);
+    if (fabsf(det) < 1.0e-12f) {
+        return false; // parallel to the plane or degenerate
+    }
+    float invDet = 1.0f / det;
+
+    vec3 s = ray.origin - triangle.a;
+    float u = Dot(s, p) * invDet;
+    if (u < 0.0f || u > 1.0f) {
+        return false;
+    }
+    vec3 q = Cross(s, e1);
+    float v = Dot(ray.direction, q) * invDet;
+    if (v < 0.0f || u + v > 1.0f) {
+        return false;
+    }
+
+    float hit = Dot(e2, q) * invDet;
+    if (hit < 0.0f) {
+        return false;
+    }
+    *t = hit;
+    return true;
+}
@@ -0,0 +1,79 @@
+#ifndef _H_3D_GEOMETRY_
+#define _H_3D_GEOMETRY_
+
+#include "vectors.h"
+#include "matrices.h"
+
+typedef struct vec3 Point3D;
+
+typedef struct Sphere
+{
+    Point3D position;
+    float radius;
+
+    inline Sphere() : radius(1.0f) {}
+    inline Sphere(const Point3D& _position, float _radius) :
+        position(_position), radius(_radius) {}
+} Sphere;
+
+/* Axis aligned box, `size` holds the half extents */
+typedef struct AABB
+{
+    Point3D position;
+    vec3 size;
+
+    inline AABB() : size(1.0f, 1.0f, 1.0f) {}
+    inline AABB(const Point3D& _position, const vec3& _size) :
+        position(_position), size(_size) {}
+} AABB;
+
+/* Oriented box, the rows of `orientation` are its local x/y/z axes */
+typedef struct OBB
+{
+    Point3D position;
+    vec3 size;
+    mat3 orientation;
+
+    inline OBB() : size(1.0f, 1.0f, 1.0f) {}
+    inline OBB(const Point3D& _position, const vec3& _size) :
+        position(_position), size(_size) {}
+    inline OBB(const Point3D& _position, const vec3& _size,
+               const mat3& _orientation) :
+        position(_position), size(_size), orientation(_orientation) {}
+} OBB;
+
+/* `direction` is not normalized, hit distances are in multiples of it */
+typedef struct Ray
+{
+    Point3D origin;
+    vec3 direction;
+
+    inline Ray() : direction(0.0f, 0.0f, 1.0f) {}
+    inline Ray(const Point3D& _origin, const vec3& _direction) :
+        origin(_origin), direction(_direction) {}
+} Ray;
+
+typedef struct Triangle
+{
+    Point3D a;
+    Point3D b;
+    Point3D c;
+
+    inline Triangle() {}
+    inline Triangle(const Point3D& _a, const Point3D& _b, const Point3D& _c) :
+        a(_a), b(_b), c(_c) {}
+} Triangle;
+
+vec3 GetMin(const AABB& aabb);
+vec3 GetMax(const AABB& aabb);
+AABB FromMinMax(const vec3& min, const vec3& max);
+
+Point3D ClosestPoint(const Triangle& triangle, const Point3D& point);
+
+bool TriangleSphere(const Triangle& triangle, const Sphere& sphere);
+bool TriangleAABB(const Triangle& triangle, const AABB& aabb);
+
+/* Two sided; `t` receives the hit distance along the ray */
+bool Raycast(const Triangle& triangle, const Ray& ray, float* t);
+
+#endif
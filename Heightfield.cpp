@@ -0,0 +1,336 @@
+#include "Heightfield.h"
+#include "Profiler.h"
+
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+Heightfield::Heightfield() :
+    m_columns(0), m_rows(0), m_spacing(1.0f), m_invSpacing(1.0f),
+    m_minHeight(0.0f), m_heightScale(0.0f)
+{
+}
+
+void Heightfield::Build(const float* heights, int columns, int rows,
+                        const Point3D& origin, float spacing)
+{
+    PROFILE_FUNCTION();
+    m_heights.clear();
+    m_mips.clear();
+    m_mipColumns.clear();
+    m_columns = m_rows = 0;
+    if (columns < 2 || rows < 2 || spacing <= 0.0f) {
+        return;
+    }
+
+    m_columns = columns;
+    m_rows = rows;
+    m_origin = origin;
+    m_spacing = spacing;
+    m_invSpacing = 1.0f / spacing;
+
+    int count = columns * rows;
+    float minHeight = heights[0];
+    float maxHeight = heights[0];
+    for (int i = 1; i < count; i++) {
+        minHeight = fminf(minHeight, heights[i]);
+        maxHeight = fmaxf(maxHeight, heights[i]);
+    }
+    // Decoded heights are world heights, origin.y included
+    m_minHeight = origin.y + minHeight;
+    m_heightScale = (maxHeight - minHeight) / 65535.0f;
+    float invScale = (m_heightScale > 0.0f) ? 1.0f / m_heightScale : 0.0f;
+
+    m_heights.resize(count);
+    for (int i = 0; i < count; i++) {
+        float q = floorf((heights[i] - minHeight) * invScale + 0.5f);
+        m_heights[i] = (uint16_t)(q > 65535.0f ? 65535.0f : q);
+    }
+
+    // Level 0 from the corners of every cell, then 2x2 blocks of the
+    // level below until a single block covers the grid
+    int mipColumns = columns - 1;
+    int mipRows = rows - 1;
+    std::vector<HeightRange> level(mipColumns * mipRows);
+    for (int z = 0; z < mipRows; z++) {
+        for (int x = 0; x < mipColumns; x++) {
+            const uint16_t* h = &m_heights[z * columns + x];
+            uint16_t lo = std::min(std::min(h[0], h[1]),
+                                   std::min(h[columns], h[columns + 1]));
+            uint16_t hi = std::max(std::max(h[0], h[1]),
+                                   std::max(h[columns], h[columns + 1]));
+            HeightRange range = { lo, hi };
+            level[z * mipColumns + x] = range;
+        }
+    }
+    m_mips.push_back(level);
+    m_mipColumns.push_back(mipColumns);
+
+    while (mipColumns > 1 || mipRows > 1) {
+        const std::vector<HeightRange>& below = m_mips.back();
+        int belowColumns = mipColumns;
+        int belowRows = mipRows;
+        mipColumns = (mipColumns + 1) / 2;
+        mipRows = (mipRows + 1) / 2;
+
+        std::vector<HeightRange> next(mipColumns * mipRows);
+        for (int z = 0; z < mipRows; z++) {
+            for (int x = 0; x < mipColumns; x++) {
+                HeightRange range = { 65535, 0 };
+                for (int i = 0; i < 4; i++) {
+                    int bx = x * 2 + (i & 1);
+                    int bz = z * 2 + (i >> 1);
+                    if (bx < belowColumns && bz < belowRows) {
+                        const HeightRange& r = below[bz * belowColumns + bx];
+                        range.min = std::min(range.min, r.min);
+                        range.max = std::max(range.max, r.max);
+                    }
+                }
+                next[z * mipColumns + x] = range;
+            }
+        }
+        m_mips.push_back(next);
+        m_mipColumns.push_back(mipColumns);
+    }
+}
+
+AABB Heightfield::GetBounds() const
+{
+    vec3 min(m_origin.x, m_minHeight, m_origin.z);
+    vec3 max(m_origin.x + (m_columns - 1) * m_spacing,
+             m_minHeight + 65535.0f * m_heightScale,
+             m_origin.z + (m_rows - 1) * m_spacing);
+    return FromMinMax(min, max);
+}
+
+Point3D Heightfield::Sample(int x, int z) const
+{
+    return Point3D(m_origin.x + x * m_spacing,
+                   Decode(m_heights[z * m_columns + x]),
+                   m_origin.z + z * m_spacing);
+}
+
+void Heightfield::CellTriangles(int x, int z, Triangle triangles[2]) const
+{
+    Point3D p00 = Sample(x, z);
+    Point3D p10 = Sample(x + 1, z);
+    Point3D p01 = Sample(x, z + 1);
+    Point3D p11 = Sample(x + 1, z + 1);
+    triangles[0] = Triangle(p00, p10, p01);
+    triangles[1] = Triangle(p10, p11, p01);
+}
+
+bool Heightfield::HeightAt(float x, float z, float* height) const
+{
+    PROFILE_FUNCTION();
+    float gx = (x - m_origin.x) * m_invSpacing;
+    float gz = (z - m_origin.z) * m_invSpacing;
+    if (m_columns == 0 || !(gx >= 0.0f && gz >= 0.0f &&
+            gx <= (float)(m_columns - 1) && gz <= (float)(m_rows - 1))) {
+        return false;
+    }
+
+    int cx = std::min((int)gx, m_columns - 2);
+    int cz = std::min((int)gz, m_rows - 2);
+    float fx = gx - (float)cx;
+    float fz = gz - (float)cz;
+    const uint16_t* h = &m_heights[cz * m_columns + cx];
+    float h00 = Decode(h[0]);
+    float h10 = Decode(h[1]);
+    float h01 = Decode(h[m_columns]);
+    float h11 = Decode(h[m_columns + 1]);
+
+    if (fx + fz <= 1.0f) {
+        *height = h00 + (h10 - h00) * fx + (h01 - h00) * fz;
+    } else {
+        *height = h11 + (h01 - h11) * (1.0f - fx) + (h10 - h11) * (1.0f - fz);
+    }
+    return true;
+}
+
+bool Heightfield::PointInside(const Point3D& point) const
+{
+    PROFILE_FUNCTION();
+    float height;
+    return HeightAt(point.x, point.z, &height) && point.y <= height;
+}
+
+bool Heightfield::Raycast(const Ray& ray, MeshHit* hit, float maxT) const
+{
+    PROFILE_FUNCTION();
+    if (m_columns == 0) {
+        return false;
+    }
+
+    // Grid space: one unit per cell on x/z, world units on y. The map is
+    // affine per axis so distances along the ray carry over unchanged.
+    int cellColumns = m_columns - 1;
+    int cellRows = m_rows - 1;
+    float o[3] = { (ray.origin.x - m_origin.x) * m_invSpacing, ray.origin.y,
+                   (ray.origin.z - m_origin.z) * m_invSpacing };
+    float d[3] = { ray.direction.x * m_invSpacing, ray.direction.y,
+                   ray.direction.z * m_invSpacing };
+    float lo[3] = { 0.0f, m_minHeight, 0.0f };
+    float hi[3] = { (float)cellColumns, m_minHeight + 65535.0f * m_heightScale,
+                    (float)cellRows };
+
+    float t0 = 0.0f;
+    float t1 = maxT;
+    for (int a = 0; a < 3; a++) {
+        if (d[a] == 0.0f) {
+            if (o[a] < lo[a] || o[a] > hi[a]) {
+                return false;
+            }
+            continue;
+        }
+        float inv = 1.0f / d[a];
+        float ta = (lo[a] - o[a]) * inv;
+        float tb = (hi[a] - o[a]) * inv;
+        t0 = fmaxf(t0, fminf(ta, tb));
+        t1 = fminf(t1, fmaxf(ta, tb));
+    }
+    if (t0 > t1) {
+        return false;
+    }
+
+    float t = t0;
+    int cx = std::max(0, std::min(cellColumns - 1, (int)floorf(o[0] + d[0] * t)));
+    int cz = std::max(0, std::min(cellRows - 1, (int)floorf(o[2] + d[2] * t)));
+    int top = (int)m_mips.size() - 1;
+    int level = top;
+    float tolerance = m_heightScale + 1.0e-5f;
+
+    for (;;) {
+        int bx = cx >> level;
+        int bz = cz >> level;
+        int x0 = bx << level;
+        int z0 = bz << level;
+        int x1 = std::min(cellColumns, (bx + 1) << level);
+        int z1 = std::min(cellRows, (bz + 1) << level);
+
+        float txExit = (d[0] > 0.0f) ? ((float)x1 - o[0]) / d[0] :
+                       (d[0] < 0.0f) ? ((float)x0 - o[0]) / d[0] : FLT_MAX;
+        float tzExit = (d[2] > 0.0f) ? ((float)z1 - o[2]) / d[2] :
+                       (d[2] < 0.0f) ? ((float)z0 - o[2]) / d[2] : FLT_MAX;
+        float tExit = fminf(t1, fminf(txExit, tzExit));
+
+        // Does the ray cross the block's height range while over it?
+        const HeightRange& range = m_mips[level][bz * m_mipColumns[level] + bx];
+        float y0 = o[1] + d[1] * t;
+        float y1 = o[1] + d[1] * tExit;
+        if (fmaxf(y0, y1) >= Decode(range.min) - tolerance &&
+            fminf(y0, y1) <= Decode(range.max) + tolerance) {
+            if (level > 0) {
+                level--;
+                continue;
+            }
+
+            Triangle triangles[2];
+            CellTriangles(cx, cz, triangles);
+            float best = FLT_MAX;
+            int bestTriangle = -1;
+            for (int i = 0; i < 2; i++) {
+                float th;
+                if (::Raycast(triangles[i], ray, &th) && th <= maxT &&
+                    th < best) {
+                    best = th;
+                    bestTriangle = i;
+                }
+            }
+            if (bestTriangle >= 0) {
+                if (hit) {
+                    const Triangle& tri = triangles[bestTriangle];
+                    vec3 normal = Normalized(Cross(tri.b - tri.a,
+                                                   tri.c - tri.a));
+                    if (Dot(normal, ray.direction) > 0.0f) {
+                        normal = normal * -1.0f;
+                    }
+                    hit->t = best;
+                    hit->point = ray.origin + ray.direction * best;
+                    hit->normal = normal;
+                    hit->triangle = (cz * cellColumns + cx) * 2 + bestTriangle;
+                }
+                return true;
+            }
+        }
+
+        if (tExit >= t1) {
+            return false;
+        }
+
+        // Step into the neighbouring block, keeping the other coordinate
+        // inside the block just left
+        t = tExit;
+        if (txExit <= tzExit) {
+            cx = (d[0] > 0.0f) ? x1 : x0 - 1;
+            cz = std::max(z0, std::min(z1 - 1, (int)floorf(o[2] + d[2] * t)));
+        } else {
+            cz = (d[2] > 0.0f) ? z1 : z0 - 1;
+            cx = std::max(x0, std::min(x1 - 1, (int)floorf(o[0] + d[0] * t)));
+        }
+        if (cx < 0 || cx >= cellColumns || cz < 0 || cz >= cellRows) {
+            return false;
+        }
+        if (level < top) {
+            level++;
+        }
+    }
+}
+
+bool Heightfield::OverlapSphere(const Sphere& sphere, Point3D* closest) const
+{
+    PROFILE_FUNCTION();
+    if (m_columns == 0) {
+        return false;
+    }
+
+    const Point3D& center = sphere.position;
+    float r = sphere.radius;
+    int x0 = std::max(0, (int)floorf((center.x - r - m_origin.x) *
+                                     m_invSpacing));
+    int z0 = std::max(0, (int)floorf((center.z - r - m_origin.z) *
+                                     m_invSpacing));
+    int x1 = std::min(m_columns - 2, (int)floorf((center.x + r - m_origin.x) *
+                                                 m_invSpacing));
+    int z1 = std::min(m_rows - 2, (int)floorf((center.z + r - m_origin.z) *
+                                              m_invSpacing));
+
+    float bestSq = FLT_MAX;
+    Point3D best;
+    const std::vector<HeightRange>& cells = m_mips[0];
+    for (int z = z0; z <= z1; z++) {
+        for (int x = x0; x <= x1; x++) {
+            // Cells entirely under or above the sphere can't be nearer
+            // than the radius
+            const HeightRange& range = cells[z * (m_columns - 1) + x];
+            if (center.y - r > Decode(range.max) ||
+                center.y + r < Decode(range.min)) {
+                continue;
+            }
+            Triangle triangles[2];
+            CellTriangles(x, z, triangles);
+            for (int i = 0; i < 2; i++) {
+                Point3D p = ClosestPoint(triangles[i], center);
+                float distSq = MagnitudeSqr(p - center);
+                if (distSq < bestSq) {
+                    bestSq = distSq;
+                    best = p;
+                }
+            }
+        }
+    }
+
+    bool inside = PointInside(center);
+    if (bestSq <= r * r || inside) {
+        if (closest) {
+            if (bestSq == FLT_MAX) {
+                HeightAt(center.x, center.z, &best.y);
+                best.x = center.x;
+                best.z = center.z;
+            }
+            *closest = best;
+        }
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,76 @@
+#ifndef _H_HEIGHTFIELD_
+#define _H_HEIGHTFIELD_
+
+#include "Geometry3D.h"
+#include "TriangleMesh.h"
+
+#include <stdint.h>
+#include <vector>
+
+/* Terrain as a regular grid of heights.
+ *
+ * Sample (x, z) sits at origin + (x * spacing, height, z * spacing) and
+ * every cell is split into the triangles (x, z) (x + 1, z) (x, z + 1) and
+ * (x + 1, z) (x + 1, z + 1) (x, z + 1). Heights are stored as 16 bit steps
+ * between the lowest and highest sample; every query runs on the decoded
+ * heights, so the collision surface is exactly the quantized one.
+ *
+ * Mip level 0 holds the height range of every cell, level n the range of
+ * 2^n x 2^n cell blocks. Raycast walks the cells with a DDA and climbs the
+ * mips to step over whole blocks the ray passes above or below, so long
+ * rays over open terrain visit a handful of blocks rather than every cell.
+ *
+ * The terrain is solid below the surface: points and spheres under it
+ * collide, as long as they are above the grid.
+ */
+
+typedef struct HeightRange
+{
+    uint16_t min;
+    uint16_t max;
+} HeightRange;
+
+class Heightfield {
+public:
+    Heightfield();
+
+    /* `heights` holds columns * rows samples, x varying fastest */
+    void Build(const float* heights, int columns, int rows,
+               const Point3D& origin, float spacing);
+
+    /* Surface height at world x/z, false outside the grid */
+    bool HeightAt(float x, float z, float* height) const;
+    /* At or below the surface */
+    bool PointInside(const Point3D& point) const;
+
+    /* MeshHit::triangle is cell * 2, plus 1 for the second triangle */
+    bool Raycast(const Ray& ray, MeshHit* hit, float maxT = 3.4e38f) const;
+    /* `closest` receives the surface point nearest the center */
+    bool OverlapSphere(const Sphere& sphere, Point3D* closest = 0) const;
+
+    int Columns() const { return m_columns; }
+    int Rows() const { return m_rows; }
+    int MipCount() const { return (int)m_mips.size(); }
+    AABB GetBounds() const;
+
+private:
+    inline float Decode(uint16_t height) const
+    {
+        return m_minHeight + (float)height * m_heightScale;
+    }
+    Point3D Sample(int x, int z) const;
+    void CellTriangles(int x, int z, Triangle triangles[2]) const;
+
+    std::vector<uint16_t> m_heights;
+    std::vector<std::vector<HeightRange> > m_mips;
+    std::vector<int> m_mipColumns;
+    int m_columns;
+    int m_rows;
+    Point3D m_origin;
+    float m_spacing;
+    float m_invSpacing;
+    float m_minHeight;
+    float m_heightScale;
+};
+
+#endif
@@ -0,0 +1,387 @@
+#include "Joints.h"
+#include "Parallel.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdint.h>
+
+JointSolver2D::JointSolver2D() : m_iterations(8)
+{
+}
+
+static inline vec2 Rotate(const vec2& v, float degrees)
+{
+    float c = cosf(DEG2RAD(degrees));
+    float s = sinf(DEG2RAD(degrees));
+    return vec2(v.x * c - v.y * s, v.x * s + v.y * c);
+}
+
+static inline float Cross(const vec2& l, const vec2& r)
+{
+    return l.x * r.y - l.y * r.x;
+}
+
+/* w x r for an angular velocity w about the z axis */
+static inline vec2 Cross(float w, const vec2& r)
+{
+    return vec2(-w * r.y, w * r.x);
+}
+
+static inline bool IsStatic(const Body2D& body)
+{
+    return body.inverseMass == 0.0f && body.inverseInertia == 0.0f;
+}
+
+int JointSolver2D::AddJoint(const Body2D* bodies, int type, int a, int b,
+                            const Point2D& anchorA, const Point2D& anchorB)
+{
+    const Body2D& bodyA = bodies[a];
+    const Body2D& bodyB = bodies[b];
+    Joint joint;
+    joint.type = type;
+    joint.bodyA = a;
+    joint.bodyB = b;
+    joint.localAnchorA = Rotate(anchorA - bodyA.position, -bodyA.rotation);
+    joint.localAnchorB = Rotate(anchorB - bodyB.position, -bodyB.rotation);
+    joint.localAxis = vec2(1.0f, 0.0f);
+    joint.referenceAngle = DEG2RAD(bodyB.rotation - bodyA.rotation);
+    joint.length = Distance(anchorA, anchorB);
+    joint.impulse = vec3(0.0f, 0.0f, 0.0f);
+    m_joints.push_back(joint);
+    return (int)m_joints.size() - 1;
+}
+
+int JointSolver2D::AddRevolute(const Body2D* bodies, int a, int b,
+                               const Point2D& anchor)
+{
+    return AddJoint(bodies, JOINT_REVOLUTE, a, b, anchor, anchor);
+}
+
+int JointSolver2D::AddPrismatic(const Body2D* bodies, int a, int b,
+                                const Point2D& anchor, const vec2& axis)
+{
+    int index = AddJoint(bodies, JOINT_PRISMATIC, a, b, anchor, anchor);
+    m_joints[index].localAxis = Rotate(Normalized(axis), -bodies[a].rotation);
+    return index;
+}
+
+int JointSolver2D::AddDistance(const Body2D* bodies, int a, int b,
+                               const Point2D& anchorA, const Point2D& anchorB)
+{
+    return AddJoint(bodies, JOINT_DISTANCE, a, b, anchorA, anchorB);
+}
+
+int JointSolver2D::AddWeld(const Body2D* bodies, int a, int b,
+                           const Point2D& anchor)
+{
+    return AddJoint(bodies, JOINT_WELD, a, b, anchor, anchor);
+}
+
+void JointSolver2D::Clear()
+{
+    m_joints.clear();
+    m_rows.clear();
+    m_colors.clear();
+}
+
+int JointSolver2D::ColorCount() const
+{
+    return m_colors.empty() ? 0 : (int)m_colors.size() - 1;
+}
+
+/* Effective masses
+ *
+ * The constraint block is K = J M^-1 J^T, J being the Jacobian of the
+ * joint's rows. Revolute and weld joints use the 2x2 and 3x3 blocks of
+ *
+ *   mA + mB + iA rA.y^2 + iB rB.y^2   -iA rA.x rA.y - iB rB.x rB.y   -iA rA.y - iB rB.y
+ *   ...                               mA + mB + iA rA.x^2 + iB rB.x^2  iA rA.x + iB rB.x
+ *   ...                               ...                              iA + iB
+ *
+ * and prismatic joints the 2x2 block of the normal and angular rows. The
+ * angular term is 1 when neither body can rotate, which leaves the
+ * angular row without effect. A singular block (both bodies static) gets
+ * a zero effective mass.
+ */
+void JointSolver2D::SetupRow(const Body2D* bodies, JointRow& row,
+                             float invDt) const
+{
+    const Joint& joint = m_joints[row.joint];
+    const Body2D& bodyA = bodies[row.bodyA];
+    const Body2D& bodyB = bodies[row.bodyB];
+    float mA = bodyA.inverseMass;
+    float mB = bodyB.inverseMass;
+    float iA = bodyA.inverseInertia;
+    float iB = bodyB.inverseInertia;
+
+    row.type = joint.type;
+    row.massA = mA;
+    row.massB = mB;
+    row.inertiaA = iA;
+    row.inertiaB = iB;
+    row.rA = Rotate(joint.localAnchorA, bodyA.rotation);
+    row.rB = Rotate(joint.localAnchorB, bodyB.rotation);
+    row.axis = vec2(0.0f, 0.0f);
+    row.armA = 0.0f;
+    row.armB = 0.0f;
+    row.impulse = joint.impulse;
+
+    const vec2& rA = row.rA;
+    const vec2& rB = row.rB;
+    vec2 d = (bodyB.position + rB) - (bodyA.position + rA);
+    float angle = DEG2RAD(bodyB.rotation - bodyA.rotation) -
+                  joint.referenceAngle;
+    float beta = JOINT_BAUMGARTE * invDt;
+
+    mat3 zero(0, 0, 0, 0, 0, 0, 0, 0, 0);
+    row.mass = zero;
+    if (joint.type == JOINT_REVOLUTE || joint.type == JOINT_WELD) {
+        mat3 k;
+        k._11 = mA + mB + iA * rA.y * rA.y + iB * rB.y * rB.y;
+        k._12 = -iA * rA.x * rA.y - iB * rB.x * rB.y;
+        k._22 = mA + mB + iA * rA.x * rA.x + iB * rB.x * rB.x;
+        k._13 = -iA * rA.y - iB * rB.y;
+        k._23 = iA * rA.x + iB * rB.x;
+        k._33 = iA + iB;
+        k._33 = (k._33 == 0.0f) ? 1.0f : k._33; // no rotation on either
+        k._21 = k._12;
+        k._31 = k._13;
+        k._32 = k._23;
+        if (joint.type == JOINT_WELD) {
+            if (Determinant(k) != 0.0f) {
+                row.mass = Inverse(k);
+            }
+            row.bias = vec3(d.x * beta, d.y * beta, angle * beta);
+        }
+        else {
+            mat2 k2(k._11, k._12, k._21, k._22);
+            if (Determinant(k2) != 0.0f) {
+                mat2 m = Inverse(k2);
+                row.mass._11 = m._11;
+                row.mass._12 = m._12;
+                row.mass._21 = m._21;
+                row.mass._22 = m._22;
+            }
+            row.bias = vec3(d.x * beta, d.y * beta, 0.0f);
+        }
+    }
+    else if (joint.type == JOINT_PRISMATIC) {
+        vec2 axis = Rotate(joint.localAxis, bodyA.rotation);
+        row.axis = vec2(-axis.y, axis.x);
+        row.armA = Cross(d + rA, row.axis);
+        row.armB = Cross(rB, row.axis);
+        mat2 k2;
+        k2._11 = mA + mB + iA * row.armA * row.armA +
+                 iB * row.armB * row.armB;
+        k2._12 = k2._21 = iA * row.armA + iB * row.armB;
+        k2._22 = (iA + iB == 0.0f) ? 1.0f : iA + iB;
+        if (Determinant(k2) != 0.0f) {
+            mat2 m = Inverse(k2);
+            row.mass._11 = m._11;
+            row.mass._12 = m._12;
+            row.mass._21 = m._21;
+            row.mass._22 = m._22;
+        }
+        row.bias = vec3(Dot(row.axis, d) * beta, angle * beta, 0.0f);
+    }
+    else {
+        float length = Magnitude(d);
+        if (length > 0.0f) {
+            row.axis = d * (1.0f / length);
+            row.armA = Cross(rA, row.axis);
+            row.armB = Cross(rB, row.axis);
+            float k = mA + mB + iA * row.armA * row.armA +
+                      iB * row.armB * row.armB;
+            row.mass._11 = (k > 0.0f) ? 1.0f / k : 0.0f;
+        }
+        row.bias = vec3((length - joint.length) * beta, 0.0f, 0.0f);
+    }
+}
+
+/* Applies the impulse of a row's constraint block: P is the linear
+ * impulse on body B (-P on body A), angularA and angularB the angular
+ * impulses taken off A and added to B. Static bodies are never written,
+ * so joints of a color may share them. */
+static inline void ApplyImpulse(Body2D* bodies, int a, int b, float massA,
+                                float massB, float inertiaA, float inertiaB,
+                                const vec2& p, float angularA, float angularB)
+{
+    Body2D& bodyA = bodies[a];
+    Body2D& bodyB = bodies[b];
+    if (!IsStatic(bodyA)) {
+        bodyA.velocity = bodyA.velocity - p * massA;
+        bodyA.angularVelocity -= RAD2DEG(inertiaA * angularA);
+    }
+    if (!IsStatic(bodyB)) {
+        bodyB.velocity = bodyB.velocity + p * massB;
+        bodyB.angularVelocity += RAD2DEG(inertiaB * angularB);
+    }
+}
+
+void JointSolver2D::ApplyRow(Body2D* bodies, const JointRow& row,
+                             const vec3& impulse) const
+{
+    vec2 p;
+    float angularA, angularB;
+    if (row.type == JOINT_PRISMATIC) {
+        p = row.axis * impulse.x;
+        angularA = row.armA * impulse.x + impulse.y;
+        angularB = row.armB * impulse.x + impulse.y;
+    }
+    else if (row.type == JOINT_DISTANCE) {
+        p = row.axis * impulse.x;
+        angularA = row.armA * impulse.x;
+        angularB = row.armB * impulse.x;
+    }
+    else {
+        p = vec2(impulse.x, impulse.y);
+        angularA = Cross(row.rA, p) + impulse.z;
+        angularB = Cross(row.rB, p) + impulse.z;
+    }
+    ApplyImpulse(bodies, row.bodyA, row.bodyB, row.massA, row.massB,
+                 row.inertiaA, row.inertiaB, p, angularA, angularB);
+}
+
+void JointSolver2D::WarmStart(Body2D* bodies, int begin, int end)
+{
+    for (int i = begin; i < end; i++) {
+        ApplyRow(bodies, m_rows[i], m_rows[i].impulse);
+    }
+}
+
+void JointSolver2D::SolveRows(Body2D* bodies, int begin, int end)
+{
+    for (int i = begin; i < end; i++) {
+        JointRow& row = m_rows[i];
+        const Body2D& bodyA = bodies[row.bodyA];
+        const Body2D& bodyB = bodies[row.bodyB];
+        float wA = DEG2RAD(bodyA.angularVelocity);
+        float wB = DEG2RAD(bodyB.angularVelocity);
+        vec2 relative = (bodyB.velocity + Cross(wB, row.rB)) -
+                        (bodyA.velocity + Cross(wA, row.rA));
+
+        // Velocity error of each row of the block
+        vec3 cdot;
+        if (row.type == JOINT_PRISMATIC) {
+            cdot = vec3(Dot(row.axis, bodyB.velocity - bodyA.velocity) +
+                        row.armB * wB - row.armA * wA, wB - wA, 0.0f);
+        }
+        else if (row.type == JOINT_DISTANCE) {
+            cdot = vec3(Dot(row.axis, relative), 0.0f, 0.0f);
+        }
+        else {
+            cdot = vec3(relative.x, relative.y, wB - wA);
+        }
+
+        // The effective mass is symmetric, so v * M is M * v
+        vec3 lambda = MultiplyVector(cdot + row.bias, row.mass) * -1.0f;
+        row.impulse = row.impulse + lambda;
+        ApplyRow(bodies, row, lambda);
+    }
+}
+
+/* Greedy coloring over the dynamic bodies, a 64 bit mask of used colors
+ * per body. Joints finding all 64 taken go round again with the next 64.
+ * Joints on missing bodies are dropped for the step. */
+void JointSolver2D::Prepare(const Body2D* bodies, int count, float dt)
+{
+    PROFILE_FUNCTION();
+    int jointCount = (int)m_joints.size();
+    std::vector<int> colors(jointCount, -1);
+    std::vector<uint64_t> used(count);
+    std::vector<int> pending;
+    for (int i = 0; i < jointCount; i++) {
+        const Joint& joint = m_joints[i];
+        if (joint.bodyA >= 0 && joint.bodyA < count &&
+            joint.bodyB >= 0 && joint.bodyB < count) {
+            pending.push_back(i);
+        }
+    }
+
+    int colorCount = 0;
+    for (int base = 0; !pending.empty(); base += 64) {
+        std::fill(used.begin(), used.end(), 0);
+        std::vector<int> next;
+        for (size_t k = 0; k < pending.size(); k++) {
+            const Joint& joint = m_joints[pending[k]];
+            bool staticA = IsStatic(bodies[joint.bodyA]);
+            bool staticB = IsStatic(bodies[joint.bodyB]);
+            uint64_t mask = (staticA ? 0 : used[joint.bodyA]) |
+                            (staticB ? 0 : used[joint.bodyB]);
+            if (mask == ~(uint64_t)0) {
+                next.push_back(pending[k]);
+                continue;
+            }
+            int color = 0;
+            while (mask & ((uint64_t)1 << color)) {
+                color++;
+            }
+            if (!staticA) {
+                used[joint.bodyA] |= (uint64_t)1 << color;
+            }
+            if (!staticB) {
+                used[joint.bodyB] |= (uint64_t)1 << color;
+            }
+            colors[pending[k]] = base + color;
+            colorCount = (base + color + 1 > colorCount) ?
+                         base + color + 1 : colorCount;
+        }
+        pending.swap(next);
+    }
+
+    // Counting sort into the row array
+    m_colors.assign(colorCount + 1, 0);
+    for (int i = 0; i < jointCount; i++) {
+        if (colors[i] >= 0) {
+            m_colors[colors[i] + 1]++;
+        }
+    }
+    for (int c = 0; c < colorCount; c++) {
+        m_colors[c + 1] += m_colors[c];
+    }
+    std::vector<int> cursor(m_colors.begin(), m_colors.end() - 1);
+    m_rows.resize(m_colors[colorCount]);
+    for (int i = 0; i < jointCount; i++) {
+        if (colors[i] >= 0) {
+            JointRow& row = m_rows[cursor[colors[i]]++];
+            row.joint = i;
+            row.bodyA = m_joints[i].bodyA;
+            row.bodyB = m_joints[i].bodyB;
+        }
+    }
+
+    float invDt = (dt > 0.0f) ? 1.0f / dt : 0.0f;
+    ParallelFor((int)m_rows.size(), JOINT_BATCH, [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            SetupRow(bodies, m_rows[i], invDt);
+        }
+    });
+}
+
+void JointSolver2D::Solve(Body2D* bodies, int count, float dt)
+{
+    PROFILE_FUNCTION();
+    Prepare(bodies, count, dt);
+
+    for (int c = 0; c < ColorCount(); c++) {
+        int first = m_colors[c];
+        ParallelFor(m_colors[c + 1] - first, JOINT_BATCH,
+                    [&](int begin, int end) {
+            WarmStart(bodies, first + begin, first + end);
+        });
+    }
+    for (int it = 0; it < m_iterations; it++) {
+        for (int c = 0; c < ColorCount(); c++) {
+            int first = m_colors[c];
+            ParallelFor(m_colors[c + 1] - first, JOINT_BATCH,
+                        [&](int begin, int end) {
+                SolveRows(bodies, first + begin, first + end);
+            });
+        }
+    }
+
+    for (size_t i = 0; i < m_rows.size(); i++) {
+        m_joints[m_rows[i].joint].impulse = m_rows[i].impulse;
+    }
+}
@@ -0,0 +1,115 @@
+#ifndef _H_JOINTS_
+#define _H_JOINTS_
+
+#include "Body2D.h"
+#include "matrices.h"
+
+#include <vector>
+
+/* Joints between Body2D, solved with sequential impulses.
+ *
+ * - revolute: the bodies share an anchor point and rotate freely about it
+ * - prismatic: the bodies keep their relative rotation and body B slides
+ *   along an axis fixed in body A
+ * - distance: two anchors, one on each body, keep their initial distance
+ * - weld: the bodies share an anchor point and keep their relative rotation
+ *
+ * Joints refer to bodies by index into the array passed to Solve(). Anchors
+ * and axes are given in world space when the joint is added and stored in
+ * the bodies' local frames.
+ *
+ * Solve() corrects the body velocities and leaves the positions alone: call
+ * it after applying forces and before integrating positions. Each step it
+ * builds the effective mass of every joint once, as the inverse of its 1x1,
+ * 2x2 or 3x3 constraint block, and the position error is fed back into the
+ * velocities (Baumgarte). The impulses of the previous step are applied
+ * first (warm starting).
+ *
+ * Joints are graph colored over their bodies every step, ignoring static
+ * bodies (zero inverse mass and inertia), and laid out color by color in
+ * one array. The joints of a color share no dynamic body, so each color is
+ * solved in parallel batches of JOINT_BATCH on the worker pool.
+ */
+
+#define JOINT_BATCH 256
+#define JOINT_BAUMGARTE 0.2f
+
+class JointSolver2D {
+public:
+    JointSolver2D();
+
+    /* Each returns the index of the new joint */
+    int AddRevolute(const Body2D* bodies, int a, int b,
+                    const Point2D& anchor);
+    int AddPrismatic(const Body2D* bodies, int a, int b,
+                     const Point2D& anchor, const vec2& axis);
+    int AddDistance(const Body2D* bodies, int a, int b,
+                    const Point2D& anchorA, const Point2D& anchorB);
+    int AddWeld(const Body2D* bodies, int a, int b, const Point2D& anchor);
+    void Clear();
+
+    int JointCount() const { return (int)m_joints.size(); }
+    /* Velocity iterations per step */
+    void SetIterations(int iterations) { m_iterations = iterations; }
+    /* Colors of the last Solve() */
+    int ColorCount() const;
+
+    void Solve(Body2D* bodies, int count, float dt);
+
+private:
+    JointSolver2D(const JointSolver2D&);
+    JointSolver2D& operator=(const JointSolver2D&);
+
+    enum JointType {
+        JOINT_REVOLUTE,
+        JOINT_PRISMATIC,
+        JOINT_DISTANCE,
+        JOINT_WELD
+    };
+
+    struct Joint {
+        int type;
+        int bodyA;
+        int bodyB;
+        vec2 localAnchorA;
+        vec2 localAnchorB;
+        vec2 localAxis;
+        float referenceAngle; // radians
+        float length;
+        vec3 impulse; // of the last step, for warm starting
+    };
+
+    /* A joint set up for this step, the rows of its constraint block being
+     * linear x, linear y, angular for revolute and weld joints, normal and
+     * angular for prismatic joints and the single distance row. */
+    struct JointRow {
+        int type;
+        int joint;
+        int bodyA;
+        int bodyB;
+        float massA, massB;       // inverse mass
+        float inertiaA, inertiaB; // inverse inertia
+        vec2 rA, rB;              // anchors relative to the centers
+        vec2 axis;                // prismatic normal or distance direction
+        float armA, armB;         // angular arms along `axis`
+        mat3 mass;                // effective mass, inverse of the block
+        vec3 bias;
+        vec3 impulse;
+    };
+
+    int AddJoint(const Body2D* bodies, int type, int a, int b,
+                 const Point2D& anchorA, const Point2D& anchorB);
+    void Prepare(const Body2D* bodies, int count, float dt);
+    void SetupRow(const Body2D* bodies, JointRow& row, float invDt) const;
+    void ApplyRow(Body2D* bodies, const JointRow& row,
+                  const vec3& impulse) const;
+    void WarmStart(Body2D* bodies, int begin, int end);
+    void SolveRows(Body2D* bodies, int begin, int end);
+
+    std::vector<Joint> m_joints;
+    std::vector<JointRow> m_rows;  // in color order
+    std::vector<int> m_colors;     // first row of each color
+    int m_iterations;
+};
+
+#endif
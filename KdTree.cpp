@@ -0,0 +1,314 @@
+#include "KdTree.h"
+#include "Parallel.h"
+#include "Profiler.h"
+
+#include <algorithm>
+
+// Queries per task in the batch versions
+#define KDTREE_BATCH_GRAIN 256
+
+template<typename Point>
+struct KdEntry {
+    Point point;
+    int id;
+};
+
+template<typename Point>
+static inline float DistanceSq(const Point& a, const Point& b)
+{
+    float sum = 0.0f;
+    for (int i = 0; i < (int)(sizeof(Point) / sizeof(float)); i++) {
+        float d = a.asArray[i] - b.asArray[i];
+        sum += d * d;
+    }
+    return sum;
+}
+
+template<typename Point>
+static int WidestAxis(const KdEntry<Point>* entries, int count)
+{
+    const int dimensions = sizeof(Point) / sizeof(float);
+    Point min = entries[0].point;
+    Point max = entries[0].point;
+    for (int i = 1; i < count; i++) {
+        for (int a = 0; a < dimensions; a++) {
+            float v = entries[i].point.asArray[a];
+            min.asArray[a] = (v < min.asArray[a]) ? v : min.asArray[a];
+            max.asArray[a] = (v > max.asArray[a]) ? v : max.asArray[a];
+        }
+    }
+    int axis = 0;
+    for (int a = 1; a < dimensions; a++) {
+        if (max.asArray[a] - min.asArray[a] >
+            max.asArray[axis] - min.asArray[axis]) {
+            axis = a;
+        }
+    }
+    return axis;
+}
+
+/* Splits [begin, end) around its median and recurses. With `tasks`, ranges
+ * of at most `taskSize` points are queued instead, as begin/end pairs. */
+template<typename Point>
+static void BuildRange(std::vector<KdEntry<Point> >& entries,
+                       std::vector<uint8_t>& axes, int begin, int end,
+                       int taskSize, std::vector<int>* tasks)
+{
+    while (end - begin > KDTREE_LEAF_SIZE) {
+        if (tasks != 0 && end - begin <= taskSize) {
+            tasks->push_back(begin);
+            tasks->push_back(end);
+            return;
+        }
+        int axis = WidestAxis(&entries[begin], end - begin);
+        int mid = begin + (end - begin) / 2;
+        std::nth_element(entries.begin() + begin, entries.begin() + mid,
+                         entries.begin() + end,
+                         [axis](const KdEntry<Point>& l,
+                                const KdEntry<Point>& r) {
+            return l.point.asArray[axis] < r.point.asArray[axis];
+        });
+        axes[mid] = (uint8_t)axis;
+
+        BuildRange(entries, axes, begin, mid, taskSize, tasks);
+        begin = mid + 1;
+    }
+}
+
+template<typename Point>
+void KdTree<Point>::Build(const Point* points, int count)
+{
+    PROFILE_FUNCTION();
+    std::vector<KdEntry<Point> > entries(count);
+    for (int i = 0; i < count; i++) {
+        entries[i].point = points[i];
+        entries[i].id = i;
+    }
+    m_axes.assign(count, 0);
+
+    // Split the top on this thread until there are a few ranges per
+    // thread, then finish those in parallel
+    int taskSize = count / (ParallelThreadCount() * 4);
+    taskSize = (taskSize < 4096) ? 4096 : taskSize;
+    std::vector<int> tasks;
+    BuildRange(entries, m_axes, 0, count, taskSize, &tasks);
+    ParallelFor((int)tasks.size() / 2, 1, [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            BuildRange(entries, m_axes, tasks[i * 2], tasks[i * 2 + 1], 0,
+                       (std::vector<int>*)0);
+        }
+    });
+
+    m_points.resize(count);
+    m_ids.resize(count);
+    for (int i = 0; i < count; i++) {
+        m_points[i] = entries[i].point;
+        m_ids[i] = entries[i].id;
+    }
+}
+
+/* k nearest search
+ *
+ * `heap` is a max heap on distance of the best `found` points so far; the
+ * search only descends into the far side of a split while the splitting
+ * plane is closer than the worst of them.
+ */
+
+static inline bool FartherNeighbor(const KdNeighbor& l, const KdNeighbor& r)
+{
+    return l.distanceSq < r.distanceSq;
+}
+
+static inline void OfferNeighbor(KdNeighbor* heap, int k, int* found,
+                                 const KdNeighbor& candidate)
+{
+    if (*found < k) {
+        heap[(*found)++] = candidate;
+        std::push_heap(heap, heap + *found, FartherNeighbor);
+    }
+    else if (candidate.distanceSq < heap[0].distanceSq) {
+        std::pop_heap(heap, heap + k, FartherNeighbor);
+        heap[k - 1] = candidate;
+        std::push_heap(heap, heap + k, FartherNeighbor);
+    }
+}
+
+template<typename Point>
+void KdTree<Point>::SearchNearest(const Point& point, int begin, int end,
+                                  int k, KdNeighbor* heap, int* found) const
+{
+    while (end - begin > KDTREE_LEAF_SIZE) {
+        int mid = begin + (end - begin) / 2;
+        int axis = m_axes[mid];
+        OfferNeighbor(heap, k, found,
+                      KdNeighbor(mid, DistanceSq(point, m_points[mid])));
+
+        float diff = point.asArray[axis] - m_points[mid].asArray[axis];
+        int nearBegin = begin, nearEnd = mid;
+        int farBegin = mid + 1, farEnd = end;
+        if (diff >= 0.0f) {
+            std::swap(nearBegin, farBegin);
+            std::swap(nearEnd, farEnd);
+        }
+        SearchNearest(point, nearBegin, nearEnd, k, heap, found);
+        if (*found == k && diff * diff >= heap[0].distanceSq) {
+            return;
+        }
+        begin = farBegin;
+        end = farEnd;
+    }
+    for (int i = begin; i < end; i++) {
+        OfferNeighbor(heap, k, found,
+                      KdNeighbor(i, DistanceSq(point, m_points[i])));
+    }
+}
+
+/* Fills heap[0 .. k) closest first with the original indices, returns how
+ * many were found */
+template<typename Point>
+int KdTree<Point>::SearchNearest(const Point& point, int k,
+                                 KdNeighbor* heap) const
+{
+    int found = 0;
+    if (k > 0) {
+        SearchNearest(point, 0, (int)m_points.size(), k, heap, &found);
+    }
+    std::sort_heap(heap, heap + found, FartherNeighbor);
+    for (int i = 0; i < found; i++) {
+        heap[i].index = m_ids[heap[i].index];
+    }
+    for (int i = found; i < k; i++) {
+        heap[i] = KdNeighbor();
+    }
+    return found;
+}
+
+template<typename Point>
+int KdTree<Point>::Nearest(const Point& point, float* distanceSq) const
+{
+    PROFILE_FUNCTION();
+    KdNeighbor best;
+    SearchNearest(point, 1, &best);
+    if (distanceSq != 0) {
+        *distanceSq = best.distanceSq;
+    }
+    return best.index;
+}
+
+template<typename Point>
+ArenaVector<KdNeighbor> KdTree<Point>::Nearest(const Point& point, int k,
+                                               FrameArena* arena) const
+{
+    PROFILE_FUNCTION();
+    ArenaVector<KdNeighbor> result((ArenaAllocator<KdNeighbor>(arena)));
+    if (k > 0) {
+        result.resize(k);
+        result.resize(SearchNearest(point, k, &result[0]));
+    }
+    return result;
+}
+
+template<typename Point>
+template<typename Result>
+void KdTree<Point>::SearchRadius(const Point& point, float radiusSq,
+                                 int begin, int end, Result& result) const
+{
+    while (end - begin > KDTREE_LEAF_SIZE) {
+        int mid = begin + (end - begin) / 2;
+        int axis = m_axes[mid];
+        if (DistanceSq(point, m_points[mid]) <= radiusSq) {
+            result.push_back(m_ids[mid]);
+        }
+
+        float diff = point.asArray[axis] - m_points[mid].asArray[axis];
+        if (diff * diff <= radiusSq) {
+            SearchRadius(point, radiusSq, begin, mid, result);
+            begin = mid + 1;
+        }
+        else if (diff < 0.0f) {
+            end = mid;
+        }
+        else {
+            begin = mid + 1;
+        }
+    }
+    for (int i = begin; i < end; i++) {
+        if (DistanceSq(point, m_points[i]) <= radiusSq) {
+            result.push_back(m_ids[i]);
+        }
+    }
+}
+
+template<typename Point>
+ArenaVector<int> KdTree<Point>::QueryRadius(const Point& point, float radius,
+                                            FrameArena* arena) const
+{
+    PROFILE_FUNCTION();
+    ArenaVector<int> result((ArenaAllocator<int>(arena)));
+    SearchRadius(point, radius * radius, 0, (int)m_points.size(), result);
+    return result;
+}
+
+template<typename Point>
+void KdTree<Point>::NearestBatch(const Point* points, int count, int k,
+                                 KdNeighbor* out) const
+{
+    PROFILE_FUNCTION();
+    if (k <= 0) {
+        return;
+    }
+    ParallelFor(count, KDTREE_BATCH_GRAIN, [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            SearchNearest(points[i], k, out + (size_t)i * k);
+        }
+    });
+}
+
+/* SearchRadius results that only count the points, and that write them
+ * to a preallocated range */
+struct KdCounter {
+    int count;
+    void push_back(int) { count++; }
+};
+
+struct KdWriter {
+    int* out;
+    void push_back(int id) { *out++ = id; }
+};
+
+template<typename Point>
+void KdTree<Point>::QueryRadiusBatch(const Point* points, int count,
+                                     float radius, std::vector<int>& starts,
+                                     std::vector<int>& indices) const
+{
+    PROFILE_FUNCTION();
+    // Count the results of every query, place them with a prefix sum, then
+    // search again writing each query's results in its own range. No pass
+    // depends on how ParallelFor splits the queries.
+    starts.assign(count + 1, 0);
+    float radiusSq = radius * radius;
+    int size = (int)m_points.size();
+    ParallelFor(count, KDTREE_BATCH_GRAIN, [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            KdCounter counter = { 0 };
+            SearchRadius(points[i], radiusSq, 0, size, counter);
+            starts[i + 1] = counter.count;
+        }
+    });
+    for (int i = 0; i < count; i++) {
+        starts[i + 1] += starts[i];
+    }
+
+    indices.resize(starts[count]);
+    ParallelFor(count, KDTREE_BATCH_GRAIN, [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            if (starts[i + 1] > starts[i]) {
+                KdWriter writer = { &indices[starts[i]] };
+                SearchRadius(points[i], radiusSq, 0, size, writer);
+            }
+        }
+    });
+}
+
+template class KdTree<Point2D>;
+template class KdTree<Point3D>;
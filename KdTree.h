@@ -0,0 +1,82 @@
+#ifndef _H_KD_TREE_
+#define _H_KD_TREE_
+
+#include "Geometry2D.h"
+#include "Geometry3D.h"
+#include "Memory.h"
+
+#include <stdint.h>
+#include <vector>
+
+/* k-d tree over a static set of Point2D or Point3D.
+ *
+ * The tree is implicit: Build() reorders a copy of the points so that the
+ * median of every range along its widest axis sits in the middle, with
+ * the smaller coordinates before it and the larger ones after. A node is
+ * just a range of the flat point array and only its split axis is stored,
+ * so the tree is the points plus one byte each. Ranges of up to
+ * KDTREE_LEAF_SIZE points are leaves and are scanned linearly.
+ *
+ * Build() partitions the top levels on the calling thread and the
+ * subtrees below them in parallel. The batch queries spread the query
+ * points over the pool. Queries report the index the point had in the
+ * array passed to Build().
+ */
+
+#define KDTREE_LEAF_SIZE 8
+
+typedef struct KdNeighbor
+{
+    int index;
+    float distanceSq;
+
+    inline KdNeighbor() : index(-1), distanceSq(3.4e38f) {}
+    inline KdNeighbor(int _index, float _distanceSq) :
+        index(_index), distanceSq(_distanceSq) {}
+} KdNeighbor;
+
+template<typename Point>
+class KdTree {
+public:
+    KdTree() {}
+
+    void Build(const Point* points, int count);
+
+    /* Index of the closest point, -1 if the tree is empty */
+    int Nearest(const Point& point, float* distanceSq = 0) const;
+    /* Up to `k` closest points, closest first */
+    ArenaVector<KdNeighbor> Nearest(const Point& point, int k,
+                                    FrameArena* arena = 0) const;
+    /* Every point within `radius`, in no particular order */
+    ArenaVector<int> QueryRadius(const Point& point, float radius,
+                                 FrameArena* arena = 0) const;
+
+    /* The `k` closest points of every query, closest first, written to
+     * out[i * k] .. out[i * k + k - 1]. Missing neighbors have index -1. */
+    void NearestBatch(const Point* points, int count, int k,
+                      KdNeighbor* out) const;
+    /* The points within `radius` of query i are
+     * indices[starts[i]] .. indices[starts[i + 1] - 1] */
+    void QueryRadiusBatch(const Point* points, int count, float radius,
+                          std::vector<int>& starts,
+                          std::vector<int>& indices) const;
+
+    int Size() const { return (int)m_points.size(); }
+
+private:
+    int SearchNearest(const Point& point, int k, KdNeighbor* heap) const;
+    void SearchNearest(const Point& point, int begin, int end, int k,
+                       KdNeighbor* heap, int* found) const;
+    template<typename Result>
+    void SearchRadius(const Point& point, float radiusSq, int begin, int end,
+                      Result& result) const;
+
+    std::vector<Point> m_points;
+    std::vector<int> m_ids;
+    std::vector<uint8_t> m_axes; // split axis of the range centered here
+};
+
+typedef KdTree<Point2D> KdTree2D;
+typedef KdTree<Point3D> KdTree3D;
+
+#endif
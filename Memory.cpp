@@ -0,0 +1,152 @@
+#include "Memory.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+static size_t AlignUp(size_t value, size_t align)
+{
+    return (value + (align - 1)) & ~(align - 1);
+}
+
+FrameArena::FrameArena(size_t capacity) :
+    m_buffer(0), m_capacity(capacity), m_offset(0), m_highWater(0),
+    m_overflowBytes(0), m_overflow(0)
+{
+    if (m_capacity > 0) {
+        m_buffer = (char*)malloc(m_capacity);
+    }
+}
+
+FrameArena::~FrameArena()
+{
+    while (m_overflow) {
+        Overflow* next = m_overflow->next;
+        free(m_overflow);
+        m_overflow = next;
+    }
+    free(m_buffer);
+}
+
+void* FrameArena::Allocate(size_t size, size_t align)
+{
+    size_t start = AlignUp((size_t)(uintptr_t)(m_buffer + m_offset), align) -
+        (size_t)(uintptr_t)m_buffer;
+    if (m_buffer && start + size <= m_capacity) {
+        m_offset = start + size;
+        if (m_offset > m_highWater) {
+            m_highWater = m_offset;
+        }
+        return m_buffer + start;
+    }
+
+    // Out of space for this tick. Serve the request from its own block
+    // and remember how much was needed so Reset() can grow the buffer.
+    size_t header = AlignUp(sizeof(Overflow), align);
+    Overflow* block = (Overflow*)malloc(header + size + align);
+    if (!block) {
+        return 0;
+    }
+    block->next = m_overflow;
+    block->size = size;
+    m_overflow = block;
+    m_overflowBytes += size + align;
+
+    char* data = (char*)block + header;
+    return (void*)AlignUp((size_t)(uintptr_t)data, align);
+}
+
+void FrameArena::FreeToMarker(size_t marker)
+{
+    if (marker <= m_offset) {
+        m_offset = marker;
+    }
+}
+
+void FrameArena::Reset()
+{
+    size_t needed = m_highWater + m_overflowBytes;
+    while (m_overflow) {
+        Overflow* next = m_overflow->next;
+        free(m_overflow);
+        m_overflow = next;
+    }
+
+    if (m_overflowBytes > 0) {
+        // Grow once so the next tick fits in a single buffer
+        size_t capacity = m_capacity ? m_capacity : 4096;
+        while (capacity < needed) {
+            capacity *= 2;
+        }
+        char* buffer = (char*)malloc(capacity);
+        if (buffer) {
+            free(m_buffer);
+            m_buffer = buffer;
+            m_capacity = capacity;
+        }
+    }
+
+    m_offset = 0;
+    m_overflowBytes = 0;
+}
+
+PoolAllocator::PoolAllocator(size_t blockSize, size_t blocksPerChunk) :
+    m_blockSize(AlignUp(blockSize < sizeof(FreeBlock) ?
+                        sizeof(FreeBlock) : blockSize, ARENA_DEFAULT_ALIGN)),
+    m_blocksPerChunk(blocksPerChunk ? blocksPerChunk : 1),
+    m_allocated(0), m_free(0), m_chunks(0)
+{
+}
+
+PoolAllocator::~PoolAllocator()
+{
+    while (m_chunks) {
+        void* next = *(void**)m_chunks;
+        free(m_chunks);
+        m_chunks = next;
+    }
+}
+
+// Each chunk starts with a pointer to the previous chunk, followed by
+// m_blocksPerChunk blocks that are threaded onto the free list.
+void PoolAllocator::AddChunk()
+{
+    size_t header = AlignUp(sizeof(void*), ARENA_DEFAULT_ALIGN);
+    char* chunk = (char*)malloc(header + m_blockSize * m_blocksPerChunk);
+    if (!chunk) {
+        return;
+    }
+    *(void**)chunk = m_chunks;
+    m_chunks = chunk;
+
+    char* blocks = chunk + header;
+    for (size_t i = m_blocksPerChunk; i > 0; i--) {
+        FreeBlock* block = (FreeBlock*)(blocks + (i - 1) * m_blockSize);
+        block->next = m_free;
+        m_free = block;
+    }
+}
+
+void* PoolAllocator::Allocate()
+{
+    if (!m_free) {
+        AddChunk();
+        if (!m_free) {
+            return 0;
+        }
+    }
+    FreeBlock* block = m_free;
+    m_free = block->next;
+    m_allocated++;
+    return block;
+}
+
+void PoolAllocator::Free(void* block)
+{
+    if (!block) {
+        return;
+    }
+    FreeBlock* freed = (FreeBlock*)block;
+    freed->next = m_free;
+    m_free = freed;
+    m_allocated--;
+}
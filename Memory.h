@@ -0,0 +1,200 @@
+#ifndef _H_MEMORY_
+#define _H_MEMORY_
+
+#include <stddef.h>
+#include <new>
+#include <vector>
+
+/* Per-tick memory for temporaries such as pair lists and transformed
+ * shapes.
+ *
+ * FrameArena is a linear allocator: allocations only bump an offset and
+ * everything is released at once by Reset(), normally at the end of a
+ * tick. If a tick asks for more than the capacity, the extra requests are
+ * served from overflow blocks and the next Reset() grows the main buffer
+ * to the high-water mark, so a steady workload stops touching the heap
+ * after the first few ticks.
+ *
+ * PoolAllocator hands out fixed-size blocks from a free list, for objects
+ * that outlive a tick but are created and destroyed often.
+ */
+
+#define ARENA_DEFAULT_ALIGN (alignof(max_align_t))
+
+class FrameArena {
+public:
+    explicit FrameArena(size_t capacity = 64 * 1024);
+    ~FrameArena();
+
+    void* Allocate(size_t size, size_t align = ARENA_DEFAULT_ALIGN);
+
+    template<typename T>
+    T* AllocateArray(size_t count)
+    {
+        return (T*)Allocate(sizeof(T) * count, alignof(T));
+    }
+
+    /* Releases every allocation made since the last Reset() */
+    void Reset();
+
+    /* Scoped rewinding inside a tick */
+    size_t GetMarker() const { return m_offset; }
+    void FreeToMarker(size_t marker);
+
+    size_t Used() const { return m_offset; }
+    size_t Capacity() const { return m_capacity; }
+    size_t HighWater() const { return m_highWater; }
+
+private:
+    FrameArena(const FrameArena&);
+    FrameArena& operator=(const FrameArena&);
+
+    struct Overflow {
+        Overflow* next;
+        size_t size;
+    };
+
+    char* m_buffer;
+    size_t m_capacity;
+    size_t m_offset;
+    size_t m_highWater;
+    size_t m_overflowBytes;
+    Overflow* m_overflow;
+};
+
+class PoolAllocator {
+public:
+    PoolAllocator(size_t blockSize, size_t blocksPerChunk = 256);
+    ~PoolAllocator();
+
+    void* Allocate();
+    void Free(void* block);
+
+    size_t BlockSize() const { return m_blockSize; }
+    size_t Allocated() const { return m_allocated; }
+
+private:
+    PoolAllocator(const PoolAllocator&);
+    PoolAllocator& operator=(const PoolAllocator&);
+
+    void AddChunk();
+
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    size_t m_blockSize;
+    size_t m_blocksPerChunk;
+    size_t m_allocated;
+    FreeBlock* m_free;
+    void* m_chunks;
+};
+
+/* STL allocator over a FrameArena. A null arena falls back to the heap,
+ * which lets APIs take the arena as an optional parameter. Deallocation
+ * into the arena is a no-op; the memory comes back on Reset().
+ */
+template<typename T>
+class ArenaAllocator {
+public:
+    typedef T value_type;
+
+    ArenaAllocator(FrameArena* arena = 0) : m_arena(arena) {}
+
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : m_arena(other.Arena()) {}
+
+    T* allocate(size_t n)
+    {
+        if (m_arena) {
+            return (T*)m_arena->Allocate(n * sizeof(T), alignof(T));
+        }
+        return (T*)::operator new(n * sizeof(T));
+    }
+
+    void deallocate(T* p, size_t)
+    {
+        if (!m_arena) {
+            ::operator delete(p);
+        }
+    }
+
+    FrameArena* Arena() const { return m_arena; }
+
+private:
+    FrameArena* m_arena;
+};
+
+template<typename T, typename U>
+inline bool operator==(const ArenaAllocator<T>& l, const ArenaAllocator<U>& r)
+{
+    return l.Arena() == r.Arena();
+}
+
+template<typename T, typename U>
+inline bool operator!=(const ArenaAllocator<T>& l, const ArenaAllocator<U>& r)
+{
+    return l.Arena() != r.Arena();
+}
+
+/* STL allocator over a PoolAllocator, meant for node based containers
+ * (std::list, std::map, ...). Single objects that fit in a pool block come
+ * from the pool, anything else from the heap.
+ */
+template<typename T>
+class PoolStlAllocator {
+public:
+    typedef T value_type;
+
+    PoolStlAllocator(PoolAllocator* pool = 0) : m_pool(pool) {}
+
+    template<typename U>
+    PoolStlAllocator(const PoolStlAllocator<U>& other) : m_pool(other.Pool()) {}
+
+    T* allocate(size_t n)
+    {
+        if (UsePool(n)) {
+            return (T*)m_pool->Allocate();
+        }
+        return (T*)::operator new(n * sizeof(T));
+    }
+
+    void deallocate(T* p, size_t n)
+    {
+        if (UsePool(n)) {
+            m_pool->Free(p);
+        } else {
+            ::operator delete(p);
+        }
+    }
+
+    PoolAllocator* Pool() const { return m_pool; }
+
+private:
+    bool UsePool(size_t n) const
+    {
+        return m_pool && n == 1 && sizeof(T) <= m_pool->BlockSize() &&
+            alignof(T) <= ARENA_DEFAULT_ALIGN;
+    }
+
+    PoolAllocator* m_pool;
+};
+
+template<typename T, typename U>
+inline bool operator==(const PoolStlAllocator<T>& l,
+                       const PoolStlAllocator<U>& r)
+{
+    return l.Pool() == r.Pool();
+}
+
+template<typename T, typename U>
+inline bool operator!=(const PoolStlAllocator<T>& l,
+                       const PoolStlAllocator<U>& r)
+{
+    return l.Pool() != r.Pool();
+}
+
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T> >;
+
+#endif
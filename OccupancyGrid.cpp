@@ -0,0 +1,470 @@
+#include "OccupancyGrid.h"
+#include "Parallel.h"
+#include "Profiler.h"
+
+#include <math.h>
+#include <float.h>
+#include <algorithm>
+
+// Dirty tiles per pool task in Update()
+#define OCCUPANCY_TILE_GRAIN 4
+
+/* Removes the first `value` from an unordered list */
+static inline void SwapRemove(std::vector<int>& list, int value)
+{
+    for (size_t i = 0; i < list.size(); i++) {
+        if (list[i] == value) {
+            list[i] = list.back();
+            list.pop_back();
+            return;
+        }
+    }
+}
+
+/* Floor of a cell coordinate, clamped to -1..count so far away or NaN
+ * coordinates stay representable */
+static inline int CellFloor(float cell, int count)
+{
+    if (!(cell > -1.0f)) {
+        return -1;
+    }
+    if (cell >= (float)count) {
+        return count;
+    }
+    return (int)floorf(cell);
+}
+
+/* Cells whose centers lie in [lo, hi], given in cell units from the
+ * grid origin */
+static inline void CenterSpan(float lo, float hi, int count, int* x0, int* x1)
+{
+    *x0 = CellFloor(lo - 0.5f, count);
+    if ((float)*x0 + 0.5f < lo) {
+        *x0 += 1;
+    }
+    *x1 = CellFloor(hi - 0.5f, count);
+}
+
+/* Solves k * x in [a, b] for x, false if no x does */
+static inline bool SolveSpan(float k, float a, float b, float* lo, float* hi)
+{
+    if (fabsf(k) < 1e-6f) {
+        *lo = -FLT_MAX;
+        *hi = FLT_MAX;
+        return a <= 0.0f && b >= 0.0f;
+    }
+    *lo = a / k;
+    *hi = b / k;
+    if (k < 0.0f) {
+        std::swap(*lo, *hi);
+    }
+    return true;
+}
+
+/* Packs the even bits of a word, or'ed with their odd neighbors, into its
+ * low 32 bits */
+static inline uint64_t CompactPairs(uint64_t w)
+{
+    w = (w | (w >> 1)) & 0x5555555555555555ull;
+    w = (w | (w >> 1)) & 0x3333333333333333ull;
+    w = (w | (w >> 2)) & 0x0f0f0f0f0f0f0f0full;
+    w = (w | (w >> 4)) & 0x00ff00ff00ff00ffull;
+    w = (w | (w >> 8)) & 0x0000ffff0000ffffull;
+    w = (w | (w >> 16)) & 0x00000000ffffffffull;
+    return w;
+}
+
+OccupancyGrid2D::OccupancyGrid2D() :
+    m_cellSize(1.0f), m_tileColumns(0), m_tileRows(0)
+{
+    Level empty;
+    empty.columns = 0;
+    empty.rows = 0;
+    empty.stride = 0;
+    m_levels.push_back(empty);
+}
+
+bool OccupancyGrid2D::Reset(const Rectangle2D& area, float cellSize,
+                            int levels)
+{
+    PROFILE_FUNCTION();
+    if (!(cellSize > 0.0f) || !(area.size.x > 0.0f) ||
+        !(area.size.y > 0.0f)) {
+        return false;
+    }
+    double columns = ceil(area.size.x / cellSize);
+    double rows = ceil(area.size.y / cellSize);
+    if (columns * rows > (double)OCCUPANCY_MAX_CELLS) {
+        return false;
+    }
+    m_origin = GetMin(area);
+    m_cellSize = cellSize;
+
+    m_levels.clear();
+    Level level;
+    level.columns = (int)columns;
+    level.rows = (int)rows;
+    levels = std::max(1, std::min(levels, OCCUPANCY_MAX_LEVELS));
+    for (int i = 0; i < levels; i++) {
+        level.stride = (level.columns + 63) / 64;
+        level.words.assign((size_t)level.stride * level.rows, 0);
+        m_levels.push_back(level);
+        if (level.columns == 1 && level.rows == 1) {
+            break;
+        }
+        level.columns = (level.columns + 1) / 2;
+        level.rows = (level.rows + 1) / 2;
+    }
+
+    m_shapes.clear();
+    m_freeShapes.clear();
+    m_tileColumns = (m_levels[0].columns + OCCUPANCY_TILE - 1) /
+                    OCCUPANCY_TILE;
+    m_tileRows = (m_levels[0].rows + OCCUPANCY_TILE - 1) / OCCUPANCY_TILE;
+    m_tiles.assign((size_t)m_tileColumns * m_tileRows, std::vector<int>());
+    m_dirty.assign(m_tiles.size(), 0);
+    m_dirtyTiles.clear();
+    return true;
+}
+
+int OccupancyGrid2D::Register(Shape& shape, const Rectangle2D& bounds)
+{
+    const Level& level = m_levels[0];
+    vec2 min = (GetMin(bounds) - m_origin) * (1.0f / m_cellSize);
+    vec2 max = (GetMax(bounds) - m_origin) * (1.0f / m_cellSize);
+    int x0 = std::max(0, CellFloor(min.x, level.columns));
+    int y0 = std::max(0, CellFloor(min.y, level.rows));
+    int x1 = std::min(level.columns - 1, CellFloor(max.x, level.columns));
+    int y1 = std::min(level.rows - 1, CellFloor(max.y, level.rows));
+    if (x0 > x1 || y0 > y1) {
+        x0 = y0 = 0;
+        x1 = y1 = -1;
+    }
+    shape.x0 = x0;
+    shape.y0 = y0;
+    shape.x1 = x1;
+    shape.y1 = y1;
+    shape.alive = true;
+
+    int index;
+    if (!m_freeShapes.empty()) {
+        index = m_freeShapes.back();
+        m_freeShapes.pop_back();
+        m_shapes[index] = shape;
+    }
+    else {
+        index = (int)m_shapes.size();
+        m_shapes.push_back(shape);
+    }
+    int tx0, ty0, tx1, ty1;
+    if (TileRange(shape, &tx0, &ty0, &tx1, &ty1)) {
+        for (int y = ty0; y <= ty1; y++) {
+            for (int x = tx0; x <= tx1; x++) {
+                m_tiles[y * m_tileColumns + x].push_back(index);
+            }
+        }
+    }
+    MarkDirty(shape);
+    return index;
+}
+
+int OccupancyGrid2D::AddShape(const Circle& circle)
+{
+    PROFILE_FUNCTION();
+    Shape shape;
+    shape.type = OCCUPANCY_CIRCLE;
+    shape.circle = circle;
+    vec2 extent(circle.radius, circle.radius);
+    return Register(shape, FromMinMax(circle.center - extent,
+                                      circle.center + extent));
+}
+
+int OccupancyGrid2D::AddShape(const Rectangle2D& rect)
+{
+    PROFILE_FUNCTION();
+    Shape shape;
+    shape.type = OCCUPANCY_RECTANGLE;
+    shape.rect = rect;
+    return Register(shape, rect);
+}
+
+int OccupancyGrid2D::AddShape(const OrientedRectangle& rect)
+{
+    PROFILE_FUNCTION();
+    Shape shape;
+    shape.type = OCCUPANCY_ORIENTED;
+    shape.oriented = rect;
+    return Register(shape, ContainingRectangle(rect));
+}
+
+int OccupancyGrid2D::AddShape(const Line2D& line)
+{
+    PROFILE_FUNCTION();
+    Shape shape;
+    shape.type = OCCUPANCY_LINE;
+    shape.line = line;
+    return Register(shape, ContainingRectangle(line));
+}
+
+void OccupancyGrid2D::RemoveShape(int shape)
+{
+    PROFILE_FUNCTION();
+    if (shape < 0 || shape >= (int)m_shapes.size() ||
+        !m_shapes[shape].alive) {
+        return;
+    }
+    Shape& s = m_shapes[shape];
+    int tx0, ty0, tx1, ty1;
+    if (TileRange(s, &tx0, &ty0, &tx1, &ty1)) {
+        for (int y = ty0; y <= ty1; y++) {
+            for (int x = tx0; x <= tx1; x++) {
+                SwapRemove(m_tiles[y * m_tileColumns + x], shape);
+            }
+        }
+    }
+    MarkDirty(s);
+    s.alive = false;
+    m_freeShapes.push_back(shape);
+}
+
+bool OccupancyGrid2D::TileRange(const Shape& shape, int* x0, int* y0,
+                                int* x1, int* y1) const
+{
+    if (shape.x0 > shape.x1 || shape.y0 > shape.y1) {
+        return false;
+    }
+    *x0 = shape.x0 / OCCUPANCY_TILE;
+    *y0 = shape.y0 / OCCUPANCY_TILE;
+    *x1 = shape.x1 / OCCUPANCY_TILE;
+    *y1 = shape.y1 / OCCUPANCY_TILE;
+    return true;
+}
+
+void OccupancyGrid2D::MarkDirty(const Shape& shape)
+{
+    int x0, y0, x1, y1;
+    if (!TileRange(shape, &x0, &y0, &x1, &y1)) {
+        return;
+    }
+    for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) {
+            int tile = y * m_tileColumns + x;
+            if (!m_dirty[tile]) {
+                m_dirty[tile] = 1;
+                m_dirtyTiles.push_back(tile);
+            }
+        }
+    }
+}
+
+void OccupancyGrid2D::SetSpan(int y, int x0, int x1)
+{
+    Level& level = m_levels[0];
+    uint64_t* row = &level.words[(size_t)y * level.stride];
+    int w0 = x0 >> 6;
+    int w1 = x1 >> 6;
+    uint64_t first = ~0ull << (x0 & 63);
+    uint64_t last = ~0ull >> (63 - (x1 & 63));
+    if (w0 == w1) {
+        row[w0] |= first & last;
+        return;
+    }
+    row[w0] |= first;
+    for (int w = w0 + 1; w < w1; w++) {
+        row[w] = ~0ull;
+    }
+    row[w1] |= last;
+}
+
+void OccupancyGrid2D::Stamp(const Shape& shape, int x0, int y0, int x1,
+                            int y1)
+{
+    int columns = m_levels[0].columns;
+    float invCellSize = 1.0f / m_cellSize;
+    // Shape coordinates in cell units from the grid origin
+    auto toCells = [&](const Point2D& p) {
+        return (p - m_origin) * invCellSize;
+    };
+
+    if (shape.type == OCCUPANCY_LINE) {
+        // Every cell the segment passes through, row by row
+        vec2 a = toCells(shape.line.start);
+        vec2 b = toCells(shape.line.end);
+        if (a.y > b.y) {
+            std::swap(a, b);
+        }
+        int r0 = std::max(y0, CellFloor(a.y, m_levels[0].rows));
+        int r1 = std::min(y1, CellFloor(b.y, m_levels[0].rows));
+        for (int y = r0; y <= r1; y++) {
+            float lo = a.x;
+            float hi = b.x;
+            if (b.y > a.y) {
+                float t0 = fmaxf(0.0f, ((float)y - a.y) / (b.y - a.y));
+                float t1 = fminf(1.0f, ((float)y + 1.0f - a.y) / (b.y - a.y));
+                lo = a.x + (b.x - a.x) * t0;
+                hi = a.x + (b.x - a.x) * t1;
+            }
+            if (lo > hi) {
+                std::swap(lo, hi);
+            }
+            int s0 = std::max(x0, CellFloor(lo, columns));
+            int s1 = std::min(x1, CellFloor(hi, columns));
+            if (s0 <= s1) {
+                SetSpan(y, s0, s1);
+            }
+        }
+        return;
+    }
+
+    // Area shapes cover the cells whose centers are inside
+    float c = 0.0f;
+    float s = 0.0f;
+    if (shape.type == OCCUPANCY_ORIENTED) {
+        float theta = -DEG2RAD(shape.oriented.rotation);
+        c = cosf(theta);
+        s = sinf(theta);
+    }
+    for (int y = y0; y <= y1; y++) {
+        float cy = (float)y + 0.5f;
+        float lo, hi;
+        if (shape.type == OCCUPANCY_CIRCLE) {
+            vec2 center = toCells(shape.circle.center);
+            float radius = shape.circle.radius * invCellSize;
+            float dy = cy - center.y;
+            float h2 = radius * radius - dy * dy;
+            if (h2 <= 0.0f) {
+                continue;
+            }
+            float h = sqrtf(h2);
+            lo = center.x - h;
+            hi = center.x + h;
+        }
+        else if (shape.type == OCCUPANCY_RECTANGLE) {
+            vec2 min = toCells(GetMin(shape.rect));
+            vec2 max = toCells(GetMax(shape.rect));
+            if (cy < min.y || cy > max.y) {
+                continue;
+            }
+            lo = min.x;
+            hi = max.x;
+        }
+        else {
+            // |dx * c - dy * s| <= hx and |dx * s + dy * c| <= hy, the
+            // local frame of PointInOrientedRectangle
+            vec2 origin = toCells(shape.oriented.origin);
+            vec2 half = shape.oriented.halfExtents * invCellSize;
+            float dy = cy - origin.y;
+            float lo0, hi0, lo1, hi1;
+            if (!SolveSpan(c, dy * s - half.x, dy * s + half.x, &lo0,
+                           &hi0) ||
+                !SolveSpan(s, -dy * c - half.y, -dy * c + half.y, &lo1,
+                           &hi1)) {
+                continue;
+            }
+            lo = origin.x + fmaxf(lo0, lo1);
+            hi = origin.x + fminf(hi0, hi1);
+        }
+        int s0, s1;
+        CenterSpan(lo, hi, columns, &s0, &s1);
+        s0 = std::max(s0, x0);
+        s1 = std::min(s1, x1);
+        if (s0 <= s1) {
+            SetSpan(y, s0, s1);
+        }
+    }
+}
+
+void OccupancyGrid2D::StampTile(int tile)
+{
+    const Level& level = m_levels[0];
+    int tx = tile % m_tileColumns;
+    int ty = tile / m_tileColumns;
+    int x0 = tx * OCCUPANCY_TILE;
+    int y0 = ty * OCCUPANCY_TILE;
+    int x1 = std::min(level.columns, x0 + OCCUPANCY_TILE) - 1;
+    int y1 = std::min(level.rows, y0 + OCCUPANCY_TILE) - 1;
+
+    // A tile is exactly one word of each of its rows
+    for (int y = y0; y <= y1; y++) {
+        m_levels[0].words[(size_t)y * level.stride + tx] = 0;
+    }
+    const std::vector<int>& shapes = m_tiles[tile];
+    for (size_t i = 0; i < shapes.size(); i++) {
+        const Shape& shape = m_shapes[shapes[i]];
+        Stamp(shape, std::max(x0, shape.x0), std::max(y0, shape.y0),
+              std::min(x1, shape.x1), std::min(y1, shape.y1));
+    }
+}
+
+void OccupancyGrid2D::Downsample(int tile)
+{
+    int x0 = (tile % m_tileColumns) * OCCUPANCY_TILE;
+    int y0 = (tile / m_tileColumns) * OCCUPANCY_TILE;
+    int x1 = std::min(m_levels[0].columns, x0 + OCCUPANCY_TILE) - 1;
+    int y1 = std::min(m_levels[0].rows, y0 + OCCUPANCY_TILE) - 1;
+    for (size_t i = 1; i < m_levels.size(); i++) {
+        const Level& fine = m_levels[i - 1];
+        Level& coarse = m_levels[i];
+        x0 >>= 1;
+        y0 >>= 1;
+        x1 >>= 1;
+        y1 >>= 1;
+        for (int y = y0; y <= y1; y++) {
+            const uint64_t* row0 = &fine.words[(size_t)(2 * y) * fine.stride];
+            const uint64_t* row1 = (2 * y + 1 < fine.rows) ?
+                                   row0 + fine.stride : row0;
+            for (int w = x0 >> 6; w <= (x1 >> 6); w++) {
+                int low = 2 * w;
+                int high = 2 * w + 1;
+                uint64_t bits = CompactPairs(row0[low] | row1[low]);
+                if (high < fine.stride) {
+                    bits |= CompactPairs(row0[high] | row1[high]) << 32;
+                }
+                coarse.words[(size_t)y * coarse.stride + w] = bits;
+            }
+        }
+    }
+}
+
+void OccupancyGrid2D::Update()
+{
+    PROFILE_FUNCTION();
+    if (m_dirtyTiles.empty()) {
+        return;
+    }
+    // Tiles own disjoint words of level 0, coarser words are shared
+    ParallelFor((int)m_dirtyTiles.size(), OCCUPANCY_TILE_GRAIN,
+                [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            StampTile(m_dirtyTiles[i]);
+        }
+    });
+    for (size_t i = 0; i < m_dirtyTiles.size(); i++) {
+        Downsample(m_dirtyTiles[i]);
+        m_dirty[m_dirtyTiles[i]] = 0;
+    }
+    m_dirtyTiles.clear();
+}
+
+bool OccupancyGrid2D::IsBlocked(int x, int y, int level) const
+{
+    const Level& l = m_levels[level];
+    if (x < 0 || y < 0 || x >= l.columns || y >= l.rows) {
+        return true;
+    }
+    return (l.words[(size_t)y * l.stride + (x >> 6)] >> (x & 63)) & 1;
+}
+
+bool OccupancyGrid2D::IsBlocked(const Point2D& point, int level) const
+{
+    const Level& l = m_levels[level];
+    vec2 cell = (point - m_origin) * (1.0f / CellSize(level));
+    return IsBlocked(CellFloor(cell.x, l.columns),
+                     CellFloor(cell.y, l.rows), level);
+}
+
+Rectangle2D OccupancyGrid2D::Area() const
+{
+    return Rectangle2D(m_origin, vec2(m_levels[0].columns * m_cellSize,
+                                      m_levels[0].rows * m_cellSize));
+}
@@ -0,0 +1,125 @@
+#ifndef _H_OCCUPANCY_GRID_
+#define _H_OCCUPANCY_GRID_
+
+#include "Geometry2D.h"
+
+#include <stdint.h>
+#include <vector>
+
+/* Blocked / free grid of the level geometry for the pathfinder.
+ *
+ * Cells are bits, 64 to a word, row by row. A cell is blocked when its
+ * center is inside a Circle, Rectangle2D or OrientedRectangle (the same
+ * test as PointInCircle() and friends), or when a Line2D passes through
+ * it. Shapes are stamped one row at a time: each shape yields the span of
+ * cells it covers in a row and the span is set a word at a time, so the
+ * cost is in rows and words, not in cells times shapes.
+ *
+ * The grid is split into tiles of OCCUPANCY_TILE x OCCUPANCY_TILE cells,
+ * one word wide, each listing the shapes overlapping it. Adding or
+ * removing a shape only marks its tiles dirty; Update() clears the dirty
+ * tiles and restamps the shapes of each, in parallel over tiles, then
+ * rebuilds the coarser levels above them.
+ *
+ * Level 0 is the full resolution grid. Each cell of level n + 1 covers
+ * 2 x 2 cells of level n and is blocked if any of them is, so a free
+ * coarse cell guarantees free cells below it.
+ */
+
+#define OCCUPANCY_TILE 64
+#define OCCUPANCY_MAX_LEVELS 16
+#define OCCUPANCY_MAX_CELLS (1 << 28)
+
+class OccupancyGrid2D {
+public:
+    OccupancyGrid2D();
+
+    /* Empties the grid and removes every shape. False if the area or cell
+     * size is empty or the grid would exceed OCCUPANCY_MAX_CELLS. `levels`
+     * counts level 0 and stops at a level of one cell. */
+    bool Reset(const Rectangle2D& area, float cellSize, int levels = 1);
+
+    /* Each returns the index of the new shape, reused once removed */
+    int AddShape(const Circle& circle);
+    int AddShape(const Rectangle2D& rect);
+    int AddShape(const OrientedRectangle& rect);
+    int AddShape(const Line2D& line);
+    void RemoveShape(int shape);
+
+    /* Restamps the tiles changed since the last Update() */
+    void Update();
+
+    /* Outside the grid counts as blocked */
+    bool IsBlocked(int x, int y, int level = 0) const;
+    bool IsBlocked(const Point2D& point, int level = 0) const;
+
+    int Levels() const { return (int)m_levels.size(); }
+    int Columns(int level = 0) const { return m_levels[level].columns; }
+    int Rows(int level = 0) const { return m_levels[level].rows; }
+    int WordsPerRow(int level = 0) const { return m_levels[level].stride; }
+    float CellSize(int level = 0) const
+    {
+        return m_cellSize * (float)(1 << level);
+    }
+    Rectangle2D Area() const;
+    /* Rows() * WordsPerRow() words; cell x of row y is bit x % 64 of word
+     * y * WordsPerRow() + x / 64 */
+    const uint64_t* Words(int level = 0) const
+    {
+        return m_levels[level].words.empty() ? 0 : &m_levels[level].words[0];
+    }
+
+private:
+    OccupancyGrid2D(const OccupancyGrid2D&);
+    OccupancyGrid2D& operator=(const OccupancyGrid2D&);
+
+    enum ShapeType {
+        OCCUPANCY_CIRCLE,
+        OCCUPANCY_RECTANGLE,
+        OCCUPANCY_ORIENTED,
+        OCCUPANCY_LINE
+    };
+
+    struct Shape {
+        int type;
+        Circle circle;
+        Rectangle2D rect;
+        OrientedRectangle oriented;
+        Line2D line;
+        // Cells that may be covered, inclusive, empty when x0 > x1
+        int x0, y0, x1, y1;
+        bool alive;
+    };
+
+    struct Level {
+        int columns;
+        int rows;
+        int stride;
+        std::vector<uint64_t> words;
+    };
+
+    int Register(Shape& shape, const Rectangle2D& bounds);
+    /* Tiles the shape may cover, false if none */
+    bool TileRange(const Shape& shape, int* x0, int* y0, int* x1,
+                   int* y1) const;
+    void MarkDirty(const Shape& shape);
+    /* Sets the cells of `shape` in rows y0..y1 and columns x0..x1 */
+    void Stamp(const Shape& shape, int x0, int y0, int x1, int y1);
+    void SetSpan(int y, int x0, int x1);
+    void StampTile(int tile);
+    void Downsample(int tile);
+
+    std::vector<Level> m_levels;
+    Point2D m_origin;
+    float m_cellSize;
+
+    std::vector<Shape> m_shapes;
+    std::vector<int> m_freeShapes;
+    std::vector<std::vector<int> > m_tiles;
+    int m_tileColumns;
+    int m_tileRows;
+    std::vector<uint8_t> m_dirty;
+    std::vector<int> m_dirtyTiles;
+};
+
+#endif
@@ -0,0 +1,156 @@
+#include "Parallel.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef struct ParallelJob
+{
+    ParallelRange range;
+    void* context;
+    int count;
+    int grain;
+    std::atomic<int> next;
+    std::atomic<int> done;
+    int users; // workers inside the job, guarded by the pool mutex
+} ParallelJob;
+
+static thread_local bool t_inParallel = false;
+
+// Grabs ranges until none are left, returns how many indices it ran
+static int RunRanges(ParallelJob* job)
+{
+    int ran = 0;
+    for (;;) {
+        int begin = job->next.fetch_add(job->grain, std::memory_order_relaxed);
+        if (begin >= job->count) {
+            return ran;
+        }
+        int end = (begin + job->grain < job->count) ?
+            begin + job->grain : job->count;
+        job->range(job->context, begin, end);
+        ran += end - begin;
+    }
+}
+
+class ParallelPool {
+public:
+    ParallelPool() : m_job(0), m_generation(0), m_shutdown(false)
+    {
+        int threads = (int)std::thread::hardware_concurrency();
+        for (int i = 1; i < threads; i++) {
+            m_threads.push_back(std::thread(&ParallelPool::Worker, this));
+        }
+    }
+
+    ~ParallelPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_shutdown = true;
+        }
+        m_wake.notify_all();
+        for (size_t i = 0; i < m_threads.size(); i++) {
+            m_threads[i].join();
+        }
+    }
+
+    int ThreadCount() const { return (int)m_threads.size() + 1; }
+
+    void Run(ParallelJob* job)
+    {
+        // One job at a time; other callers queue up here
+        std::lock_guard<std::mutex> runLock(m_runMutex);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_job = job;
+            m_generation++;
+        }
+        m_wake.notify_all();
+
+        t_inParallel = true;
+        int ran = RunRanges(job);
+        t_inParallel = false;
+        job->done.fetch_add(ran, std::memory_order_acq_rel);
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_finished.wait(lock, [job] {
+            return job->done.load(std::memory_order_acquire) == job->count &&
+                job->users == 0;
+        });
+        m_job = 0;
+    }
+
+private:
+    void Worker()
+    {
+        t_inParallel = true;
+        unsigned int seen = 0;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;) {
+            m_wake.wait(lock, [this, seen] {
+                return m_shutdown || (m_job && m_generation != seen);
+            });
+            if (m_shutdown) {
+                return;
+            }
+            seen = m_generation;
+            ParallelJob* job = m_job;
+            job->users++;
+            lock.unlock();
+
+            int ran = RunRanges(job);
+            job->done.fetch_add(ran, std::memory_order_acq_rel);
+
+            lock.lock();
+            job->users--;
+            m_finished.notify_all();
+        }
+    }
+
+    std::vector<std::thread> m_threads;
+    std::mutex m_runMutex;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_finished;
+    ParallelJob* m_job;
+    unsigned int m_generation;
+    bool m_shutdown;
+};
+
+static ParallelPool& GetPool()
+{
+    static ParallelPool pool;
+    return pool;
+}
+
+void ParallelRun(int count, int grain, ParallelRange range, void* context)
+{
+    if (count <= 0) {
+        return;
+    }
+    if (grain < 1) {
+        grain = 1;
+    }
+    if (count <= grain || t_inParallel || GetPool().ThreadCount() == 1) {
+        range(context, 0, count);
+        return;
+    }
+
+    ParallelJob job;
+    job.range = range;
+    job.context = context;
+    job.count = count;
+    job.grain = grain;
+    job.next.store(0, std::memory_order_relaxed);
+    job.done.store(0, std::memory_order_relaxed);
+    job.users = 0;
+    GetPool().Run(&job);
+}
+
+int ParallelThreadCount()
+{
+    return GetPool().ThreadCount();
+}
@@ -0,0 +1,36 @@
+#ifndef _H_PARALLEL_
+#define _H_PARALLEL_
+
+/* Data parallel loops on a shared worker pool.
+ *
+ * ParallelFor(count, grain, f) calls f(begin, end) on disjoint ranges that
+ * cover [0, count), from the pool threads and the calling thread, and
+ * returns once every range is done. Ranges spread over the pool hold at
+ * most `grain` indices each. The pool starts on first use with one worker
+ * per hardware thread, minus the caller. Loops started from inside a pool
+ * task, loops of at most `grain` indices and every loop on a one thread
+ * pool run inline on the calling thread as a single f(0, count), so
+ * nesting is safe, but per-range state must not assume a range starts on
+ * a multiple of `grain`.
+ */
+
+typedef void (*ParallelRange)(void* context, int begin, int end);
+
+void ParallelRun(int count, int grain, ParallelRange range, void* context);
+
+/* Threads a ParallelFor can use, including the caller */
+int ParallelThreadCount();
+
+template<typename F>
+static void ParallelForRange(void* context, int begin, int end)
+{
+    (*(const F*)context)(begin, end);
+}
+
+template<typename F>
+inline void ParallelFor(int count, int grain, const F& f)
+{
+    ParallelRun(count, grain, ParallelForRange<F>, (void*)&f);
+}
+
+#endif
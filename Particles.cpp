@@ -0,0 +1,338 @@
+#include "Particles.h"
+#include "Parallel.h"
+#include "Profiler.h"
+#include "Wide.h"
+
+#include <math.h>
+
+ParticleSystem2D::ParticleSystem2D() :
+    m_count(0), m_gravity(0.0f, -9.8f), m_restitution(0.5f),
+    m_friction(0.0f)
+{
+}
+
+static inline int PaddedCount(int count)
+{
+    return (count + WIDE_LANES - 1) / WIDE_LANES * WIDE_LANES;
+}
+
+void ParticleSystem2D::SetLane(int index, const Point2D& position,
+                               const vec2& velocity)
+{
+    m_x[index] = position.x;
+    m_y[index] = position.y;
+    m_vx[index] = velocity.x;
+    m_vy[index] = velocity.y;
+}
+
+void ParticleSystem2D::Resize(int size)
+{
+    m_x.resize(size);
+    m_y.resize(size);
+    m_vx.resize(size);
+    m_vy.resize(size);
+}
+
+void ParticleSystem2D::FillPadding()
+{
+    int padded = PaddedCount(m_count);
+    Resize(padded);
+    for (int i = m_count; i < padded; i++) {
+        SetLane(i, GetPosition(m_count - 1), GetVelocity(m_count - 1));
+    }
+}
+
+int ParticleSystem2D::Add(const Point2D& position, const vec2& velocity)
+{
+    int index = m_count++;
+    Resize(PaddedCount(m_count));
+    SetLane(index, position, velocity);
+    FillPadding();
+    return index;
+}
+
+void ParticleSystem2D::Remove(int index)
+{
+    m_count--;
+    SetLane(index, GetPosition(m_count), GetVelocity(m_count));
+    if (m_count == 0) {
+        Clear();
+        return;
+    }
+    FillPadding();
+}
+
+void ParticleSystem2D::Clear()
+{
+    m_x.clear();
+    m_y.clear();
+    m_vx.clear();
+    m_vy.clear();
+    m_count = 0;
+}
+
+void ParticleSystem2D::Reserve(int count)
+{
+    int padded = PaddedCount(count);
+    m_x.reserve(padded);
+    m_y.reserve(padded);
+    m_vx.reserve(padded);
+    m_vy.reserve(padded);
+}
+
+Point2D ParticleSystem2D::GetPosition(int index) const
+{
+    return Point2D(m_x[index], m_y[index]);
+}
+
+vec2 ParticleSystem2D::GetVelocity(int index) const
+{
+    return vec2(m_vx[index], m_vy[index]);
+}
+
+void ParticleSystem2D::SetPosition(int index, const Point2D& position)
+{
+    m_x[index] = position.x;
+    m_y[index] = position.y;
+    if (index == m_count - 1) {
+        FillPadding();
+    }
+}
+
+void ParticleSystem2D::SetVelocity(int index, const vec2& velocity)
+{
+    m_vx[index] = velocity.x;
+    m_vy[index] = velocity.y;
+    if (index == m_count - 1) {
+        FillPadding();
+    }
+}
+
+void ParticleSystem2D::AddCollider(const Circle& circle)
+{
+    m_circles.push_back(circle);
+    vec2 extent(circle.radius, circle.radius);
+    m_circleBounds.push_back(FromMinMax(circle.center - extent,
+                                        circle.center + extent));
+}
+
+void ParticleSystem2D::AddCollider(const Rectangle2D& rect)
+{
+    m_rectangles.push_back(rect);
+}
+
+void ParticleSystem2D::AddCollider(const OrientedRectangle& rect)
+{
+    OrientedCollider collider;
+    collider.origin = rect.origin;
+    collider.halfExtents = rect.halfExtents;
+    collider.cos = cosf(DEG2RAD(rect.rotation));
+    collider.sin = sinf(DEG2RAD(rect.rotation));
+    m_orientedRectangles.push_back(collider);
+    m_orientedBounds.push_back(ContainingRectangle(rect));
+}
+
+void ParticleSystem2D::ClearColliders()
+{
+    m_circles.clear();
+    m_circleBounds.clear();
+    m_rectangles.clear();
+    m_orientedRectangles.clear();
+    m_orientedBounds.clear();
+}
+
+/* Collision response, for the lanes in `inside`: move to `surface` and
+ * split the velocity along `normal` when moving inwards */
+struct ParticleResponse {
+    floatw restitution;
+    floatw tangentScale;
+};
+
+static inline void Respond(const ParticleResponse& response,
+                           const maskw& inside, const vec2w& normal,
+                           const vec2w& surface, vec2w& p, vec2w& v)
+{
+    p = Select(inside, surface, p);
+    floatw vn = Dot(v, normal);
+    vec2w tangent = v - normal * vn;
+    vec2w bounced = tangent * response.tangentScale -
+                    normal * (vn * response.restitution);
+    v = Select(inside & (vn < 0.0f), bounced, v);
+}
+
+/* Closest face of the box [min, max] to the inside point p */
+static inline void ClosestFace(const vec2w& p, const vec2& min,
+                               const vec2& max, vec2w& normal,
+                               vec2w& surface)
+{
+    floatw best = p.x - min.x;
+    normal = vec2w(floatw(-1.0f), floatw(0.0f));
+    surface = vec2w(floatw(min.x), p.y);
+
+    floatw d = floatw(max.x) - p.x;
+    maskw closer = d < best;
+    best = Select(closer, d, best);
+    normal = Select(closer, vec2w(floatw(1.0f), floatw(0.0f)), normal);
+    surface = Select(closer, vec2w(floatw(max.x), p.y), surface);
+
+    d = p.y - min.y;
+    closer = d < best;
+    best = Select(closer, d, best);
+    normal = Select(closer, vec2w(floatw(0.0f), floatw(-1.0f)), normal);
+    surface = Select(closer, vec2w(p.x, floatw(min.y)), surface);
+
+    d = floatw(max.y) - p.y;
+    closer = d < best;
+    normal = Select(closer, vec2w(floatw(0.0f), floatw(1.0f)), normal);
+    surface = Select(closer, vec2w(p.x, floatw(max.y)), surface);
+}
+
+static inline maskw InsideBox(const vec2w& p, const vec2& min,
+                              const vec2& max)
+{
+    return (p.x > min.x) & (p.x < max.x) & (p.y > min.y) & (p.y < max.y);
+}
+
+static inline void CollideCircle(const ParticleResponse& response,
+                                 const Circle& circle, vec2w& p, vec2w& v)
+{
+    vec2w d = p - vec2w(circle.center);
+    floatw distSq = Dot(d, d);
+    maskw inside = distSq < circle.radius * circle.radius;
+    if (!Any(inside)) {
+        return;
+    }
+    // A particle exactly at the center leaves upwards
+    floatw dist = Sqrt(distSq);
+    vec2w normal = Select(dist > 0.0f, d * (floatw(1.0f) / dist),
+                          vec2w(floatw(0.0f), floatw(1.0f)));
+    vec2w surface = vec2w(circle.center) + normal * circle.radius;
+    Respond(response, inside, normal, surface, p, v);
+}
+
+static inline void CollideRectangle(const ParticleResponse& response,
+                                    const Rectangle2D& rect, vec2w& p,
+                                    vec2w& v)
+{
+    vec2 min = GetMin(rect);
+    vec2 max = GetMax(rect);
+    maskw inside = InsideBox(p, min, max);
+    if (!Any(inside)) {
+        return;
+    }
+    vec2w normal, surface;
+    ClosestFace(p, min, max, normal, surface);
+    Respond(response, inside, normal, surface, p, v);
+}
+
+static inline vec2w Rotate(const vec2w& v, float c, float s)
+{
+    return vec2w(v.x * c - v.y * s, v.x * s + v.y * c);
+}
+
+static inline void CollideOriented(const ParticleResponse& response,
+                                   const Point2D& origin,
+                                   const vec2& halfExtents, float c, float s,
+                                   vec2w& p, vec2w& v)
+{
+    // Into the rectangle's frame, same rotation as PointInOrientedRectangle
+    vec2w local = Rotate(p - vec2w(origin), c, -s);
+    vec2 min(-halfExtents.x, -halfExtents.y);
+    maskw inside = InsideBox(local, min, halfExtents);
+    if (!Any(inside)) {
+        return;
+    }
+    vec2w normal, surface;
+    ClosestFace(local, min, halfExtents, normal, surface);
+    Respond(response, inside, Rotate(normal, c, s),
+            Rotate(surface, c, s) + vec2w(origin), p, v);
+}
+
+static inline bool Overlaps(const Rectangle2D& rect, const vec2& min,
+                            const vec2& max)
+{
+    vec2 rmin = GetMin(rect);
+    vec2 rmax = GetMax(rect);
+    return rmin.x <= max.x && rmax.x >= min.x &&
+           rmin.y <= max.y && rmax.y >= min.y;
+}
+
+void ParticleSystem2D::UpdateBlocks(int begin, int end, float dt)
+{
+    float* px = &m_x[0];
+    float* py = &m_y[0];
+    float* vx = &m_vx[0];
+    float* vy = &m_vy[0];
+
+    // Integrate, tracking the bounds of the chunk
+    floatw minX(3.4e38f), minY(3.4e38f), maxX(-3.4e38f), maxY(-3.4e38f);
+    floatw gx(m_gravity.x * dt), gy(m_gravity.y * dt), wdt(dt);
+    for (int b = begin; b < end; b++) {
+        int i = b * WIDE_LANES;
+        floatw nvx = LoadWide(vx + i) + gx;
+        floatw nvy = LoadWide(vy + i) + gy;
+        floatw nx = LoadWide(px + i) + nvx * wdt;
+        floatw ny = LoadWide(py + i) + nvy * wdt;
+        StoreWide(vx + i, nvx);
+        StoreWide(vy + i, nvy);
+        StoreWide(px + i, nx);
+        StoreWide(py + i, ny);
+        minX = Min(minX, nx);
+        minY = Min(minY, ny);
+        maxX = Max(maxX, nx);
+        maxY = Max(maxY, ny);
+    }
+    vec2 min(Lane(minX, 0), Lane(minY, 0));
+    vec2 max(Lane(maxX, 0), Lane(maxY, 0));
+    for (int l = 1; l < WIDE_LANES; l++) {
+        min = vec2(fminf(min.x, Lane(minX, l)), fminf(min.y, Lane(minY, l)));
+        max = vec2(fmaxf(max.x, Lane(maxX, l)), fmaxf(max.y, Lane(maxY, l)));
+    }
+
+    // Then every collider touching the chunk, over the whole chunk. The
+    // chunk stays in L1 between colliders.
+    ParticleResponse response;
+    response.restitution = floatw(m_restitution);
+    response.tangentScale = floatw(1.0f - m_friction);
+
+#define PARTICLE_BLOCKS(collide) \
+    for (int b = begin; b < end; b++) { \
+        int i = b * WIDE_LANES; \
+        vec2w p(LoadWide(px + i), LoadWide(py + i)); \
+        vec2w v(LoadWide(vx + i), LoadWide(vy + i)); \
+        collide; \
+        StoreWide(px + i, p.x); \
+        StoreWide(py + i, p.y); \
+        StoreWide(vx + i, v.x); \
+        StoreWide(vy + i, v.y); \
+    }
+
+    for (size_t c = 0; c < m_circles.size(); c++) {
+        if (Overlaps(m_circleBounds[c], min, max)) {
+            PARTICLE_BLOCKS(CollideCircle(response, m_circles[c], p, v));
+        }
+    }
+    for (size_t c = 0; c < m_rectangles.size(); c++) {
+        if (Overlaps(m_rectangles[c], min, max)) {
+            PARTICLE_BLOCKS(CollideRectangle(response, m_rectangles[c], p, v));
+        }
+    }
+    for (size_t c = 0; c < m_orientedRectangles.size(); c++) {
+        if (Overlaps(m_orientedBounds[c], min, max)) {
+            const OrientedCollider& o = m_orientedRectangles[c];
+            PARTICLE_BLOCKS(CollideOriented(response, o.origin,
+                                            o.halfExtents, o.cos, o.sin,
+                                            p, v));
+        }
+    }
+#undef PARTICLE_BLOCKS
+}
+
+void ParticleSystem2D::Update(float dt)
+{
+    PROFILE_FUNCTION();
+    int blocks = (int)m_x.size() / WIDE_LANES;
+    ParallelFor(blocks, PARTICLE_CHUNK / WIDE_LANES, [&](int begin, int end) {
+        UpdateBlocks(begin, end, dt);
+    });
+}
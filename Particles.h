@@ -0,0 +1,89 @@
+#ifndef _H_PARTICLES_
+#define _H_PARTICLES_
+
+#include "Geometry2D.h"
+
+#include <vector>
+
+/* Point particles (debris, effects) bouncing off static 2D colliders.
+ *
+ * Positions and velocities are stored as separate x and y arrays padded
+ * to a multiple of WIDE_LANES (see Wide.h), so Update() runs on whole SIMD
+ * registers: semi-implicit Euler integration, then every collider's test
+ * and response for all lanes at once. The padding lanes copy the last
+ * particle, so they never extend the bounds of a chunk.
+ *
+ * Update() splits the particles into chunks of PARTICLE_CHUNK and hands
+ * them to the worker pool. Each chunk takes the bounds of its particles
+ * after integration and only runs the colliders overlapping them.
+ *
+ * A particle found inside a collider is moved to the closest point of its
+ * surface. If it was moving inwards, its normal velocity is reflected and
+ * scaled by the restitution and its tangential velocity is scaled by
+ * (1 - friction); restitution 1 and friction 0 give exactly Reflection().
+ */
+
+#define PARTICLE_CHUNK 1024
+
+class ParticleSystem2D {
+public:
+    ParticleSystem2D();
+
+    /* Returns the index of the new particle */
+    int Add(const Point2D& position, const vec2& velocity);
+    /* Moves the last particle into `index` */
+    void Remove(int index);
+    void Clear();
+    void Reserve(int count);
+
+    int Count() const { return m_count; }
+    Point2D GetPosition(int index) const;
+    vec2 GetVelocity(int index) const;
+    void SetPosition(int index, const Point2D& position);
+    void SetVelocity(int index, const vec2& velocity);
+    /* Count() values each, for rendering */
+    const float* PositionsX() const { return m_x.empty() ? 0 : &m_x[0]; }
+    const float* PositionsY() const { return m_y.empty() ? 0 : &m_y[0]; }
+
+    void AddCollider(const Circle& circle);
+    void AddCollider(const Rectangle2D& rect);
+    void AddCollider(const OrientedRectangle& rect);
+    void ClearColliders();
+
+    void SetGravity(const vec2& gravity) { m_gravity = gravity; }
+    void SetRestitution(float restitution) { m_restitution = restitution; }
+    void SetFriction(float friction) { m_friction = friction; }
+
+    void Update(float dt);
+
+private:
+    struct OrientedCollider {
+        Point2D origin;
+        vec2 halfExtents;
+        float cos;
+        float sin;
+    };
+
+    void UpdateBlocks(int begin, int end, float dt);
+    void Resize(int size);
+    void SetLane(int index, const Point2D& position, const vec2& velocity);
+    void FillPadding();
+
+    std::vector<float> m_x;
+    std::vector<float> m_y;
+    std::vector<float> m_vx;
+    std::vector<float> m_vy;
+    int m_count;
+
+    std::vector<Circle> m_circles;
+    std::vector<Rectangle2D> m_rectangles;
+    std::vector<OrientedCollider> m_orientedRectangles;
+    std::vector<Rectangle2D> m_circleBounds;
+    std::vector<Rectangle2D> m_orientedBounds;
+
+    vec2 m_gravity;
+    float m_restitution;
+    float m_friction;
+};
+
+#endif
@@ -0,0 +1,186 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#elif defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+thread_local ProfileThreadData* g_profileThread = 0;
+
+static std::mutex s_profileMutex;
+static const char* s_siteNames[PROFILER_MAX_SITES];
+static std::atomic<int> s_siteCount(0);
+
+// Thread blocks are never freed so that counters of finished threads
+// still show up in snapshots.
+static std::vector<ProfileThreadData*> s_threads;
+
+// Reference point to convert cycle counts to microseconds for traces
+static uint64_t s_startCycles = 0;
+static std::chrono::steady_clock::time_point s_startTime;
+
+uint64_t ProfileCycles()
+{
+#if defined(__x86_64__) || defined(__i386__) || defined(_MSC_VER)
+    return __rdtsc();
+#else
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+int ProfileRegisterSite(const char* name)
+{
+    std::lock_guard<std::mutex> lock(s_profileMutex);
+    int site = s_siteCount.load(std::memory_order_relaxed);
+    if (site >= PROFILER_MAX_SITES) {
+        return -1;
+    }
+    if (site == 0) {
+        s_startCycles = ProfileCycles();
+        s_startTime = std::chrono::steady_clock::now();
+    }
+    s_siteNames[site] = name;
+    s_siteCount.store(site + 1, std::memory_order_release);
+    return site;
+}
+
+ProfileThreadData* ProfileThreadInit()
+{
+    ProfileThreadData* data = new ProfileThreadData();
+    for (int i = 0; i < PROFILER_MAX_SITES; i++) {
+        data->calls[i].store(0, std::memory_order_relaxed);
+        data->sampledCalls[i].store(0, std::memory_order_relaxed);
+        data->sampledCycles[i].store(0, std::memory_order_relaxed);
+    }
+    data->eventCount.store(0, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(s_profileMutex);
+    data->threadIndex = (int)s_threads.size();
+    s_threads.push_back(data);
+    g_profileThread = data;
+    return data;
+}
+
+int ProfileSnapshot(ProfileCounter* out, int maxCount)
+{
+    std::lock_guard<std::mutex> lock(s_profileMutex);
+    int sites = s_siteCount.load(std::memory_order_acquire);
+    int n = std::min(sites, maxCount);
+
+    for (int i = 0; i < n; i++) {
+        ProfileCounter& counter = out[i];
+        counter.name = s_siteNames[i];
+        counter.calls = 0;
+        counter.sampledCalls = 0;
+        counter.sampledCycles = 0;
+        for (size_t t = 0; t < s_threads.size(); t++) {
+            ProfileThreadData* data = s_threads[t];
+            counter.calls += data->calls[i].load(std::memory_order_relaxed);
+            counter.sampledCalls +=
+                data->sampledCalls[i].load(std::memory_order_relaxed);
+            counter.sampledCycles +=
+                data->sampledCycles[i].load(std::memory_order_relaxed);
+        }
+    }
+    return sites;
+}
+
+void ProfileReset()
+{
+    std::lock_guard<std::mutex> lock(s_profileMutex);
+    for (size_t t = 0; t < s_threads.size(); t++) {
+        ProfileThreadData* data = s_threads[t];
+        for (int i = 0; i < PROFILER_MAX_SITES; i++) {
+            data->calls[i].store(0, std::memory_order_relaxed);
+            data->sampledCalls[i].store(0, std::memory_order_relaxed);
+            data->sampledCycles[i].store(0, std::memory_order_relaxed);
+        }
+        data->eventCount.store(0, std::memory_order_relaxed);
+    }
+}
+
+static bool CompareCalls(const ProfileCounter& a, const ProfileCounter& b)
+{
+    return a.calls > b.calls;
+}
+
+void ProfileDump(FILE* file)
+{
+    ProfileCounter counters[PROFILER_MAX_SITES];
+    int n = ProfileSnapshot(counters, PROFILER_MAX_SITES);
+    std::sort(counters, counters + n, CompareCalls);
+
+    fprintf(file, "%12s %14s  %s\n", "calls", "avg cycles", "function");
+    for (int i = 0; i < n; i++) {
+        if (counters[i].calls == 0) {
+            continue;
+        }
+        double avg = counters[i].sampledCalls ?
+            (double)counters[i].sampledCycles / counters[i].sampledCalls : 0.0;
+        fprintf(file, "%12llu %14.1f  %s\n",
+                (unsigned long long)counters[i].calls, avg, counters[i].name);
+    }
+}
+
+// Writes `name` as a JSON string body
+static void WriteJsonString(FILE* file, const char* name)
+{
+    for (const char* c = name; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            fputc('\\', file);
+        }
+        fputc(*c, file);
+    }
+}
+
+bool ProfileWriteChromeTrace(const char* path)
+{
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(s_profileMutex);
+
+    // Cycles per microsecond, measured over the lifetime of the profiler
+    double elapsedUs = (double)std::chrono::duration_cast<
+        std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - s_startTime).count();
+    double elapsedCycles = (double)(ProfileCycles() - s_startCycles);
+    double cyclesPerUs = (elapsedUs > 0.0) ? elapsedCycles / elapsedUs : 1.0;
+
+    fprintf(file, "{\"traceEvents\":[");
+    bool first = true;
+    for (size_t t = 0; t < s_threads.size(); t++) {
+        ProfileThreadData* data = s_threads[t];
+        uint64_t count = data->eventCount.load(std::memory_order_acquire);
+        uint64_t begin = (count > PROFILER_MAX_EVENTS) ?
+            count - PROFILER_MAX_EVENTS : 0;
+
+        for (uint64_t e = begin; e < count; e++) {
+            const ProfileEvent& event = data->events[e % PROFILER_MAX_EVENTS];
+            double ts = (double)(int64_t)(event.start - s_startCycles) /
+                cyclesPerUs;
+            double dur = (double)event.cycles / cyclesPerUs;
+
+            fprintf(file, "%s\n{\"name\":\"", first ? "" : ",");
+            WriteJsonString(file, s_siteNames[event.site]);
+            fprintf(file, "\",\"cat\":\"math\",\"ph\":\"X\","
+                    "\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":%d}",
+                    ts, dur, data->threadIndex);
+            first = false;
+        }
+    }
+    fprintf(file, "\n]}\n");
+
+    bool ok = (ferror(file) == 0);
+    fclose(file);
+    return ok;
+}
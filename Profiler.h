@@ -0,0 +1,138 @@
+#ifndef _H_PROFILER_
+#define _H_PROFILER_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+
+/* Opt-in instrumentation for the math library.
+ *
+ * Build with GAMEPHYSICS_PROFILE defined to have every function in
+ * vectors.cpp, matrices.cpp and Geometry2D.cpp count its calls. One call
+ * in PROFILER_SAMPLE_RATE (per function, per thread) is also timed with
+ * the cycle counter and kept in a per-thread ring for trace export.
+ * Without the define PROFILE_FUNCTION() expands to nothing.
+ *
+ * Counters live in thread-local blocks, so the hot path never takes a
+ * lock or a contended atomic; ProfileSnapshot sums the blocks of every
+ * thread that has made an instrumented call.
+ */
+
+#define PROFILER_MAX_SITES 256
+#define PROFILER_SAMPLE_RATE 64
+#define PROFILER_MAX_EVENTS 8192
+
+typedef struct ProfileCounter {
+    const char* name;
+    uint64_t calls;
+    uint64_t sampledCalls;
+    uint64_t sampledCycles;
+} ProfileCounter;
+
+typedef struct ProfileEvent {
+    int site;
+    uint32_t cycles;
+    uint64_t start;
+} ProfileEvent;
+
+typedef struct ProfileThreadData {
+    std::atomic<uint64_t> calls[PROFILER_MAX_SITES];
+    std::atomic<uint64_t> sampledCalls[PROFILER_MAX_SITES];
+    std::atomic<uint64_t> sampledCycles[PROFILER_MAX_SITES];
+
+    ProfileEvent events[PROFILER_MAX_EVENTS];
+    std::atomic<uint64_t> eventCount;
+    int threadIndex;
+} ProfileThreadData;
+
+uint64_t ProfileCycles();
+
+int ProfileRegisterSite(const char* name);
+ProfileThreadData* ProfileThreadInit();
+
+extern thread_local ProfileThreadData* g_profileThread;
+
+/* Fills `out` with up to `maxCount` counters, summed over all threads, and
+ * returns the number of registered sites. Safe to call at any time.
+ */
+int ProfileSnapshot(ProfileCounter* out, int maxCount);
+void ProfileReset();
+
+/* Prints a table of the counters sorted by call count. */
+void ProfileDump(FILE* file);
+
+/* Writes the sampled calls as Chrome trace events (chrome://tracing,
+ * Perfetto). The per-thread event rings are read without
+ * synchronization, so call this while instrumented threads are idle,
+ * e.g. between ticks.
+ */
+bool ProfileWriteChromeTrace(const char* path);
+
+class ProfileScope {
+public:
+    inline explicit ProfileScope(int site) : m_site(site), m_start(0)
+    {
+        if (site < 0) {
+            return;
+        }
+        ProfileThreadData* data = g_profileThread;
+        if (data == 0) {
+            data = ProfileThreadInit();
+        }
+        m_data = data;
+
+        // Only the owning thread writes its block, relaxed load/store
+        // keeps snapshots from other threads well defined without a
+        // locked increment.
+        uint64_t calls = data->calls[site].load(std::memory_order_relaxed);
+        data->calls[site].store(calls + 1, std::memory_order_relaxed);
+        if (calls % PROFILER_SAMPLE_RATE == 0) {
+            m_start = ProfileCycles();
+        }
+    }
+
+    inline ~ProfileScope()
+    {
+        if (m_start == 0) {
+            return;
+        }
+        uint64_t cycles = ProfileCycles() - m_start;
+        ProfileThreadData* data = m_data;
+
+        uint64_t n = data->sampledCalls[m_site].load(std::memory_order_relaxed);
+        data->sampledCalls[m_site].store(n + 1, std::memory_order_relaxed);
+        uint64_t c = data->sampledCycles[m_site].load(std::memory_order_relaxed);
+        data->sampledCycles[m_site].store(c + cycles, std::memory_order_relaxed);
+
+        uint64_t e = data->eventCount.load(std::memory_order_relaxed);
+        ProfileEvent& event = data->events[e % PROFILER_MAX_EVENTS];
+        event.site = m_site;
+        event.start = m_start;
+        event.cycles = (cycles > 0xffffffffu) ? 0xffffffffu : (uint32_t)cycles;
+        data->eventCount.store(e + 1, std::memory_order_release);
+    }
+
+private:
+    int m_site;
+    uint64_t m_start;
+    ProfileThreadData* m_data;
+};
+
+#if defined(__GNUC__) || defined(__clang__)
+#define PROFILE_FUNCTION_NAME __PRETTY_FUNCTION__
+#elif defined(_MSC_VER)
+#define PROFILE_FUNCTION_NAME __FUNCSIG__
+#else
+#define PROFILE_FUNCTION_NAME __func__
+#endif
+
+#if defined(GAMEPHYSICS_PROFILE)
+#define PROFILE_FUNCTION() \
+    static const int _profileSite = \
+        ProfileRegisterSite(PROFILE_FUNCTION_NAME); \
+    ProfileScope _profileScope(_profileSite)
+#else
+#define PROFILE_FUNCTION()
+#endif
+
+#endif
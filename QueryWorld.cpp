@@ -0,0 +1,91 @@
+#include "QueryWorld.h"
+#include "Profiler.h"
+
+QueryWorld2D::QueryWorld2D() : m_current(-1)
+{
+    for (int i = 0; i < QUERY_WORLD_SLOTS; i++) {
+        m_slots[i].readers.store(0);
+        m_slots[i].step = 0;
+    }
+}
+
+bool QueryWorld2D::Publish(const SweptTargets& shapes, uint32_t step,
+                           float cellSize)
+{
+    PROFILE_FUNCTION();
+    // A reader that pins a slot after this check sees it is not current
+    // and backs off before reading it
+    int current = m_current.load();
+    int slot = -1;
+    for (int i = 0; i < QUERY_WORLD_SLOTS && slot < 0; i++) {
+        if (i != current && m_slots[i].readers.load() == 0) {
+            slot = i;
+        }
+    }
+    if (slot < 0) {
+        return false;
+    }
+
+    // Binned by bounds only: the queries run the exact tests anyway
+    Slot& s = m_slots[slot];
+    const void* image = 0;
+    size_t size = 0;
+    if (!BakeCollisionMemory(shapes, s.buffer, &image, &size, cellSize,
+                             false) ||
+        !s.world.OpenMemory(image, size)) {
+        s.world.Close();
+        return false;
+    }
+    s.step = step;
+    m_current.store(slot);
+    return true;
+}
+
+uint32_t QueryWorld2D::PublishedStep() const
+{
+    QueryWorldView view(*this);
+    return view.Step();
+}
+
+int QueryWorld2D::Pin() const
+{
+    for (;;) {
+        int slot = m_current.load();
+        if (slot < 0) {
+            return -1;
+        }
+        m_slots[slot].readers.fetch_add(1);
+        if (m_current.load() == slot) {
+            return slot;
+        }
+        m_slots[slot].readers.fetch_sub(1);
+    }
+}
+
+void QueryWorld2D::Unpin(int slot) const
+{
+    m_slots[slot].readers.fetch_sub(1);
+}
+
+QueryWorldView::QueryWorldView(const QueryWorld2D& source) :
+    m_source(source), m_slot(source.Pin())
+{
+}
+
+QueryWorldView::~QueryWorldView()
+{
+    if (m_slot >= 0) {
+        m_source.Unpin(m_slot);
+    }
+}
+
+const CollisionFile& QueryWorldView::World() const
+{
+    static const CollisionFile empty;
+    return m_slot >= 0 ? m_source.m_slots[m_slot].world : empty;
+}
+
+uint32_t QueryWorldView::Step() const
+{
+    return m_slot >= 0 ? m_source.m_slots[m_slot].step : 0;
+}
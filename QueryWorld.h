@@ -0,0 +1,86 @@
+#ifndef _H_QUERY_WORLD_
+#define _H_QUERY_WORLD_
+
+#include "CollisionFile.h"
+
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+
+/* Read-only copies of the world for threads that query it while the
+ * simulation steps (network, AI).
+ *
+ * Once per step the simulation thread calls Publish() with the current
+ * shapes. They are copied with BakeCollisionMemory into a slot no reader
+ * holds, shape arrays and grid in one immutable block, and the slot
+ * becomes the current one with a single atomic store; nothing is copied
+ * on the reader side. Publishing bins the shapes into the grid by their
+ * bounds only and leaves the exact overlap tests to the queries, so it
+ * costs a copy and a counting sort rather than an offline bake.
+ *
+ * Any thread pins the current slot by constructing a QueryWorldView and
+ * runs the CollisionFile queries on it without locks. The view keeps its
+ * slot alive until it is destroyed, so a query never sees a half written
+ * world, however many steps are published meanwhile. Readers count
+ * themselves in the slot, then check it is still current and back off if
+ * it is not; the publisher only rewrites slots that are not current and
+ * have no readers.
+ *
+ * With QUERY_WORLD_SLOTS slots, Publish() fails (and readers keep the
+ * previous step) only when every other slot is pinned. Views are meant to
+ * live for a few queries, not across steps.
+ */
+
+#define QUERY_WORLD_SLOTS 4
+
+class QueryWorld2D {
+public:
+    QueryWorld2D();
+
+    /* Simulation thread only. `cellSize` as for BakeCollisionFile. */
+    bool Publish(const SweptTargets& shapes, uint32_t step,
+                 float cellSize = 0.0f);
+    /* Step of the current slot, 0 before the first Publish() */
+    uint32_t PublishedStep() const;
+
+private:
+    QueryWorld2D(const QueryWorld2D&);
+    QueryWorld2D& operator=(const QueryWorld2D&);
+
+    friend class QueryWorldView;
+
+    struct Slot {
+        std::atomic<int> readers;
+        std::vector<uint8_t> buffer;
+        CollisionFile world;
+        uint32_t step;
+    };
+
+    /* Index of the pinned slot, -1 if nothing was published */
+    int Pin() const;
+    void Unpin(int slot) const;
+
+    mutable Slot m_slots[QUERY_WORLD_SLOTS];
+    std::atomic<int> m_current;
+};
+
+class QueryWorldView {
+public:
+    explicit QueryWorldView(const QueryWorld2D& source);
+    ~QueryWorldView();
+
+    /* False before the first Publish() */
+    bool IsValid() const { return m_slot >= 0; }
+    /* The pinned world, an empty CollisionFile when not valid */
+    const CollisionFile& World() const;
+    uint32_t Step() const;
+
+private:
+    QueryWorldView(const QueryWorldView&);
+    QueryWorldView& operator=(const QueryWorldView&);
+
+    const QueryWorld2D& m_source;
+    int m_slot;
+};
+
+#endif
@@ -0,0 +1,418 @@
+#include "Snapshot.h"
+#include "Profiler.h"
+
+#include <string.h>
+#include <cmath>
+
+static_assert(sizeof(Body2D) % sizeof(uint32_t) == 0,
+              "Body2D must be whole words");
+static_assert(sizeof(mat4) == 16 * sizeof(float), "mat4 layout");
+
+/* SnapshotWriter */
+
+void SnapshotWriter::Append(const void* data, size_t size)
+{
+    size_t offset = m_words.size();
+    m_words.resize(offset + size / sizeof(uint32_t));
+    if (size > 0) {
+        memcpy(&m_words[offset], data, size);
+    }
+}
+
+void SnapshotWriter::Write(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    m_words.push_back(bits);
+}
+
+void SnapshotWriter::Write(const vec2& value)
+{
+    Append(value.asArray, sizeof(float) * 2);
+}
+
+void SnapshotWriter::Write(const vec3& value)
+{
+    Append(value.asArray, sizeof(float) * 3);
+}
+
+void SnapshotWriter::Write(const mat4& value)
+{
+    Append(value.asArray, sizeof(float) * 16);
+}
+
+void SnapshotWriter::Write(const Line2D& line)
+{
+    Write(line.start);
+    Write(line.end);
+}
+
+void SnapshotWriter::Write(const Circle& circle)
+{
+    Write(circle.center);
+    Write(circle.radius);
+}
+
+void SnapshotWriter::Write(const Rectangle2D& rect)
+{
+    Write(rect.origin);
+    Write(rect.size);
+}
+
+void SnapshotWriter::Write(const OrientedRectangle& rect)
+{
+    Write(rect.origin);
+    Write(rect.halfExtents);
+    Write(rect.rotation);
+}
+
+void SnapshotWriter::Write(const Polygon2D& polygon)
+{
+    Write(polygon.count);
+    Append(polygon.vertices, sizeof(vec2) * polygon.count);
+}
+
+void SnapshotWriter::Write(const Capsule2D& capsule)
+{
+    Write(capsule.start);
+    Write(capsule.end);
+    Write(capsule.radius);
+}
+
+void SnapshotWriter::Write(const Body2D& body)
+{
+    Append(&body, sizeof(body));
+}
+
+void SnapshotWriter::Write(const Body2D* bodies, int count)
+{
+    PROFILE_FUNCTION();
+    Write(count);
+    Append(bodies, sizeof(Body2D) * count);
+}
+
+void SnapshotWriter::WriteQuantized(float value, float step)
+{
+    Write((int)floorf(value / step + 0.5f));
+}
+
+void SnapshotWriter::WriteQuantized(const vec2& value, float step)
+{
+    WriteQuantized(value.x, step);
+    WriteQuantized(value.y, step);
+}
+
+/* SnapshotReader */
+
+void SnapshotReader::Extract(void* data, size_t size)
+{
+    int words = (int)(size / sizeof(uint32_t));
+    if (words > m_count - m_cursor) {
+        memset(data, 0, size);
+        m_cursor = m_count;
+        m_ok = false;
+        return;
+    }
+    if (size > 0) {
+        memcpy(data, m_words + m_cursor, size);
+    }
+    m_cursor += words;
+}
+
+void SnapshotReader::Read(uint32_t& value)
+{
+    Extract(&value, sizeof(value));
+}
+
+void SnapshotReader::Read(int& value)
+{
+    Extract(&value, sizeof(value));
+}
+
+void SnapshotReader::Read(float& value)
+{
+    Extract(&value, sizeof(value));
+}
+
+void SnapshotReader::Read(vec2& value)
+{
+    Extract(value.asArray, sizeof(float) * 2);
+}
+
+void SnapshotReader::Read(vec3& value)
+{
+    Extract(value.asArray, sizeof(float) * 3);
+}
+
+void SnapshotReader::Read(mat4& value)
+{
+    Extract(value.asArray, sizeof(float) * 16);
+}
+
+void SnapshotReader::Read(Line2D& line)
+{
+    Read(line.start);
+    Read(line.end);
+}
+
+void SnapshotReader::Read(Circle& circle)
+{
+    Read(circle.center);
+    Read(circle.radius);
+}
+
+void SnapshotReader::Read(Rectangle2D& rect)
+{
+    Read(rect.origin);
+    Read(rect.size);
+}
+
+void SnapshotReader::Read(OrientedRectangle& rect)
+{
+    Read(rect.origin);
+    Read(rect.halfExtents);
+    Read(rect.rotation);
+}
+
+void SnapshotReader::Read(Polygon2D& polygon)
+{
+    int count;
+    Read(count);
+    if (count < 0 || count > POLYGON2D_MAX_VERTICES) {
+        m_ok = false;
+        count = 0;
+    }
+    vec2 vertices[POLYGON2D_MAX_VERTICES];
+    Extract(vertices, sizeof(vec2) * count);
+    SetVertices(polygon, vertices, count);
+}
+
+void SnapshotReader::Read(Capsule2D& capsule)
+{
+    Read(capsule.start);
+    Read(capsule.end);
+    Read(capsule.radius);
+}
+
+void SnapshotReader::Read(Body2D& body)
+{
+    Extract(&body, sizeof(body));
+}
+
+int SnapshotReader::Read(Body2D* bodies, int capacity)
+{
+    PROFILE_FUNCTION();
+    int count;
+    Read(count);
+    if (count < 0) {
+        m_ok = false;
+        return 0;
+    }
+    int stored = count < capacity ? count : capacity;
+    Extract(bodies, sizeof(Body2D) * stored);
+
+    // Skip the bodies that didn't fit
+    int skip = (int)((count - stored) * (sizeof(Body2D) / sizeof(uint32_t)));
+    if (skip > m_count - m_cursor) {
+        m_cursor = m_count;
+        m_ok = false;
+    } else {
+        m_cursor += skip;
+    }
+    return m_ok ? stored : 0;
+}
+
+void SnapshotReader::ReadQuantized(float& value, float step)
+{
+    int quantized;
+    Read(quantized);
+    value = (float)quantized * step;
+}
+
+void SnapshotReader::ReadQuantized(vec2& value, float step)
+{
+    ReadQuantized(value.x, step);
+    ReadQuantized(value.y, step);
+}
+
+/* Delta codec */
+
+// Bytes stored per size code: unchanged, 2, 3 or all 4 low bytes
+static const int s_codeBytes[4] = { 0, 2, 3, 4 };
+
+static inline int SizeCode(uint32_t x)
+{
+    return (x == 0) ? 0 : (x <= 0xFFFFu ? 1 : (x <= 0xFFFFFFu ? 2 : 3));
+}
+
+static inline uint32_t XorWord(const uint32_t* base, int baseCount,
+                               const uint32_t* frame, int i)
+{
+    return frame[i] ^ (i < baseCount ? base[i] : 0u);
+}
+
+static inline bool GroupUnchanged(const uint32_t* base, int baseCount,
+                                  const uint32_t* frame, int count, int i)
+{
+    int end = (i + 4 < count) ? i + 4 : count;
+    for (; i < end; i++) {
+        if (XorWord(base, baseCount, frame, i) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void EncodeDelta(const uint32_t* base, int baseCount,
+                 const uint32_t* frame, int count, std::vector<uint8_t>& out)
+{
+    PROFILE_FUNCTION();
+    // Write through a pointer into the worst case size, trim at the end
+    size_t start = out.size();
+    out.resize(start + (size_t)count * 4 + (size_t)count / 4 + 2);
+    uint8_t* p = &out[0] + start;
+
+    int i = 0;
+    while (i < count) {
+        if (GroupUnchanged(base, baseCount, frame, count, i)) {
+            int run = 0;
+            i += 4;
+            while (run < 255 && i < count &&
+                   GroupUnchanged(base, baseCount, frame, count, i)) {
+                run++;
+                i += 4;
+            }
+            *p++ = 0;
+            *p++ = (uint8_t)run;
+            continue;
+        }
+
+        uint8_t* control = p++;
+        *control = 0;
+        int end = (i + 4 < count) ? i + 4 : count;
+        for (int k = 0; i + k < end; k++) {
+            uint32_t x = XorWord(base, baseCount, frame, i + k);
+            int code = SizeCode(x);
+            *control |= (uint8_t)(code << (k * 2));
+            for (int b = 0; b < s_codeBytes[code]; b++) {
+                *p++ = (uint8_t)(x >> (b * 8));
+            }
+        }
+        i = end;
+    }
+    out.resize(p - &out[0]);
+}
+
+bool ApplyDelta(const uint8_t* delta, size_t size, int count,
+                std::vector<uint32_t>& frame)
+{
+    PROFILE_FUNCTION();
+    frame.resize(count, 0u);
+    const uint8_t* p = delta;
+    const uint8_t* end = delta + size;
+
+    int i = 0;
+    while (i < count) {
+        if (p >= end) {
+            return false;
+        }
+        uint8_t control = *p++;
+        if (control == 0) {
+            if (p >= end) {
+                return false;
+            }
+            i += 4 * (1 + *p++);
+            continue;
+        }
+        for (int k = 0; k < 4; k++) {
+            int bytes = s_codeBytes[(control >> (k * 2)) & 3];
+            if (bytes == 0) {
+                continue;
+            }
+            if (i + k >= count || end - p < bytes) {
+                return false;
+            }
+            uint32_t x = 0;
+            for (int b = 0; b < bytes; b++) {
+                x |= (uint32_t)p[b] << (b * 8);
+            }
+            p += bytes;
+            frame[i + k] ^= x;
+        }
+        i += 4;
+    }
+    return p == end;
+}
+
+/* SnapshotRing */
+
+SnapshotRing::SnapshotRing(int capacity) :
+    m_slots(capacity > 1 ? capacity : 1), m_newestTick(0), m_count(0)
+{
+}
+
+void SnapshotRing::Push(uint32_t tick, const std::vector<uint32_t>& frame)
+{
+    PROFILE_FUNCTION();
+    if (m_count > 0 && tick <= m_newestTick) {
+        std::vector<uint32_t> previous;
+        if (!Rewind(tick - 1, previous)) {
+            m_count = 0;
+        }
+    }
+
+    if (m_count > 0 && tick == m_newestTick + 1) {
+        // The old newest frame becomes the delta back from the new one
+        Slot& slot = SlotOf(m_newestTick);
+        slot.delta.clear();
+        EncodeDelta(frame.empty() ? 0 : &frame[0], (int)frame.size(),
+                    m_newest.empty() ? 0 : &m_newest[0], (int)m_newest.size(),
+                    slot.delta);
+        slot.wordCount = (int)m_newest.size();
+        if (m_count < (int)m_slots.size()) {
+            m_count++;
+        }
+    } else {
+        m_count = 1;
+    }
+    m_newest = frame;
+    m_newestTick = tick;
+}
+
+bool SnapshotRing::Restore(uint32_t tick, std::vector<uint32_t>& frame) const
+{
+    PROFILE_FUNCTION();
+    if (m_count == 0 || tick > m_newestTick || tick < OldestTick()) {
+        return false;
+    }
+    frame = m_newest;
+    for (uint32_t t = m_newestTick; t != tick; ) {
+        t--;
+        const Slot& slot = SlotOf(t);
+        if (!ApplyDelta(slot.delta.empty() ? 0 : &slot.delta[0],
+                        slot.delta.size(), slot.wordCount, frame)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SnapshotRing::Rewind(uint32_t tick, std::vector<uint32_t>& frame)
+{
+    if (!Restore(tick, frame)) {
+        return false;
+    }
+    m_count -= (int)(m_newestTick - tick);
+    m_newestTick = tick;
+    m_newest = frame;
+    return true;
+}
+
+size_t SnapshotRing::Size() const
+{
+    size_t size = m_newest.size() * sizeof(uint32_t);
+    for (int i = 1; i < m_count; i++) {
+        size += SlotOf(m_newestTick - i).delta.size();
+    }
+    return size;
+}
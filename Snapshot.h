@@ -0,0 +1,151 @@
+#ifndef _H_SNAPSHOT_
+#define _H_SNAPSHOT_
+
+#include "vectors.h"
+#include "matrices.h"
+#include "Geometry2D.h"
+#include "Body2D.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/* Simulation state snapshots for rollback.
+ *
+ * A snapshot is a flat array of 32 bit words: SnapshotWriter appends
+ * values bit for bit and SnapshotReader reads them back in the same
+ * order, so restoring is exact. WriteQuantized is the lossy exception,
+ * for values the game already rounds to a step every tick.
+ *
+ * Deltas XOR a frame against a base frame and store, for every word, only
+ * the low bytes that changed. Each group of four words starts with a
+ * control byte holding a 2 bit size per word (0, 2, 3 or 4 bytes), and a
+ * zero control byte is followed by a count of further unchanged groups,
+ * so static parts of the world cost next to nothing.
+ *
+ * SnapshotRing keeps the newest frame whole and every older frame as the
+ * delta that turns its successor back into it. Pushing a frame encodes
+ * one delta; restoring k frames back applies k of them.
+ */
+
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(std::vector<uint32_t>& words) : m_words(words) {}
+
+    void Write(uint32_t value) { m_words.push_back(value); }
+    void Write(int value) { m_words.push_back((uint32_t)value); }
+    void Write(float value);
+    void Write(const vec2& value);
+    void Write(const vec3& value);
+    void Write(const mat4& value);
+
+    void Write(const Line2D& line);
+    void Write(const Circle& circle);
+    void Write(const Rectangle2D& rect);
+    void Write(const OrientedRectangle& rect);
+    /* Vertices only, the normals and bounds are rebuilt on read */
+    void Write(const Polygon2D& polygon);
+    void Write(const Capsule2D& capsule);
+    void Write(const Body2D& body);
+
+    /* The count and then the bodies in one copy */
+    void Write(const Body2D* bodies, int count);
+
+    /* round(value / step) */
+    void WriteQuantized(float value, float step);
+    void WriteQuantized(const vec2& value, float step);
+
+private:
+    void Append(const void* data, size_t size);
+
+    std::vector<uint32_t>& m_words;
+};
+
+/* Reads past the end return zeros and clear Ok() */
+class SnapshotReader {
+public:
+    SnapshotReader(const uint32_t* words, int count) :
+        m_words(words), m_count(count), m_cursor(0), m_ok(true) {}
+    explicit SnapshotReader(const std::vector<uint32_t>& words) :
+        m_words(words.empty() ? 0 : &words[0]), m_count((int)words.size()),
+        m_cursor(0), m_ok(true) {}
+
+    bool Ok() const { return m_ok; }
+    int Remaining() const { return m_count - m_cursor; }
+
+    void Read(uint32_t& value);
+    void Read(int& value);
+    void Read(float& value);
+    void Read(vec2& value);
+    void Read(vec3& value);
+    void Read(mat4& value);
+
+    void Read(Line2D& line);
+    void Read(Circle& circle);
+    void Read(Rectangle2D& rect);
+    void Read(OrientedRectangle& rect);
+    void Read(Polygon2D& polygon);
+    void Read(Capsule2D& capsule);
+    void Read(Body2D& body);
+
+    /* Reads at most `capacity` bodies, returns how many were stored */
+    int Read(Body2D* bodies, int capacity);
+
+    void ReadQuantized(float& value, float step);
+    void ReadQuantized(vec2& value, float step);
+
+private:
+    void Extract(void* data, size_t size);
+
+    const uint32_t* m_words;
+    int m_count;
+    int m_cursor;
+    bool m_ok;
+};
+
+/* Appends the delta turning `base` into `frame` to `out`. Words past the
+ * end of `base` are XORed against zero. */
+void EncodeDelta(const uint32_t* base, int baseCount,
+                 const uint32_t* frame, int count, std::vector<uint8_t>& out);
+/* Turns `frame` (the base) into the frame of `count` words the delta was
+ * encoded from. False if the delta is malformed. */
+bool ApplyDelta(const uint8_t* delta, size_t size, int count,
+                std::vector<uint32_t>& frame);
+
+class SnapshotRing {
+public:
+    explicit SnapshotRing(int capacity = 64);
+
+    /* Ticks are consecutive. Pushing a tick at or below the newest one
+     * first drops it and every frame after it, as after a rollback; a gap
+     * starts the ring over. */
+    void Push(uint32_t tick, const std::vector<uint32_t>& frame);
+    bool Restore(uint32_t tick, std::vector<uint32_t>& frame) const;
+    /* Restores `tick` and drops the frames after it */
+    bool Rewind(uint32_t tick, std::vector<uint32_t>& frame);
+
+    int Count() const { return m_count; }
+    uint32_t NewestTick() const { return m_newestTick; }
+    uint32_t OldestTick() const { return m_newestTick - (m_count - 1); }
+    /* Bytes held by the deltas and the newest frame */
+    size_t Size() const;
+
+private:
+    struct Slot {
+        std::vector<uint8_t> delta; // from the next tick back to this one
+        int wordCount;
+    };
+
+    Slot& SlotOf(uint32_t tick) { return m_slots[tick % m_slots.size()]; }
+    const Slot& SlotOf(uint32_t tick) const
+    {
+        return m_slots[tick % m_slots.size()];
+    }
+
+    std::vector<Slot> m_slots;
+    std::vector<uint32_t> m_newest;
+    uint32_t m_newestTick;
+    int m_count;
+};
+
+#endif
@@ -0,0 +1,587 @@
+#include "SoftBody.h"
+#include "Parallel.h"
+#include "Profiler.h"
+#include "Wide.h"
+
+#include <algorithm>
+#include <math.h>
+
+// Constraints or particles per pool task, a multiple of WIDE_LANES
+#define SOFT_BODY_GRAIN 2048
+
+SoftBodySystem2D::SoftBodySystem2D() :
+    m_gravity(0.0f, -9.8f), m_substeps(8), m_damping(0.0f),
+    m_prepared(true)
+{
+}
+
+int SoftBodySystem2D::AddParticle(const Point2D& position, float mass)
+{
+    m_x.push_back(position.x);
+    m_y.push_back(position.y);
+    m_prevX.push_back(position.x);
+    m_prevY.push_back(position.y);
+    m_vx.push_back(0.0f);
+    m_vy.push_back(0.0f);
+    m_invMass.push_back(mass > 0.0f ? 1.0f / mass : 0.0f);
+    return (int)m_x.size() - 1;
+}
+
+void SoftBodySystem2D::AddDistanceConstraint(int a, int b, float compliance)
+{
+    m_distanceA.push_back(a);
+    m_distanceB.push_back(b);
+    m_distanceRest.push_back(Distance(GetPosition(a), GetPosition(b)));
+    m_distanceCompliance.push_back(compliance);
+    m_distanceLambda.push_back(0.0f);
+    m_prepared = false;
+}
+
+// Signed angle from a-b to b-c, in radians
+static inline float BendAngle(const vec2& a, const vec2& b, const vec2& c)
+{
+    vec2 e1 = b - a;
+    vec2 e2 = c - b;
+    return atan2f(e1.x * e2.y - e1.y * e2.x, Dot(e1, e2));
+}
+
+void SoftBodySystem2D::AddBendingConstraint(int a, int b, int c,
+                                            float compliance)
+{
+    m_bendingA.push_back(a);
+    m_bendingB.push_back(b);
+    m_bendingC.push_back(c);
+    m_bendingRest.push_back(BendAngle(GetPosition(a), GetPosition(b),
+                                      GetPosition(c)));
+    m_bendingCompliance.push_back(compliance);
+    m_bendingLambda.push_back(0.0f);
+    m_prepared = false;
+}
+
+static float RingArea(const float* x, const float* y, const int* ring,
+                      int count)
+{
+    float area = 0.0f;
+    for (int i = 0; i < count; i++) {
+        int p = ring[i];
+        int q = ring[(i + 1) % count];
+        area += x[p] * y[q] - x[q] * y[p];
+    }
+    return area * 0.5f;
+}
+
+void SoftBodySystem2D::AddAreaConstraint(const int* particles, int count,
+                                         float compliance, float pressure)
+{
+    if (m_areaStart.empty()) {
+        m_areaStart.push_back(0);
+    }
+    m_areaParticles.insert(m_areaParticles.end(), particles,
+                           particles + count);
+    m_areaStart.push_back((int)m_areaParticles.size());
+    m_areaRest.push_back(pressure *
+                         RingArea(&m_x[0], &m_y[0], particles, count));
+    m_areaCompliance.push_back(compliance);
+    m_areaLambda.push_back(0.0f);
+}
+
+int SoftBodySystem2D::AddCloth(const Point2D& origin, const vec2& size,
+                               int columns, int rows, float particleMass,
+                               float compliance, float bendingCompliance)
+{
+    PROFILE_FUNCTION();
+    int first = ParticleCount();
+    vec2 step(size.x / (float)(columns > 1 ? columns - 1 : 1),
+              size.y / (float)(rows > 1 ? rows - 1 : 1));
+    for (int r = 0; r < rows; r++) {
+        for (int c = 0; c < columns; c++) {
+            AddParticle(origin + vec2(step.x * c, step.y * r), particleMass);
+        }
+    }
+    for (int r = 0; r < rows; r++) {
+        for (int c = 0; c < columns; c++) {
+            int i = first + r * columns + c;
+            if (c + 1 < columns) {
+                AddDistanceConstraint(i, i + 1, compliance);
+            }
+            if (r + 1 < rows) {
+                AddDistanceConstraint(i, i + columns, compliance);
+            }
+            if (c + 2 < columns) {
+                AddBendingConstraint(i, i + 1, i + 2, bendingCompliance);
+            }
+            if (r + 2 < rows) {
+                AddBendingConstraint(i, i + columns, i + 2 * columns,
+                                     bendingCompliance);
+            }
+        }
+    }
+    return first;
+}
+
+void SoftBodySystem2D::AddCollider(const Circle& circle)
+{
+    m_circles.push_back(circle);
+}
+
+void SoftBodySystem2D::AddCollider(const Rectangle2D& rect)
+{
+    m_rectangles.push_back(rect);
+}
+
+void SoftBodySystem2D::AddCollider(const OrientedRectangle& rect)
+{
+    OrientedCollider collider;
+    collider.origin = rect.origin;
+    collider.halfExtents = rect.halfExtents;
+    collider.cos = cosf(DEG2RAD(rect.rotation));
+    collider.sin = sinf(DEG2RAD(rect.rotation));
+    m_orientedRectangles.push_back(collider);
+}
+
+void SoftBodySystem2D::ClearColliders()
+{
+    m_circles.clear();
+    m_rectangles.clear();
+    m_orientedRectangles.clear();
+}
+
+Point2D SoftBodySystem2D::GetPosition(int index) const
+{
+    return Point2D(m_x[index], m_y[index]);
+}
+
+vec2 SoftBodySystem2D::GetVelocity(int index) const
+{
+    return vec2(m_vx[index], m_vy[index]);
+}
+
+void SoftBodySystem2D::SetPosition(int index, const Point2D& position)
+{
+    m_x[index] = position.x;
+    m_y[index] = position.y;
+}
+
+int SoftBodySystem2D::DistanceColorCount() const
+{
+    return m_distanceColors.empty() ? 0 : (int)m_distanceColors.size() - 1;
+}
+
+int SoftBodySystem2D::BendingColorCount() const
+{
+    return m_bendingColors.empty() ? 0 : (int)m_bendingColors.size() - 1;
+}
+
+/* Graph coloring
+ *
+ * Greedy: every constraint takes the lowest color none of its particles
+ * has yet, tracked as a 64 bit mask per particle. Constraints that find
+ * all 64 colors taken go round again with the next 64.
+ */
+static int ColorConstraints(const int* const* particles, int arity,
+                            int count, int particleCount,
+                            std::vector<int>& colors)
+{
+    colors.assign(count, 0);
+    std::vector<uint64_t> used(particleCount);
+    std::vector<int> pending(count);
+    for (int i = 0; i < count; i++) {
+        pending[i] = i;
+    }
+
+    int colorCount = 0;
+    for (int base = 0; !pending.empty(); base += SOFT_BODY_MAX_COLORS) {
+        std::fill(used.begin(), used.end(), 0);
+        std::vector<int> next;
+        for (size_t k = 0; k < pending.size(); k++) {
+            int constraint = pending[k];
+            uint64_t mask = 0;
+            for (int j = 0; j < arity; j++) {
+                mask |= used[particles[j][constraint]];
+            }
+            if (mask == ~(uint64_t)0) {
+                next.push_back(constraint);
+                continue;
+            }
+            int color = 0;
+            while (mask & ((uint64_t)1 << color)) {
+                color++;
+            }
+            for (int j = 0; j < arity; j++) {
+                used[particles[j][constraint]] |= (uint64_t)1 << color;
+            }
+            colors[constraint] = base + color;
+            colorCount = (base + color + 1 > colorCount) ?
+                         base + color + 1 : colorCount;
+        }
+        pending.swap(next);
+    }
+    return colorCount;
+}
+
+/* Stable counting sort of the constraints by color. `starts` gets the
+ * first constraint of each color and the total count at the end. */
+static void SortByColor(const std::vector<int>& colors, int colorCount,
+                        std::vector<int>& order, std::vector<int>& starts)
+{
+    starts.assign(colorCount + 1, 0);
+    for (size_t i = 0; i < colors.size(); i++) {
+        starts[colors[i] + 1]++;
+    }
+    for (int c = 0; c < colorCount; c++) {
+        starts[c + 1] += starts[c];
+    }
+    std::vector<int> next(starts.begin(), starts.end() - 1);
+    order.resize(colors.size());
+    for (size_t i = 0; i < colors.size(); i++) {
+        order[next[colors[i]]++] = (int)i;
+    }
+}
+
+template<typename T>
+static void Permute(std::vector<T>& values, const std::vector<int>& order)
+{
+    std::vector<T> sorted(values.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        sorted[i] = values[order[i]];
+    }
+    values.swap(sorted);
+}
+
+void SoftBodySystem2D::Prepare()
+{
+    PROFILE_FUNCTION();
+    std::vector<int> colors, order;
+    int particleCount = ParticleCount();
+
+    const int* distance[2] = {
+        m_distanceA.empty() ? 0 : &m_distanceA[0],
+        m_distanceB.empty() ? 0 : &m_distanceB[0]
+    };
+    int colorCount = ColorConstraints(distance, 2, (int)m_distanceA.size(),
+                                      particleCount, colors);
+    SortByColor(colors, colorCount, order, m_distanceColors);
+    Permute(m_distanceA, order);
+    Permute(m_distanceB, order);
+    Permute(m_distanceRest, order);
+    Permute(m_distanceCompliance, order);
+    Permute(m_distanceLambda, order);
+
+    const int* bending[3] = {
+        m_bendingA.empty() ? 0 : &m_bendingA[0],
+        m_bendingB.empty() ? 0 : &m_bendingB[0],
+        m_bendingC.empty() ? 0 : &m_bendingC[0]
+    };
+    colorCount = ColorConstraints(bending, 3, (int)m_bendingA.size(),
+                                  particleCount, colors);
+    SortByColor(colors, colorCount, order, m_bendingColors);
+    Permute(m_bendingA, order);
+    Permute(m_bendingB, order);
+    Permute(m_bendingC, order);
+    Permute(m_bendingRest, order);
+    Permute(m_bendingCompliance, order);
+    Permute(m_bendingLambda, order);
+
+    m_prepared = true;
+}
+
+/* Distance constraints
+ *
+ * dlambda = (-C - alpha * lambda) / (w1 + w2 + alpha), alpha being the
+ * compliance over h^2, then each end moves along the constraint direction
+ * by its inverse mass times dlambda. Full groups of WIDE_LANES gather
+ * their particles into registers, the rest of the range runs the same
+ * math one constraint at a time.
+ */
+void SoftBodySystem2D::SolveDistances(int begin, int end, float invH2)
+{
+    float* x = &m_x[0];
+    float* y = &m_y[0];
+    const float* w = &m_invMass[0];
+    int i = begin;
+    for (; i + WIDE_LANES <= end; i += WIDE_LANES) {
+        const int* a = &m_distanceA[i];
+        const int* b = &m_distanceB[i];
+        float ax[WIDE_LANES], ay[WIDE_LANES], aw[WIDE_LANES];
+        float bx[WIDE_LANES], by[WIDE_LANES], bw[WIDE_LANES];
+        for (int l = 0; l < WIDE_LANES; l++) {
+            ax[l] = x[a[l]];
+            ay[l] = y[a[l]];
+            aw[l] = w[a[l]];
+            bx[l] = x[b[l]];
+            by[l] = y[b[l]];
+            bw[l] = w[b[l]];
+        }
+        vec2w pa(LoadWide(ax), LoadWide(ay));
+        vec2w pb(LoadWide(bx), LoadWide(by));
+        floatw wa = LoadWide(aw);
+        floatw wb = LoadWide(bw);
+
+        vec2w d = pa - pb;
+        floatw length = Magnitude(d);
+        floatw alpha = LoadWide(&m_distanceCompliance[i]) * invH2;
+        floatw lambda = LoadWide(&m_distanceLambda[i]);
+        floatw c = length - LoadWide(&m_distanceRest[i]);
+        floatw denominator = wa + wb + alpha;
+        maskw valid = (denominator > 0.0f) & (length > 0.0f);
+        floatw dLambda = Select(valid, (-c - alpha * lambda) / denominator,
+                                floatw(0.0f));
+        vec2w n = d * Select(valid, floatw(1.0f) / length, floatw(0.0f));
+
+        pa = pa + n * (wa * dLambda);
+        pb = pb - n * (wb * dLambda);
+        StoreWide(&m_distanceLambda[i], lambda + dLambda);
+        StoreWide(ax, pa.x);
+        StoreWide(ay, pa.y);
+        StoreWide(bx, pb.x);
+        StoreWide(by, pb.y);
+        for (int l = 0; l < WIDE_LANES; l++) {
+            x[a[l]] = ax[l];
+            y[a[l]] = ay[l];
+            x[b[l]] = bx[l];
+            y[b[l]] = by[l];
+        }
+    }
+    for (; i < end; i++) {
+        int a = m_distanceA[i];
+        int b = m_distanceB[i];
+        vec2 d(x[a] - x[b], y[a] - y[b]);
+        float length = Magnitude(d);
+        float alpha = m_distanceCompliance[i] * invH2;
+        float denominator = w[a] + w[b] + alpha;
+        if (denominator <= 0.0f || length <= 0.0f) {
+            continue;
+        }
+        float c = length - m_distanceRest[i];
+        float dLambda = (-c - alpha * m_distanceLambda[i]) / denominator;
+        vec2 n = d * (1.0f / length);
+        x[a] += n.x * (w[a] * dLambda);
+        y[a] += n.y * (w[a] * dLambda);
+        x[b] -= n.x * (w[b] * dLambda);
+        y[b] -= n.y * (w[b] * dLambda);
+        m_distanceLambda[i] += dLambda;
+    }
+}
+
+/* Bending constraints, C = angle(a, b, c) - rest. The gradient of the
+ * direction angle of an edge e with respect to its end is
+ * perp(e) / |e|^2, which gives the three gradients below.
+ */
+void SoftBodySystem2D::SolveBending(int begin, int end, float invH2)
+{
+    float* x = &m_x[0];
+    float* y = &m_y[0];
+    const float* w = &m_invMass[0];
+    for (int i = begin; i < end; i++) {
+        int a = m_bendingA[i];
+        int b = m_bendingB[i];
+        int c = m_bendingC[i];
+        vec2 e1(x[b] - x[a], y[b] - y[a]);
+        vec2 e2(x[c] - x[b], y[c] - y[b]);
+        float l1 = MagnitudeSqr(e1);
+        float l2 = MagnitudeSqr(e2);
+        if (l1 <= 0.0f || l2 <= 0.0f) {
+            continue;
+        }
+
+        float angle = atan2f(e1.x * e2.y - e1.y * e2.x, Dot(e1, e2));
+        float error = angle - m_bendingRest[i];
+        if (error > 3.14159265f) {
+            error -= 6.28318531f;
+        }
+        else if (error < -3.14159265f) {
+            error += 6.28318531f;
+        }
+
+        vec2 ga(-e1.y / l1, e1.x / l1);
+        vec2 gc(-e2.y / l2, e2.x / l2);
+        vec2 gb(-ga.x - gc.x, -ga.y - gc.y);
+        float alpha = m_bendingCompliance[i] * invH2;
+        float denominator = w[a] * MagnitudeSqr(ga) +
+                            w[b] * MagnitudeSqr(gb) +
+                            w[c] * MagnitudeSqr(gc) + alpha;
+        if (denominator <= 0.0f) {
+            continue;
+        }
+        float dLambda = (-error - alpha * m_bendingLambda[i]) / denominator;
+        x[a] += ga.x * (w[a] * dLambda);
+        y[a] += ga.y * (w[a] * dLambda);
+        x[b] += gb.x * (w[b] * dLambda);
+        y[b] += gb.y * (w[b] * dLambda);
+        x[c] += gc.x * (w[c] * dLambda);
+        y[c] += gc.y * (w[c] * dLambda);
+        m_bendingLambda[i] += dLambda;
+    }
+}
+
+/* Area constraint, C = area - rest. The gradient for a particle is half
+ * its neighbors' difference turned by 90 degrees. */
+void SoftBodySystem2D::SolveArea(int index, float invH2)
+{
+    float* x = &m_x[0];
+    float* y = &m_y[0];
+    const float* w = &m_invMass[0];
+    const int* ring = &m_areaParticles[m_areaStart[index]];
+    int count = m_areaStart[index + 1] - m_areaStart[index];
+
+    float error = RingArea(x, y, ring, count) - m_areaRest[index];
+    float alpha = m_areaCompliance[index] * invH2;
+    float denominator = alpha;
+    for (int i = 0; i < count; i++) {
+        int prev = ring[(i + count - 1) % count];
+        int next = ring[(i + 1) % count];
+        vec2 g(0.5f * (y[next] - y[prev]), 0.5f * (x[prev] - x[next]));
+        denominator += w[ring[i]] * MagnitudeSqr(g);
+    }
+    if (denominator <= 0.0f) {
+        return;
+    }
+    float dLambda = (-error - alpha * m_areaLambda[index]) / denominator;
+
+    // The gradients use the positions from before this solve
+    float firstX = x[ring[0]];
+    float firstY = y[ring[0]];
+    float prevX = x[ring[count - 1]];
+    float prevY = y[ring[count - 1]];
+    for (int i = 0; i < count; i++) {
+        int p = ring[i];
+        float nextX = (i + 1 < count) ? x[ring[i + 1]] : firstX;
+        float nextY = (i + 1 < count) ? y[ring[i + 1]] : firstY;
+        float px = x[p];
+        float py = y[p];
+        x[p] += 0.5f * (nextY - prevY) * (w[p] * dLambda);
+        y[p] += 0.5f * (prevX - nextX) * (w[p] * dLambda);
+        prevX = px;
+        prevY = py;
+    }
+    m_areaLambda[index] += dLambda;
+}
+
+/* Closest face of the box [min, max] to p, which is inside it */
+static vec2 ClosestFace(const vec2& p, const vec2& min, const vec2& max)
+{
+    vec2 result(min.x, p.y);
+    float best = p.x - min.x;
+    if (max.x - p.x < best) {
+        best = max.x - p.x;
+        result = vec2(max.x, p.y);
+    }
+    if (p.y - min.y < best) {
+        best = p.y - min.y;
+        result = vec2(p.x, min.y);
+    }
+    if (max.y - p.y < best) {
+        result = vec2(p.x, max.y);
+    }
+    return result;
+}
+
+static inline bool InsideBox(const vec2& p, const vec2& min,
+                             const vec2& max)
+{
+    return p.x > min.x && p.x < max.x && p.y > min.y && p.y < max.y;
+}
+
+void SoftBodySystem2D::Collide(int begin, int end)
+{
+    for (int i = begin; i < end; i++) {
+        if (m_invMass[i] == 0.0f) {
+            continue;
+        }
+        vec2 p(m_x[i], m_y[i]);
+        for (size_t c = 0; c < m_circles.size(); c++) {
+            const Circle& circle = m_circles[c];
+            vec2 d = p - circle.center;
+            float distSq = MagnitudeSqr(d);
+            if (distSq < circle.radius * circle.radius) {
+                float dist = sqrtf(distSq);
+                vec2 n = (dist > 0.0f) ? d * (1.0f / dist) : vec2(0.0f, 1.0f);
+                p = circle.center + n * circle.radius;
+            }
+        }
+        for (size_t c = 0; c < m_rectangles.size(); c++) {
+            vec2 min = GetMin(m_rectangles[c]);
+            vec2 max = GetMax(m_rectangles[c]);
+            if (InsideBox(p, min, max)) {
+                p = ClosestFace(p, min, max);
+            }
+        }
+        for (size_t c = 0; c < m_orientedRectangles.size(); c++) {
+            // Same frame as PointInOrientedRectangle
+            const OrientedCollider& o = m_orientedRectangles[c];
+            vec2 d = p - o.origin;
+            vec2 local(d.x * o.cos + d.y * o.sin, -d.x * o.sin + d.y * o.cos);
+            vec2 min(-o.halfExtents.x, -o.halfExtents.y);
+            if (InsideBox(local, min, o.halfExtents)) {
+                local = ClosestFace(local, min, o.halfExtents);
+                p = o.origin + vec2(local.x * o.cos - local.y * o.sin,
+                                    local.x * o.sin + local.y * o.cos);
+            }
+        }
+        m_x[i] = p.x;
+        m_y[i] = p.y;
+    }
+}
+
+void SoftBodySystem2D::Substep(float h)
+{
+    int count = ParticleCount();
+    float invH2 = 1.0f / (h * h);
+
+    ParallelFor(count, SOFT_BODY_GRAIN, [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            float moving = (m_invMass[i] > 0.0f) ? 1.0f : 0.0f;
+            m_vx[i] += m_gravity.x * h * moving;
+            m_vy[i] += m_gravity.y * h * moving;
+            m_prevX[i] = m_x[i];
+            m_prevY[i] = m_y[i];
+            m_x[i] += m_vx[i] * h;
+            m_y[i] += m_vy[i] * h;
+        }
+    });
+
+    std::fill(m_distanceLambda.begin(), m_distanceLambda.end(), 0.0f);
+    std::fill(m_bendingLambda.begin(), m_bendingLambda.end(), 0.0f);
+    std::fill(m_areaLambda.begin(), m_areaLambda.end(), 0.0f);
+
+    for (int c = 0; c < DistanceColorCount(); c++) {
+        int first = m_distanceColors[c];
+        ParallelFor(m_distanceColors[c + 1] - first, SOFT_BODY_GRAIN,
+                    [&](int begin, int end) {
+            SolveDistances(first + begin, first + end, invH2);
+        });
+    }
+    for (int c = 0; c < BendingColorCount(); c++) {
+        int first = m_bendingColors[c];
+        ParallelFor(m_bendingColors[c + 1] - first, SOFT_BODY_GRAIN,
+                    [&](int begin, int end) {
+            SolveBending(first + begin, first + end, invH2);
+        });
+    }
+    for (size_t i = 0; i < m_areaRest.size(); i++) {
+        SolveArea((int)i, invH2);
+    }
+
+    float keep = 1.0f - m_damping * h;
+    keep = (keep < 0.0f) ? 0.0f : keep;
+    float invH = 1.0f / h;
+    ParallelFor(count, SOFT_BODY_GRAIN, [&](int begin, int end) {
+        Collide(begin, end);
+        for (int i = begin; i < end; i++) {
+            m_vx[i] = (m_x[i] - m_prevX[i]) * invH * keep;
+            m_vy[i] = (m_y[i] - m_prevY[i]) * invH * keep;
+        }
+    });
+}
+
+void SoftBodySystem2D::Update(float dt)
+{
+    PROFILE_FUNCTION();
+    if (!m_prepared) {
+        Prepare();
+    }
+    int substeps = (m_substeps > 0) ? m_substeps : 1;
+    for (int s = 0; s < substeps; s++) {
+        Substep(dt / (float)substeps);
+    }
+}
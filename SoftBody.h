@@ -0,0 +1,135 @@
+#ifndef _H_SOFT_BODY_
+#define _H_SOFT_BODY_
+
+#include "Geometry2D.h"
+
+#include <stdint.h>
+#include <vector>
+
+/* Extended position based dynamics (XPBD) for ropes, cloth and soft
+ * bodies in 2D.
+ *
+ * Particles are tied together by constraints, each with a compliance
+ * (inverse stiffness, 0 is rigid):
+ * - distance constraints keep two particles at their initial distance,
+ * - bending constraints keep the angle a-b-c at its initial value,
+ * - area constraints keep the area of a closed counter clockwise ring of
+ *   particles at `pressure` times its initial area (the 2D "volume" of a
+ *   jelly body).
+ *
+ * Update() splits the step into substeps, each predicting positions from
+ * the velocities, solving every constraint once and deriving the new
+ * velocities from the change in position.
+ *
+ * Distance and bending constraints are graph colored the first time the
+ * solver runs after they change: no two constraints of a color share a
+ * particle, so each color is solved in parallel on the worker pool, and
+ * distance constraints WIDE_LANES at a time in SIMD (see Wide.h). Area
+ * constraints touch whole rings and are solved one after the other.
+ *
+ * Particles found inside a collider at the end of a substep are moved to
+ * the closest point of its surface.
+ */
+
+#define SOFT_BODY_MAX_COLORS 64
+
+class SoftBodySystem2D {
+public:
+    SoftBodySystem2D();
+
+    /* A mass of zero pins the particle */
+    int AddParticle(const Point2D& position, float mass);
+    void AddDistanceConstraint(int a, int b, float compliance = 0.0f);
+    void AddBendingConstraint(int a, int b, int c, float compliance = 0.0f);
+    void AddAreaConstraint(const int* particles, int count,
+                           float compliance = 0.0f, float pressure = 1.0f);
+
+    /* A grid of columns x rows particles starting at `origin`, row by row,
+     * with distance constraints between neighbors and bending constraints
+     * along rows and columns. Returns the index of the first particle. */
+    int AddCloth(const Point2D& origin, const vec2& size, int columns,
+                 int rows, float particleMass, float compliance,
+                 float bendingCompliance);
+
+    void AddCollider(const Circle& circle);
+    void AddCollider(const Rectangle2D& rect);
+    void AddCollider(const OrientedRectangle& rect);
+    void ClearColliders();
+
+    void SetGravity(const vec2& gravity) { m_gravity = gravity; }
+    void SetSubsteps(int substeps) { m_substeps = substeps; }
+    /* Fraction of the velocity lost per second */
+    void SetDamping(float damping) { m_damping = damping; }
+
+    void Update(float dt);
+
+    int ParticleCount() const { return (int)m_x.size(); }
+    Point2D GetPosition(int index) const;
+    vec2 GetVelocity(int index) const;
+    void SetPosition(int index, const Point2D& position);
+    /* Colors of the distance and bending constraints, after Update() */
+    int DistanceColorCount() const;
+    int BendingColorCount() const;
+
+private:
+    SoftBodySystem2D(const SoftBodySystem2D&);
+    SoftBodySystem2D& operator=(const SoftBodySystem2D&);
+
+    struct OrientedCollider {
+        Point2D origin;
+        vec2 halfExtents;
+        float cos;
+        float sin;
+    };
+
+    void Prepare();
+    void Substep(float h);
+    void SolveDistances(int begin, int end, float invH2);
+    void SolveBending(int begin, int end, float invH2);
+    void SolveArea(int index, float invH2);
+    void Collide(int begin, int end);
+
+    // Particles
+    std::vector<float> m_x;
+    std::vector<float> m_y;
+    std::vector<float> m_prevX;
+    std::vector<float> m_prevY;
+    std::vector<float> m_vx;
+    std::vector<float> m_vy;
+    std::vector<float> m_invMass;
+
+    // Distance constraints, sorted by color once prepared
+    std::vector<int> m_distanceA;
+    std::vector<int> m_distanceB;
+    std::vector<float> m_distanceRest;
+    std::vector<float> m_distanceCompliance;
+    std::vector<float> m_distanceLambda;
+    std::vector<int> m_distanceColors; // first constraint of each color
+
+    // Bending constraints, sorted by color once prepared
+    std::vector<int> m_bendingA;
+    std::vector<int> m_bendingB;
+    std::vector<int> m_bendingC;
+    std::vector<float> m_bendingRest;
+    std::vector<float> m_bendingCompliance;
+    std::vector<float> m_bendingLambda;
+    std::vector<int> m_bendingColors;
+
+    // Area constraints, ring i is m_areaParticles[m_areaStart[i]..[i + 1])
+    std::vector<int> m_areaParticles;
+    std::vector<int> m_areaStart;
+    std::vector<float> m_areaRest;
+    std::vector<float> m_areaCompliance;
+    std::vector<float> m_areaLambda;
+
+    std::vector<Circle> m_circles;
+    std::vector<Rectangle2D> m_rectangles;
+    std::vector<OrientedCollider> m_orientedRectangles;
+
+    vec2 m_gravity;
+    int m_substeps;
+    float m_damping;
+    bool m_prepared;
+};
+
+#endif
@@ -0,0 +1,661 @@
+#include "TriangleMesh.h"
+#include "Parallel.h"
+#include "Profiler.h"
+
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+// Ranges this large bin on the pool while the top of the tree is split
+#define BVH_PARALLEL_BIN_MIN (64 * 1024)
+#define BVH_BIN_GRAIN (16 * 1024)
+// Below this depth SAH gives way to median splits, which bounds the tree
+// depth (and so the traversal stacks) whatever the input
+#define BVH_SAH_MAX_DEPTH 32
+
+/* Build */
+
+typedef struct BuildBounds
+{
+    vec3 min;
+    vec3 max;
+    vec3 centroidMin;
+    vec3 centroidMax;
+} BuildBounds;
+
+typedef struct BuildBin
+{
+    vec3 min;
+    vec3 max;
+    int count;
+} BuildBin;
+
+typedef struct BuildBins
+{
+    BuildBin axis[3][BVH_BINS];
+} BuildBins;
+
+/* Nodes of the top of the tree and of every subtree. `left`/`right`
+ * index the same array, -1 for leaves; a top node with a `task` >= 0
+ * stands for the root of that subtree. */
+typedef struct BuildNode
+{
+    vec3 min;
+    vec3 max;
+    int left;
+    int right;
+    int begin;
+    int count;
+    int task;
+} BuildNode;
+
+typedef struct BuildTask
+{
+    int begin;
+    int end;
+    int depth;
+} BuildTask;
+
+typedef struct BuildContext
+{
+    std::vector<vec3> mins;
+    std::vector<vec3> maxs;
+    std::vector<vec3> centroids;
+    std::vector<int> indices;
+} BuildContext;
+
+static inline vec3 Min3(const vec3& a, const vec3& b)
+{
+    return vec3(fminf(a.x, b.x), fminf(a.y, b.y), fminf(a.z, b.z));
+}
+
+static inline vec3 Max3(const vec3& a, const vec3& b)
+{
+    return vec3(fmaxf(a.x, b.x), fmaxf(a.y, b.y), fmaxf(a.z, b.z));
+}
+
+static inline float HalfArea(const vec3& min, const vec3& max)
+{
+    vec3 d = max - min;
+    return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+static void ResetBounds(BuildBounds& b)
+{
+    b.min = b.centroidMin = vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+    b.max = b.centroidMax = vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+}
+
+static void MergeBounds(BuildBounds& into, const BuildBounds& b)
+{
+    into.min = Min3(into.min, b.min);
+    into.max = Max3(into.max, b.max);
+    into.centroidMin = Min3(into.centroidMin, b.centroidMin);
+    into.centroidMax = Max3(into.centroidMax, b.centroidMax);
+}
+
+static void ResetBins(BuildBins& bins)
+{
+    for (int a = 0; a < 3; a++) {
+        for (int i = 0; i < BVH_BINS; i++) {
+            bins.axis[a][i].min = vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+            bins.axis[a][i].max = vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+            bins.axis[a][i].count = 0;
+        }
+    }
+}
+
+static void MergeBins(BuildBins& into, const BuildBins& b)
+{
+    for (int a = 0; a < 3; a++) {
+        for (int i = 0; i < BVH_BINS; i++) {
+            BuildBin& bin = into.axis[a][i];
+            bin.min = Min3(bin.min, b.axis[a][i].min);
+            bin.max = Max3(bin.max, b.axis[a][i].max);
+            bin.count += b.axis[a][i].count;
+        }
+    }
+}
+
+static inline int BinIndex(float centroid, float min, float scale)
+{
+    int bin = (int)((centroid - min) * scale);
+    return bin < 0 ? 0 : (bin >= BVH_BINS ? BVH_BINS - 1 : bin);
+}
+
+static void ComputeBounds(const BuildContext& ctx, int begin, int end,
+                          BuildBounds& result)
+{
+    ResetBounds(result);
+    for (int i = begin; i < end; i++) {
+        int t = ctx.indices[i];
+        result.min = Min3(result.min, ctx.mins[t]);
+        result.max = Max3(result.max, ctx.maxs[t]);
+        result.centroidMin = Min3(result.centroidMin, ctx.centroids[t]);
+        result.centroidMax = Max3(result.centroidMax, ctx.centroids[t]);
+    }
+}
+
+static void ComputeBins(const BuildContext& ctx, int begin, int end,
+                        const BuildBounds& bounds, const vec3& binScale,
+                        BuildBins& result)
+{
+    ResetBins(result);
+    for (int i = begin; i < end; i++) {
+        int t = ctx.indices[i];
+        const vec3& c = ctx.centroids[t];
+        for (int a = 0; a < 3; a++) {
+            BuildBin& bin = result.axis[a][BinIndex(c.asArray[a],
+                    bounds.centroidMin.asArray[a], binScale.asArray[a])];
+            bin.min = Min3(bin.min, ctx.mins[t]);
+            bin.max = Max3(bin.max, ctx.maxs[t]);
+            bin.count++;
+        }
+    }
+}
+
+// Large ranges bin one chunk per pool task and merge the chunks after
+static void RangeBounds(const BuildContext& ctx, int begin, int end,
+                        BuildBounds& result)
+{
+    int count = end - begin;
+    if (count < BVH_PARALLEL_BIN_MIN) {
+        ComputeBounds(ctx, begin, end, result);
+        return;
+    }
+    // One task per chunk, so a ParallelFor that runs inline still fills
+    // every chunk
+    int chunkCount = (count + BVH_BIN_GRAIN - 1) / BVH_BIN_GRAIN;
+    std::vector<BuildBounds> chunks(chunkCount);
+    ParallelFor(chunkCount, 1, [&](int first, int last) {
+        for (int c = first; c < last; c++) {
+            ComputeBounds(ctx, begin + c * BVH_BIN_GRAIN,
+                          std::min(end, begin + (c + 1) * BVH_BIN_GRAIN),
+                          chunks[c]);
+        }
+    });
+    ResetBounds(result);
+    for (size_t i = 0; i < chunks.size(); i++) {
+        MergeBounds(result, chunks[i]);
+    }
+}
+
+static void RangeBins(const BuildContext& ctx, int begin, int end,
+                      const BuildBounds& bounds, const vec3& binScale,
+                      BuildBins& result)
+{
+    int count = end - begin;
+    if (count < BVH_PARALLEL_BIN_MIN) {
+        ComputeBins(ctx, begin, end, bounds, binScale, result);
+        return;
+    }
+    int chunkCount = (count + BVH_BIN_GRAIN - 1) / BVH_BIN_GRAIN;
+    std::vector<BuildBins> chunks(chunkCount);
+    ParallelFor(chunkCount, 1, [&](int first, int last) {
+        for (int c = first; c < last; c++) {
+            ComputeBins(ctx, begin + c * BVH_BIN_GRAIN,
+                        std::min(end, begin + (c + 1) * BVH_BIN_GRAIN),
+                        bounds, binScale, chunks[c]);
+        }
+    });
+    ResetBins(result);
+    for (size_t i = 0; i < chunks.size(); i++) {
+        MergeBins(result, chunks[i]);
+    }
+}
+
+/* Picks the split of [begin, end) and partitions the indices around it.
+ * Returns the first index of the right half, or -1 to make a leaf. */
+static int Partition(BuildContext& ctx, int begin, int end, int depth,
+                     const BuildBounds& bounds)
+{
+    int count = end - begin;
+    vec3 extent = bounds.centroidMax - bounds.centroidMin;
+    int longest = (extent.x >= extent.y && extent.x >= extent.z) ? 0 :
+                  (extent.y >= extent.z ? 1 : 2);
+
+    if (extent.asArray[longest] <= 0.0f) {
+        // Every centroid in one spot, no split can separate them
+        return count <= BVH_MAX_LEAF_TRIANGLES ? -1 : begin + count / 2;
+    }
+
+    if (depth < BVH_SAH_MAX_DEPTH) {
+        vec3 binScale;
+        for (int a = 0; a < 3; a++) {
+            binScale.asArray[a] = (extent.asArray[a] > 0.0f) ?
+                BVH_BINS / extent.asArray[a] : 0.0f;
+        }
+        BuildBins bins;
+        RangeBins(ctx, begin, end, bounds, binScale, bins);
+
+        // Sweep the bins from the right to get the suffix areas, then from
+        // the left to evaluate every split plane
+        float bestCost = FLT_MAX;
+        int bestAxis = -1;
+        int bestBin = 0;
+        for (int a = 0; a < 3; a++) {
+            if (extent.asArray[a] <= 0.0f) {
+                continue;
+            }
+            const BuildBin* axis = bins.axis[a];
+            float rightArea[BVH_BINS];
+            int rightCount[BVH_BINS];
+            vec3 min(FLT_MAX, FLT_MAX, FLT_MAX);
+            vec3 max(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+            int n = 0;
+            for (int i = BVH_BINS - 1; i > 0; i--) {
+                min = Min3(min, axis[i].min);
+                max = Max3(max, axis[i].max);
+                n += axis[i].count;
+                rightArea[i] = n ? HalfArea(min, max) : 0.0f;
+                rightCount[i] = n;
+            }
+            min = vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+            max = vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+            n = 0;
+            for (int i = 0; i < BVH_BINS - 1; i++) {
+                min = Min3(min, axis[i].min);
+                max = Max3(max, axis[i].max);
+                n += axis[i].count;
+                if (n == 0 || rightCount[i + 1] == 0) {
+                    continue;
+                }
+                float cost = HalfArea(min, max) * n +
+                    rightArea[i + 1] * rightCount[i + 1];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = a;
+                    bestBin = i;
+                }
+            }
+        }
+
+        // Traversal costs about as much as one triangle test
+        float area = HalfArea(bounds.min, bounds.max);
+        float leafCost = area * count;
+        float splitCost = area + bestCost;
+        if (count <= BVH_MAX_LEAF_TRIANGLES &&
+            (bestAxis < 0 || leafCost <= splitCost)) {
+            return -1;
+        }
+        if (bestAxis >= 0) {
+            float min = bounds.centroidMin.asArray[bestAxis];
+            float scale = binScale.asArray[bestAxis];
+            int* mid = std::partition(&ctx.indices[0] + begin,
+                                      &ctx.indices[0] + end,
+                                      [&](int t) {
+                return BinIndex(ctx.centroids[t].asArray[bestAxis], min,
+                                scale) <= bestBin;
+            });
+            int split = (int)(mid - &ctx.indices[0]);
+            if (split > begin && split < end) {
+                return split;
+            }
+        }
+    } else if (count <= BVH_MAX_LEAF_TRIANGLES) {
+        return -1;
+    }
+
+    // Median along the longest axis
+    int mid = begin + count / 2;
+    std::nth_element(&ctx.indices[0] + begin, &ctx.indices[0] + mid,
+                     &ctx.indices[0] + end, [&](int l, int r) {
+        return ctx.centroids[l].asArray[longest] <
+               ctx.centroids[r].asArray[longest];
+    });
+    return mid;
+}
+
+static int BuildRecursive(BuildContext& ctx, int begin, int end, int depth,
+                          int taskSize, std::vector<BuildNode>& nodes,
+                          std::vector<BuildTask>* tasks)
+{
+    // Hand ranges small enough to the subtree builders
+    if (tasks && end - begin <= taskSize) {
+        BuildNode node;
+        node.left = node.right = -1;
+        node.begin = begin;
+        node.count = end - begin;
+        node.task = (int)tasks->size();
+        BuildTask task = { begin, end, depth };
+        tasks->push_back(task);
+        nodes.push_back(node);
+        return (int)nodes.size() - 1;
+    }
+
+    BuildBounds bounds;
+    RangeBounds(ctx, begin, end, bounds);
+
+    int index = (int)nodes.size();
+    BuildNode node;
+    node.min = bounds.min;
+    node.max = bounds.max;
+    node.left = node.right = -1;
+    node.begin = begin;
+    node.count = end - begin;
+    node.task = -1;
+    nodes.push_back(node);
+
+    int split = Partition(ctx, begin, end, depth, bounds);
+    if (split >= 0) {
+        int left = BuildRecursive(ctx, begin, split, depth + 1, taskSize,
+                                  nodes, tasks);
+        int right = BuildRecursive(ctx, split, end, depth + 1, taskSize,
+                                   nodes, tasks);
+        nodes[index].left = left;
+        nodes[index].right = right;
+    }
+    return index;
+}
+
+/* TriangleMesh */
+
+TriangleMesh::TriangleMesh() :
+    m_scale(1.0f, 1.0f, 1.0f), m_invScale(1.0f, 1.0f, 1.0f)
+{
+}
+
+typedef struct FlattenContext
+{
+    const std::vector<std::vector<BuildNode> >* subtrees;
+    std::vector<BVHNode>* out;
+    vec3 meshMin;
+    vec3 invScale;
+} FlattenContext;
+
+static uint16_t QuantizeDown(float value, float min, float invScale)
+{
+    float q = floorf((value - min) * invScale) - 1.0f;
+    return (uint16_t)(q < 0.0f ? 0.0f : (q > 65535.0f ? 65535.0f : q));
+}
+
+static uint16_t QuantizeUp(float value, float min, float invScale)
+{
+    float q = ceilf((value - min) * invScale) + 1.0f;
+    return (uint16_t)(q < 0.0f ? 0.0f : (q > 65535.0f ? 65535.0f : q));
+}
+
+static void Flatten(FlattenContext& ctx, const std::vector<BuildNode>& nodes,
+                    int index)
+{
+    const BuildNode& node = nodes[index];
+    if (node.task >= 0) {
+        Flatten(ctx, (*ctx.subtrees)[node.task], 0);
+        return;
+    }
+
+    int out = (int)ctx.out->size();
+    BVHNode flat;
+    for (int a = 0; a < 3; a++) {
+        flat.min[a] = QuantizeDown(node.min.asArray[a],
+                                   ctx.meshMin.asArray[a],
+                                   ctx.invScale.asArray[a]);
+        flat.max[a] = QuantizeUp(node.max.asArray[a], ctx.meshMin.asArray[a],
+                                 ctx.invScale.asArray[a]);
+    }
+    if (node.left < 0) {
+        flat.data = BVH_LEAF_BIT |
+            ((uint32_t)node.begin << BVH_LEAF_COUNT_BITS) |
+            (uint32_t)node.count;
+        ctx.out->push_back(flat);
+        return;
+    }
+    ctx.out->push_back(flat);
+    Flatten(ctx, nodes, node.left);
+    (*ctx.out)[out].data = (uint32_t)ctx.out->size();
+    Flatten(ctx, nodes, node.right);
+}
+
+void TriangleMesh::Build(const Triangle* triangles, int count)
+{
+    PROFILE_FUNCTION();
+    m_triangles.clear();
+    m_triangleIds.clear();
+    m_nodes.clear();
+    m_min = m_max = vec3();
+    if (count <= 0) {
+        return;
+    }
+
+    BuildContext ctx;
+    ctx.mins.resize(count);
+    ctx.maxs.resize(count);
+    ctx.centroids.resize(count);
+    ctx.indices.resize(count);
+    ParallelFor(count, 4096, [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            const Triangle& t = triangles[i];
+            ctx.mins[i] = Min3(t.a, Min3(t.b, t.c));
+            ctx.maxs[i] = Max3(t.a, Max3(t.b, t.c));
+            ctx.centroids[i] = (ctx.mins[i] + ctx.maxs[i]) * 0.5f;
+            ctx.indices[i] = i;
+        }
+    });
+
+    // Split the top on this thread until there are a few ranges per
+    // thread, then build those subtrees in parallel
+    int taskSize = count / (ParallelThreadCount() * 4);
+    if (taskSize < 4096) {
+        taskSize = 4096;
+    }
+    std::vector<BuildNode> top;
+    std::vector<BuildTask> tasks;
+    BuildRecursive(ctx, 0, count, 0, taskSize, top, &tasks);
+
+    std::vector<std::vector<BuildNode> > subtrees(tasks.size());
+    ParallelFor((int)tasks.size(), 1, [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            BuildRecursive(ctx, tasks[i].begin, tasks[i].end, tasks[i].depth,
+                           0, subtrees[i], 0);
+        }
+    });
+
+    const BuildNode& root = (top[0].task >= 0) ?
+        subtrees[top[0].task][0] : top[0];
+    m_min = root.min;
+    m_max = root.max;
+    for (int a = 0; a < 3; a++) {
+        float extent = m_max.asArray[a] - m_min.asArray[a];
+        m_scale.asArray[a] = (extent > 0.0f) ? extent / 65535.0f : 1.0f;
+        m_invScale.asArray[a] = 1.0f / m_scale.asArray[a];
+    }
+
+    FlattenContext flatten;
+    flatten.subtrees = &subtrees;
+    flatten.out = &m_nodes;
+    flatten.meshMin = m_min;
+    flatten.invScale = m_invScale;
+    m_nodes.reserve(count / 2 + 1);
+    Flatten(flatten, top, 0);
+
+    m_triangles.resize(count);
+    m_triangleIds.resize(count);
+    ParallelFor(count, 4096, [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            m_triangles[i] = triangles[ctx.indices[i]];
+            m_triangleIds[i] = ctx.indices[i];
+        }
+    });
+}
+
+/* Queries */
+
+// Entry distance of the ray into the quantized box, or FLT_MAX on a miss
+static inline float SlabEntry(const BVHNode& node, const vec3& origin,
+                              const vec3& invDirection, float maxT)
+{
+    float tmin = 0.0f;
+    float tmax = maxT;
+    for (int a = 0; a < 3; a++) {
+        float t1 = ((float)node.min[a] - origin.asArray[a]) *
+            invDirection.asArray[a];
+        float t2 = ((float)node.max[a] - origin.asArray[a]) *
+            invDirection.asArray[a];
+        // fminf/fmaxf drop the NaN of a ray lying on a slab plane
+        tmin = fmaxf(tmin, fminf(t1, t2));
+        tmax = fminf(tmax, fmaxf(t1, t2));
+    }
+    return tmin <= tmax ? tmin : FLT_MAX;
+}
+
+bool TriangleMesh::Raycast(const Ray& ray, MeshHit* hit, float maxT) const
+{
+    PROFILE_FUNCTION();
+    if (m_nodes.empty()) {
+        return false;
+    }
+
+    // The quantization is an affine map per axis, so distances along the
+    // ray are the same in quantized and world space
+    vec3 origin = (ray.origin - m_min) * m_invScale;
+    vec3 direction = ray.direction * m_invScale;
+    vec3 invDirection(1.0f / direction.x, 1.0f / direction.y,
+                      1.0f / direction.z);
+
+    float best = maxT;
+    int bestTriangle = -1;
+    uint32_t stack[BVH_MAX_DEPTH];
+    int top = 0;
+    uint32_t index = 0;
+    if (SlabEntry(m_nodes[0], origin, invDirection, best) == FLT_MAX) {
+        return false;
+    }
+
+    for (;;) {
+        const BVHNode& node = m_nodes[index];
+        if (node.data & BVH_LEAF_BIT) {
+            uint32_t first = (node.data & ~BVH_LEAF_BIT) >> BVH_LEAF_COUNT_BITS;
+            uint32_t last = first + (node.data & BVH_LEAF_COUNT_MASK);
+            for (uint32_t i = first; i < last; i++) {
+                float t;
+                if (::Raycast(m_triangles[i], ray, &t) && t <= best) {
+                    best = t;
+                    bestTriangle = (int)i;
+                }
+            }
+        } else {
+            uint32_t left = index + 1;
+            uint32_t right = node.data;
+            float tl = SlabEntry(m_nodes[left], origin, invDirection, best);
+            float tr = SlabEntry(m_nodes[right], origin, invDirection, best);
+            if (tl != FLT_MAX && tr != FLT_MAX) {
+                // Nearer child first, the other may be culled by then
+                if (tr < tl) {
+                    std::swap(left, right);
+                }
+                stack[top++] = right;
+                index = left;
+                continue;
+            }
+            if (tl != FLT_MAX) {
+                index = left;
+                continue;
+            }
+            if (tr != FLT_MAX) {
+                index = right;
+                continue;
+            }
+        }
+
+        // Pop, skipping nodes the current best hit already beats
+        for (;;) {
+            if (top == 0) {
+                if (bestTriangle < 0) {
+                    return false;
+                }
+                const Triangle& triangle = m_triangles[bestTriangle];
+                vec3 normal = Normalized(Cross(triangle.b - triangle.a,
+                                               triangle.c - triangle.a));
+                if (Dot(normal, ray.direction) > 0.0f) {
+                    normal = normal * -1.0f;
+                }
+                if (hit) {
+                    hit->t = best;
+                    hit->point = ray.origin + ray.direction * best;
+                    hit->normal = normal;
+                    hit->triangle = m_triangleIds[bestTriangle];
+                }
+                return true;
+            }
+            index = stack[--top];
+            if (SlabEntry(m_nodes[index], origin, invDirection, best) !=
+                    FLT_MAX) {
+                break;
+            }
+        }
+    }
+}
+
+bool TriangleMesh::QuantizeBounds(const vec3& min, const vec3& max,
+                                  uint16_t qmin[3], uint16_t qmax[3]) const
+{
+    for (int a = 0; a < 3; a++) {
+        if (max.asArray[a] < m_min.asArray[a] ||
+            min.asArray[a] > m_max.asArray[a]) {
+            return false;
+        }
+        qmin[a] = QuantizeDown(min.asArray[a], m_min.asArray[a],
+                               m_invScale.asArray[a]);
+        qmax[a] = QuantizeUp(max.asArray[a], m_min.asArray[a],
+                             m_invScale.asArray[a]);
+    }
+    return true;
+}
+
+template<typename Test>
+void TriangleMesh::Overlap(const vec3& min, const vec3& max, const Test& test,
+                           ArenaVector<int>& result) const
+{
+    uint16_t qmin[3], qmax[3];
+    if (m_nodes.empty() || !QuantizeBounds(min, max, qmin, qmax)) {
+        return;
+    }
+
+    uint32_t stack[BVH_MAX_DEPTH];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const BVHNode& node = m_nodes[stack[--top]];
+        if (node.min[0] > qmax[0] || node.max[0] < qmin[0] ||
+            node.min[1] > qmax[1] || node.max[1] < qmin[1] ||
+            node.min[2] > qmax[2] || node.max[2] < qmin[2]) {
+            continue;
+        }
+        if (node.data & BVH_LEAF_BIT) {
+            uint32_t first = (node.data & ~BVH_LEAF_BIT) >> BVH_LEAF_COUNT_BITS;
+            uint32_t last = first + (node.data & BVH_LEAF_COUNT_MASK);
+            for (uint32_t i = first; i < last; i++) {
+                if (test(m_triangles[i])) {
+                    result.push_back(m_triangleIds[i]);
+                }
+            }
+        } else {
+            stack[top++] = node.data;
+            stack[top++] = (uint32_t)(&node - &m_nodes[0]) + 1;
+        }
+    }
+}
+
+ArenaVector<int> TriangleMesh::OverlapSphere(const Sphere& sphere,
+                                             FrameArena* arena) const
+{
+    PROFILE_FUNCTION();
+    ArenaVector<int> result((ArenaAllocator<int>(arena)));
+    vec3 extent(sphere.radius, sphere.radius, sphere.radius);
+    Overlap(sphere.position - extent, sphere.position + extent,
+            [&](const Triangle& triangle) {
+        return TriangleSphere(triangle, sphere);
+    }, result);
+    return result;
+}
+
+ArenaVector<int> TriangleMesh::OverlapAABB(const AABB& aabb,
+                                           FrameArena* arena) const
+{
+    PROFILE_FUNCTION();
+    ArenaVector<int> result((ArenaAllocator<int>(arena)));
+    Overlap(::GetMin(aabb), ::GetMax(aabb), [&](const Triangle& triangle) {
+        return TriangleAABB(triangle, aabb);
+    }, result);
+    return result;
+}
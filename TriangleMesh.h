@@ -0,0 +1,87 @@
+#ifndef _H_TRIANGLE_MESH_
+#define _H_TRIANGLE_MESH_
+
+#include "Geometry3D.h"
+#include "Memory.h"
+
+#include <stdint.h>
+#include <vector>
+
+/* Static triangle mesh (terrain, buildings) with a BVH for ray, sphere and
+ * box queries.
+ *
+ * Build() splits the triangles with a binned surface area heuristic. The
+ * top of the tree is split on the calling thread with the binning spread
+ * over the pool, then the subtrees below it are built in parallel. The
+ * finished tree is flattened depth first into 16 byte nodes whose bounds
+ * are quantized to 16 bits within the mesh bounds (rounded outwards), so
+ * four nodes share a cache line and a node's left child is the next one.
+ *
+ * The mesh keeps its own copy of the triangles, reordered so every leaf
+ * references a contiguous run. Queries report the index the triangle had
+ * in the array passed to Build().
+ */
+
+#define BVH_BINS 16
+#define BVH_MAX_LEAF_TRIANGLES 8
+#define BVH_MAX_DEPTH 64
+
+typedef struct BVHNode
+{
+    uint16_t min[3];
+    uint16_t max[3];
+    /* Leaves: BVH_LEAF_BIT, the first triangle above BVH_LEAF_COUNT_BITS
+     * and the triangle count below. Inner nodes: the right child, the
+     * left one directly follows the node. */
+    uint32_t data;
+} BVHNode;
+
+#define BVH_LEAF_BIT 0x80000000u
+#define BVH_LEAF_COUNT_BITS 4
+#define BVH_LEAF_COUNT_MASK ((1u << BVH_LEAF_COUNT_BITS) - 1u)
+
+typedef struct MeshHit
+{
+    float t;
+    Point3D point;
+    vec3 normal; // unit length, facing the ray origin
+    int triangle;
+} MeshHit;
+
+class TriangleMesh {
+public:
+    TriangleMesh();
+
+    void Build(const Triangle* triangles, int count);
+
+    /* Closest hit within `maxT` */
+    bool Raycast(const Ray& ray, MeshHit* hit, float maxT = 3.4e38f) const;
+
+    ArenaVector<int> OverlapSphere(const Sphere& sphere,
+                                   FrameArena* arena = 0) const;
+    ArenaVector<int> OverlapAABB(const AABB& aabb,
+                                 FrameArena* arena = 0) const;
+
+    int TriangleCount() const { return (int)m_triangles.size(); }
+    int NodeCount() const { return (int)m_nodes.size(); }
+    const BVHNode* Nodes() const { return m_nodes.empty() ? 0 : &m_nodes[0]; }
+    vec3 GetMin() const { return m_min; }
+    vec3 GetMax() const { return m_max; }
+
+private:
+    bool QuantizeBounds(const vec3& min, const vec3& max,
+                        uint16_t qmin[3], uint16_t qmax[3]) const;
+    template<typename Test>
+    void Overlap(const vec3& min, const vec3& max, const Test& test,
+                 ArenaVector<int>& result) const;
+
+    std::vector<Triangle> m_triangles;
+    std::vector<int> m_triangleIds;
+    std::vector<BVHNode> m_nodes;
+    vec3 m_min;
+    vec3 m_max;
+    vec3 m_scale;    // world units per quantization step
+    vec3 m_invScale;
+};
+
+#endif
@@ -0,0 +1,314 @@
+#include "Triggers.h"
+#include "Profiler.h"
+
+#include <math.h>
+
+static inline uint64_t PairKey(int trigger, int entity)
+{
+    return ((uint64_t)(uint32_t)trigger << 32) | (uint64_t)(uint32_t)entity;
+}
+
+static inline uint64_t CellKey(int x, int y)
+{
+    return ((uint64_t)(uint32_t)x << 32) | (uint64_t)(uint32_t)y;
+}
+
+/* Removes the first `value` from an unordered list */
+static inline void SwapRemove(std::vector<int>& list, int value)
+{
+    for (size_t i = 0; i < list.size(); i++) {
+        if (list[i] == value) {
+            list[i] = list.back();
+            list.pop_back();
+            return;
+        }
+    }
+}
+
+TriggerSystem2D::TriggerSystem2D(float cellSize) :
+    m_cellSize(cellSize > 0.0f ? cellSize : 1.0f)
+{
+}
+
+int TriggerSystem2D::Register(const Trigger& trigger)
+{
+    int index;
+    if (!m_freeTriggers.empty()) {
+        index = m_freeTriggers.back();
+        m_freeTriggers.pop_back();
+        m_triggers[index] = trigger;
+    }
+    else {
+        index = (int)m_triggers.size();
+        m_triggers.push_back(trigger);
+    }
+    m_triggers[index].alive = true;
+    m_triggers[index].fresh = true;
+    m_triggers[index].occupants.clear();
+    m_freshTriggers.push_back(index);
+    Insert(index);
+    return index;
+}
+
+int TriggerSystem2D::AddTrigger(const Circle& circle, uint32_t mask)
+{
+    PROFILE_FUNCTION();
+    Trigger trigger;
+    trigger.shape = TRIGGER_CIRCLE;
+    trigger.circle = circle;
+    vec2 extent(circle.radius, circle.radius);
+    trigger.bounds = FromMinMax(circle.center - extent,
+                                circle.center + extent);
+    trigger.mask = mask;
+    return Register(trigger);
+}
+
+int TriggerSystem2D::AddTrigger(const Rectangle2D& rect, uint32_t mask)
+{
+    PROFILE_FUNCTION();
+    Trigger trigger;
+    trigger.shape = TRIGGER_RECTANGLE;
+    trigger.rect = rect;
+    trigger.bounds = rect;
+    trigger.mask = mask;
+    return Register(trigger);
+}
+
+int TriggerSystem2D::AddTrigger(const OrientedRectangle& rect, uint32_t mask)
+{
+    PROFILE_FUNCTION();
+    Trigger trigger;
+    trigger.shape = TRIGGER_ORIENTED;
+    trigger.oriented = rect;
+    trigger.bounds = ContainingRectangle(rect);
+    trigger.mask = mask;
+    return Register(trigger);
+}
+
+void TriggerSystem2D::RemoveTrigger(int trigger)
+{
+    PROFILE_FUNCTION();
+    Trigger& t = m_triggers[trigger];
+    while (!t.occupants.empty()) {
+        int entity = t.occupants.back();
+        RemovePair(trigger, entity);
+        m_removed.push_back(TriggerEvent(trigger, entity, false));
+    }
+    Erase(trigger);
+    t.alive = false;
+    t.fresh = false;
+    m_freeTriggers.push_back(trigger);
+}
+
+int TriggerSystem2D::AddEntity(const Point2D& position, uint32_t layers)
+{
+    PROFILE_FUNCTION();
+    int index;
+    if (!m_freeEntities.empty()) {
+        index = m_freeEntities.back();
+        m_freeEntities.pop_back();
+    }
+    else {
+        index = (int)m_entities.size();
+        m_entities.push_back(Entity());
+    }
+    Entity& entity = m_entities[index];
+    entity.position = position;
+    entity.layers = layers;
+    entity.alive = true;
+    entity.dirty = false;
+    entity.triggers.clear();
+    MarkDirty(index);
+    return index;
+}
+
+void TriggerSystem2D::MoveEntity(int entity, const Point2D& position)
+{
+    m_entities[entity].position = position;
+    MarkDirty(entity);
+}
+
+void TriggerSystem2D::RemoveEntity(int entity)
+{
+    PROFILE_FUNCTION();
+    Entity& e = m_entities[entity];
+    while (!e.triggers.empty()) {
+        int trigger = e.triggers.back();
+        RemovePair(trigger, entity);
+        m_removed.push_back(TriggerEvent(trigger, entity, false));
+    }
+    e.alive = false;
+    e.dirty = false;
+    m_freeEntities.push_back(entity);
+}
+
+void TriggerSystem2D::MarkDirty(int entity)
+{
+    if (!m_entities[entity].dirty) {
+        m_entities[entity].dirty = true;
+        m_dirtyEntities.push_back(entity);
+    }
+}
+
+bool TriggerSystem2D::Contains(const Trigger& trigger,
+                               const Entity& entity) const
+{
+    if ((trigger.mask & entity.layers) == 0) {
+        return false;
+    }
+    if (trigger.shape == TRIGGER_CIRCLE) {
+        return PointInCircle(entity.position, trigger.circle);
+    }
+    if (trigger.shape == TRIGGER_RECTANGLE) {
+        return PointInRectangle2D(entity.position, trigger.rect);
+    }
+    return PointInOrientedRectangle(entity.position, trigger.oriented);
+}
+
+void TriggerSystem2D::AddPair(int trigger, int entity)
+{
+    std::vector<int>& occupants = m_triggers[trigger].occupants;
+    m_pairs[PairKey(trigger, entity)] = (int)occupants.size();
+    occupants.push_back(entity);
+    m_entities[entity].triggers.push_back(trigger);
+}
+
+void TriggerSystem2D::RemovePair(int trigger, int entity)
+{
+    std::unordered_map<uint64_t, int>::iterator it =
+            m_pairs.find(PairKey(trigger, entity));
+    if (it == m_pairs.end()) {
+        return;
+    }
+    std::vector<int>& occupants = m_triggers[trigger].occupants;
+    int slot = it->second;
+    m_pairs.erase(it);
+    int last = occupants.back();
+    occupants.pop_back();
+    if (last != entity) {
+        occupants[slot] = last;
+        m_pairs[PairKey(trigger, last)] = slot;
+    }
+    SwapRemove(m_entities[entity].triggers, trigger);
+}
+
+/* The grid cells overlapped by a trigger's bounds each list it */
+void TriggerSystem2D::Insert(int trigger)
+{
+    vec2 min = GetMin(m_triggers[trigger].bounds);
+    vec2 max = GetMax(m_triggers[trigger].bounds);
+    float invCellSize = 1.0f / m_cellSize;
+    int x0 = (int)floorf(min.x * invCellSize);
+    int y0 = (int)floorf(min.y * invCellSize);
+    int x1 = (int)floorf(max.x * invCellSize);
+    int y1 = (int)floorf(max.y * invCellSize);
+    for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) {
+            m_cells[CellKey(x, y)].push_back(trigger);
+        }
+    }
+}
+
+void TriggerSystem2D::Erase(int trigger)
+{
+    vec2 min = GetMin(m_triggers[trigger].bounds);
+    vec2 max = GetMax(m_triggers[trigger].bounds);
+    float invCellSize = 1.0f / m_cellSize;
+    int x0 = (int)floorf(min.x * invCellSize);
+    int y0 = (int)floorf(min.y * invCellSize);
+    int x1 = (int)floorf(max.x * invCellSize);
+    int y1 = (int)floorf(max.y * invCellSize);
+    for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) {
+            std::unordered_map<uint64_t, std::vector<int> >::iterator it =
+                    m_cells.find(CellKey(x, y));
+            if (it == m_cells.end()) {
+                continue;
+            }
+            SwapRemove(it->second, trigger);
+            if (it->second.empty()) {
+                m_cells.erase(it);
+            }
+        }
+    }
+}
+
+void TriggerSystem2D::Update()
+{
+    PROFILE_FUNCTION();
+    m_events.clear();
+    m_events.swap(m_removed);
+
+    // New triggers against the entities that stayed put. The moved ones
+    // find them in the grid below.
+    for (size_t i = 0; i < m_freshTriggers.size(); i++) {
+        int trigger = m_freshTriggers[i];
+        Trigger& t = m_triggers[trigger];
+        if (!t.fresh) {
+            continue;
+        }
+        t.fresh = false;
+        for (size_t e = 0; e < m_entities.size(); e++) {
+            const Entity& entity = m_entities[e];
+            if (entity.alive && !entity.dirty && Contains(t, entity)) {
+                AddPair(trigger, (int)e);
+                m_events.push_back(TriggerEvent(trigger, (int)e, true));
+            }
+        }
+    }
+    m_freshTriggers.clear();
+
+    float invCellSize = 1.0f / m_cellSize;
+    std::vector<int> inside;
+    for (size_t i = 0; i < m_dirtyEntities.size(); i++) {
+        int entity = m_dirtyEntities[i];
+        Entity& e = m_entities[entity];
+        if (!e.dirty) {
+            continue; // removed since it moved
+        }
+        e.dirty = false;
+
+        inside.clear();
+        std::unordered_map<uint64_t, std::vector<int> >::const_iterator it =
+                m_cells.find(CellKey((int)floorf(e.position.x * invCellSize),
+                                     (int)floorf(e.position.y * invCellSize)));
+        if (it != m_cells.end()) {
+            const std::vector<int>& candidates = it->second;
+            for (size_t c = 0; c < candidates.size(); c++) {
+                if (Contains(m_triggers[candidates[c]], e)) {
+                    inside.push_back(candidates[c]);
+                }
+            }
+        }
+
+        // Exits first, then enters
+        for (size_t k = e.triggers.size(); k-- > 0;) {
+            int trigger = e.triggers[k];
+            bool still = false;
+            for (size_t n = 0; n < inside.size() && !still; n++) {
+                still = inside[n] == trigger;
+            }
+            if (!still) {
+                RemovePair(trigger, entity);
+                m_events.push_back(TriggerEvent(trigger, entity, false));
+            }
+        }
+        for (size_t n = 0; n < inside.size(); n++) {
+            if (m_pairs.find(PairKey(inside[n], entity)) == m_pairs.end()) {
+                AddPair(inside[n], entity);
+                m_events.push_back(TriggerEvent(inside[n], entity, true));
+            }
+        }
+    }
+    m_dirtyEntities.clear();
+}
+
+bool TriggerSystem2D::IsInside(int trigger, int entity) const
+{
+    return m_pairs.find(PairKey(trigger, entity)) != m_pairs.end();
+}
+
+const std::vector<int>& TriggerSystem2D::Occupants(int trigger) const
+{
+    return m_triggers[trigger].occupants;
+}
@@ -0,0 +1,126 @@
+#ifndef _H_TRIGGERS_
+#define _H_TRIGGERS_
+
+#include "Geometry2D.h"
+
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+/* Trigger volumes ("zones") and the point entities inside them.
+ *
+ * The system keeps the set of (trigger, entity) pairs currently
+ * overlapping in a hash map and only reports changes to it: Update()
+ * fills Events() with one enter or exit event per pair that appeared or
+ * disappeared since the last Update(). A pair staying inside produces no
+ * event; IsInside() and Occupants() answer from the pair set.
+ *
+ * Only entities moved, added or removed since the last Update() are
+ * tested, against the triggers registered in the uniform grid cell under
+ * them. A trigger reacts to the entities whose layer bits intersect its
+ * mask, and the mask is checked before any PointInCircle(),
+ * PointInRectangle2D() or PointInOrientedRectangle() test. A new trigger
+ * is tested once against every entity at the next Update(); removing an
+ * entity or trigger reports the exits of its pairs at the next Update().
+ *
+ * Trigger and entity indices of removed objects are reused.
+ */
+
+#define TRIGGER_ALL_LAYERS 0xffffffffu
+
+typedef struct TriggerEvent
+{
+    int trigger;
+    int entity;
+    bool entered; // false for an exit
+
+    inline TriggerEvent() : trigger(-1), entity(-1), entered(false) {}
+    inline TriggerEvent(int _trigger, int _entity, bool _entered) :
+        trigger(_trigger), entity(_entity), entered(_entered) {}
+} TriggerEvent;
+
+class TriggerSystem2D {
+public:
+    explicit TriggerSystem2D(float cellSize = 32.0f);
+
+    /* Each returns the index of the new trigger */
+    int AddTrigger(const Circle& circle, uint32_t mask = TRIGGER_ALL_LAYERS);
+    int AddTrigger(const Rectangle2D& rect,
+                   uint32_t mask = TRIGGER_ALL_LAYERS);
+    int AddTrigger(const OrientedRectangle& rect,
+                   uint32_t mask = TRIGGER_ALL_LAYERS);
+    void RemoveTrigger(int trigger);
+
+    int AddEntity(const Point2D& position, uint32_t layers = 1);
+    void MoveEntity(int entity, const Point2D& position);
+    void RemoveEntity(int entity);
+
+    void Update();
+    /* Enter and exit events of the last Update() */
+    const std::vector<TriggerEvent>& Events() const { return m_events; }
+
+    bool IsInside(int trigger, int entity) const;
+    /* Entities inside a trigger, in no particular order */
+    const std::vector<int>& Occupants(int trigger) const;
+    int PairCount() const { return (int)m_pairs.size(); }
+
+private:
+    TriggerSystem2D(const TriggerSystem2D&);
+    TriggerSystem2D& operator=(const TriggerSystem2D&);
+
+    enum TriggerShape {
+        TRIGGER_CIRCLE,
+        TRIGGER_RECTANGLE,
+        TRIGGER_ORIENTED
+    };
+
+    struct Trigger {
+        int shape;
+        Circle circle;
+        Rectangle2D rect;
+        OrientedRectangle oriented;
+        Rectangle2D bounds;
+        uint32_t mask;
+        bool alive;
+        bool fresh; // not yet tested against the entities
+        std::vector<int> occupants;
+
+        inline Trigger() :
+            shape(TRIGGER_CIRCLE), mask(0), alive(false), fresh(false) {}
+    };
+
+    struct Entity {
+        Point2D position;
+        uint32_t layers;
+        bool alive;
+        bool dirty; // moved since the last Update()
+        std::vector<int> triggers; // the triggers it is inside
+
+        inline Entity() : layers(0), alive(false), dirty(false) {}
+    };
+
+    int Register(const Trigger& trigger);
+    bool Contains(const Trigger& trigger, const Entity& entity) const;
+    void AddPair(int trigger, int entity);
+    void RemovePair(int trigger, int entity);
+    void Insert(int trigger);
+    void Erase(int trigger);
+    void MarkDirty(int entity);
+
+    std::vector<Trigger> m_triggers;
+    std::vector<Entity> m_entities;
+    std::vector<int> m_freeTriggers;
+    std::vector<int> m_freeEntities;
+    std::vector<int> m_freshTriggers;
+    std::vector<int> m_dirtyEntities;
+
+    // Pair (trigger, entity) -> its index in the trigger's occupants
+    std::unordered_map<uint64_t, int> m_pairs;
+    std::unordered_map<uint64_t, std::vector<int> > m_cells;
+    float m_cellSize;
+
+    std::vector<TriggerEvent> m_events;
+    std::vector<TriggerEvent> m_removed; // exits waiting for Update()
+};
+
+#endif
@@ -0,0 +1,754 @@
+#ifndef _H_WIDE_
+#define _H_WIDE_
+
+#include "vectors.h"
+#include "matrices.h"
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+/* Wide math types for writing SIMD kernels with ordinary looking code.
+ *
+ * floatw holds WIDE_LANES floats: 8 with AVX, 4 with SSE2 and 4 plain
+ * floats otherwise. vec2w, vec3w, mat3w and mat4w are the vectors.h and
+ * matrices.h types with a floatw per component (SoA inside a register),
+ * so one call does the math for WIDE_LANES elements at once. Comparisons
+ * return a maskw; Select(mask, a, b) picks per lane instead of branching.
+ *
+ * LoadWide/StoreWide move WIDE_LANES elements between arrays of the usual
+ * types and the wide types, with a count for the tail of an array. Data
+ * that is processed every tick is better kept in an AoSoA container,
+ * whose blocks already hold WIDE_LANES of each component side by side.
+ *
+ *     for (int b = 0; b < positions.BlockCount(); b++) {
+ *         vec3w p = positions.Load(b) + velocities.Load(b) * dt;
+ *         positions.Store(b, Select(p.y < 0.0f, Reflection(p, up), p));
+ *     }
+ *
+ * Everything is inline, the wrappers compile down to the raw intrinsics.
+ */
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define WIDE_LANES 8
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define WIDE_LANES 4
+#else
+#define WIDE_LANES 4
+#endif
+
+typedef struct floatw
+{
+#if defined(__AVX__)
+    __m256 v;
+    inline floatw() : v(_mm256_setzero_ps()) {}
+    inline floatw(float s) : v(_mm256_set1_ps(s)) {}
+    inline explicit floatw(__m256 _v) : v(_v) {}
+#elif defined(__SSE2__)
+    __m128 v;
+    inline floatw() : v(_mm_setzero_ps()) {}
+    inline floatw(float s) : v(_mm_set1_ps(s)) {}
+    inline explicit floatw(__m128 _v) : v(_v) {}
+#else
+    float v[WIDE_LANES];
+    inline floatw()
+    {
+        for (int i = 0; i < WIDE_LANES; i++) { v[i] = 0.0f; }
+    }
+    inline floatw(float s)
+    {
+        for (int i = 0; i < WIDE_LANES; i++) { v[i] = s; }
+    }
+#endif
+} floatw;
+
+/* All bits set in a lane means true */
+typedef struct maskw
+{
+#if defined(__AVX__)
+    __m256 v;
+    inline explicit maskw(__m256 _v) : v(_v) {}
+#elif defined(__SSE2__)
+    __m128 v;
+    inline explicit maskw(__m128 _v) : v(_v) {}
+#else
+    bool v[WIDE_LANES];
+#endif
+    inline maskw() { *this = maskw(false); }
+    inline explicit maskw(bool b);
+} maskw;
+
+/* Backend primitives */
+
+#if defined(__AVX__)
+
+inline maskw::maskw(bool b) :
+    v(b ? _mm256_castsi256_ps(_mm256_set1_epi32(-1)) : _mm256_setzero_ps()) {}
+
+inline floatw LoadWide(const float* p) { return floatw(_mm256_loadu_ps(p)); }
+inline void StoreWide(float* p, const floatw& a) { _mm256_storeu_ps(p, a.v); }
+
+inline floatw operator+(const floatw& l, const floatw& r)
+{
+    return floatw(_mm256_add_ps(l.v, r.v));
+}
+inline floatw operator-(const floatw& l, const floatw& r)
+{
+    return floatw(_mm256_sub_ps(l.v, r.v));
+}
+inline floatw operator*(const floatw& l, const floatw& r)
+{
+    return floatw(_mm256_mul_ps(l.v, r.v));
+}
+inline floatw operator/(const floatw& l, const floatw& r)
+{
+    return floatw(_mm256_div_ps(l.v, r.v));
+}
+inline floatw Sqrt(const floatw& a) { return floatw(_mm256_sqrt_ps(a.v)); }
+inline floatw Min(const floatw& l, const floatw& r)
+{
+    return floatw(_mm256_min_ps(l.v, r.v));
+}
+inline floatw Max(const floatw& l, const floatw& r)
+{
+    return floatw(_mm256_max_ps(l.v, r.v));
+}
+inline floatw Abs(const floatw& a)
+{
+    return floatw(_mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v));
+}
+
+inline maskw operator<(const floatw& l, const floatw& r)
+{
+    return maskw(_mm256_cmp_ps(l.v, r.v, _CMP_LT_OQ));
+}
+inline maskw operator<=(const floatw& l, const floatw& r)
+{
+    return maskw(_mm256_cmp_ps(l.v, r.v, _CMP_LE_OQ));
+}
+inline maskw operator>(const floatw& l, const floatw& r)
+{
+    return maskw(_mm256_cmp_ps(l.v, r.v, _CMP_GT_OQ));
+}
+inline maskw operator>=(const floatw& l, const floatw& r)
+{
+    return maskw(_mm256_cmp_ps(l.v, r.v, _CMP_GE_OQ));
+}
+inline maskw operator==(const floatw& l, const floatw& r)
+{
+    return maskw(_mm256_cmp_ps(l.v, r.v, _CMP_EQ_OQ));
+}
+inline maskw operator!=(const floatw& l, const floatw& r)
+{
+    return maskw(_mm256_cmp_ps(l.v, r.v, _CMP_NEQ_UQ));
+}
+
+inline maskw operator&(const maskw& l, const maskw& r)
+{
+    return maskw(_mm256_and_ps(l.v, r.v));
+}
+inline maskw operator|(const maskw& l, const maskw& r)
+{
+    return maskw(_mm256_or_ps(l.v, r.v));
+}
+inline maskw operator!(const maskw& m)
+{
+    return maskw(_mm256_xor_ps(m.v, maskw(true).v));
+}
+/* Bit i is set when lane i is */
+inline int MaskBits(const maskw& m) { return _mm256_movemask_ps(m.v); }
+
+inline floatw Select(const maskw& m, const floatw& a, const floatw& b)
+{
+    return floatw(_mm256_blendv_ps(b.v, a.v, m.v));
+}
+
+#elif defined(__SSE2__)
+
+inline maskw::maskw(bool b) :
+    v(b ? _mm_castsi128_ps(_mm_set1_epi32(-1)) : _mm_setzero_ps()) {}
+
+inline floatw LoadWide(const float* p) { return floatw(_mm_loadu_ps(p)); }
+inline void StoreWide(float* p, const floatw& a) { _mm_storeu_ps(p, a.v); }
+
+inline floatw operator+(const floatw& l, const floatw& r)
+{
+    return floatw(_mm_add_ps(l.v, r.v));
+}
+inline floatw operator-(const floatw& l, const floatw& r)
+{
+    return floatw(_mm_sub_ps(l.v, r.v));
+}
+inline floatw operator*(const floatw& l, const floatw& r)
+{
+    return floatw(_mm_mul_ps(l.v, r.v));
+}
+inline floatw operator/(const floatw& l, const floatw& r)
+{
+    return floatw(_mm_div_ps(l.v, r.v));
+}
+inline floatw Sqrt(const floatw& a) { return floatw(_mm_sqrt_ps(a.v)); }
+inline floatw Min(const floatw& l, const floatw& r)
+{
+    return floatw(_mm_min_ps(l.v, r.v));
+}
+inline floatw Max(const floatw& l, const floatw& r)
+{
+    return floatw(_mm_max_ps(l.v, r.v));
+}
+inline floatw Abs(const floatw& a)
+{
+    return floatw(_mm_andnot_ps(_mm_set1_ps(-0.0f), a.v));
+}
+
+inline maskw operator<(const floatw& l, const floatw& r)
+{
+    return maskw(_mm_cmplt_ps(l.v, r.v));
+}
+inline maskw operator<=(const floatw& l, const floatw& r)
+{
+    return maskw(_mm_cmple_ps(l.v, r.v));
+}
+inline maskw operator>(const floatw& l, const floatw& r)
+{
+    return maskw(_mm_cmpgt_ps(l.v, r.v));
+}
+inline maskw operator>=(const floatw& l, const floatw& r)
+{
+    return maskw(_mm_cmpge_ps(l.v, r.v));
+}
+inline maskw operator==(const floatw& l, const floatw& r)
+{
+    return maskw(_mm_cmpeq_ps(l.v, r.v));
+}
+inline maskw operator!=(const floatw& l, const floatw& r)
+{
+    return maskw(_mm_cmpneq_ps(l.v, r.v));
+}
+
+inline maskw operator&(const maskw& l, const maskw& r)
+{
+    return maskw(_mm_and_ps(l.v, r.v));
+}
+inline maskw operator|(const maskw& l, const maskw& r)
+{
+    return maskw(_mm_or_ps(l.v, r.v));
+}
+inline maskw operator!(const maskw& m)
+{
+    return maskw(_mm_xor_ps(m.v, maskw(true).v));
+}
+/* Bit i is set when lane i is */
+inline int MaskBits(const maskw& m) { return _mm_movemask_ps(m.v); }
+
+inline floatw Select(const maskw& m, const floatw& a, const floatw& b)
+{
+    return floatw(_mm_or_ps(_mm_and_ps(m.v, a.v), _mm_andnot_ps(m.v, b.v)));
+}
+
+#else
+
+inline maskw::maskw(bool b)
+{
+    for (int i = 0; i < WIDE_LANES; i++) { v[i] = b; }
+}
+
+inline floatw LoadWide(const float* p)
+{
+    floatw result;
+    memcpy(result.v, p, sizeof(result.v));
+    return result;
+}
+inline void StoreWide(float* p, const floatw& a)
+{
+    memcpy(p, a.v, sizeof(a.v));
+}
+
+#define WIDE_LANEWISE(type, expr) \
+    type result; \
+    for (int i = 0; i < WIDE_LANES; i++) { result.v[i] = (expr); } \
+    return result;
+
+inline floatw operator+(const floatw& l, const floatw& r)
+{
+    WIDE_LANEWISE(floatw, l.v[i] + r.v[i])
+}
+inline floatw operator-(const floatw& l, const floatw& r)
+{
+    WIDE_LANEWISE(floatw, l.v[i] - r.v[i])
+}
+inline floatw operator*(const floatw& l, const floatw& r)
+{
+    WIDE_LANEWISE(floatw, l.v[i] * r.v[i])
+}
+inline floatw operator/(const floatw& l, const floatw& r)
+{
+    WIDE_LANEWISE(floatw, l.v[i] / r.v[i])
+}
+inline floatw Sqrt(const floatw& a) { WIDE_LANEWISE(floatw, sqrtf(a.v[i])) }
+inline floatw Min(const floatw& l, const floatw& r)
+{
+    WIDE_LANEWISE(floatw, l.v[i] < r.v[i] ? l.v[i] : r.v[i])
+}
+inline floatw Max(const floatw& l, const floatw& r)
+{
+    WIDE_LANEWISE(floatw, l.v[i] > r.v[i] ? l.v[i] : r.v[i])
+}
+inline floatw Abs(const floatw& a) { WIDE_LANEWISE(floatw, fabsf(a.v[i])) }
+
+inline maskw operator<(const floatw& l, const floatw& r)
+{
+    WIDE_LANEWISE(maskw, l.v[i] < r.v[i])
+}
+inline maskw operator<=(const floatw& l, const floatw& r)
+{
+    WIDE_LANEWISE(maskw, l.v[i] <= r.v[i])
+}
+inline maskw operator>(const floatw& l, const floatw& r)
+{
+    WIDE_LANEWISE(maskw, l.v[i] > r.v[i])
+}
+inline maskw operator>=(const floatw& l, const floatw& r)
+{
+    WIDE_LANEWISE(maskw, l.v[i] >= r.v[i])
+}
+inline maskw operator==(const floatw& l, const floatw& r)
+{
+    WIDE_LANEWISE(maskw, l.v[i] == r.v[i])
+}
+inline maskw operator!=(const floatw& l, const floatw& r)
+{
+    WIDE_LANEWISE(maskw, l.v[i] != r.v[i])
+}
+
+inline maskw operator&(const maskw& l, const maskw& r)
+{
+    WIDE_LANEWISE(maskw, l.v[i] && r.v[i])
+}
+inline maskw operator|(const maskw& l, const maskw& r)
+{
+    WIDE_LANEWISE(maskw, l.v[i] || r.v[i])
+}
+inline maskw operator!(const maskw& m) { WIDE_LANEWISE(maskw, !m.v[i]) }
+inline int MaskBits(const maskw& m)
+{
+    int bits = 0;
+    for (int i = 0; i < WIDE_LANES; i++) { bits |= (m.v[i] ? 1 : 0) << i; }
+    return bits;
+}
+
+inline floatw Select(const maskw& m, const floatw& a, const floatw& b)
+{
+    WIDE_LANEWISE(floatw, m.v[i] ? a.v[i] : b.v[i])
+}
+
+#undef WIDE_LANEWISE
+
+#endif
+
+/* Lane helpers, built on the primitives */
+
+inline floatw operator-(const floatw& a) { return floatw(0.0f) - a; }
+inline bool Any(const maskw& m) { return MaskBits(m) != 0; }
+inline bool All(const maskw& m)
+{
+    return MaskBits(m) == (1 << WIDE_LANES) - 1;
+}
+
+inline float Lane(const floatw& a, int i)
+{
+    float lanes[WIDE_LANES];
+    StoreWide(lanes, a);
+    return lanes[i];
+}
+
+inline float ReduceAdd(const floatw& a)
+{
+    float lanes[WIDE_LANES];
+    StoreWide(lanes, a);
+    float sum = 0.0f;
+    for (int i = 0; i < WIDE_LANES; i++) {
+        sum += lanes[i];
+    }
+    return sum;
+}
+
+/* Wide vectors and matrices */
+
+typedef struct vec2w
+{
+    floatw x;
+    floatw y;
+
+    inline vec2w() {}
+    inline vec2w(const floatw& _x, const floatw& _y) : x(_x), y(_y) {}
+    /* The same vector in every lane */
+    inline explicit vec2w(const vec2& v) : x(v.x), y(v.y) {}
+} vec2w;
+
+typedef struct vec3w
+{
+    floatw x;
+    floatw y;
+    floatw z;
+
+    inline vec3w() {}
+    inline vec3w(const floatw& _x, const floatw& _y, const floatw& _z) :
+        x(_x), y(_y), z(_z) {}
+    inline explicit vec3w(const vec3& v) : x(v.x), y(v.y), z(v.z) {}
+} vec3w;
+
+typedef struct mat3w
+{
+    floatw asArray[9];
+
+    inline floatw* operator[](int i) { return &(asArray[i * 3]); }
+    inline const floatw* operator[](int i) const
+    {
+        return &(asArray[i * 3]);
+    }
+
+    inline mat3w() { *this = mat3w(mat3()); }
+    inline explicit mat3w(const mat3& m)
+    {
+        for (int i = 0; i < 9; i++) { asArray[i] = floatw(m.asArray[i]); }
+    }
+} mat3w;
+
+typedef struct mat4w
+{
+    floatw asArray[16];
+
+    inline floatw* operator[](int i) { return &(asArray[i * 4]); }
+    inline const floatw* operator[](int i) const
+    {
+        return &(asArray[i * 4]);
+    }
+
+    inline mat4w() { *this = mat4w(mat4()); }
+    inline explicit mat4w(const mat4& m)
+    {
+        for (int i = 0; i < 16; i++) { asArray[i] = floatw(m.asArray[i]); }
+    }
+} mat4w;
+
+inline vec2w operator+(const vec2w& l, const vec2w& r)
+{
+    return vec2w(l.x + r.x, l.y + r.y);
+}
+inline vec2w operator-(const vec2w& l, const vec2w& r)
+{
+    return vec2w(l.x - r.x, l.y - r.y);
+}
+inline vec2w operator*(const vec2w& l, const vec2w& r)
+{
+    return vec2w(l.x * r.x, l.y * r.y);
+}
+inline vec2w operator*(const vec2w& l, const floatw& r)
+{
+    return vec2w(l.x * r, l.y * r);
+}
+
+inline vec3w operator+(const vec3w& l, const vec3w& r)
+{
+    return vec3w(l.x + r.x, l.y + r.y, l.z + r.z);
+}
+inline vec3w operator-(const vec3w& l, const vec3w& r)
+{
+    return vec3w(l.x - r.x, l.y - r.y, l.z - r.z);
+}
+inline vec3w operator*(const vec3w& l, const vec3w& r)
+{
+    return vec3w(l.x * r.x, l.y * r.y, l.z * r.z);
+}
+inline vec3w operator*(const vec3w& l, const floatw& r)
+{
+    return vec3w(l.x * r, l.y * r, l.z * r);
+}
+
+inline floatw Dot(const vec2w& l, const vec2w& r)
+{
+    return l.x * r.x + l.y * r.y;
+}
+inline floatw Dot(const vec3w& l, const vec3w& r)
+{
+    return l.x * r.x + l.y * r.y + l.z * r.z;
+}
+
+inline floatw MagnitudeSqr(const vec2w& v) { return Dot(v, v); }
+inline floatw MagnitudeSqr(const vec3w& v) { return Dot(v, v); }
+inline floatw Magnitude(const vec2w& v) { return Sqrt(Dot(v, v)); }
+inline floatw Magnitude(const vec3w& v) { return Sqrt(Dot(v, v)); }
+
+inline floatw Distance(const vec2w& p1, const vec2w& p2)
+{
+    return Magnitude(p1 - p2);
+}
+inline floatw Distance(const vec3w& p1, const vec3w& p2)
+{
+    return Magnitude(p1 - p2);
+}
+
+inline vec2w Normalized(const vec2w& v)
+{
+    return v * (floatw(1.0f) / Magnitude(v));
+}
+inline vec3w Normalized(const vec3w& v)
+{
+    return v * (floatw(1.0f) / Magnitude(v));
+}
+
+inline vec3w Cross(const vec3w& l, const vec3w& r)
+{
+    return vec3w(l.y * r.z - l.z * r.y,
+                 l.z * r.x - l.x * r.z,
+                 l.x * r.y - l.y * r.x);
+}
+
+inline vec2w Project(const vec2w& len, const vec2w& dir)
+{
+    return dir * (Dot(len, dir) / MagnitudeSqr(dir));
+}
+inline vec3w Project(const vec3w& len, const vec3w& dir)
+{
+    return dir * (Dot(len, dir) / MagnitudeSqr(dir));
+}
+
+inline vec2w Perpendicular(const vec2w& len, const vec2w& dir)
+{
+    return len - Project(len, dir);
+}
+inline vec3w Perpendicular(const vec3w& len, const vec3w& dir)
+{
+    return len - Project(len, dir);
+}
+
+inline vec2w Reflection(const vec2w& vec, const vec2w& normal)
+{
+    return vec - Project(vec, normal) * floatw(2.0f);
+}
+inline vec3w Reflection(const vec3w& vec, const vec3w& normal)
+{
+    return vec - Project(vec, normal) * floatw(2.0f);
+}
+
+inline vec2w Select(const maskw& m, const vec2w& a, const vec2w& b)
+{
+    return vec2w(Select(m, a.x, b.x), Select(m, a.y, b.y));
+}
+inline vec3w Select(const maskw& m, const vec3w& a, const vec3w& b)
+{
+    return vec3w(Select(m, a.x, b.x), Select(m, a.y, b.y),
+                 Select(m, a.z, b.z));
+}
+
+inline mat3w operator*(const mat3w& m1, const mat3w& m2)
+{
+    mat3w result;
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            result[i][j] = m1[i][0] * m2[0][j] + m1[i][1] * m2[1][j] +
+                           m1[i][2] * m2[2][j];
+        }
+    }
+    return result;
+}
+
+inline mat4w operator*(const mat4w& m1, const mat4w& m2)
+{
+    mat4w result;
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            result[i][j] = m1[i][0] * m2[0][j] + m1[i][1] * m2[1][j] +
+                           m1[i][2] * m2[2][j] + m1[i][3] * m2[3][j];
+        }
+    }
+    return result;
+}
+
+inline vec3w MultiplyVector(const vec3w& vec, const mat3w& mat)
+{
+    return vec3w(vec.x * mat[0][0] + vec.y * mat[1][0] + vec.z * mat[2][0],
+                 vec.x * mat[0][1] + vec.y * mat[1][1] + vec.z * mat[2][1],
+                 vec.x * mat[0][2] + vec.y * mat[1][2] + vec.z * mat[2][2]);
+}
+
+inline vec3w MultiplyVector(const vec3w& vec, const mat4w& mat)
+{
+    return vec3w(vec.x * mat[0][0] + vec.y * mat[1][0] + vec.z * mat[2][0],
+                 vec.x * mat[0][1] + vec.y * mat[1][1] + vec.z * mat[2][1],
+                 vec.x * mat[0][2] + vec.y * mat[1][2] + vec.z * mat[2][2]);
+}
+
+inline vec3w MultiplyPoint(const vec3w& point, const mat4w& mat)
+{
+    vec3w result = MultiplyVector(point, mat);
+    return vec3w(result.x + mat[3][0], result.y + mat[3][1],
+                 result.z + mat[3][2]);
+}
+
+/* Loads and stores between arrays of the usual types and the wide types.
+ * The versions taking a count move only the first `count` elements
+ * (count <= WIDE_LANES); missing lanes load as zero.
+ */
+
+// Lanes of a component spread through an array of structs
+inline floatw GatherWide(const float* first, int stride, int count)
+{
+    float lanes[WIDE_LANES] = { 0.0f };
+    for (int i = 0; i < count; i++) {
+        lanes[i] = first[i * stride];
+    }
+    return LoadWide(lanes);
+}
+
+inline void ScatterWide(float* first, int stride, const floatw& a, int count)
+{
+    float lanes[WIDE_LANES];
+    StoreWide(lanes, a);
+    for (int i = 0; i < count; i++) {
+        first[i * stride] = lanes[i];
+    }
+}
+
+inline vec2w LoadWide(const vec2* v, int count = WIDE_LANES)
+{
+    return vec2w(GatherWide(&v->x, 2, count), GatherWide(&v->y, 2, count));
+}
+inline vec3w LoadWide(const vec3* v, int count = WIDE_LANES)
+{
+    return vec3w(GatherWide(&v->x, 3, count), GatherWide(&v->y, 3, count),
+                 GatherWide(&v->z, 3, count));
+}
+inline mat3w LoadWide(const mat3* m, int count = WIDE_LANES)
+{
+    mat3w result;
+    for (int i = 0; i < 9; i++) {
+        result.asArray[i] = GatherWide(&m->asArray[i], 9, count);
+    }
+    return result;
+}
+inline mat4w LoadWide(const mat4* m, int count = WIDE_LANES)
+{
+    static_assert(sizeof(mat4) == 16 * sizeof(float), "mat4 layout");
+    mat4w result;
+    for (int i = 0; i < 16; i++) {
+        result.asArray[i] = GatherWide(&m->asArray[i], 16, count);
+    }
+    return result;
+}
+
+inline void StoreWide(vec2* v, const vec2w& a, int count = WIDE_LANES)
+{
+    ScatterWide(&v->x, 2, a.x, count);
+    ScatterWide(&v->y, 2, a.y, count);
+}
+inline void StoreWide(vec3* v, const vec3w& a, int count = WIDE_LANES)
+{
+    ScatterWide(&v->x, 3, a.x, count);
+    ScatterWide(&v->y, 3, a.y, count);
+    ScatterWide(&v->z, 3, a.z, count);
+}
+inline void StoreWide(mat3* m, const mat3w& a, int count = WIDE_LANES)
+{
+    for (int i = 0; i < 9; i++) {
+        ScatterWide(&m->asArray[i], 9, a.asArray[i], count);
+    }
+}
+inline void StoreWide(mat4* m, const mat4w& a, int count = WIDE_LANES)
+{
+    for (int i = 0; i < 16; i++) {
+        ScatterWide(&m->asArray[i], 16, a.asArray[i], count);
+    }
+}
+
+/* AoSoA containers
+ *
+ * Elements are stored in blocks of WIDE_LANES, each block holding the
+ * lanes of one component after the other, so Load/Store of a block are
+ * plain vector loads. The lanes past Size() in the last block are zero
+ * after Assign() and are otherwise free for kernels to write.
+ */
+template<typename T, typename W, int N>
+class AoSoAArray {
+public:
+    AoSoAArray() : m_count(0) {}
+    AoSoAArray(const T* values, int count) : m_count(0)
+    {
+        Assign(values, count);
+    }
+
+    void Assign(const T* values, int count)
+    {
+        m_count = count;
+        m_blocks.assign((count + WIDE_LANES - 1) / WIDE_LANES, Block());
+        for (int i = 0; i < count; i++) {
+            Set(i, values[i]);
+        }
+    }
+
+    void CopyTo(T* out) const
+    {
+        for (int i = 0; i < m_count; i++) {
+            out[i] = Get(i);
+        }
+    }
+
+    int Size() const { return m_count; }
+    int BlockCount() const { return (int)m_blocks.size(); }
+
+    W Load(int block) const
+    {
+        W result;
+        floatw* lanes = &result.x;
+        for (int c = 0; c < N; c++) {
+            lanes[c] = LoadWide(m_blocks[block].lanes[c]);
+        }
+        return result;
+    }
+
+    void Store(int block, const W& value)
+    {
+        const floatw* lanes = &value.x;
+        for (int c = 0; c < N; c++) {
+            StoreWide(m_blocks[block].lanes[c], lanes[c]);
+        }
+    }
+
+    T Get(int i) const
+    {
+        const Block& block = m_blocks[i / WIDE_LANES];
+        T result;
+        for (int c = 0; c < N; c++) {
+            result.asArray[c] = block.lanes[c][i % WIDE_LANES];
+        }
+        return result;
+    }
+
+    void Set(int i, const T& value)
+    {
+        Block& block = m_blocks[i / WIDE_LANES];
+        for (int c = 0; c < N; c++) {
+            block.lanes[c][i % WIDE_LANES] = value.asArray[c];
+        }
+    }
+
+private:
+    static_assert(sizeof(W) == N * sizeof(floatw),
+                  "AoSoAArray: W must hold N floatw components");
+
+    struct Block {
+        float lanes[N][WIDE_LANES];
+        Block() { memset(lanes, 0, sizeof(lanes)); }
+    };
+
+    std::vector<Block> m_blocks;
+    int m_count;
+};
+
+typedef AoSoAArray<vec2, vec2w, 2> AoSoAVec2;
+typedef AoSoAArray<vec3, vec3w, 3> AoSoAVec3;
+
+#endif
@@ -0,0 +1,520 @@
+#include "WorldPartition.h"
+#include "Profiler.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <cmath>
+#include <algorithm>
+#include <map>
+
+#define WORLD_PARTITION_PAGE_SIZE 4096
+
+typedef struct WorldManifestHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    float cellSize;
+    uint32_t cellCount;
+} WorldManifestHeader;
+
+static inline uint64_t CellKey(int x, int y)
+{
+    return ((uint64_t)(uint32_t)x << 32) | (uint64_t)(uint32_t)y;
+}
+
+static inline int CellKeyX(uint64_t key)
+{
+    return (int)(uint32_t)(key >> 32);
+}
+
+static inline int CellKeyY(uint64_t key)
+{
+    return (int)(uint32_t)key;
+}
+
+static void CellPath(char* path, size_t size, const char* directory,
+                     int x, int y)
+{
+    snprintf(path, size, "%s/cell_%d_%d.gpcf", directory, x, y);
+}
+
+/* World cells overlapped by the bounds of a shape, the same at bake and
+ * query time so both agree on where copies of a shape live */
+static void ShapeCells(const Rectangle2D& bounds, float invCellSize,
+                       int* x0, int* y0, int* x1, int* y1)
+{
+    vec2 min = GetMin(bounds);
+    vec2 max = GetMax(bounds);
+    *x0 = (int)floorf(min.x * invCellSize);
+    *y0 = (int)floorf(min.y * invCellSize);
+    *x1 = (int)floorf(max.x * invCellSize);
+    *y1 = (int)floorf(max.y * invCellSize);
+}
+
+/* Bake */
+
+typedef struct WorldCellShapes
+{
+    std::vector<Line2D> lines;
+    std::vector<Rectangle2D> rectangles;
+    std::vector<OrientedRectangle> orientedRectangles;
+} WorldCellShapes;
+
+bool BakeWorldPartition(const char* directory, const SweptTargets& shapes,
+                        float cellSize)
+{
+    PROFILE_FUNCTION();
+    if (cellSize <= 0.0f) {
+        return false;
+    }
+
+    // Sorted so the manifest and cell files come out the same every bake.
+    // A shape goes to every cell its bounds overlap, so no shape reaches
+    // past the cells holding it.
+    std::map<uint64_t, WorldCellShapes> cells;
+    float invCellSize = 1.0f / cellSize;
+    std::vector<WorldCellShapes*> overlapped;
+    auto cellsOf = [&](const Rectangle2D& bounds) {
+        int x0, y0, x1, y1;
+        ShapeCells(bounds, invCellSize, &x0, &y0, &x1, &y1);
+        overlapped.clear();
+        for (int y = y0; y <= y1; y++) {
+            for (int x = x0; x <= x1; x++) {
+                overlapped.push_back(&cells[CellKey(x, y)]);
+            }
+        }
+    };
+    for (int i = 0; i < shapes.lineCount; i++) {
+        cellsOf(ContainingRectangle(shapes.lines[i]));
+        for (size_t c = 0; c < overlapped.size(); c++) {
+            overlapped[c]->lines.push_back(shapes.lines[i]);
+        }
+    }
+    for (int i = 0; i < shapes.rectangleCount; i++) {
+        cellsOf(shapes.rectangles[i]);
+        for (size_t c = 0; c < overlapped.size(); c++) {
+            overlapped[c]->rectangles.push_back(shapes.rectangles[i]);
+        }
+    }
+    for (int i = 0; i < shapes.orientedRectangleCount; i++) {
+        cellsOf(ContainingRectangle(shapes.orientedRectangles[i]));
+        for (size_t c = 0; c < overlapped.size(); c++) {
+            overlapped[c]->orientedRectangles.push_back(
+                    shapes.orientedRectangles[i]);
+        }
+    }
+
+    char path[1024];
+    std::vector<int32_t> coordinates;
+    for (std::map<uint64_t, WorldCellShapes>::const_iterator it =
+             cells.begin(); it != cells.end(); ++it) {
+        const WorldCellShapes& cell = it->second;
+        SweptTargets targets;
+        targets.lines = cell.lines.empty() ? 0 : &cell.lines[0];
+        targets.lineCount = (int)cell.lines.size();
+        targets.rectangles = cell.rectangles.empty() ? 0 : &cell.rectangles[0];
+        targets.rectangleCount = (int)cell.rectangles.size();
+        targets.orientedRectangles = cell.orientedRectangles.empty() ?
+            0 : &cell.orientedRectangles[0];
+        targets.orientedRectangleCount = (int)cell.orientedRectangles.size();
+
+        int x = CellKeyX(it->first);
+        int y = CellKeyY(it->first);
+        CellPath(path, sizeof(path), directory, x, y);
+        if (!BakeCollisionFile(path, targets)) {
+            return false;
+        }
+        coordinates.push_back(x);
+        coordinates.push_back(y);
+    }
+
+    WorldManifestHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = WORLD_PARTITION_MAGIC;
+    header.version = WORLD_PARTITION_VERSION;
+    header.cellSize = cellSize;
+    header.cellCount = (uint32_t)cells.size();
+
+    snprintf(path, sizeof(path), "%s/%s", directory, WORLD_PARTITION_MANIFEST);
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+        (coordinates.empty() ||
+         fwrite(&coordinates[0], sizeof(int32_t), coordinates.size(), file) ==
+            coordinates.size());
+    ok = (fclose(file) == 0) && ok;
+    return ok;
+}
+
+/* WorldPartition */
+
+WorldPartition::WorldPartition(size_t memoryBudget) :
+    m_budget(memoryBudget), m_cellSize(1.0f), m_tick(0),
+    m_residentBytes(0), m_loading(false), m_shutdown(false)
+{
+    m_directory[0] = '\0';
+}
+
+WorldPartition::~WorldPartition()
+{
+    Close();
+}
+
+bool WorldPartition::Open(const char* directory)
+{
+    PROFILE_FUNCTION();
+    Close();
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s", directory, WORLD_PARTITION_MANIFEST);
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+    WorldManifestHeader header;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+        header.magic == WORLD_PARTITION_MAGIC &&
+        header.version == WORLD_PARTITION_VERSION &&
+        header.cellSize > 0.0f;
+    std::vector<int32_t> coordinates;
+    if (ok && header.cellCount > 0) {
+        coordinates.resize(header.cellCount * 2);
+        ok = fread(&coordinates[0], sizeof(int32_t), coordinates.size(),
+                   file) == coordinates.size();
+    }
+    fclose(file);
+    if (!ok || strlen(directory) >= sizeof(m_directory)) {
+        return false;
+    }
+
+    strcpy(m_directory, directory);
+    m_cellSize = header.cellSize;
+    for (size_t i = 0; i < coordinates.size(); i += 2) {
+        m_cells.insert(CellKey(coordinates[i], coordinates[i + 1]));
+    }
+    m_shutdown = false;
+    m_loader = std::thread(&WorldPartition::LoaderThread, this);
+    return true;
+}
+
+void WorldPartition::Close()
+{
+    if (m_loader.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_shutdown = true;
+        }
+        m_wake.notify_all();
+        m_loader.join();
+    }
+
+    for (std::unordered_map<uint64_t, Cell*>::iterator it =
+             m_resident.begin(); it != m_resident.end(); ++it) {
+        delete it->second;
+    }
+    for (size_t i = 0; i < m_loaded.size(); i++) {
+        delete m_loaded[i];
+    }
+    for (size_t i = 0; i < m_unload.size(); i++) {
+        delete m_unload[i];
+    }
+    m_resident.clear();
+    m_loaded.clear();
+    m_unload.clear();
+    m_requests.clear();
+    m_pending.clear();
+    m_cells.clear();
+    m_lru.clear();
+    m_residentBytes = 0;
+    m_loading = false;
+    m_directory[0] = '\0';
+}
+
+void WorldPartition::LoaderThread()
+{
+    char path[1024];
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+        m_wake.wait(lock, [this] {
+            return m_shutdown || !m_requests.empty() || !m_unload.empty();
+        });
+        if (m_shutdown) {
+            return;
+        }
+
+        // Unmapping can take a while too, so evicted cells close here
+        std::vector<Cell*> unload;
+        unload.swap(m_unload);
+        uint64_t key = 0;
+        bool load = !m_requests.empty();
+        if (load) {
+            key = m_requests.front();
+            m_requests.pop_front();
+            m_loading = true;
+        }
+        lock.unlock();
+
+        for (size_t i = 0; i < unload.size(); i++) {
+            delete unload[i];
+        }
+
+        Cell* cell = 0;
+        if (load) {
+            cell = new Cell();
+            cell->key = key;
+            cell->lastNeeded = 0;
+            CellPath(path, sizeof(path), m_directory, CellKeyX(key),
+                     CellKeyY(key));
+            if (cell->file.Open(path)) {
+                // Fault the pages in now rather than in the first query
+                const volatile char* data =
+                    (const volatile char*)cell->file.Data();
+                size_t size = cell->file.Size();
+                unsigned int sum = 0;
+                for (size_t offset = 0; offset < size;
+                     offset += WORLD_PARTITION_PAGE_SIZE) {
+                    sum += (unsigned char)data[offset];
+                }
+                (void)sum;
+            }
+        }
+
+        lock.lock();
+        if (cell) {
+            m_loaded.push_back(cell);
+            m_loading = false;
+        }
+        if (m_requests.empty() && !m_loading) {
+            m_idle.notify_all();
+        }
+    }
+}
+
+// Takes the cells the loader finished, simulation thread only
+void WorldPartition::Integrate()
+{
+    std::vector<Cell*> loaded;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        loaded.swap(m_loaded);
+    }
+    for (size_t i = 0; i < loaded.size(); i++) {
+        Cell* cell = loaded[i];
+        m_pending.erase(cell->key);
+        if (!cell->file.IsOpen()) {
+            // Missing or stale file, don't ask for it again
+            m_cells.erase(cell->key);
+            delete cell;
+            continue;
+        }
+        cell->lastNeeded = m_tick;
+        cell->lru = m_lru.insert(m_lru.end(), cell);
+        m_resident[cell->key] = cell;
+        m_residentBytes += cell->file.Size();
+    }
+}
+
+void WorldPartition::Evict()
+{
+    std::vector<Cell*> evicted;
+    while (m_residentBytes > m_budget && !m_lru.empty() &&
+           m_lru.front()->lastNeeded < m_tick) {
+        Cell* cell = m_lru.front();
+        m_lru.pop_front();
+        m_resident.erase(cell->key);
+        m_residentBytes -= cell->file.Size();
+        evicted.push_back(cell);
+    }
+    if (!evicted.empty()) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_unload.insert(m_unload.end(), evicted.begin(), evicted.end());
+        }
+        m_wake.notify_one();
+    }
+}
+
+void WorldPartition::CellRange(const vec2& min, const vec2& max,
+                               int* x0, int* y0, int* x1, int* y1) const
+{
+    float invCellSize = 1.0f / m_cellSize;
+    *x0 = (int)floorf(min.x * invCellSize);
+    *y0 = (int)floorf(min.y * invCellSize);
+    *x1 = (int)floorf(max.x * invCellSize);
+    *y1 = (int)floorf(max.y * invCellSize);
+}
+
+typedef struct WorldRequest
+{
+    uint64_t key;
+    float distanceSq;
+} WorldRequest;
+
+void WorldPartition::Update(const Point2D* observers, int count, float radius)
+{
+    PROFILE_FUNCTION();
+    m_tick++;
+    Integrate();
+
+    // Cells within `radius` of an observer
+    std::vector<WorldRequest> requests;
+    for (int i = 0; i < count; i++) {
+        vec2 extent(radius, radius);
+        int x0, y0, x1, y1;
+        CellRange(observers[i] - extent, observers[i] + extent,
+                  &x0, &y0, &x1, &y1);
+        for (int y = y0; y <= y1; y++) {
+            for (int x = x0; x <= x1; x++) {
+                uint64_t key = CellKey(x, y);
+                std::unordered_map<uint64_t, Cell*>::iterator resident =
+                    m_resident.find(key);
+                if (resident != m_resident.end()) {
+                    Cell* cell = resident->second;
+                    cell->lastNeeded = m_tick;
+                    m_lru.splice(m_lru.end(), m_lru, cell->lru);
+                    continue;
+                }
+                if (m_pending.count(key) || !m_cells.count(key)) {
+                    continue;
+                }
+                vec2 center((x + 0.5f) * m_cellSize, (y + 0.5f) * m_cellSize);
+                WorldRequest request = { key,
+                    MagnitudeSqr(center - observers[i]) };
+                requests.push_back(request);
+                m_pending.insert(key);
+            }
+        }
+    }
+
+    if (!requests.empty()) {
+        // Nearest cells first
+        std::sort(requests.begin(), requests.end(),
+                  [](const WorldRequest& l, const WorldRequest& r) {
+            return l.distanceSq < r.distanceSq;
+        });
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (size_t i = 0; i < requests.size(); i++) {
+                m_requests.push_back(requests[i].key);
+            }
+        }
+        m_wake.notify_one();
+    }
+
+    Evict();
+}
+
+void WorldPartition::Flush()
+{
+    PROFILE_FUNCTION();
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_idle.wait(lock, [this] {
+            return !m_loader.joinable() ||
+                (m_requests.empty() && !m_loading);
+        });
+    }
+    Integrate();
+    Evict();
+}
+
+const CollisionFile* WorldPartition::GetCell(int x, int y) const
+{
+    std::unordered_map<uint64_t, Cell*>::const_iterator it =
+        m_resident.find(CellKey(x, y));
+    return (it != m_resident.end()) ? &it->second->file : 0;
+}
+
+bool WorldPartition::IsFirstCopy(const CollisionFile& file,
+                                 const StaticShapeRef& shape, int x, int y,
+                                 int x0, int y0, int x1, int y1) const
+{
+    Rectangle2D bounds;
+    if (shape.type == SWEPT_LINE) {
+        bounds = ContainingRectangle(file.Lines()[shape.index]);
+    }
+    else if (shape.type == SWEPT_RECTANGLE) {
+        bounds = file.Rectangles()[shape.index];
+    }
+    else {
+        bounds = ContainingRectangle(file.OrientedRectangles()[shape.index]);
+    }
+    int sx0, sy0, sx1, sy1;
+    ShapeCells(bounds, 1.0f / m_cellSize, &sx0, &sy0, &sx1, &sy1);
+    sx0 = std::max(sx0, x0);
+    sy0 = std::max(sy0, y0);
+    sx1 = std::min(sx1, x1);
+    sy1 = std::min(sy1, y1);
+    // Every cell the shape overlaps holds a copy; the first resident one
+    // in scan order reports it
+    for (int cy = sy0; cy <= sy1; cy++) {
+        for (int cx = sx0; cx <= sx1; cx++) {
+            if (cx == x && cy == y) {
+                return true;
+            }
+            if (GetCell(cx, cy)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+template<typename Query>
+ArenaVector<WorldShapeRef> WorldPartition::QueryCells(const vec2& min,
+        const vec2& max, FrameArena* arena, const Query& query) const
+{
+    ArenaVector<WorldShapeRef> result((ArenaAllocator<WorldShapeRef>(arena)));
+    int x0, y0, x1, y1;
+    CellRange(min, max, &x0, &y0, &x1, &y1);
+    for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) {
+            const CollisionFile* file = GetCell(x, y);
+            if (!file) {
+                continue;
+            }
+            ArenaVector<StaticShapeRef> hits = query(*file);
+            for (size_t i = 0; i < hits.size(); i++) {
+                if (!IsFirstCopy(*file, hits[i], x, y, x0, y0, x1, y1)) {
+                    continue;
+                }
+                WorldShapeRef ref = { x, y, hits[i] };
+                result.push_back(ref);
+            }
+        }
+    }
+    return result;
+}
+
+ArenaVector<WorldShapeRef> WorldPartition::QueryPoint(const Point2D& point,
+                                                      FrameArena* arena) const
+{
+    PROFILE_FUNCTION();
+    return QueryCells(point, point, arena, [&](const CollisionFile& file) {
+        return file.QueryPoint(point, arena);
+    });
+}
+
+ArenaVector<WorldShapeRef> WorldPartition::QueryLine(const Line2D& line,
+                                                     FrameArena* arena) const
+{
+    PROFILE_FUNCTION();
+    Rectangle2D bounds = ContainingRectangle(line);
+    return QueryCells(GetMin(bounds), GetMax(bounds), arena,
+                      [&](const CollisionFile& file) {
+        return file.QueryLine(line, arena);
+    });
+}
+
+ArenaVector<WorldShapeRef> WorldPartition::QueryCircle(const Circle& circle,
+                                                       FrameArena* arena) const
+{
+    PROFILE_FUNCTION();
+    vec2 extent(circle.radius, circle.radius);
+    return QueryCells(circle.center - extent, circle.center + extent, arena,
+                      [&](const CollisionFile& file) {
+        return file.QueryCircle(circle, arena);
+    });
+}
@@ -0,0 +1,129 @@
+#ifndef _H_WORLD_PARTITION_
+#define _H_WORLD_PARTITION_
+
+#include "CollisionFile.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/* Static level geometry streamed in square world cells.
+ *
+ * BakeWorldPartition copies every shape into each world cell its bounds
+ * overlap and writes one baked CollisionFile per non-empty cell plus a
+ * small manifest to a directory. No shape reaches past the cells holding
+ * it, so a large shape never widens the loaded area or the cells a query
+ * visits. A shape found in several resident cells is reported once, from
+ * the first of them in scan order that the query covers.
+ *
+ * At runtime Update() takes the observer positions once per tick. Cells
+ * within `radius` of an observer are queued for a background loader
+ * thread, which maps the cell file and touches its pages so queries never
+ * fault on them. Loaded cells are handed over at the next Update(), and
+ * resident cells beyond the memory budget are evicted least recently
+ * needed first; cells an observer needs this tick are never evicted.
+ *
+ * Queries span the resident cells only. All calls except the loader's
+ * own work happen on the simulation thread, so queries take no locks.
+ */
+
+#define WORLD_PARTITION_MAGIC 0x50575047u // "GPWP"
+#define WORLD_PARTITION_VERSION 2u
+#define WORLD_PARTITION_MANIFEST "world.gpwp"
+
+bool BakeWorldPartition(const char* directory, const SweptTargets& shapes,
+                        float cellSize);
+
+typedef struct WorldShapeRef
+{
+    int cellX;
+    int cellY;
+    StaticShapeRef shape;
+} WorldShapeRef;
+
+class WorldPartition {
+public:
+    explicit WorldPartition(size_t memoryBudget = 64 * 1024 * 1024);
+    ~WorldPartition();
+
+    /* Reads the manifest and starts the loader thread */
+    bool Open(const char* directory);
+    void Close();
+
+    void Update(const Point2D* observers, int count, float radius);
+    /* Blocks until the loader is idle, then takes its cells (tools, tests
+     * and level start) */
+    void Flush();
+
+    ArenaVector<WorldShapeRef> QueryPoint(const Point2D& point,
+                                          FrameArena* arena = 0) const;
+    ArenaVector<WorldShapeRef> QueryLine(const Line2D& line,
+                                         FrameArena* arena = 0) const;
+    ArenaVector<WorldShapeRef> QueryCircle(const Circle& circle,
+                                           FrameArena* arena = 0) const;
+
+    /* The resident file of a cell, null when not loaded */
+    const CollisionFile* GetCell(int x, int y) const;
+
+    float CellSize() const { return m_cellSize; }
+    int ResidentCellCount() const { return (int)m_resident.size(); }
+    int PendingCellCount() const { return (int)m_pending.size(); }
+    size_t ResidentBytes() const { return m_residentBytes; }
+
+private:
+    WorldPartition(const WorldPartition&);
+    WorldPartition& operator=(const WorldPartition&);
+
+    struct Cell {
+        CollisionFile file;
+        uint64_t key;
+        uint64_t lastNeeded;
+        std::list<Cell*>::iterator lru;
+    };
+
+    void LoaderThread();
+    void Integrate();
+    void Evict();
+    void CellRange(const vec2& min, const vec2& max,
+                   int* x0, int* y0, int* x1, int* y1) const;
+    /* Whether cell (x, y) reports `shape` for a query over cells x0..x1,
+     * y0..y1 */
+    bool IsFirstCopy(const CollisionFile& file, const StaticShapeRef& shape,
+                     int x, int y, int x0, int y0, int x1, int y1) const;
+    template<typename Query>
+    ArenaVector<WorldShapeRef> QueryCells(const vec2& min, const vec2& max,
+                                          FrameArena* arena,
+                                          const Query& query) const;
+
+    size_t m_budget;
+    char m_directory[512];
+    float m_cellSize;
+    uint64_t m_tick;
+
+    // Simulation thread only
+    std::unordered_set<uint64_t> m_cells; // cells that have a file
+    std::unordered_map<uint64_t, Cell*> m_resident;
+    std::unordered_set<uint64_t> m_pending;
+    std::list<Cell*> m_lru; // least recently needed first
+    size_t m_residentBytes;
+
+    // Shared with the loader, guarded by m_mutex
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_idle;
+    std::deque<uint64_t> m_requests;
+    std::vector<Cell*> m_loaded;
+    std::vector<Cell*> m_unload;
+    bool m_loading;
+    bool m_shutdown;
+    std::thread m_loader;
+};
+
+#endif
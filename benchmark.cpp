@@ -0,0 +1,800 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+
+#include "vectors.h"
+#include "matrices.h"
+#include "Geometry2D.h"
+#include "GJK.h"
+#include "CollisionFile.h"
+#include "TriangleMesh.h"
+#include "Heightfield.h"
+#include "KdTree.h"
+#include "Particles.h"
+#include "SoftBody.h"
+#include "Joints.h"
+#include "Triggers.h"
+#include "QueryWorld.h"
+#include "DistanceField.h"
+#include "OccupancyGrid.h"
+#include "Snapshot.h"
+#include "Compression.h"
+#include "Wide.h"
+
+/* Micro benchmarks for the hot math paths.
+ *
+ * Also used as the PGO training run, so it should exercise the calls a
+ * real tick makes. Usage: gamephysics_bench [scale] [filter]
+ * `scale` multiplies the iteration counts, `filter` only runs benchmarks
+ * whose name contains it.
+ */
+
+static float s_scale = 1.0f;
+static const char* s_filter = 0;
+
+// Keeps results alive so the optimizer can't drop the benchmarked work
+static volatile float s_sink;
+
+static float RandomFloat(float min, float max)
+{
+    return min + (max - min) * ((float)rand() / (float)RAND_MAX);
+}
+
+template<typename F>
+static void Bench(const char* name, int iterations, const F& f)
+{
+    if (s_filter && !strstr(name, s_filter)) {
+        return;
+    }
+    iterations = (int)(iterations * s_scale);
+    if (iterations < 1) {
+        iterations = 1;
+    }
+
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        f(i);
+    }
+    double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    printf("%-32s %12d iters %12.2f ns/iter\n", name, iterations,
+           ns / iterations);
+}
+
+static void BenchVectors()
+{
+    std::vector<vec3> v(1024);
+    for (size_t i = 0; i < v.size(); i++) {
+        v[i] = vec3(RandomFloat(-10, 10), RandomFloat(-10, 10),
+                    RandomFloat(-10, 10));
+    }
+
+    Bench("vec3 Normalized+Dot", 1 << 22, [&](int i) {
+        vec3 a = Normalized(v[i & 1023]);
+        s_sink = Dot(a, v[(i + 1) & 1023]);
+    });
+    Bench("vec3 Reflection", 1 << 22, [&](int i) {
+        s_sink = Reflection(v[i & 1023], v[(i + 7) & 1023]).x;
+    });
+}
+
+static void BenchMatrices()
+{
+    std::vector<mat4> m(256);
+    for (size_t i = 0; i < m.size(); i++) {
+        m[i] = Transform(vec3(1, 1, 1),
+                         vec3(RandomFloat(0, 360), RandomFloat(0, 360),
+                              RandomFloat(0, 360)),
+                         vec3(RandomFloat(-5, 5), RandomFloat(-5, 5),
+                              RandomFloat(-5, 5)));
+    }
+
+    Bench("mat4 operator*", 1 << 21, [&](int i) {
+        s_sink = (m[i & 255] * m[(i + 1) & 255])._11;
+    });
+    Bench("mat4 Inverse", 1 << 18, [&](int i) {
+        s_sink = Inverse(m[i & 255])._11;
+    });
+    Bench("mat3 Inverse", 1 << 20, [&](int i) {
+        s_sink = Inverse(Rotation3x3((float)i, 0.0f, 0.0f))._11;
+    });
+    Bench("MultiplyPoint", 1 << 22, [&](int i) {
+        s_sink = MultiplyPoint(vec3((float)i, 1.0f, 2.0f), m[i & 255]).x;
+    });
+    Bench("MultiplyPoint vec3a", 1 << 22, [&](int i) {
+        s_sink = MultiplyPoint(vec3a((float)i, 1.0f, 2.0f), m[i & 255]).x;
+    });
+
+    const int count = 4096;
+    std::vector<vec3> axes(count);
+    std::vector<float> angles(count);
+    std::vector<mat4> out(count);
+    for (int i = 0; i < count; i++) {
+        axes[i] = vec3(RandomFloat(-1, 1), RandomFloat(-1, 1),
+                       RandomFloat(-1, 1));
+        angles[i] = RandomFloat(-360, 360);
+    }
+    Bench("AxisAngle x4096", 1 << 8, [&](int) {
+        for (int j = 0; j < count; j++) {
+            out[j] = AxisAngle(axes[j], angles[j]);
+        }
+        s_sink = out[0]._11;
+    });
+    Bench("AxisAngleBatch x4096", 1 << 8, [&](int) {
+        AxisAngleBatch(&axes[0], &angles[0], &out[0], count);
+        s_sink = out[0]._11;
+    });
+
+    std::vector<vec3a> alignedAxes(count);
+    for (int i = 0; i < count; i++) {
+        alignedAxes[i] = vec3a(axes[i]);
+    }
+    FrameArena arena(count * sizeof(vec3a) * 2);
+    Bench("MultiplyPoints x4096", 1 << 10, [&](int i) {
+        s_sink = MultiplyPoints(&axes[0], count, m[i & 255], &arena)[0].x;
+        arena.Reset();
+    });
+    Bench("MultiplyPoints vec3a x4096", 1 << 10, [&](int i) {
+        s_sink = MultiplyPoints(&alignedAxes[0], count, m[i & 255],
+                                &arena)[0].x;
+        arena.Reset();
+    });
+}
+
+static void BenchGeometry2D()
+{
+    const int count = 2048;
+    std::vector<Circle> circles(count);
+    std::vector<Line2D> lines(count);
+    for (int i = 0; i < count; i++) {
+        circles[i] = Circle(Point2D(RandomFloat(0, 500), RandomFloat(0, 500)),
+                            RandomFloat(0.5f, 4.0f));
+        Point2D start(RandomFloat(-20, 20), RandomFloat(-20, 20));
+        lines[i] = Line2D(start, start + vec2(RandomFloat(-5, 5),
+                                              RandomFloat(-5, 5)));
+    }
+    OrientedRectangle box(vec2(2.0f, 1.0f), vec2(4.0f, 2.0f), 30.0f);
+    Rectangle2D rect(vec2(-3.0f, -2.0f), vec2(6.0f, 4.0f));
+
+    Bench("PointInOrientedRectangle", 1 << 21, [&](int i) {
+        s_sink = (float)PointInOrientedRectangle(lines[i & (count - 1)].start,
+                                                 box);
+    });
+    Bench("LineRectangle", 1 << 21, [&](int i) {
+        s_sink = (float)LineRectangle(lines[i & (count - 1)], rect);
+    });
+    Bench("LineOrientedRectangle", 1 << 21, [&](int i) {
+        s_sink = (float)LineOrientedRectangle(lines[i & (count - 1)], box);
+    });
+
+    std::vector<Polygon2D> polygons(256);
+    for (size_t i = 0; i < polygons.size(); i++) {
+        vec2 center(RandomFloat(-20, 20), RandomFloat(-20, 20));
+        vec2 vertices[8];
+        for (int j = 0; j < 8; j++) {
+            float theta = DEG2RAD(45.0f * j);
+            vertices[j] = center + vec2(cosf(theta), sinf(theta)) *
+                RandomFloat(2.0f, 3.0f);
+        }
+        SetVertices(polygons[i], vertices, 8);
+    }
+    Bench("PolygonPolygon2D", 1 << 21, [&](int i) {
+        s_sink = (float)PolygonPolygon2D(polygons[i & 255],
+                                         polygons[(i + 1) & 255]);
+    });
+    Bench("CirclePolygon2D", 1 << 21, [&](int i) {
+        s_sink = (float)CirclePolygon2D(circles[i & (count - 1)],
+                                        polygons[i & 255]);
+    });
+    Bench("SignedDistance OrientedRectangle", 1 << 21, [&](int i) {
+        s_sink = SignedDistance(lines[i & (count - 1)].start, box);
+    });
+    Bench("SignedDistance Polygon2D", 1 << 21, [&](int i) {
+        s_sink = SignedDistance(lines[i & (count - 1)].start,
+                                polygons[i & 255]);
+    });
+
+    FrameArena arena(1 << 20);
+    Bench("CircleCirclePairs x2048", 1 << 8, [&](int) {
+        ArenaVector<CollisionPair> pairs =
+            CircleCirclePairs(&circles[0], count, &arena);
+        s_sink = (float)pairs.size();
+        arena.Reset();
+    });
+    Bench("LinesOrientedRectangle x2048", 1 << 9, [&](int) {
+        ArenaVector<int> hits =
+            LinesOrientedRectangle(&lines[0], count, box, &arena);
+        s_sink = (float)hits.size();
+        arena.Reset();
+    });
+    Bench("LineLine", 1 << 21, [&](int i) {
+        s_sink = (float)LineLine(lines[i & (count - 1)],
+                                 lines[(i + 1) & (count - 1)]);
+    });
+
+    // Wall segments of a 2000 x 2000 level
+    const int wallCount = 200000;
+    std::vector<Line2D> segments(wallCount);
+    for (int i = 0; i < wallCount; i++) {
+        Point2D start(RandomFloat(0, 2000), RandomFloat(0, 2000));
+        segments[i] = Line2D(start, start + vec2(RandomFloat(-4, 4),
+                                                 RandomFloat(-4, 4)));
+    }
+    Bench("LineLinePairs x200k", 1 << 2, [&](int) {
+        ArenaVector<LineIntersection> hits =
+            LineLinePairs(&segments[0], wallCount);
+        s_sink = (float)hits.size();
+    });
+
+    std::vector<vec2> velocities(count);
+    std::vector<Rectangle2D> walls(64);
+    for (int i = 0; i < count; i++) {
+        velocities[i] = vec2(RandomFloat(-40, 40), RandomFloat(-40, 40));
+    }
+    for (size_t i = 0; i < walls.size(); i++) {
+        walls[i] = Rectangle2D(vec2(RandomFloat(0, 500), RandomFloat(0, 500)),
+                               vec2(RandomFloat(0.1f, 2), RandomFloat(5, 60)));
+    }
+    SweptTargets targets;
+    targets.rectangles = &walls[0];
+    targets.rectangleCount = (int)walls.size();
+    Bench("SweptCircles x2048", 1 << 7, [&](int) {
+        ArenaVector<SweptHit> hits = SweptCircles(&circles[0], &velocities[0],
+                                                  count, targets, &arena);
+        s_sink = (float)hits.size();
+        arena.Reset();
+    });
+}
+
+static void BenchGJK()
+{
+    const int count = 1024;
+    std::vector<OBB> boxes(count);
+    std::vector<Sphere> spheres(count);
+    for (int i = 0; i < count; i++) {
+        boxes[i] = OBB(vec3(RandomFloat(-2, 2), RandomFloat(-2, 2),
+                            RandomFloat(-2, 2)),
+                       vec3(RandomFloat(0.5f, 2), RandomFloat(0.5f, 2),
+                            RandomFloat(0.5f, 2)),
+                       Rotation3x3(RandomFloat(0, 360), RandomFloat(0, 360),
+                                   RandomFloat(0, 360)));
+        spheres[i] = Sphere(vec3(RandomFloat(-4, 4), RandomFloat(-4, 4),
+                                 RandomFloat(-4, 4)), RandomFloat(0.2f, 1.5f));
+    }
+
+    Bench("GjkCollide OBB/Sphere", 1 << 19, [&](int i) {
+        GjkResult3D r = GjkCollide(MakeConvexShape(boxes[i & (count - 1)]),
+                                   MakeConvexShape(spheres[i & (count - 1)]));
+        s_sink = r.depth + r.distance;
+    });
+    Bench("GjkCollide OBB/OBB", 1 << 18, [&](int i) {
+        GjkResult3D r = GjkCollide(MakeConvexShape(boxes[i & (count - 1)]),
+                                   MakeConvexShape(boxes[(i + 1) & (count - 1)]));
+        s_sink = r.depth + r.distance;
+    });
+
+    // Persistent pairs: the same pair queried again after a small move
+    std::vector<GjkCache3D> caches(count);
+    Bench("GjkOverlap OBB/OBB warm", 1 << 18, [&](int i) {
+        int pair = i & (count - 1);
+        OBB moved = boxes[(pair + 1) & (count - 1)];
+        moved.position = moved.position + vec3(0.001f * (i >> 10), 0, 0);
+        s_sink = (float)GjkOverlap(MakeConvexShape(boxes[pair]),
+                                   MakeConvexShape(moved), &caches[pair]);
+    });
+}
+
+static void BenchCollisionFile()
+{
+    const int count = 100000;
+    std::vector<Line2D> lines(count);
+    std::vector<OrientedRectangle> boxes(count);
+    for (int i = 0; i < count; i++) {
+        Point2D start(RandomFloat(0, 4000), RandomFloat(0, 4000));
+        lines[i] = Line2D(start, start + vec2(RandomFloat(-20, 20),
+                                              RandomFloat(-20, 20)));
+        boxes[i] = OrientedRectangle(vec2(RandomFloat(0, 4000),
+                                          RandomFloat(0, 4000)),
+                                     vec2(RandomFloat(0.5f, 8),
+                                          RandomFloat(0.5f, 8)),
+                                     RandomFloat(0, 360));
+    }
+    SweptTargets shapes;
+    shapes.lines = &lines[0];
+    shapes.lineCount = count;
+    shapes.orientedRectangles = &boxes[0];
+    shapes.orientedRectangleCount = count;
+
+    const char* path = "gamephysics_bench.gpcf";
+    if (!BakeCollisionFile(path, shapes)) {
+        printf("BakeCollisionFile failed\n");
+        return;
+    }
+    CollisionFile file;
+    Bench("CollisionFile Open", 1 << 10, [&](int) {
+        s_sink = (float)file.Open(path);
+    });
+
+    FrameArena arena(1 << 16);
+    Bench("CollisionFile QueryCircle", 1 << 18, [&](int i) {
+        Circle circle(Point2D((float)(i * 37 % 4000), (float)(i * 91 % 4000)),
+                      10.0f);
+        s_sink = (float)file.QueryCircle(circle, &arena).size();
+        arena.Reset();
+    });
+
+    // 2048 bullets through the 200k shape level
+    const int moverCount = 2048;
+    std::vector<Circle> movers(moverCount);
+    std::vector<vec2> velocities(moverCount);
+    for (int i = 0; i < moverCount; i++) {
+        movers[i] = Circle(Point2D(RandomFloat(0, 4000), RandomFloat(0, 4000)),
+                           RandomFloat(0.5f, 2.0f));
+        velocities[i] = vec2(RandomFloat(-40, 40), RandomFloat(-40, 40));
+    }
+    FrameArena sweepArena(1 << 20);
+    Bench("CollisionFile QuerySweptCircles x2048", 1 << 6, [&](int) {
+        s_sink = (float)file.QuerySweptCircles(&movers[0], &velocities[0],
+                                               moverCount, &sweepArena).size();
+        sweepArena.Reset();
+    });
+    file.Close();
+    remove(path);
+}
+
+// Rolling terrain of 2 * 708 * 708 (about a million) triangles
+static void BenchTriangleMesh()
+{
+    const int size = 708;
+    std::vector<Triangle> triangles;
+    triangles.reserve(2 * size * size);
+    for (int z = 0; z < size; z++) {
+        for (int x = 0; x < size; x++) {
+            vec3 p[4];
+            for (int i = 0; i < 4; i++) {
+                float px = (float)(x + (i & 1));
+                float pz = (float)(z + (i >> 1));
+                p[i] = vec3(px, 8.0f * sinf(px * 0.05f) * cosf(pz * 0.07f) +
+                            RandomFloat(-0.2f, 0.2f), pz);
+            }
+            triangles.push_back(Triangle(p[0], p[1], p[2]));
+            triangles.push_back(Triangle(p[1], p[3], p[2]));
+        }
+    }
+
+    TriangleMesh mesh;
+    Bench("TriangleMesh Build 1M", 1, [&](int) {
+        mesh.Build(&triangles[0], (int)triangles.size());
+        s_sink = (float)mesh.NodeCount();
+    });
+
+    std::vector<Ray> rays(1024);
+    for (size_t i = 0; i < rays.size(); i++) {
+        rays[i] = Ray(vec3(RandomFloat(0, size), 30.0f, RandomFloat(0, size)),
+                      vec3(RandomFloat(-1, 1), -1.0f, RandomFloat(-1, 1)));
+    }
+    Bench("TriangleMesh Raycast", 1 << 18, [&](int i) {
+        MeshHit hit;
+        s_sink = mesh.Raycast(rays[i & 1023], &hit) ? hit.t : 0.0f;
+    });
+
+    FrameArena arena(1 << 16);
+    Bench("TriangleMesh OverlapSphere", 1 << 18, [&](int i) {
+        const Ray& ray = rays[i & 1023];
+        Sphere sphere(vec3(ray.origin.x, 0.0f, ray.origin.z), 2.0f);
+        s_sink = (float)mesh.OverlapSphere(sphere, &arena).size();
+        arena.Reset();
+    });
+}
+
+static void BenchHeightfield()
+{
+    const int size = 2048;
+    std::vector<float> heights(size * size);
+    for (int z = 0; z < size; z++) {
+        for (int x = 0; x < size; x++) {
+            heights[z * size + x] = 40.0f * sinf(x * 0.01f) * cosf(z * 0.013f) +
+                RandomFloat(-0.5f, 0.5f);
+        }
+    }
+    Heightfield terrain;
+    terrain.Build(&heights[0], size, size, vec3(), 1.0f);
+
+    // Long, shallow rays are the worst case for a plain cell walk
+    std::vector<Ray> rays(1024);
+    for (size_t i = 0; i < rays.size(); i++) {
+        rays[i] = Ray(vec3(RandomFloat(0, size), 60.0f, RandomFloat(0, size)),
+                      vec3(RandomFloat(-1, 1), RandomFloat(-0.1f, -0.01f),
+                           RandomFloat(-1, 1)));
+    }
+    Bench("Heightfield Raycast", 1 << 18, [&](int i) {
+        MeshHit hit;
+        s_sink = terrain.Raycast(rays[i & 1023], &hit) ? hit.t : 0.0f;
+    });
+    Bench("Heightfield OverlapSphere", 1 << 20, [&](int i) {
+        const Ray& ray = rays[i & 1023];
+        Sphere sphere(vec3(ray.origin.x, 0.0f, ray.origin.z), 2.0f);
+        s_sink = (float)terrain.OverlapSphere(sphere);
+    });
+}
+
+static void BenchKdTree()
+{
+    const int count = 50000;
+    std::vector<Point2D> points(count);
+    for (int i = 0; i < count; i++) {
+        points[i] = Point2D(RandomFloat(0, 1000), RandomFloat(0, 1000));
+    }
+    KdTree2D tree;
+    Bench("KdTree2D Build 50k", 1 << 4, [&](int) {
+        tree.Build(&points[0], count);
+    });
+
+    FrameArena arena;
+    Bench("KdTree2D Nearest 8", 1 << 18, [&](int i) {
+        s_sink = (float)tree.Nearest(points[i % count] + vec2(0.5f, 0.5f), 8,
+                                     &arena)[0].index;
+        arena.Reset();
+    });
+    Bench("KdTree2D QueryRadius 10", 1 << 18, [&](int i) {
+        s_sink = (float)tree.QueryRadius(points[i % count], 10.0f,
+                                         &arena).size();
+        arena.Reset();
+    });
+
+    std::vector<KdNeighbor> neighbors(4096 * 8);
+    Bench("KdTree2D NearestBatch 8 x4096", 1 << 6, [&](int) {
+        tree.NearestBatch(&points[0], 4096, 8, &neighbors[0]);
+        s_sink = neighbors[0].distanceSq;
+    });
+}
+
+static void BenchParticles()
+{
+    ParticleSystem2D particles;
+    particles.AddCollider(Rectangle2D(vec2(-100, -20), vec2(1200, 20)));
+    for (int i = 0; i < 16; i++) {
+        particles.AddCollider(Circle(vec2(RandomFloat(0, 1000),
+                                          RandomFloat(0, 200)), 20.0f));
+        particles.AddCollider(OrientedRectangle(
+                vec2(RandomFloat(0, 1000), RandomFloat(0, 200)),
+                vec2(40.0f, 5.0f), RandomFloat(-60, 60)));
+    }
+    const int count = 200000;
+    particles.Reserve(count);
+    for (int i = 0; i < count; i++) {
+        particles.Add(vec2(RandomFloat(0, 1000), RandomFloat(0, 300)),
+                      vec2(RandomFloat(-10, 10), RandomFloat(-10, 10)));
+    }
+    Bench("ParticleSystem2D Update 200k", 1 << 6, [&](int) {
+        particles.Update(1.0f / 60.0f);
+        s_sink = particles.PositionsY()[0];
+    });
+}
+
+static void BenchSoftBody()
+{
+    SoftBodySystem2D cloth;
+    cloth.AddCloth(Point2D(0, 0), vec2(100, 100), 256, 256, 1.0f, 0.0f, 0.01f);
+    cloth.AddCollider(Circle(Point2D(50, -30), 20.0f));
+    cloth.Update(1.0f / 60.0f); // colors the constraints
+    Bench("SoftBodySystem2D Update 256x256 cloth", 1 << 4, [&](int) {
+        cloth.Update(1.0f / 60.0f);
+        s_sink = cloth.GetPosition(0).y;
+    });
+}
+
+static void BenchJoints()
+{
+    // 256 chains of 32 links hanging from a static body
+    std::vector<Body2D> bodies;
+    bodies.push_back(Body2D(Point2D(0, 0), 0.0f, 0.0f));
+    JointSolver2D joints;
+    for (int c = 0; c < 256; c++) {
+        int prev = 0;
+        for (int l = 0; l < 32; l++) {
+            bodies.push_back(Body2D(Point2D(c * 2.0f + l + 0.5f, 0), 1.0f,
+                                    0.1f));
+            int link = (int)bodies.size() - 1;
+            joints.AddRevolute(&bodies[0], prev, link,
+                               Point2D(c * 2.0f + l, 0));
+            prev = link;
+        }
+    }
+    Bench("JointSolver2D Solve 8k revolute", 1 << 6, [&](int) {
+        joints.Solve(&bodies[0], (int)bodies.size(), 1.0f / 60.0f);
+        s_sink = bodies[1].velocity.y;
+    });
+}
+
+static void BenchTriggers()
+{
+    TriggerSystem2D triggers;
+    for (int i = 0; i < 1000; i++) {
+        triggers.AddTrigger(Circle(vec2(RandomFloat(0, 2000),
+                                        RandomFloat(0, 2000)), 30.0f));
+        triggers.AddTrigger(OrientedRectangle(
+                vec2(RandomFloat(0, 2000), RandomFloat(0, 2000)),
+                vec2(40.0f, 20.0f), RandomFloat(0, 90)), 2u);
+    }
+    const int count = 20000;
+    std::vector<Point2D> positions(count);
+    for (int i = 0; i < count; i++) {
+        positions[i] = vec2(RandomFloat(0, 2000), RandomFloat(0, 2000));
+        triggers.AddEntity(positions[i], (i & 1) ? 1u : 3u);
+    }
+    triggers.Update();
+
+    // A twentieth of the entities move each tick
+    int tick = 0;
+    Bench("TriggerSystem2D Update 2k zones 1k movers", 1 << 8, [&](int) {
+        for (int i = tick++ % 20; i < count; i += 20) {
+            positions[i] = positions[i] + vec2(RandomFloat(-4, 4),
+                                               RandomFloat(-4, 4));
+            triggers.MoveEntity(i, positions[i]);
+        }
+        triggers.Update();
+        s_sink = (float)triggers.Events().size();
+    });
+}
+
+static void BenchQueryWorld()
+{
+    const int count = 10000;
+    std::vector<OrientedRectangle> boxes(count);
+    for (int i = 0; i < count; i++) {
+        boxes[i] = OrientedRectangle(vec2(RandomFloat(0, 2000),
+                                          RandomFloat(0, 2000)),
+                                     vec2(RandomFloat(0.5f, 8),
+                                          RandomFloat(0.5f, 8)),
+                                     RandomFloat(0, 360));
+    }
+    SweptTargets shapes;
+    shapes.orientedRectangles = &boxes[0];
+    shapes.orientedRectangleCount = count;
+
+    QueryWorld2D world;
+    uint32_t step = 0;
+    Bench("QueryWorld2D Publish 10k boxes", 1 << 6, [&](int) {
+        s_sink = (float)world.Publish(shapes, ++step, 32.0f);
+    });
+
+    FrameArena arena(1 << 16);
+    Bench("QueryWorldView QueryCircle", 1 << 18, [&](int i) {
+        QueryWorldView view(world);
+        Circle circle(Point2D((float)(i * 37 % 2000), (float)(i * 91 % 2000)),
+                      10.0f);
+        s_sink = (float)view.World().QueryCircle(circle, &arena).size();
+        arena.Reset();
+    });
+}
+
+static void BenchDistanceField()
+{
+    const int count = 2000;
+    std::vector<Circle> circles(count);
+    std::vector<OrientedRectangle> boxes(count);
+    for (int i = 0; i < count; i++) {
+        circles[i] = Circle(vec2(RandomFloat(0, 2000), RandomFloat(0, 2000)),
+                            RandomFloat(2, 20));
+        boxes[i] = OrientedRectangle(vec2(RandomFloat(0, 2000),
+                                          RandomFloat(0, 2000)),
+                                     vec2(RandomFloat(2, 20),
+                                          RandomFloat(2, 20)),
+                                     RandomFloat(0, 360));
+    }
+    DistanceFieldShapes shapes;
+    shapes.circles = &circles[0];
+    shapes.circleCount = count;
+    shapes.orientedRectangles = &boxes[0];
+    shapes.orientedRectangleCount = count;
+
+    DistanceField2D field;
+    Rectangle2D area(vec2(0.0f, 0.0f), vec2(2048.0f, 2048.0f));
+    Bench("DistanceField2D Bake 4k shapes 512x512", 1 << 2, [&](int) {
+        s_sink = (float)field.Bake(shapes, area, 4.0f);
+    });
+    Bench("DistanceField2D Sample", 1 << 21, [&](int i) {
+        s_sink = field.Sample(Point2D((float)(i * 37 % 2000),
+                                      (float)(i * 91 % 2000)));
+    });
+    Bench("DistanceField2D Gradient", 1 << 21, [&](int i) {
+        s_sink = field.Gradient(Point2D((float)(i * 37 % 2000),
+                                        (float)(i * 91 % 2000))).x;
+    });
+}
+
+static void BenchOccupancyGrid()
+{
+    const int count = 2000;
+    std::vector<Circle> circles(count);
+    std::vector<Rectangle2D> rects(count);
+    std::vector<OrientedRectangle> boxes(count);
+    std::vector<Line2D> walls(count);
+    for (int i = 0; i < count; i++) {
+        circles[i] = Circle(vec2(RandomFloat(0, 2048), RandomFloat(0, 2048)),
+                            RandomFloat(2, 20));
+        rects[i] = Rectangle2D(vec2(RandomFloat(0, 2048),
+                                    RandomFloat(0, 2048)),
+                               vec2(RandomFloat(2, 40), RandomFloat(2, 40)));
+        boxes[i] = OrientedRectangle(vec2(RandomFloat(0, 2048),
+                                          RandomFloat(0, 2048)),
+                                     vec2(RandomFloat(2, 20),
+                                          RandomFloat(2, 20)),
+                                     RandomFloat(0, 360));
+        Point2D start(RandomFloat(0, 2048), RandomFloat(0, 2048));
+        walls[i] = Line2D(start, start + vec2(RandomFloat(-60, 60),
+                                              RandomFloat(-60, 60)));
+    }
+
+    OccupancyGrid2D grid;
+    Rectangle2D area(vec2(0.0f, 0.0f), vec2(2048.0f, 2048.0f));
+    Bench("OccupancyGrid2D rebuild 8k shapes 2048x2048", 1 << 3, [&](int) {
+        grid.Reset(area, 1.0f, 6);
+        for (int i = 0; i < count; i++) {
+            grid.AddShape(circles[i]);
+            grid.AddShape(rects[i]);
+            grid.AddShape(boxes[i]);
+            grid.AddShape(walls[i]);
+        }
+        grid.Update();
+        s_sink = (float)grid.Words(5)[0];
+    });
+
+    // A door opens or closes: one box is replaced per update
+    int tick = 0;
+    Bench("OccupancyGrid2D restamp 1 shape", 1 << 12, [&](int) {
+        int i = tick++ % count;
+        grid.RemoveShape(4 * i + 2);
+        boxes[i].rotation += 90.0f;
+        grid.AddShape(boxes[i]);
+        grid.Update();
+        s_sink = (float)grid.IsBlocked(boxes[i].origin);
+    });
+}
+
+static void BenchSnapshot()
+{
+    const int count = 10000;
+    std::vector<Body2D> bodies(count);
+    for (int i = 0; i < count; i++) {
+        bodies[i] = Body2D(Point2D(RandomFloat(-500, 500),
+                                   RandomFloat(-500, 500)), 1.0f, 1.0f);
+    }
+    std::vector<uint32_t> frame;
+    frame.reserve(count * sizeof(Body2D) / sizeof(uint32_t) + 1);
+
+    // A third of the bodies move each tick, the rest are asleep
+    SnapshotRing ring(64);
+    uint32_t tick = 0;
+    Bench("Snapshot+Push 10k bodies", 1 << 8, [&](int) {
+        for (int i = tick % 3; i < count; i += 3) {
+            bodies[i].position.x += bodies[i].velocity.x + 0.01f;
+            bodies[i].velocity.y -= 0.1f;
+        }
+        frame.clear();
+        SnapshotWriter writer(frame);
+        writer.Write(&bodies[0], count);
+        ring.Push(tick++, frame);
+    });
+    std::vector<uint32_t> restored;
+    Bench("SnapshotRing Restore 8 back", 1 << 8, [&](int) {
+        s_sink = ring.Restore(ring.NewestTick() - 8, restored) ? 1.0f : 0.0f;
+    });
+}
+
+static void BenchCompression()
+{
+    const int count = 4096;
+    std::vector<vec3> positions(count);
+    std::vector<vec3> normals(count);
+    std::vector<mat3> rotations(count);
+    for (int i = 0; i < count; i++) {
+        positions[i] = vec3(RandomFloat(0, 256), RandomFloat(0, 256),
+                            RandomFloat(0, 256));
+        normals[i] = Normalized(vec3(RandomFloat(-1, 1), RandomFloat(-1, 1),
+                                     RandomFloat(-1, 1)));
+        rotations[i] = AxisAngle3x3(normals[i], RandomFloat(-180, 180));
+    }
+    std::vector<QuantizedPosition> quantized(count);
+    std::vector<uint32_t> encoded(count);
+    vec3 origin;
+
+    Bench("QuantizePositions x4096", 1 << 11, [&](int) {
+        QuantizePositions(&positions[0], origin, 256.0f, &quantized[0], count);
+    });
+    Bench("DequantizePositions x4096", 1 << 11, [&](int) {
+        DequantizePositions(&quantized[0], origin, 256.0f, &positions[0],
+                            count);
+    });
+    Bench("EncodeNormals x4096", 1 << 11, [&](int) {
+        EncodeNormals(&normals[0], &encoded[0], count);
+    });
+    Bench("DecodeNormals x4096", 1 << 11, [&](int) {
+        DecodeNormals(&encoded[0], &normals[0], count);
+    });
+    Bench("EncodeRotations x4096", 1 << 9, [&](int) {
+        EncodeRotations(&rotations[0], &encoded[0], count);
+    });
+    Bench("DecodeRotations x4096", 1 << 9, [&](int) {
+        DecodeRotations(&encoded[0], &rotations[0], count);
+    });
+}
+
+static void BenchWide()
+{
+    // Integrate and bounce off the ground plane, scalar and wide
+    const int count = 4096;
+    const float dt = 1.0f / 60.0f;
+    std::vector<vec3> positions(count);
+    std::vector<vec3> velocities(count);
+    for (int i = 0; i < count; i++) {
+        positions[i] = vec3(RandomFloat(-50, 50), RandomFloat(0, 50),
+                            RandomFloat(-50, 50));
+        velocities[i] = vec3(RandomFloat(-5, 5), RandomFloat(-5, 5),
+                             RandomFloat(-5, 5));
+    }
+    vec3 up(0.0f, 1.0f, 0.0f);
+
+    Bench("Integrate scalar x4096", 1 << 10, [&](int) {
+        for (int i = 0; i < count; i++) {
+            vec3 p = positions[i] + velocities[i] * dt;
+            if (p.y < 0.0f) {
+                velocities[i] = Reflection(velocities[i], up);
+                p.y = -p.y;
+            }
+            positions[i] = p;
+        }
+        s_sink = positions[0].x;
+    });
+
+    AoSoAVec3 widePositions(&positions[0], count);
+    AoSoAVec3 wideVelocities(&velocities[0], count);
+    vec3w wideUp(up);
+    Bench("Integrate AoSoA x4096", 1 << 10, [&](int) {
+        for (int b = 0; b < widePositions.BlockCount(); b++) {
+            vec3w v = wideVelocities.Load(b);
+            vec3w p = widePositions.Load(b) + v * dt;
+            maskw below = p.y < 0.0f;
+            wideVelocities.Store(b, Select(below, Reflection(v, wideUp), v));
+            p.y = Select(below, -p.y, p.y);
+            widePositions.Store(b, p);
+        }
+        s_sink = widePositions.Get(0).x;
+    });
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1) {
+        s_scale = (float)atof(argv[1]);
+    }
+    if (argc > 2) {
+        s_filter = argv[2];
+    }
+    srand(1234);
+
+    BenchVectors();
+    BenchMatrices();
+    BenchGeometry2D();
+    BenchGJK();
+    BenchCollisionFile();
+    BenchTriangleMesh();
+    BenchHeightfield();
+    BenchKdTree();
+    BenchParticles();
+    BenchSoftBody();
+    BenchJoints();
+    BenchTriggers();
+    BenchQueryWorld();
+    BenchDistanceField();
+    BenchOccupancyGrid();
+    BenchSnapshot();
+    BenchCompression();
+    BenchWide();
+    return 0;
+}
@@ -1,9 +1,76 @@
-echo "Building..."
-# start_time=$(date +%s)
-start_time=$SECONDS
-g++ -std=c++11 vectors.cpp Geometry2d.cpp matrices.cpp main.cpp
-# end_time=$(date +%s)
-end_time=$SECONDS
-time_taken=$((end_time-start_time))
-# time_taken=$(echo "$END - $START" | bc)
-echo "Build Completed. Time taken: $time_taken secs"
+#!/bin/sh
+# Thin wrapper around the CMake build.
+#
+#   ./build.sh            optimized Release build in build/
+#   ./build.sh native     Release tuned for this CPU (-march=native) + LTO
+#   ./build.sh debug      Debug build in build-debug/
+#   ./build.sh asan       Debug build with address/undefined sanitizers
+#   ./build.sh pgo        profile guided build: instrumented build, training
+#                         run of the benchmark, then the optimized rebuild
+#
+# Each mode runs the tests (ctest) on the finished build.
+# Extra arguments are forwarded to the CMake configure step.
+set -e
+
+mode=${1:-release}
+[ $# -gt 0 ] && shift
+jobs=$(nproc 2>/dev/null || echo 4)
+
+configure_and_build() {
+    dir=$1
+    shift
+    cmake -S . -B "$dir" "$@"
+    cmake --build "$dir" -j"$jobs"
+}
+
+run_tests() {
+    (cd "$1" && ctest --output-on-failure)
+}
+
+echo "Building ($mode)..."
+start_time=$(date +%s)
+
+case "$mode" in
+    release)
+        configure_and_build build -DCMAKE_BUILD_TYPE=Release "$@"
+        run_tests build
+        ;;
+    native)
+        configure_and_build build-native -DCMAKE_BUILD_TYPE=Release \
+            -DGAMEPHYSICS_ARCH=native -DGAMEPHYSICS_LTO=ON "$@"
+        run_tests build-native
+        ;;
+    debug)
+        configure_and_build build-debug -DCMAKE_BUILD_TYPE=Debug "$@"
+        run_tests build-debug
+        ;;
+    asan)
+        configure_and_build build-asan -DCMAKE_BUILD_TYPE=Debug \
+            -DGAMEPHYSICS_SANITIZE=address,undefined "$@"
+        run_tests build-asan
+        ;;
+    pgo)
+        # Both stages use the same build directory, GCC looks profiles up by
+        # the object file path.
+        profiles="$(pwd)/build-pgo/profiles"
+        rm -rf "$profiles"
+        configure_and_build build-pgo -DCMAKE_BUILD_TYPE=Release \
+            -DGAMEPHYSICS_PGO=GENERATE -DGAMEPHYSICS_PGO_DIR="$profiles" "$@"
+        ./build-pgo/gamephysics_bench 0.25
+        if ls "$profiles"/*.profraw >/dev/null 2>&1; then
+            llvm-profdata merge -o "$profiles/default.profdata" \
+                "$profiles"/*.profraw
+        fi
+        cmake -S . -B build-pgo -DGAMEPHYSICS_PGO=USE -DGAMEPHYSICS_LTO=ON "$@"
+        cmake --build build-pgo -j"$jobs" --clean-first
+        # Only the final build is tested, the training run is the benchmark
+        run_tests build-pgo
+        ;;
+    *)
+        echo "unknown mode: $mode (release, native, debug, asan, pgo)"
+        exit 1
+        ;;
+esac
+
+end_time=$(date +%s)
+echo "Build Completed. Time taken: $((end_time - start_time)) secs"
@@ -1,8 +1,19 @@
 #include "matrices.h"
+#include "Profiler.h"
 
 #include <cmath>
 #include <float.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+
+#if defined(GAMEPHYSICS_PACKED_MATRICES)
+#define LOAD_ROW(p) _mm_loadu_ps(p)
+#else
+#define LOAD_ROW(p) _mm_load_ps(p)
+#endif
+#endif
+
 /* For details on the float comparison, check
  * http://realtimecollisiondetection.net/pubs/Tolerances/
  */
@@ -15,6 +26,7 @@
 void Transpose(const float* srcMatrix, float* destMatrix,
         int srcRows, int srcCols)
 {
+    PROFILE_FUNCTION();
     for (int i = 0; i < (srcRows * srcCols); i++)
     {
         int row = i / srcRows;
@@ -25,27 +37,31 @@ void Transpose(const float* srcMatrix, float* destMatrix,
 
 mat2 Transpose(const mat2& matrix)
 {
+    PROFILE_FUNCTION();
     mat2 mT;
-    Transpose(matrix.asArray, mT.asArray, 2, 2);
+    Transpose<2, 2>(matrix.asArray, mT.asArray);
     return mT;
 }
 
 mat3 Transpose(const mat3& matrix)
 {
+    PROFILE_FUNCTION();
     mat3 mT;
-    Transpose(matrix.asArray, mT.asArray, 3, 3);
+    Transpose<3, 3>(matrix.asArray, mT.asArray);
     return mT;
 }
 
 mat4 Transpose(const mat4& matrix)
 {
+    PROFILE_FUNCTION();
     mat4 mT;
-    Transpose(matrix.asArray, mT.asArray, 4, 4);
+    Transpose<4, 4>(matrix.asArray, mT.asArray);
     return mT;
 }
 
 mat2 operator*(const mat2& matrix, float scalar)
 {
+    PROFILE_FUNCTION();
     mat2 result;
     for (int i = 0; i < 4; i++) {
         result.asArray[i] = matrix.asArray[i] * scalar;
@@ -55,6 +71,7 @@ mat2 operator*(const mat2& matrix, float scalar)
 
 mat3 operator*(const mat3& matrix, float scalar)
 {
+    PROFILE_FUNCTION();
     mat3 result;
     for (int i = 0; i < 9; i++) {
         result.asArray[i] = matrix.asArray[i] * scalar;
@@ -64,6 +81,7 @@ mat3 operator*(const mat3& matrix, float scalar)
 
 mat4 operator*(const mat4& matrix, float scalar)
 {
+    PROFILE_FUNCTION();
     mat4 result;
     for (int i = 0; i < 16; i++) {
         result.asArray[i] = matrix.asArray[i] * scalar;
@@ -76,6 +94,7 @@ bool Multiply(const float* matA, int aRows, int aCols,
               float* out
         )
 {
+    PROFILE_FUNCTION();
     if (aCols != bRows)
         return false;
 
@@ -95,55 +114,79 @@ bool Multiply(const float* matA, int aRows, int aCols,
 
 mat2 operator*(const mat2& m1, const mat2& m2)
 {
+    PROFILE_FUNCTION();
     mat2 result;
-    Multiply(m1.asArray, 2, 2, m2.asArray, 2, 2, result.asArray);
+    Multiply<2, 2, 2, 2>(m1.asArray, m2.asArray, result.asArray);
     return result;
 }
 
 mat3 operator*(const mat3& m1, const mat3& m2)
 {
+    PROFILE_FUNCTION();
     mat3 result;
-    Multiply(m1.asArray, 3, 3, m2.asArray, 3, 3, result.asArray);
+    Multiply<3, 3, 3, 3>(m1.asArray, m2.asArray, result.asArray);
     return result;
 }
 
 mat4 operator*(const mat4& m1, const mat4& m2)
 {
+    PROFILE_FUNCTION();
     mat4 result;
-    Multiply(m1.asArray, 4, 4, m2.asArray, 4, 4, result.asArray);
+#if defined(__SSE2__)
+    // Each result row is m1's row weighting the rows of m2, summed in the
+    // same order as Multiply<> so the results match bit for bit
+    __m128 r0 = LOAD_ROW(m2.asArray);
+    __m128 r1 = LOAD_ROW(m2.asArray + 4);
+    __m128 r2 = LOAD_ROW(m2.asArray + 8);
+    __m128 r3 = LOAD_ROW(m2.asArray + 12);
+    for (int i = 0; i < 4; i++) {
+        const float* a = m1.asArray + i * 4;
+        __m128 row = _mm_mul_ps(_mm_set1_ps(a[0]), r0);
+        row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(a[1]), r1));
+        row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(a[2]), r2));
+        row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(a[3]), r3));
+        _mm_storeu_ps(result.asArray + i * 4, row);
+    }
+#else
+    Multiply<4, 4, 4, 4>(m1.asArray, m2.asArray, result.asArray);
+#endif
     return result;
 }
 
 float Determinant(const mat2& matrix)
 {
+    PROFILE_FUNCTION();
     return (matrix._11 * matrix._22) -
            (matrix._21 * matrix._12);
 }
 
 float Determinant(const mat3& matrix)
 {
+    PROFILE_FUNCTION();
+    // Expansion along the first row, only its cofactors are needed
     float result = 0.0f;
-    mat3 cofactor = Cofactor(matrix);
     for (int i = 0; i < 3; i++) {
-        int index = 3 * 0 + i;
-        result += (matrix.asArray[index] * cofactor[0][i]);
+        float minor = Determinant(Cut(matrix, 0, i));
+        result += matrix.asArray[i] * ((i & 1) ? -minor : minor);
     }
     return result;
 }
 
 float Determinant(const mat4& matrix)
 {
+    PROFILE_FUNCTION();
+    // Expansion along the first row, only its cofactors are needed
     float result = 0.0f;
-    mat4 cofactor = Cofactor(matrix);
     for (int i = 0; i < 4; i++) {
-        int index = 4 * 0 + i;
-        result += (matrix.asArray[index] * cofactor[0][i]);
+        float minor = Determinant(Cut(matrix, 0, i));
+        result += matrix.asArray[i] * ((i & 1) ? -minor : minor);
     }
     return result;
 }
 
 mat2 Cut(const mat3& source, int x, int y)
 {
+    PROFILE_FUNCTION();
     int index = 0;
     mat2 result;
     for (int i = 0; i < 3; i++) {
@@ -158,6 +201,7 @@ mat2 Cut(const mat3& source, int x, int y)
 
 mat3 Cut(const mat4& source, int x, int y)
 {
+    PROFILE_FUNCTION();
     int index = 0;
     mat3 result;
     for (int i = 0; i < 4; i++) {
@@ -172,6 +216,7 @@ mat3 Cut(const mat4& source, int x, int y)
 
 mat4 Minor(const mat4& matrix)
 {
+    PROFILE_FUNCTION();
     mat4 result;
     for (int i = 0; i < 4; i++) {
         for (int j = 0; j < 4; j++) {
@@ -183,6 +228,7 @@ mat4 Minor(const mat4& matrix)
 
 mat3 Minor(const mat3& matrix)
 {
+    PROFILE_FUNCTION();
     mat3 result;
     for (int i = 0; i < 3; i++) {
         for (int j = 0; j < 3; j++) {
@@ -194,12 +240,14 @@ mat3 Minor(const mat3& matrix)
 
 mat2 Minor(const mat2& matrix)
 {
+    PROFILE_FUNCTION();
     return mat2(matrix._22, matrix._21,
                 matrix._12, matrix._11);
 }
 
 void Cofactor(float* out, const float* minor, int row, int col)
 {
+    PROFILE_FUNCTION();
     for (int i = 0; i < row; i++) {
         for (int j = 0; j < col; j++) {
             float sign = powf(-1, i + j);
@@ -211,42 +259,49 @@ void Cofactor(float* out, const float* minor, int row, int col)
 
 mat2 Cofactor(const mat2& matrix)
 {
+    PROFILE_FUNCTION();
     mat2 result;
-    Cofactor(result.asArray, matrix.asArray, 2, 2);
+    Cofactor<2, 2>(result.asArray, Minor(matrix).asArray);
     return result;
 }
 
 mat3 Cofactor(const mat3& matrix)
 {
+    PROFILE_FUNCTION();
     mat3 result;
-    Cofactor(result.asArray, matrix.asArray, 3, 3);
+    Cofactor<3, 3>(result.asArray, Minor(matrix).asArray);
     return result;
 }
 
 mat4 Cofactor(const mat4& matrix)
 {
+    PROFILE_FUNCTION();
     mat4 result;
-    Cofactor(result.asArray, matrix.asArray, 4, 4);
+    Cofactor<4, 4>(result.asArray, Minor(matrix).asArray);
     return result;
 }
 
 mat2 Adjugate(const mat2& matrix)
 {
+    PROFILE_FUNCTION();
     return Transpose(Cofactor(matrix));
 }
 
 mat3 Adjugate(const mat3& matrix)
 {
+    PROFILE_FUNCTION();
     return Transpose(Cofactor(matrix));
 }
 
 mat4 Adjugate(const mat4& matrix)
 {
+    PROFILE_FUNCTION();
     return Transpose(Cofactor(matrix));
 }
 
 mat2 Inverse(const mat2& matrix)
 {
+    PROFILE_FUNCTION();
     // Adjugate / Determinant
     float det = Determinant(matrix);
     if (FLOAT_CMP(det, 0.0f)) { return mat2(); }
@@ -255,6 +310,7 @@ mat2 Inverse(const mat2& matrix)
 
 mat3 Inverse(const mat3& matrix)
 {
+    PROFILE_FUNCTION();
     float det = Determinant(matrix);
     if (FLOAT_CMP(det, 0.0f)) { return mat3(); }
     return Adjugate(matrix) * (1.0f / det);
@@ -262,6 +318,7 @@ mat3 Inverse(const mat3& matrix)
 
 mat4 Inverse(const mat4& matrix)
 {
+    PROFILE_FUNCTION();
     float det = Determinant(matrix);
     if (FLOAT_CMP(det, 0.0f)) { return mat4(); }
     return Adjugate(matrix) * (1.0f / det);
@@ -269,6 +326,7 @@ mat4 Inverse(const mat4& matrix)
 
 mat4 Translation(float x, float y, float z)
 {
+    PROFILE_FUNCTION();
     return mat4(
             1.0f, 0.0f, 0.0f, 0.0f,
             0.0f, 1.0f, 0.0f, 0.0f,
@@ -279,6 +337,7 @@ mat4 Translation(float x, float y, float z)
 
 mat4 Translation(const vec3& pos)
 {
+    PROFILE_FUNCTION();
     return mat4(
             1.0f, 0.0f, 0.0f, 0.0f,
             0.0f, 1.0f, 0.0f, 0.0f,
@@ -289,11 +348,13 @@ mat4 Translation(const vec3& pos)
 
 vec3 GetTranslation(mat4 matrix)
 {
+    PROFILE_FUNCTION();
     return vec3(matrix._41, matrix._42, matrix._43);
 }
 
 mat4 Scale(float x, float y, float z)
 {
+    PROFILE_FUNCTION();
     return mat4(
             x,    0.0f, 0.0f, 0.0f,
             0.0f, y,    0.0f, 0.0f,
@@ -304,6 +365,7 @@ mat4 Scale(float x, float y, float z)
 
 mat4 Scale(const vec3& vec)
 {
+    PROFILE_FUNCTION();
     return mat4(
             vec.x, 0.0f, 0.0f, 0.0f,
             0.0f, vec.y, 0.0f, 0.0f,
@@ -314,11 +376,13 @@ mat4 Scale(const vec3& vec)
 
 vec3 GetScale(mat4 matrix)
 {
+    PROFILE_FUNCTION();
     return vec3(matrix._11, matrix._22, matrix._33);
 }
 
 mat4 Rotation(float pitch, float yaw, float roll)
 {
+    PROFILE_FUNCTION();
     return ZRotation(roll) *
            XRotation(pitch) *
            YRotation(yaw);
@@ -326,6 +390,7 @@ mat4 Rotation(float pitch, float yaw, float roll)
 
 mat3 Rotation3x3(float pitch, float yaw, float roll)
 {
+    PROFILE_FUNCTION();
     return ZRotation3x3(roll) *
            XRotation3x3(pitch) *
            YRotation3x3(yaw);
@@ -333,6 +398,7 @@ mat3 Rotation3x3(float pitch, float yaw, float roll)
 
 mat4 ZRotation(float angle)
 {
+    PROFILE_FUNCTION();
     angle = DEG2RAD(angle);
     return mat4(
             cosf(angle),  sinf(angle), 0.0f, 0.0f,
@@ -344,6 +410,7 @@ mat4 ZRotation(float angle)
 
 mat3 ZRotation3x3(float angle)
 {
+    PROFILE_FUNCTION();
     angle = DEG2RAD(angle);
     return mat3(
             cosf(angle),  sinf(angle), 0.0f,
@@ -354,6 +421,7 @@ mat3 ZRotation3x3(float angle)
 
 mat4 YRotation(float angle)
 {
+    PROFILE_FUNCTION();
     angle = DEG2RAD(angle);
     return mat4(
             cosf(angle),  0.0f, -sinf(angle), 0.0f,
@@ -365,6 +433,7 @@ mat4 YRotation(float angle)
 
 mat3 YRotation3x3(float angle)
 {
+    PROFILE_FUNCTION();
     angle = DEG2RAD(angle);
     return mat3(
             cosf(angle),  0.0f, -sinf(angle),
@@ -375,6 +444,7 @@ mat3 YRotation3x3(float angle)
 
 mat4 XRotation(float angle)
 {
+    PROFILE_FUNCTION();
     angle = DEG2RAD(angle);
     return mat4(
             1.0f, 0.0f,         0.0f,          0.0f,
@@ -386,6 +456,7 @@ mat4 XRotation(float angle)
 
 mat3 XRotation3x3(float angle)
 {
+    PROFILE_FUNCTION();
     angle = DEG2RAD(angle);
     return mat3(
             1.0f, 0.0f,         0.0f,
@@ -396,10 +467,11 @@ mat3 XRotation3x3(float angle)
 
 mat4 AxisAngle(const vec3& axis, float angle)
 {
+    PROFILE_FUNCTION();
     angle = DEG2RAD(angle);
     float s = sinf(angle);
     float c = cosf(angle);
-    float t = 1 - s;
+    float t = 1 - c;
 
     float x = axis.x;
     float y = axis.y;
@@ -414,19 +486,20 @@ mat4 AxisAngle(const vec3& axis, float angle)
     }
 
     return mat4(
-            (t * x * x) + c, (t * x * y) + (s * z), (t * x* z) + (s * y), 0.0f,
-            (t * x * y) + (s * z), (t * y * y) + c, (t * y * z) + (s * x), 0.0f,
-            (t * x * y) + (s * y), (t * y * z) + (s * x), (t * z * z) + c, 0.0f,
-            0.0f, 0.0f, 0.0f, 0.0f
+            (t * x * x) + c, (t * x * y) + (s * z), (t * x * z) - (s * y), 0.0f,
+            (t * x * y) - (s * z), (t * y * y) + c, (t * y * z) + (s * x), 0.0f,
+            (t * x * z) + (s * y), (t * y * z) - (s * x), (t * z * z) + c, 0.0f,
+            0.0f, 0.0f, 0.0f, 1.0f
             );
 }
 
 mat3 AxisAngle3x3(const vec3& axis, float angle)
 {
+    PROFILE_FUNCTION();
     angle = DEG2RAD(angle);
     float s = sinf(angle);
     float c = cosf(angle);
-    float t = 1 - s;
+    float t = 1 - c;
 
     float x = axis.x;
     float y = axis.y;
@@ -441,14 +514,237 @@ mat3 AxisAngle3x3(const vec3& axis, float angle)
     }
 
     return mat3(
-            (t * x * x) + c, (t * x * y) + (s * z), (t * x* z) + (s * y),
-            (t * x * y) + (s * z), (t * y * y) + c, (t * y * z) + (s * x),
-            (t * x * y) + (s * y), (t * y * z) + (s * x), (t * z * z) + c
+            (t * x * x) + c, (t * x * y) + (s * z), (t * x * z) - (s * y),
+            (t * x * y) - (s * z), (t * y * y) + c, (t * y * z) + (s * x),
+            (t * x * z) + (s * y), (t * y * z) - (s * x), (t * z * z) + c
             );
 }
 
+/* The batch builders work on blocks of BATCH_LANES elements, first
+ * gathering the inputs into SoA lanes, then running the trig and the
+ * normalization across all lanes at once and finally scattering the
+ * matrices out.
+ */
+#define BATCH_LANES 4
+
+// sin and cos of up to BATCH_LANES angles given in degrees
+static void SinCosLanes(const float* angles, float* s, float* c, int n)
+{
+#if defined(__SSE2__)
+    float in[BATCH_LANES] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < n; i++) {
+        in[i] = DEG2RAD(angles[i]);
+    }
+
+    // Reduce to r in [-pi/4, pi/4] with x = q * (pi/2) + r. pi/2 is split
+    // into three parts so the reduction stays exact for large q.
+    __m128 x = _mm_loadu_ps(in);
+    __m128i q = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(0.63661977f)));
+    __m128 qf = _mm_cvtepi32_ps(q);
+    __m128 r = _mm_sub_ps(x, _mm_mul_ps(qf, _mm_set1_ps(1.5703125f)));
+    r = _mm_sub_ps(r, _mm_mul_ps(qf, _mm_set1_ps(4.837512969970703125e-4f)));
+    r = _mm_sub_ps(r, _mm_mul_ps(qf, _mm_set1_ps(7.54978995489188216e-8f)));
+    __m128 z = _mm_mul_ps(r, r);
+
+    // Minimax polynomials from Cephes, valid on [-pi/4, pi/4]
+    __m128 sr = _mm_add_ps(_mm_set1_ps(8.3321608736e-3f),
+                           _mm_mul_ps(z, _mm_set1_ps(-1.9515295891e-4f)));
+    sr = _mm_add_ps(_mm_set1_ps(-1.6666654611e-1f), _mm_mul_ps(z, sr));
+    sr = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, z), sr));
+
+    __m128 cr = _mm_add_ps(_mm_set1_ps(-1.388731625493765e-3f),
+                           _mm_mul_ps(z, _mm_set1_ps(2.443315711809948e-5f)));
+    cr = _mm_add_ps(_mm_set1_ps(4.166664568298827e-2f), _mm_mul_ps(z, cr));
+    cr = _mm_mul_ps(_mm_mul_ps(z, z), cr);
+    cr = _mm_add_ps(_mm_sub_ps(_mm_set1_ps(1.0f),
+                               _mm_mul_ps(z, _mm_set1_ps(0.5f))), cr);
+
+    // Odd quadrants swap sin and cos, the sign follows the quadrant
+    __m128i one = _mm_set1_epi32(1);
+    __m128i two = _mm_set1_epi32(2);
+    __m128 swap = _mm_castsi128_ps(
+            _mm_cmpeq_epi32(_mm_and_si128(q, one), one));
+    __m128 sinSign = _mm_castsi128_ps(
+            _mm_slli_epi32(_mm_and_si128(q, two), 30));
+    __m128 cosSign = _mm_castsi128_ps(
+            _mm_slli_epi32(_mm_and_si128(_mm_add_epi32(q, one), two), 30));
+
+    __m128 sinv = _mm_or_ps(_mm_and_ps(swap, cr), _mm_andnot_ps(swap, sr));
+    __m128 cosv = _mm_or_ps(_mm_and_ps(swap, sr), _mm_andnot_ps(swap, cr));
+    sinv = _mm_xor_ps(sinv, sinSign);
+    cosv = _mm_xor_ps(cosv, cosSign);
+
+    float sOut[BATCH_LANES];
+    float cOut[BATCH_LANES];
+    _mm_storeu_ps(sOut, sinv);
+    _mm_storeu_ps(cOut, cosv);
+    for (int i = 0; i < n; i++) {
+        s[i] = sOut[i];
+        c[i] = cOut[i];
+    }
+#else
+    for (int i = 0; i < n; i++) {
+        float angle = DEG2RAD(angles[i]);
+        s[i] = sinf(angle);
+        c[i] = cosf(angle);
+    }
+#endif
+}
+
+// Unit length copies of up to BATCH_LANES axes, split into x/y/z lanes
+static void NormalizeLanes(const vec3* axes, float* x, float* y, float* z,
+                           int n)
+{
+#if defined(__SSE2__)
+    float ax[BATCH_LANES] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    float ay[BATCH_LANES] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    float az[BATCH_LANES] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < n; i++) {
+        ax[i] = axes[i].x;
+        ay[i] = axes[i].y;
+        az[i] = axes[i].z;
+    }
+
+    __m128 vx = _mm_loadu_ps(ax);
+    __m128 vy = _mm_loadu_ps(ay);
+    __m128 vz = _mm_loadu_ps(az);
+    __m128 lenSq = _mm_add_ps(_mm_mul_ps(vx, vx),
+                   _mm_add_ps(_mm_mul_ps(vy, vy), _mm_mul_ps(vz, vz)));
+    __m128 invLen = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(lenSq));
+
+    _mm_storeu_ps(ax, _mm_mul_ps(vx, invLen));
+    _mm_storeu_ps(ay, _mm_mul_ps(vy, invLen));
+    _mm_storeu_ps(az, _mm_mul_ps(vz, invLen));
+    for (int i = 0; i < n; i++) {
+        x[i] = ax[i];
+        y[i] = ay[i];
+        z[i] = az[i];
+    }
+#else
+    for (int i = 0; i < n; i++) {
+        float invLen = 1.0f / Magnitude(axes[i]);
+        x[i] = axes[i].x * invLen;
+        y[i] = axes[i].y * invLen;
+        z[i] = axes[i].z * invLen;
+    }
+#endif
+}
+
+// Writes the 3x3 rotation part of each lane into rows of `stride` floats
+static void AxisAngleLanes(const vec3* axes, const float* angles,
+                           float* out, int stride, int n)
+{
+    float s[BATCH_LANES], c[BATCH_LANES];
+    float x[BATCH_LANES], y[BATCH_LANES], z[BATCH_LANES];
+    SinCosLanes(angles, s, c, n);
+    NormalizeLanes(axes, x, y, z, n);
+
+    for (int i = 0; i < n; i++) {
+        float t = 1.0f - c[i];
+        float* m = out + i * stride * stride;
+        m[0] = (t * x[i] * x[i]) + c[i];
+        m[1] = (t * x[i] * y[i]) + (s[i] * z[i]);
+        m[2] = (t * x[i] * z[i]) - (s[i] * y[i]);
+        m[stride + 0] = (t * x[i] * y[i]) - (s[i] * z[i]);
+        m[stride + 1] = (t * y[i] * y[i]) + c[i];
+        m[stride + 2] = (t * y[i] * z[i]) + (s[i] * x[i]);
+        m[2 * stride + 0] = (t * x[i] * z[i]) + (s[i] * y[i]);
+        m[2 * stride + 1] = (t * y[i] * z[i]) - (s[i] * x[i]);
+        m[2 * stride + 2] = (t * z[i] * z[i]) + c[i];
+    }
+}
+
+// Closed form of ZRotation(roll) * XRotation(pitch) * YRotation(yaw)
+static void EulerLanes(const float* pitch, const float* yaw,
+                       const float* roll, float* out, int stride, int n)
+{
+    float sx[BATCH_LANES], cx[BATCH_LANES];
+    float sy[BATCH_LANES], cy[BATCH_LANES];
+    float sz[BATCH_LANES], cz[BATCH_LANES];
+    SinCosLanes(pitch, sx, cx, n);
+    SinCosLanes(yaw, sy, cy, n);
+    SinCosLanes(roll, sz, cz, n);
+
+    for (int i = 0; i < n; i++) {
+        float* m = out + i * stride * stride;
+        m[0] = cz[i] * cy[i] + sz[i] * sx[i] * sy[i];
+        m[1] = sz[i] * cx[i];
+        m[2] = sz[i] * sx[i] * cy[i] - cz[i] * sy[i];
+        m[stride + 0] = cz[i] * sx[i] * sy[i] - sz[i] * cy[i];
+        m[stride + 1] = cz[i] * cx[i];
+        m[stride + 2] = sz[i] * sy[i] + cz[i] * sx[i] * cy[i];
+        m[2 * stride + 0] = cx[i] * sy[i];
+        m[2 * stride + 1] = -sx[i];
+        m[2 * stride + 2] = cx[i] * cy[i];
+    }
+}
+
+void AxisAngleBatch(const vec3* axes, const float* angles,
+                    mat4* out, int count)
+{
+    PROFILE_FUNCTION();
+    for (int i = 0; i < count; i += BATCH_LANES) {
+        int n = (count - i < BATCH_LANES) ? count - i : BATCH_LANES;
+        for (int j = 0; j < n; j++) {
+            out[i + j] = mat4();
+        }
+        AxisAngleLanes(axes + i, angles + i, out[i].asArray, 4, n);
+    }
+}
+
+void AxisAngle3x3Batch(const vec3* axes, const float* angles,
+                       mat3* out, int count)
+{
+    PROFILE_FUNCTION();
+    for (int i = 0; i < count; i += BATCH_LANES) {
+        int n = (count - i < BATCH_LANES) ? count - i : BATCH_LANES;
+        AxisAngleLanes(axes + i, angles + i, out[i].asArray, 3, n);
+    }
+}
+
+void RotationBatch(const float* pitch, const float* yaw, const float* roll,
+                   mat4* out, int count)
+{
+    PROFILE_FUNCTION();
+    for (int i = 0; i < count; i += BATCH_LANES) {
+        int n = (count - i < BATCH_LANES) ? count - i : BATCH_LANES;
+        for (int j = 0; j < n; j++) {
+            out[i + j] = mat4();
+        }
+        EulerLanes(pitch + i, yaw + i, roll + i, out[i].asArray, 4, n);
+    }
+}
+
+void Rotation3x3Batch(const float* pitch, const float* yaw, const float* roll,
+                      mat3* out, int count)
+{
+    PROFILE_FUNCTION();
+    for (int i = 0; i < count; i += BATCH_LANES) {
+        int n = (count - i < BATCH_LANES) ? count - i : BATCH_LANES;
+        EulerLanes(pitch + i, yaw + i, roll + i, out[i].asArray, 3, n);
+    }
+}
+
+void ZRotation3x3Batch(const float* angles, mat3* out, int count)
+{
+    PROFILE_FUNCTION();
+    float s[BATCH_LANES], c[BATCH_LANES];
+    for (int i = 0; i < count; i += BATCH_LANES) {
+        int n = (count - i < BATCH_LANES) ? count - i : BATCH_LANES;
+        SinCosLanes(angles + i, s, c, n);
+        for (int j = 0; j < n; j++) {
+            out[i + j] = mat3(
+                    c[j],  s[j], 0.0f,
+                    -s[j], c[j], 0.0f,
+                    0.0f,  0.0f, 1.0f
+                    );
+        }
+    }
+}
+
 vec3 MultiplyPoint(const vec3& point, const mat4& mat)
 {
+    PROFILE_FUNCTION();
     vec3 result;
     result.x = point.x * mat._11 + point.y * mat._21 +
                point.z * mat._31 + 1.0f * mat._41;
@@ -461,6 +757,7 @@ vec3 MultiplyPoint(const vec3& point, const mat4& mat)
 
 vec3 MultiplyVector(const vec3& vec, const mat4& mat)
 {
+    PROFILE_FUNCTION();
     vec3 result;
     result.x = vec.x * mat._11 + vec.y * mat._21 +
                vec.z * mat._31 + 0.0f * mat._41;
@@ -473,6 +770,7 @@ vec3 MultiplyVector(const vec3& vec, const mat4& mat)
 
 vec3 MultiplyVector(const vec3& vec, const mat3& mat)
 {
+    PROFILE_FUNCTION();
     vec3 result;
     result.x = Dot(vec, vec3(mat._11, mat._21, mat._31));
     result.y = Dot(vec, vec3(mat._12, mat._22, mat._32));
@@ -480,9 +778,122 @@ vec3 MultiplyVector(const vec3& vec, const mat3& mat)
     return result;
 }
 
+/* x * row0 + y * row1 + z * row2 + w * row3, w being 1 for points and 0
+ * for directions. The sum runs in the same order as the scalar versions.
+ */
+#if defined(__SSE2__)
+static inline __m128 TransformRow(const float* v, const mat4& mat, bool point)
+{
+    __m128 result = _mm_mul_ps(_mm_set1_ps(v[0]), LOAD_ROW(mat.asArray));
+    result = _mm_add_ps(result, _mm_mul_ps(_mm_set1_ps(v[1]),
+                                           LOAD_ROW(mat.asArray + 4)));
+    result = _mm_add_ps(result, _mm_mul_ps(_mm_set1_ps(v[2]),
+                                           LOAD_ROW(mat.asArray + 8)));
+    if (point) {
+        result = _mm_add_ps(result, LOAD_ROW(mat.asArray + 12));
+    }
+    return result;
+}
+#endif
+
+vec4 operator*(const vec4& vec, const mat4& mat)
+{
+    PROFILE_FUNCTION();
+    vec4 result;
+#if defined(__SSE2__)
+    __m128 sum = TransformRow(vec.asArray, mat, false);
+    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(vec.w),
+                                     LOAD_ROW(mat.asArray + 12)));
+    _mm_store_ps(result.asArray, sum);
+#else
+    for (int j = 0; j < 4; j++) {
+        result.asArray[j] = vec.x * mat.asArray[j] +
+                            vec.y * mat.asArray[4 + j] +
+                            vec.z * mat.asArray[8 + j] +
+                            vec.w * mat.asArray[12 + j];
+    }
+#endif
+    return result;
+}
+
+vec3a MultiplyPoint(const vec3a& point, const mat4& mat)
+{
+    PROFILE_FUNCTION();
+#if defined(__SSE2__)
+    vec3a result;
+    _mm_store_ps(result.asArray, TransformRow(point.asArray, mat, true));
+    result.pad = 0.0f;
+    return result;
+#else
+    return vec3a(MultiplyPoint(ToVec3(point), mat));
+#endif
+}
+
+vec3a MultiplyVector(const vec3a& vec, const mat4& mat)
+{
+    PROFILE_FUNCTION();
+#if defined(__SSE2__)
+    vec3a result;
+    _mm_store_ps(result.asArray, TransformRow(vec.asArray, mat, false));
+    result.pad = 0.0f;
+    return result;
+#else
+    return vec3a(MultiplyVector(ToVec3(vec), mat));
+#endif
+}
+
+ArenaVector<vec3> MultiplyPoints(const vec3* points, int count,
+                                 const mat4& mat, FrameArena* arena)
+{
+    PROFILE_FUNCTION();
+    ArenaVector<vec3> result((ArenaAllocator<vec3>(arena)));
+    result.reserve(count);
+    for (int i = 0; i < count; i++) {
+        result.push_back(MultiplyPoint(points[i], mat));
+    }
+    return result;
+}
+
+ArenaVector<vec3> MultiplyVectors(const vec3* vecs, int count,
+                                  const mat4& mat, FrameArena* arena)
+{
+    PROFILE_FUNCTION();
+    ArenaVector<vec3> result((ArenaAllocator<vec3>(arena)));
+    result.reserve(count);
+    for (int i = 0; i < count; i++) {
+        result.push_back(MultiplyVector(vecs[i], mat));
+    }
+    return result;
+}
+
+ArenaVector<vec3a> MultiplyPoints(const vec3a* points, int count,
+                                  const mat4& mat, FrameArena* arena)
+{
+    PROFILE_FUNCTION();
+    ArenaVector<vec3a> result((ArenaAllocator<vec3a>(arena)));
+    result.resize(count);
+    for (int i = 0; i < count; i++) {
+        result[i] = MultiplyPoint(points[i], mat);
+    }
+    return result;
+}
+
+ArenaVector<vec3a> MultiplyVectors(const vec3a* vecs, int count,
+                                   const mat4& mat, FrameArena* arena)
+{
+    PROFILE_FUNCTION();
+    ArenaVector<vec3a> result((ArenaAllocator<vec3a>(arena)));
+    result.resize(count);
+    for (int i = 0; i < count; i++) {
+        result[i] = MultiplyVector(vecs[i], mat);
+    }
+    return result;
+}
+
 mat4 Transform(const vec3& scale, const vec3& rotation,
         const vec3& translation)
 {
+    PROFILE_FUNCTION();
     return Scale(scale.x, scale.y, scale.z) *
            Rotation(rotation.x, rotation.y, rotation.z) *
            Translation(translation);
@@ -491,6 +902,7 @@ mat4 Transform(const vec3& scale, const vec3& rotation,
 mat4 Transform(const vec3& scale, const vec3& rotateAxis,
         float rotateAngle, const vec3& translation)
 {
+    PROFILE_FUNCTION();
     return Scale(scale.x, scale.y, scale.z) *
            AxisAngle(rotateAxis, rotateAngle) *
            Translation(translation);
@@ -500,6 +912,7 @@ mat4 Transform(const vec3& scale, const vec3& rotateAxis,
 mat4 LookAt(const vec3& pos, const vec3& target,
             const vec3& up)
 {
+    PROFILE_FUNCTION();
     vec3 forward = Normalized(target - pos);
     vec3 right = Normalized(Cross(up, forward));
     vec3 newUp = Cross(forward, right);
@@ -518,6 +931,7 @@ mat4 LookAt(const vec3& pos, const vec3& target,
 mat4 Projection(float fov, float aspect,
                 float zNear, float zFar)
 {
+    PROFILE_FUNCTION();
     float tanHalfFov = tanf(DEG2RAD(fov * 0.5f));
     float fovY = 1.0f / tanHalfFov;
     float fovX = fovY / aspect;
@@ -535,6 +949,7 @@ mat4 Projection(float fov, float aspect,
 mat4 Ortho(float left, float right, float bottom,
            float top, float zNear, float zFar)
 {
+    PROFILE_FUNCTION();
     float _11 = 2.0f / (right - left);
     float _22 = 2.0f / (top - bottom);
     float _33 = 1.0f / (zFar - zNear);
@@ -2,6 +2,7 @@
 #define _H_MATH_MATRICES_
 
 #include "vectors.h"
+#include "Memory.h"
 
 typedef struct mat2 {
     union {
@@ -62,7 +63,18 @@ typedef struct mat3 {
     }
 }mat3;
 
-typedef struct mat4 {
+/* mat4 is 16 byte aligned so each row loads as one SSE/NEON register.
+ * Building with GAMEPHYSICS_PACKED_MATRICES keeps the old 4 byte aligned
+ * layout for code that overlays mat4 on packed data; the SIMD paths then
+ * fall back to unaligned loads.
+ */
+#if defined(GAMEPHYSICS_PACKED_MATRICES)
+#define MAT4_ALIGN
+#else
+#define MAT4_ALIGN alignas(16)
+#endif
+
+typedef struct MAT4_ALIGN mat4 {
     union {
         struct {
             float _11, _12, _13, _14,
@@ -93,13 +105,73 @@ typedef struct mat4 {
                 float f41, float f42, float f43, float f44)
     {
         _11 = f11; _12 = f12; _13 = f13; _14 = f14;
-        _21 = f21; _22 = f22; _23 = f23; _24 = f14;
+        _21 = f21; _22 = f22; _23 = f23; _24 = f24;
         _31 = f31; _32 = f32; _33 = f33; _34 = f34;
         _41 = f41; _42 = f42; _43 = f43; _44 = f44;
     }
 }mat4;
 
-void Transpose(float* srcMatrix, float* destMatrix,
+/* Compile-time sized kernels.
+ *
+ * The runtime-dimension versions below loop over sizes that are only known
+ * at run time, so every mat2/mat3/mat4 operation paid for index math and a
+ * loop. These take the dimensions as template arguments instead; Unroll<N>
+ * expands the loop body N times so each size gets straight-line code.
+ */
+template<int N>
+struct Unroll {
+    template<typename F>
+    static inline void Step(const F& f)
+    {
+        Unroll<N - 1>::Step(f);
+        f(N - 1);
+    }
+};
+
+template<>
+struct Unroll<0> {
+    template<typename F>
+    static inline void Step(const F&) {}
+};
+
+template<int R, int C>
+inline void Transpose(const float* srcMatrix, float* destMatrix)
+{
+    static_assert(R > 0 && C > 0, "Transpose: invalid matrix size");
+    Unroll<R * C>::Step([&](int i) {
+        int row = i / C;
+        int col = i % C;
+        destMatrix[col * R + row] = srcMatrix[i];
+    });
+}
+
+template<int ARows, int ACols, int BRows, int BCols>
+inline void Multiply(const float* matA, const float* matB, float* out)
+{
+    static_assert(ACols == BRows,
+            "Multiply: columns of A must match rows of B");
+    Unroll<ARows * BCols>::Step([&](int idx) {
+        int i = idx / BCols;
+        int j = idx % BCols;
+        float sum = 0.0f;
+        Unroll<ACols>::Step([&](int k) {
+            sum += matA[i * ACols + k] * matB[k * BCols + j];
+        });
+        out[idx] = sum;
+    });
+}
+
+template<int R, int C>
+inline void Cofactor(float* out, const float* minor)
+{
+    static_assert(R > 0 && C > 0, "Cofactor: invalid matrix size");
+    Unroll<R * C>::Step([&](int i) {
+        // (-1)^(row + col)
+        out[i] = (((i / C) + (i % C)) & 1) ? -minor[i] : minor[i];
+    });
+}
+
+void Transpose(const float* srcMatrix, float* destMatrix,
         int srcRows, int srcCols);
 mat2 Transpose(const mat2& matrix);
 mat3 Transpose(const mat3& matrix);
@@ -132,7 +204,7 @@ mat4 Minor(const mat4& matrix);
 mat3 Minor(const mat3& matrix);
 mat2 Minor(const mat2& matrix);
 
-void Cofactor(const float* matrix, int row, int col);
+void Cofactor(float* out, const float* minor, int row, int col);
 mat2 Cofactor(const mat2& matrix);
 mat3 Cofactor(const mat3& matrix);
 mat4 Cofactor(const mat4& matrix);
@@ -173,10 +245,45 @@ mat3 XRotation3x3(float angle);
 mat4 AxisAngle(const vec3& axis, float angle);
 mat3 AxisAngle3x3(const vec3& axis, float angle);
 
+/* Batch rotation builders
+ *
+ * Build `count` matrices from parallel arrays of inputs (angles in degrees,
+ * like the single-matrix versions). sin/cos and axis normalization are
+ * evaluated four lanes at a time when SSE2 is available.
+ */
+void AxisAngleBatch(const vec3* axes, const float* angles,
+                    mat4* out, int count);
+void AxisAngle3x3Batch(const vec3* axes, const float* angles,
+                       mat3* out, int count);
+
+void RotationBatch(const float* pitch, const float* yaw, const float* roll,
+                   mat4* out, int count);
+void Rotation3x3Batch(const float* pitch, const float* yaw, const float* roll,
+                      mat3* out, int count);
+
+void ZRotation3x3Batch(const float* angles, mat3* out, int count);
+
 vec3 MultiplyPoint(const vec3& point, const mat4& mat);
 vec3 MultiplyVector(const vec3& vec, const mat4& mat);
 vec3 MultiplyVector(const vec3& vec, const mat3& mat);
 
+/* Row vector times matrix */
+vec4 operator*(const vec4& vec, const mat4& mat);
+vec3a MultiplyPoint(const vec3a& point, const mat4& mat);
+vec3a MultiplyVector(const vec3a& vec, const mat4& mat);
+
+/* Batch versions of MultiplyPoint/MultiplyVector. The result is allocated
+ * from `arena` when given, otherwise from the heap.
+ */
+ArenaVector<vec3> MultiplyPoints(const vec3* points, int count,
+                                 const mat4& mat, FrameArena* arena = 0);
+ArenaVector<vec3> MultiplyVectors(const vec3* vecs, int count,
+                                  const mat4& mat, FrameArena* arena = 0);
+ArenaVector<vec3a> MultiplyPoints(const vec3a* points, int count,
+                                  const mat4& mat, FrameArena* arena = 0);
+ArenaVector<vec3a> MultiplyVectors(const vec3a* vecs, int count,
+                                   const mat4& mat, FrameArena* arena = 0);
+
 mat4 Transform(const vec3& scale, const vec3& rotation,
         const vec3& translation);
 
@@ -0,0 +1,1564 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <vector>
+
+#include "vectors.h"
+#include "matrices.h"
+#include "Geometry2D.h"
+#include "Memory.h"
+#include "OccupancyGrid.h"
+#include "Parallel.h"
+#include "CollisionFile.h"
+#include "DistanceField.h"
+#include "Heightfield.h"
+#include "Joints.h"
+#include "KdTree.h"
+#include "Particles.h"
+#include "QueryWorld.h"
+#include "SoftBody.h"
+#include "TriangleMesh.h"
+#include "Triggers.h"
+#include "WorldPartition.h"
+
+/* Regression tests, mostly fast paths checked against a brute force or
+ * reference version of the same query.
+ *
+ * Run by ctest and at the end of each build.sh mode. Usage:
+ * gamephysics_tests [filter], `filter` only runs tests whose name
+ * contains it. The exit code is the number of failed tests.
+ */
+
+static const char* s_filter = 0;
+static int s_checks = 0;
+static int s_failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        s_checks++; \
+        if (!(condition)) { \
+            s_failures++; \
+            printf("  %s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, \
+                   #condition); \
+        } \
+    } while (0)
+
+static float RandomFloat(float min, float max)
+{
+    return min + (max - min) * ((float)rand() / (float)RAND_MAX);
+}
+
+static bool Near(float a, float b, float tolerance)
+{
+    return fabsf(a - b) <= tolerance;
+}
+
+template<typename F>
+static void Test(const char* name, const F& f, int* failed)
+{
+    if (s_filter && !strstr(name, s_filter)) {
+        return;
+    }
+    int failures = s_failures;
+    srand(1234);
+    f();
+    bool passed = (s_failures == failures);
+    printf("%-40s %s\n", name, passed ? "ok" : "FAILED");
+    if (!passed) {
+        (*failed)++;
+    }
+}
+
+static void TestMatrixInverse()
+{
+    for (int n = 0; n < 200; n++) {
+        mat4 m;
+        for (int i = 0; i < 16; i++) {
+            m.asArray[i] = RandomFloat(-4, 4);
+        }
+        if (fabsf(Determinant(m)) < 0.1f) {
+            continue;
+        }
+        mat4 identity = m * Inverse(m);
+        for (int i = 0; i < 16; i++) {
+            CHECK(Near(identity.asArray[i], (i % 5 == 0) ? 1.0f : 0.0f,
+                       1e-3f));
+        }
+
+        mat3 m3 = Cut(m, 0, 0);
+        if (fabsf(Determinant(m3)) > 0.1f) {
+            mat3 identity3 = m3 * Inverse(m3);
+            for (int i = 0; i < 9; i++) {
+                CHECK(Near(identity3.asArray[i], (i % 4 == 0) ? 1.0f : 0.0f,
+                           1e-3f));
+            }
+        }
+    }
+}
+
+static void TestCircleRectangle()
+{
+    // Against sampling the rectangle on a fine grid
+    for (int n = 0; n < 500; n++) {
+        Circle circle(Point2D(RandomFloat(-10, 10), RandomFloat(-10, 10)),
+                      RandomFloat(0.5f, 4.0f));
+        Rectangle2D rect(Point2D(RandomFloat(-10, 10), RandomFloat(-10, 10)),
+                         vec2(RandomFloat(0.5f, 6), RandomFloat(0.5f, 6)));
+        bool sampled = false;
+        bool nearEdge = false;
+        for (int y = 0; y <= 64 && !sampled; y++) {
+            for (int x = 0; x <= 64; x++) {
+                Point2D p = rect.origin + vec2(rect.size.x * x / 64.0f,
+                                               rect.size.y * y / 64.0f);
+                float d = Magnitude(p - circle.center) - circle.radius;
+                sampled |= d <= 0.0f;
+                nearEdge |= fabsf(d) < 0.2f;
+            }
+        }
+        if (!nearEdge) {
+            CHECK(CircleRectangle(circle, rect) == sampled);
+        }
+    }
+}
+
+/* Whether the segment crosses the closed box, by clipping it */
+static bool SegmentBox(const Line2D& line, const vec2& min, const vec2& max)
+{
+    float t0 = 0.0f;
+    float t1 = 1.0f;
+    vec2 d = line.end - line.start;
+    for (int axis = 0; axis < 2; axis++) {
+        float start = line.start.asArray[axis];
+        float delta = d.asArray[axis];
+        float lo = min.asArray[axis];
+        float hi = max.asArray[axis];
+        if (delta == 0.0f) {
+            if (start < lo || start > hi) {
+                return false;
+            }
+            continue;
+        }
+        float ta = (lo - start) / delta;
+        float tb = (hi - start) / delta;
+        t0 = fmaxf(t0, fminf(ta, tb));
+        t1 = fminf(t1, fmaxf(ta, tb));
+        if (t0 > t1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void TestLineRectangle()
+{
+    // The examples of segments parallel to an axis that were missed
+    CHECK(LineRectangle(Line2D(Point2D(3, -5), Point2D(3, 5)),
+                        Rectangle2D(Point2D(2, 0), vec2(2, 2))));
+    CHECK(LineRectangle(Line2D(Point2D(-5, 1), Point2D(5, 1)),
+                        Rectangle2D(Point2D(0, 0), vec2(2, 2))));
+    CHECK(!LineRectangle(Line2D(Point2D(5, -5), Point2D(5, 5)),
+                         Rectangle2D(Point2D(2, 0), vec2(2, 2))));
+    CHECK(LineOrientedRectangle(Line2D(Point2D(0, -5), Point2D(0, 5)),
+                                OrientedRectangle(Point2D(0, 0),
+                                                  vec2(1, 1), 30.0f)));
+
+    // Against clipping, away from the touching cases
+    const float epsilon = 1e-3f;
+    vec2 grow(epsilon, epsilon);
+    for (int n = 0; n < 20000; n++) {
+        Point2D start(RandomFloat(-10, 10), RandomFloat(-10, 10));
+        Line2D line(start, start + vec2(RandomFloat(-10, 10),
+                                        RandomFloat(-10, 10)));
+        if (n % 3 == 0) {
+            line.end.x = line.start.x;
+        }
+        else if (n % 3 == 1) {
+            line.end.y = line.start.y;
+        }
+        Rectangle2D rect(Point2D(RandomFloat(-10, 10), RandomFloat(-10, 10)),
+                         vec2(RandomFloat(0.5f, 6), RandomFloat(0.5f, 6)));
+        bool inside = SegmentBox(line, GetMin(rect) + grow,
+                                 GetMax(rect) - grow);
+        bool touching = SegmentBox(line, GetMin(rect) - grow,
+                                   GetMax(rect) + grow);
+        if (inside == touching) {
+            CHECK(LineRectangle(line, rect) == inside);
+        }
+    }
+}
+
+static void TestFrameArena()
+{
+    FrameArena arena(1024);
+    void* a = arena.Allocate(24);
+    size_t marker = arena.GetMarker();
+    void* b = arena.Allocate(100, 64);
+    CHECK(a != 0 && b != 0);
+    CHECK(((size_t)b & 63) == 0);
+    arena.FreeToMarker(marker);
+    CHECK(arena.Used() == marker);
+    CHECK(arena.Allocate(100, 64) == b);
+    arena.Reset();
+    CHECK(arena.Used() == 0);
+}
+
+static void TestSweptCircles()
+{
+    const int count = 400;
+    std::vector<Line2D> lines(count);
+    std::vector<Rectangle2D> rects(count);
+    std::vector<OrientedRectangle> boxes(count);
+    for (int i = 0; i < count; i++) {
+        Point2D start(RandomFloat(0, 400), RandomFloat(0, 400));
+        lines[i] = Line2D(start, start + vec2(RandomFloat(-20, 20),
+                                              RandomFloat(-20, 20)));
+        rects[i] = Rectangle2D(Point2D(RandomFloat(0, 400),
+                                       RandomFloat(0, 400)),
+                               vec2(RandomFloat(0.5f, 10),
+                                    RandomFloat(0.5f, 10)));
+        boxes[i] = OrientedRectangle(Point2D(RandomFloat(0, 400),
+                                             RandomFloat(0, 400)),
+                                     vec2(RandomFloat(0.5f, 6),
+                                          RandomFloat(0.5f, 6)),
+                                     RandomFloat(0, 360));
+    }
+    SweptTargets targets;
+    targets.lines = &lines[0];
+    targets.lineCount = count;
+    targets.rectangles = &rects[0];
+    targets.rectangleCount = count;
+    targets.orientedRectangles = &boxes[0];
+    targets.orientedRectangleCount = count;
+
+    const int moverCount = 1000;
+    std::vector<Circle> movers(moverCount);
+    std::vector<vec2> velocities(moverCount);
+    for (int i = 0; i < moverCount; i++) {
+        movers[i] = Circle(Point2D(RandomFloat(-20, 420),
+                                   RandomFloat(-20, 420)),
+                           RandomFloat(0.2f, 3.0f));
+        velocities[i] = vec2(RandomFloat(-60, 60), RandomFloat(-60, 60));
+    }
+
+    // Earliest time of impact of every mover, testing every shape
+    std::vector<float> expected(moverCount, 2.0f);
+    for (int i = 0; i < moverCount; i++) {
+        float t;
+        for (int j = 0; j < count; j++) {
+            if (SweptCircleLine(movers[i], velocities[i], lines[j], &t)) {
+                expected[i] = fminf(expected[i], t);
+            }
+            if (SweptCircleRectangle(movers[i], velocities[i], rects[j],
+                                     &t)) {
+                expected[i] = fminf(expected[i], t);
+            }
+            if (SweptCircleOrientedRectangle(movers[i], velocities[i],
+                                             boxes[j], &t)) {
+                expected[i] = fminf(expected[i], t);
+            }
+        }
+    }
+
+    FrameArena arena(1 << 16);
+    ArenaVector<SweptHit> hits = SweptCircles(&movers[0], &velocities[0],
+                                              moverCount, targets, &arena);
+    CHECK(hits.size() > moverCount / 10);
+    std::vector<float> found(moverCount, 2.0f);
+    for (size_t i = 0; i < hits.size(); i++) {
+        found[hits[i].mover] = hits[i].toi;
+    }
+    for (int i = 0; i < moverCount; i++) {
+        CHECK(found[i] == expected[i]);
+    }
+
+    // The grid query gives the same hits
+    std::vector<uint8_t> buffer;
+    const void* image = 0;
+    size_t size = 0;
+    CollisionFile file;
+    CHECK(BakeCollisionMemory(targets, buffer, &image, &size, 16.0f));
+    CHECK(file.OpenMemory(image, size));
+    ArenaVector<SweptHit> gridHits = file.QuerySweptCircles(
+            &movers[0], &velocities[0], moverCount, &arena);
+    CHECK(gridHits.size() == hits.size());
+    for (size_t i = 0; i < gridHits.size() && i < hits.size(); i++) {
+        CHECK(gridHits[i].mover == hits[i].mover);
+        CHECK(gridHits[i].type == hits[i].type);
+        CHECK(gridHits[i].target == hits[i].target);
+        CHECK(gridHits[i].toi == hits[i].toi);
+    }
+}
+
+static void TestCollisionFileWalls()
+{
+    // Horizontal and vertical walls crossing many grid cells are found
+    // away from their ends
+    std::vector<Line2D> walls;
+    walls.push_back(Line2D(Point2D(0, 50), Point2D(100, 50)));
+    walls.push_back(Line2D(Point2D(30, 0), Point2D(30, 100)));
+    SweptTargets targets;
+    targets.lines = &walls[0];
+    targets.lineCount = (int)walls.size();
+
+    std::vector<uint8_t> buffer;
+    const void* image = 0;
+    size_t size = 0;
+    CollisionFile file;
+    CHECK(BakeCollisionMemory(targets, buffer, &image, &size, 5.0f));
+    CHECK(file.OpenMemory(image, size));
+
+    FrameArena arena(1 << 16);
+    ArenaVector<StaticShapeRef> hits = file.QueryCircle(
+            Circle(Point2D(52, 50.5f), 1), &arena);
+    CHECK(hits.size() == 1 && hits[0].type == SWEPT_LINE &&
+          hits[0].index == 0);
+    hits = file.QueryCircle(Circle(Point2D(29.5f, 77), 1), &arena);
+    CHECK(hits.size() == 1 && hits[0].index == 1);
+    hits = file.QueryLine(Line2D(Point2D(70, 40), Point2D(71, 60)), &arena);
+    CHECK(hits.size() == 1 && hits[0].index == 0);
+    hits = file.QueryLine(Line2D(Point2D(20, 20), Point2D(40, 21)), &arena);
+    CHECK(hits.size() == 1 && hits[0].index == 1);
+
+    Circle movers[2] = { Circle(Point2D(80, 40), 1),
+                         Circle(Point2D(11, 12), 1) };
+    vec2 velocities[2] = { vec2(0, 20), vec2(40, 0) };
+    ArenaVector<SweptHit> swept = file.QuerySweptCircles(movers, velocities,
+                                                         2, &arena);
+    CHECK(swept.size() == 2);
+    for (size_t i = 0; i < swept.size(); i++) {
+        CHECK(swept[i].target == swept[i].mover);
+        CHECK(Near(swept[i].toi, 0.45f, 1e-4f));
+    }
+}
+
+static void TestTriangleMesh()
+{
+    // Enough triangles for the top of the build to bin in chunks, all far
+    // from the origin
+    const int count = 100000;
+    std::vector<Triangle> triangles(count);
+    vec3 min(FLT_MAX, FLT_MAX, FLT_MAX);
+    vec3 max(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for (int i = 0; i < count; i++) {
+        Point3D base(RandomFloat(1000, 1100), RandomFloat(0, 5),
+                     RandomFloat(1000, 1100));
+        Point3D corners[3] = { base,
+            base + vec3(RandomFloat(0, 1), RandomFloat(-1, 1), 0),
+            base + vec3(0, RandomFloat(-1, 1), RandomFloat(0, 1)) };
+        triangles[i] = Triangle(corners[0], corners[1], corners[2]);
+        for (int j = 0; j < 3; j++) {
+            for (int a = 0; a < 3; a++) {
+                min.asArray[a] = fminf(min.asArray[a],
+                                       corners[j].asArray[a]);
+                max.asArray[a] = fmaxf(max.asArray[a],
+                                       corners[j].asArray[a]);
+            }
+        }
+    }
+    TriangleMesh mesh;
+    mesh.Build(&triangles[0], count);
+    CHECK(mesh.TriangleCount() == count);
+    for (int a = 0; a < 3; a++) {
+        CHECK(mesh.GetMin().asArray[a] == min.asArray[a]);
+        CHECK(mesh.GetMax().asArray[a] == max.asArray[a]);
+    }
+
+    // Nested in a pool task the build runs its loops inline
+    TriangleMesh nested;
+    ParallelFor(1, 1, [&](int, int) {
+        nested.Build(&triangles[0], count);
+    });
+    for (int a = 0; a < 3; a++) {
+        CHECK(nested.GetMin().asArray[a] == min.asArray[a]);
+        CHECK(nested.GetMax().asArray[a] == max.asArray[a]);
+    }
+
+    // Rays straight down against testing every triangle
+    for (int n = 0; n < 50; n++) {
+        Ray ray(Point3D(RandomFloat(1000, 1100), 20, RandomFloat(1000, 1100)),
+                vec3(0, -1, 0));
+        float nearest = FLT_MAX;
+        for (int i = 0; i < count; i++) {
+            float t;
+            if (Raycast(triangles[i], ray, &t) && t >= 0.0f) {
+                nearest = fminf(nearest, t);
+            }
+        }
+        MeshHit hit;
+        bool found = mesh.Raycast(ray, &hit);
+        CHECK(found == (nearest < FLT_MAX));
+        CHECK(!found || Near(hit.t, nearest, 1e-4f));
+    }
+}
+
+static void TestHeightfield()
+{
+    // Sample (x, z) sits at origin + (x * spacing, height, z * spacing),
+    // origin.y included, for every query
+    const int columns = 33;
+    const int rows = 21;
+    std::vector<float> heights(columns * rows);
+    for (size_t i = 0; i < heights.size(); i++) {
+        heights[i] = RandomFloat(-2, 3);
+    }
+    Point3D origin(10, 5, -3);
+    const float spacing = 0.5f;
+    Heightfield field;
+    field.Build(&heights[0], columns, rows, origin, spacing);
+
+    AABB bounds = field.GetBounds();
+    float low = *std::min_element(heights.begin(), heights.end());
+    float high = *std::max_element(heights.begin(), heights.end());
+    CHECK(Near(GetMin(bounds).y, origin.y + low, 1e-4f));
+    CHECK(Near(GetMax(bounds).y, origin.y + high, 1e-4f));
+    CHECK(Near(GetMin(bounds).x, origin.x, 1e-4f) &&
+          Near(GetMax(bounds).z, origin.z + (rows - 1) * spacing, 1e-4f));
+
+    // Heights off by at most the 16 bit step
+    float tolerance = (high - low) / 65535.0f + 1e-4f;
+    for (int z = 0; z < rows; z++) {
+        for (int x = 0; x < columns; x++) {
+            float height;
+            CHECK(field.HeightAt(origin.x + x * spacing,
+                                 origin.z + z * spacing, &height));
+            CHECK(Near(height, origin.y + heights[z * columns + x],
+                       tolerance));
+        }
+    }
+
+    for (int n = 0; n < 500; n++) {
+        float x = origin.x + RandomFloat(0, (columns - 1) * spacing);
+        float z = origin.z + RandomFloat(0, (rows - 1) * spacing);
+        float height;
+        CHECK(field.HeightAt(x, z, &height));
+
+        // The triangle of the cell under (x, z), interpolated
+        float gx = (x - origin.x) / spacing;
+        float gz = (z - origin.z) / spacing;
+        int cx = std::min((int)gx, columns - 2);
+        int cz = std::min((int)gz, rows - 2);
+        float fx = gx - cx;
+        float fz = gz - cz;
+        const float* h = &heights[cz * columns + cx];
+        float expected = (fx + fz <= 1.0f) ?
+            h[0] + (h[1] - h[0]) * fx + (h[columns] - h[0]) * fz :
+            h[columns + 1] + (h[columns] - h[columns + 1]) * (1.0f - fx) +
+                (h[1] - h[columns + 1]) * (1.0f - fz);
+        CHECK(Near(height, origin.y + expected, 2e-3f));
+
+        MeshHit hit;
+        CHECK(field.Raycast(Ray(Point3D(x, origin.y + 10, z),
+                                vec3(0, -1, 0)), &hit));
+        CHECK(Near(hit.point.y, height, 2e-3f));
+        CHECK(field.PointInside(Point3D(x, height - 0.01f, z)));
+        CHECK(!field.PointInside(Point3D(x, height + 0.01f, z)));
+    }
+}
+
+static void TestTriggers()
+{
+    // Pair set and events against testing every pair after each Update()
+    TriggerSystem2D triggers(16.0f);
+    const int triggerCount = 60;
+    std::vector<Circle> circles(triggerCount);
+    std::vector<OrientedRectangle> boxes(triggerCount);
+    std::vector<uint32_t> masks(triggerCount);
+    std::vector<bool> alive(triggerCount, true);
+    for (int i = 0; i < triggerCount; i++) {
+        masks[i] = (i % 3 == 0) ? 2u : TRIGGER_ALL_LAYERS;
+        if (i % 2 == 0) {
+            circles[i] = Circle(Point2D(RandomFloat(0, 200),
+                                        RandomFloat(0, 200)),
+                                RandomFloat(2, 30));
+            CHECK(triggers.AddTrigger(circles[i], masks[i]) == i);
+        }
+        else {
+            boxes[i] = OrientedRectangle(Point2D(RandomFloat(0, 200),
+                                                 RandomFloat(0, 200)),
+                                         vec2(RandomFloat(2, 20),
+                                              RandomFloat(2, 20)),
+                                         RandomFloat(0, 360));
+            CHECK(triggers.AddTrigger(boxes[i], masks[i]) == i);
+        }
+    }
+    const int entityCount = 300;
+    std::vector<Point2D> positions(entityCount);
+    std::vector<uint32_t> layers(entityCount);
+    for (int i = 0; i < entityCount; i++) {
+        positions[i] = Point2D(RandomFloat(0, 200), RandomFloat(0, 200));
+        layers[i] = (i % 4 == 0) ? 2u : 1u;
+        CHECK(triggers.AddEntity(positions[i], layers[i]) == i);
+    }
+
+    std::vector<uint8_t> inside(triggerCount * entityCount, 0);
+    for (int frame = 0; frame < 20; frame++) {
+        if (frame > 0) {
+            for (int i = 0; i < entityCount; i++) {
+                if (rand() % 3 == 0) {
+                    positions[i] = positions[i] +
+                                   vec2(RandomFloat(-8, 8), RandomFloat(-8, 8));
+                    triggers.MoveEntity(i, positions[i]);
+                }
+            }
+            int removed = rand() % triggerCount;
+            if (alive[removed]) {
+                triggers.RemoveTrigger(removed);
+                alive[removed] = false;
+            }
+        }
+        triggers.Update();
+
+        std::vector<uint8_t> expected(triggerCount * entityCount, 0);
+        for (int t = 0; t < triggerCount; t++) {
+            for (int e = 0; e < entityCount && alive[t]; e++) {
+                bool in = (t % 2 == 0) ?
+                          PointInCircle(positions[e], circles[t]) :
+                          PointInOrientedRectangle(positions[e], boxes[t]);
+                expected[t * entityCount + e] = in && (masks[t] & layers[e]);
+            }
+        }
+        // Every change of the pair set is reported once
+        const std::vector<TriggerEvent>& events = triggers.Events();
+        for (size_t i = 0; i < events.size(); i++) {
+            int pair = events[i].trigger * entityCount + events[i].entity;
+            CHECK(inside[pair] != (uint8_t)events[i].entered);
+            inside[pair] = events[i].entered ? 1 : 0;
+        }
+        int pairs = 0;
+        for (int t = 0; t < triggerCount; t++) {
+            for (int e = 0; e < entityCount; e++) {
+                int pair = t * entityCount + e;
+                CHECK(inside[pair] == expected[pair]);
+                if (alive[t]) {
+                    CHECK(triggers.IsInside(t, e) == (expected[pair] != 0));
+                }
+                pairs += expected[pair];
+            }
+        }
+        CHECK(triggers.PairCount() == pairs);
+    }
+}
+
+/* Index of `ref` in the shapes baked into the partition */
+static int WorldShapeIndex(const WorldPartition& world,
+                           const WorldShapeRef& ref,
+                           const SweptTargets& shapes)
+{
+    const CollisionFile* file = world.GetCell(ref.cellX, ref.cellY);
+    if (!file) {
+        return -1;
+    }
+    int index = ref.shape.index;
+    int offset = 0;
+    if (ref.shape.type == SWEPT_LINE) {
+        const Line2D& line = file->Lines()[index];
+        for (int i = 0; i < shapes.lineCount; i++) {
+            if (!memcmp(&shapes.lines[i], &line, sizeof(line))) {
+                return i;
+            }
+        }
+        return -1;
+    }
+    offset += shapes.lineCount;
+    if (ref.shape.type == SWEPT_RECTANGLE) {
+        const Rectangle2D& rect = file->Rectangles()[index];
+        for (int i = 0; i < shapes.rectangleCount; i++) {
+            if (!memcmp(&shapes.rectangles[i], &rect, sizeof(rect))) {
+                return offset + i;
+            }
+        }
+        return -1;
+    }
+    offset += shapes.rectangleCount;
+    const OrientedRectangle& rect = file->OrientedRectangles()[index];
+    for (int i = 0; i < shapes.orientedRectangleCount; i++) {
+        if (!memcmp(&shapes.orientedRectangles[i], &rect, sizeof(rect))) {
+            return offset + i;
+        }
+    }
+    return -1;
+}
+
+static void TestWorldPartition()
+{
+    // Small shapes plus walls spanning most of the world, which land in
+    // many cells
+    std::vector<Line2D> lines;
+    std::vector<Rectangle2D> rects;
+    std::vector<OrientedRectangle> boxes;
+    for (int i = 0; i < 100; i++) {
+        Point2D start(RandomFloat(0, 512), RandomFloat(0, 512));
+        lines.push_back(Line2D(start, start + vec2(RandomFloat(-20, 20),
+                                                   RandomFloat(-20, 20))));
+        rects.push_back(Rectangle2D(Point2D(RandomFloat(0, 512),
+                                            RandomFloat(0, 512)),
+                                    vec2(RandomFloat(1, 16),
+                                         RandomFloat(1, 16))));
+        boxes.push_back(OrientedRectangle(Point2D(RandomFloat(0, 512),
+                                                  RandomFloat(0, 512)),
+                                          vec2(RandomFloat(1, 8),
+                                               RandomFloat(1, 8)),
+                                          RandomFloat(0, 360)));
+    }
+    for (int i = 0; i < 3; i++) {
+        float y = RandomFloat(20, 490);
+        lines.push_back(Line2D(Point2D(5, y), Point2D(505, y + 7)));
+        lines.push_back(Line2D(Point2D(5, y + 9), Point2D(505, y + 9)));
+        rects.push_back(Rectangle2D(Point2D(RandomFloat(20, 490), 3),
+                                    vec2(4, 500)));
+        boxes.push_back(OrientedRectangle(Point2D(256, 256), vec2(240, 3),
+                                          RandomFloat(0, 180)));
+    }
+    SweptTargets shapes;
+    shapes.lines = &lines[0];
+    shapes.lineCount = (int)lines.size();
+    shapes.rectangles = &rects[0];
+    shapes.rectangleCount = (int)rects.size();
+    shapes.orientedRectangles = &boxes[0];
+    shapes.orientedRectangleCount = (int)boxes.size();
+    int shapeCount = shapes.lineCount + shapes.rectangleCount +
+        shapes.orientedRectangleCount;
+
+    const char* directory = "world_partition_test";
+    mkdir(directory, 0755);
+    CHECK(BakeWorldPartition(directory, shapes, 64.0f));
+
+    // Every shape the query touches, once each. Queries inside `area`
+    // only, where every cell is resident.
+    auto compare = [&](const WorldPartition& world, const Rectangle2D& area) {
+        FrameArena arena(1 << 16);
+        for (int n = 0; n < 300; n++) {
+            vec2 min = GetMin(area) + vec2(20, 20);
+            vec2 max = GetMax(area) - vec2(20, 20);
+            Point2D point(RandomFloat(min.x, max.x),
+                          RandomFloat(min.y, max.y));
+            Circle circle(point, RandomFloat(0.5f, 20));
+            Line2D line(point, point + vec2(RandomFloat(-20, 20),
+                                            RandomFloat(-20, 20)));
+            std::vector<uint8_t> expected(shapeCount * 3, 0);
+            for (int i = 0; i < shapes.lineCount; i++) {
+                expected[i * 3 + 1] = LineLine(lines[i], line);
+                expected[i * 3 + 2] = CircleLine(lines[i], circle);
+            }
+            for (int i = 0; i < shapes.rectangleCount; i++) {
+                int s = (shapes.lineCount + i) * 3;
+                expected[s] = PointInRectangle2D(point, rects[i]);
+                expected[s + 1] = LineRectangle(line, rects[i]);
+                expected[s + 2] = CircleRectangle(circle, rects[i]);
+            }
+            for (int i = 0; i < shapes.orientedRectangleCount; i++) {
+                int s = (shapes.lineCount + shapes.rectangleCount + i) * 3;
+                expected[s] = PointInOrientedRectangle(point, boxes[i]);
+                expected[s + 1] = LineOrientedRectangle(line, boxes[i]);
+                expected[s + 2] = CircleOrientedRectangle(circle, boxes[i]);
+            }
+
+            std::vector<uint8_t> found(shapeCount * 3, 0);
+            for (int query = 0; query < 3; query++) {
+                arena.Reset();
+                ArenaVector<WorldShapeRef> hits =
+                    (query == 0) ? world.QueryPoint(point, &arena) :
+                    (query == 1) ? world.QueryLine(line, &arena) :
+                    world.QueryCircle(circle, &arena);
+                for (size_t i = 0; i < hits.size(); i++) {
+                    int shape = WorldShapeIndex(world, hits[i], shapes);
+                    CHECK(shape >= 0);
+                    if (shape >= 0) {
+                        found[shape * 3 + query]++;
+                    }
+                }
+            }
+            CHECK(found == expected);
+        }
+    };
+
+    // Everything resident
+    WorldPartition world;
+    CHECK(world.Open(directory));
+    Point2D center(256, 256);
+    world.Update(&center, 1, 400.0f);
+    world.Flush();
+    CHECK(world.ResidentCellCount() >= 64);
+    compare(world, Rectangle2D(Point2D(0, 0), vec2(512, 512)));
+
+    // The walls don't widen the loaded area: a radius of 100 loads the
+    // 4 x 4 cells around the observer
+    CHECK(world.Open(directory));
+    Point2D corner(100, 100);
+    world.Update(&corner, 1, 100.0f);
+    world.Flush();
+    CHECK(world.ResidentCellCount() == 16);
+    compare(world, Rectangle2D(Point2D(0, 0), vec2(200, 200)));
+    world.Close();
+}
+
+static bool SameRefs(const ArenaVector<StaticShapeRef>& a,
+                     const ArenaVector<StaticShapeRef>& b)
+{
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].type != b[i].type || a[i].index != b[i].index) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void TestQueryWorld()
+{
+    // The published world, binned by bounds only, answers like the exact
+    // offline bake
+    const int count = 2000;
+    std::vector<Line2D> lines(count);
+    std::vector<Rectangle2D> rects(count);
+    std::vector<OrientedRectangle> boxes(count);
+    for (int i = 0; i < count; i++) {
+        Point2D start(RandomFloat(0, 500), RandomFloat(0, 500));
+        lines[i] = Line2D(start, start + vec2(RandomFloat(-30, 30),
+                                              RandomFloat(-30, 30)));
+        rects[i] = Rectangle2D(Point2D(RandomFloat(0, 500),
+                                       RandomFloat(0, 500)),
+                               vec2(RandomFloat(0.5f, 12),
+                                    RandomFloat(0.5f, 12)));
+        boxes[i] = OrientedRectangle(Point2D(RandomFloat(0, 500),
+                                             RandomFloat(0, 500)),
+                                     vec2(RandomFloat(0.5f, 12),
+                                          RandomFloat(0.5f, 12)),
+                                     RandomFloat(0, 360));
+    }
+    SweptTargets shapes;
+    shapes.lines = &lines[0];
+    shapes.lineCount = count;
+    shapes.rectangles = &rects[0];
+    shapes.rectangleCount = count;
+    shapes.orientedRectangles = &boxes[0];
+    shapes.orientedRectangleCount = count;
+
+    std::vector<uint8_t> buffer;
+    const void* image = 0;
+    size_t size = 0;
+    CollisionFile exact;
+    CHECK(BakeCollisionMemory(shapes, buffer, &image, &size, 16.0f));
+    CHECK(exact.OpenMemory(image, size));
+
+    QueryWorld2D world;
+    CHECK(world.Publish(shapes, 7, 16.0f));
+    QueryWorldView view(world);
+    CHECK(view.IsValid() && view.Step() == 7);
+    const CollisionFile& published = view.World();
+
+    FrameArena arena(1 << 20);
+    for (int n = 0; n < 500; n++) {
+        arena.Reset();
+        Point2D point(RandomFloat(-10, 510), RandomFloat(-10, 510));
+        Circle circle(point, RandomFloat(0.5f, 20));
+        Line2D line(point, point + vec2(RandomFloat(-40, 40),
+                                        RandomFloat(-40, 40)));
+        CHECK(SameRefs(published.QueryPoint(point, &arena),
+                       exact.QueryPoint(point, &arena)));
+        CHECK(SameRefs(published.QueryLine(line, &arena),
+                       exact.QueryLine(line, &arena)));
+        CHECK(SameRefs(published.QueryCircle(circle, &arena),
+                       exact.QueryCircle(circle, &arena)));
+    }
+
+    const int moverCount = 500;
+    std::vector<Circle> movers(moverCount);
+    std::vector<vec2> velocities(moverCount);
+    for (int i = 0; i < moverCount; i++) {
+        movers[i] = Circle(Point2D(RandomFloat(0, 500), RandomFloat(0, 500)),
+                           RandomFloat(0.2f, 3.0f));
+        velocities[i] = vec2(RandomFloat(-40, 40), RandomFloat(-40, 40));
+    }
+    arena.Reset();
+    ArenaVector<SweptHit> a = published.QuerySweptCircles(
+            &movers[0], &velocities[0], moverCount, &arena);
+    ArenaVector<SweptHit> b = exact.QuerySweptCircles(
+            &movers[0], &velocities[0], moverCount, &arena);
+    CHECK(a.size() == b.size() && a.size() > 0);
+    for (size_t i = 0; i < a.size() && i < b.size(); i++) {
+        CHECK(a[i].mover == b[i].mover && a[i].type == b[i].type &&
+              a[i].target == b[i].target && a[i].toi == b[i].toi);
+    }
+}
+
+template<typename Point>
+static float PointDistanceSq(const Point& a, const Point& b)
+{
+    float sum = 0.0f;
+    for (int i = 0; i < (int)(sizeof(Point) / sizeof(float)); i++) {
+        float d = a.asArray[i] - b.asArray[i];
+        sum += d * d;
+    }
+    return sum;
+}
+
+template<typename Point>
+static Point RandomPoint(float min, float max)
+{
+    Point point;
+    for (int i = 0; i < (int)(sizeof(Point) / sizeof(float)); i++) {
+        point.asArray[i] = RandomFloat(min, max);
+    }
+    return point;
+}
+
+/* Nearest, k nearest and radius queries against scanning every point */
+template<typename Point>
+static void CheckKdTree(int count)
+{
+    std::vector<Point> points(count);
+    for (int i = 0; i < count; i++) {
+        // Some duplicates, which share a distance to every query
+        points[i] = (i % 10 == 9) ? points[i - 5] :
+                                    RandomPoint<Point>(0, 100);
+    }
+    KdTree<Point> tree;
+    tree.Build(&points[0], count);
+    CHECK(tree.Size() == count);
+
+    // More queries than a batch task takes
+    const int queryCount = 1000;
+    const int k = 8;
+    const float radius = 9.0f;
+    std::vector<Point> queries(queryCount);
+    for (int i = 0; i < queryCount; i++) {
+        queries[i] = RandomPoint<Point>(-10, 110);
+    }
+    std::vector<KdNeighbor> batch(queryCount * k);
+    tree.NearestBatch(&queries[0], queryCount, k, &batch[0]);
+    std::vector<int> starts;
+    std::vector<int> indices;
+    tree.QueryRadiusBatch(&queries[0], queryCount, radius, starts, indices);
+    CHECK((int)starts.size() == queryCount + 1);
+    CHECK(starts[queryCount] == (int)indices.size());
+
+    // Nested in a pool task the batch runs inline in one range
+    std::vector<int> nestedStarts[2];
+    std::vector<int> nestedIndices[2];
+    ParallelFor(2, 1, [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            tree.QueryRadiusBatch(&queries[0], queryCount, radius,
+                                  nestedStarts[i], nestedIndices[i]);
+        }
+    });
+    for (int i = 0; i < 2; i++) {
+        CHECK(nestedStarts[i] == starts);
+        CHECK(nestedIndices[i] == indices);
+    }
+
+    FrameArena arena(1 << 16);
+    for (int q = 0; q < queryCount; q++) {
+        arena.Reset();
+        const Point& query = queries[q];
+        std::vector<float> distances(count);
+        std::vector<int> inside;
+        for (int i = 0; i < count; i++) {
+            distances[i] = PointDistanceSq(query, points[i]);
+            if (distances[i] <= radius * radius) {
+                inside.push_back(i);
+            }
+        }
+        std::vector<float> sorted(distances);
+        std::sort(sorted.begin(), sorted.end());
+
+        float nearestSq = -1.0f;
+        int nearest = tree.Nearest(query, &nearestSq);
+        CHECK(nearest >= 0 && nearest < count &&
+              distances[nearest] == sorted[0] && nearestSq == sorted[0]);
+
+        // Ties may come in any order, so compare distances
+        ArenaVector<KdNeighbor> neighbors = tree.Nearest(query, k, &arena);
+        int expected = std::min(k, count);
+        CHECK((int)neighbors.size() == expected);
+        for (int i = 0; i < (int)neighbors.size() && i < expected; i++) {
+            CHECK(neighbors[i].distanceSq == sorted[i]);
+            CHECK(distances[neighbors[i].index] == sorted[i]);
+            CHECK(batch[q * k + i].index == neighbors[i].index);
+        }
+        for (int i = expected; i < k; i++) {
+            CHECK(batch[q * k + i].index == -1);
+        }
+
+        ArenaVector<int> found = tree.QueryRadius(query, radius, &arena);
+        std::vector<int> single(found.begin(), found.end());
+        std::vector<int> batched(indices.begin() + starts[q],
+                                 indices.begin() + starts[q + 1]);
+        std::sort(single.begin(), single.end());
+        std::sort(batched.begin(), batched.end());
+        CHECK(single == inside);
+        CHECK(batched == inside);
+    }
+
+    KdTree<Point> empty;
+    empty.Build(0, 0);
+    CHECK(empty.Nearest(queries[0]) == -1);
+    CHECK(empty.QueryRadius(queries[0], radius, &arena).empty());
+}
+
+static void TestKdTree()
+{
+    CheckKdTree<Point2D>(3000);
+    CheckKdTree<Point3D>(3000);
+    // Fewer points than a leaf, and than k
+    CheckKdTree<Point2D>(5);
+}
+
+/* One particle against one collider, the scalar version of Respond() */
+static void RespondReference(const vec2& normal, const vec2& surface,
+                             float restitution, float friction, vec2& p,
+                             vec2& v)
+{
+    p = surface;
+    float vn = Dot(v, normal);
+    if (vn < 0.0f) {
+        v = (v - normal * vn) * (1.0f - friction) -
+            normal * (vn * restitution);
+    }
+}
+
+static bool ClosestFaceReference(const vec2& p, const vec2& min,
+                                 const vec2& max, vec2* normal,
+                                 vec2* surface)
+{
+    if (!(p.x > min.x && p.x < max.x && p.y > min.y && p.y < max.y)) {
+        return false;
+    }
+    float best = p.x - min.x;
+    *normal = vec2(-1, 0);
+    *surface = vec2(min.x, p.y);
+    if (max.x - p.x < best) {
+        best = max.x - p.x;
+        *normal = vec2(1, 0);
+        *surface = vec2(max.x, p.y);
+    }
+    if (p.y - min.y < best) {
+        best = p.y - min.y;
+        *normal = vec2(0, -1);
+        *surface = vec2(p.x, min.y);
+    }
+    if (max.y - p.y < best) {
+        *normal = vec2(0, 1);
+        *surface = vec2(p.x, max.y);
+    }
+    return true;
+}
+
+static void TestParticles()
+{
+    // One step of the SIMD chunks against a scalar loop over every
+    // particle and collider, restarting from the system's state each step
+    std::vector<Circle> circles;
+    std::vector<Rectangle2D> rects;
+    std::vector<OrientedRectangle> boxes;
+    ParticleSystem2D particles;
+    for (int i = 0; i < 12; i++) {
+        circles.push_back(Circle(Point2D(RandomFloat(0, 300),
+                                         RandomFloat(0, 300)),
+                                 RandomFloat(4, 20)));
+        rects.push_back(Rectangle2D(Point2D(RandomFloat(0, 300),
+                                            RandomFloat(0, 300)),
+                                    vec2(RandomFloat(4, 40),
+                                         RandomFloat(4, 40))));
+        boxes.push_back(OrientedRectangle(Point2D(RandomFloat(0, 300),
+                                                  RandomFloat(0, 300)),
+                                          vec2(RandomFloat(2, 20),
+                                               RandomFloat(2, 20)),
+                                          RandomFloat(0, 360)));
+        particles.AddCollider(circles.back());
+        particles.AddCollider(rects.back());
+        particles.AddCollider(boxes.back());
+    }
+    const float restitution = 0.6f;
+    const float friction = 0.2f;
+    const vec2 gravity(0.0f, -9.8f);
+    particles.SetRestitution(restitution);
+    particles.SetFriction(friction);
+    particles.SetGravity(gravity);
+
+    // Not a multiple of the chunk or lane count
+    const int count = 3001;
+    particles.Reserve(count);
+    for (int i = 0; i < count; i++) {
+        CHECK(particles.Add(Point2D(RandomFloat(0, 300), RandomFloat(0, 300)),
+                            vec2(RandomFloat(-40, 40),
+                                 RandomFloat(-40, 40))) == i);
+    }
+    CHECK(particles.Count() == count);
+
+    const float dt = 1.0f / 30.0f;
+    int collisions = 0;
+    for (int step = 0; step < 20; step++) {
+        std::vector<vec2> ps(count), vs(count);
+        for (int i = 0; i < count; i++) {
+            ps[i] = particles.GetPosition(i);
+            vs[i] = particles.GetVelocity(i);
+        }
+        particles.Update(dt);
+
+        for (int i = 0; i < count; i++) {
+            vec2 v = vs[i] + gravity * dt;
+            vec2 p = ps[i] + v * dt;
+            vec2 normal, surface;
+            for (size_t c = 0; c < circles.size(); c++) {
+                vec2 d = p - circles[c].center;
+                float distSq = Dot(d, d);
+                if (distSq < circles[c].radius * circles[c].radius) {
+                    float dist = sqrtf(distSq);
+                    normal = (dist > 0.0f) ? d * (1.0f / dist) : vec2(0, 1);
+                    surface = circles[c].center + normal * circles[c].radius;
+                    RespondReference(normal, surface, restitution, friction,
+                                     p, v);
+                    collisions++;
+                }
+            }
+            for (size_t c = 0; c < rects.size(); c++) {
+                if (ClosestFaceReference(p, GetMin(rects[c]),
+                                         GetMax(rects[c]), &normal,
+                                         &surface)) {
+                    RespondReference(normal, surface, restitution, friction,
+                                     p, v);
+                    collisions++;
+                }
+            }
+            for (size_t c = 0; c < boxes.size(); c++) {
+                const OrientedRectangle& box = boxes[c];
+                float cs = cosf(DEG2RAD(box.rotation));
+                float sn = sinf(DEG2RAD(box.rotation));
+                vec2 d = p - box.origin;
+                vec2 local(d.x * cs + d.y * sn, -d.x * sn + d.y * cs);
+                if (ClosestFaceReference(local, box.halfExtents * -1.0f,
+                                         box.halfExtents, &normal,
+                                         &surface)) {
+                    normal = vec2(normal.x * cs - normal.y * sn,
+                                  normal.x * sn + normal.y * cs);
+                    surface = box.origin +
+                              vec2(surface.x * cs - surface.y * sn,
+                                   surface.x * sn + surface.y * cs);
+                    RespondReference(normal, surface, restitution, friction,
+                                     p, v);
+                    collisions++;
+                }
+            }
+            CHECK(Near(particles.GetPosition(i).x, p.x, 1e-3f) &&
+                  Near(particles.GetPosition(i).y, p.y, 1e-3f));
+            CHECK(Near(particles.GetVelocity(i).x, v.x, 1e-3f) &&
+                  Near(particles.GetVelocity(i).y, v.y, 1e-3f));
+        }
+    }
+    CHECK(collisions > 100);
+
+    // Removing moves the last particle into the hole
+    Point2D last = particles.GetPosition(count - 1);
+    particles.Remove(10);
+    CHECK(particles.Count() == count - 1);
+    CHECK(particles.GetPosition(10).x == last.x &&
+          particles.GetPosition(10).y == last.y);
+}
+
+static void TestSoftBody()
+{
+    // A rigid rope pinned at one end falls from horizontal and settles
+    // hanging straight down at its rest length
+    const int links = 20;
+    const float dt = 1.0f / 60.0f;
+    SoftBodySystem2D rope;
+    rope.SetGravity(vec2(0.0f, -9.8f));
+    rope.SetSubsteps(20);
+    rope.SetDamping(1.0f);
+    for (int i = 0; i <= links; i++) {
+        CHECK(rope.AddParticle(Point2D((float)i, 0.0f),
+                               (i == 0) ? 0.0f : 1.0f) == i);
+        if (i > 0) {
+            rope.AddDistanceConstraint(i - 1, i);
+        }
+    }
+    for (int step = 0; step < 1200; step++) {
+        rope.Update(dt);
+    }
+    CHECK(rope.DistanceColorCount() == 2);
+    CHECK(rope.GetPosition(0).x == 0.0f && rope.GetPosition(0).y == 0.0f);
+    float ropeError = 0.0f;
+    for (int i = 1; i <= links; i++) {
+        float length = Magnitude(rope.GetPosition(i) -
+                                 rope.GetPosition(i - 1));
+        ropeError = std::max(ropeError, fabsf(length - 1.0f));
+        CHECK(Magnitude(rope.GetVelocity(i)) < 0.01f);
+    }
+    CHECK(ropeError < 0.01f);
+    CHECK(Near(rope.GetPosition(links).x, 0.0f, 0.1f));
+    CHECK(Near(rope.GetPosition(links).y, -(float)links, 0.1f));
+
+    // A cloth large enough for every color to be solved in parallel drapes
+    // over a circle: no constraint stretches past its tolerance and no
+    // particle ends inside the collider
+    const int side = 66;
+    const float spacing = 0.5f;
+    const float width = spacing * (side - 1);
+    const Circle ball(Point2D(0.0f, -10.0f), 8.0f);
+    SoftBodySystem2D cloth;
+    cloth.SetGravity(vec2(0.0f, -9.8f));
+    cloth.SetSubsteps(40);
+    cloth.SetDamping(0.5f);
+    cloth.AddCollider(ball);
+    int first = cloth.AddCloth(Point2D(-width * 0.5f, 0.0f),
+                               vec2(width, width), side, side, 1.0f, 0.0f,
+                               0.01f);
+    CHECK(first == 0 && cloth.ParticleCount() == side * side);
+    for (int step = 0; step < 120; step++) {
+        cloth.Update(dt);
+    }
+    CHECK(cloth.DistanceColorCount() >= 4 &&
+          cloth.DistanceColorCount() <= SOFT_BODY_MAX_COLORS);
+    float clothError = 0.0f;
+    float depth = -FLT_MAX;
+    for (int r = 0; r < side; r++) {
+        for (int c = 0; c < side; c++) {
+            int i = r * side + c;
+            Point2D p = cloth.GetPosition(i);
+            if (c + 1 < side) {
+                float length = Magnitude(cloth.GetPosition(i + 1) - p);
+                clothError = std::max(clothError,
+                                      fabsf(length - spacing) / spacing);
+            }
+            if (r + 1 < side) {
+                float length = Magnitude(cloth.GetPosition(i + side) - p);
+                clothError = std::max(clothError,
+                                      fabsf(length - spacing) / spacing);
+            }
+            depth = std::max(depth, ball.radius - Magnitude(p - ball.center));
+        }
+    }
+    CHECK(clothError < 0.05f);
+    CHECK(depth > -0.1f && depth < 1e-3f);
+}
+
+static vec2 JointAnchor(const Body2D& body, const vec2& local)
+{
+    float c = cosf(DEG2RAD(body.rotation));
+    float s = sinf(DEG2RAD(body.rotation));
+    return body.position + vec2(local.x * c - local.y * s,
+                                local.x * s + local.y * c);
+}
+
+/* Chains of revolute links of length 1, laid out along x 2 apart and
+ * hanging from static body 0. Link l of chain c is body 1 + c * links + l
+ * and joint c * links + l ties it to the previous link. */
+static void AddChains(int chains, int links, std::vector<Body2D>* bodies,
+                      JointSolver2D* joints)
+{
+    bodies->push_back(Body2D(Point2D(0, 0), 0.0f, 0.0f));
+    for (int c = 0; c < chains; c++) {
+        int prev = 0;
+        for (int l = 0; l < links; l++) {
+            Point2D anchor(c * 2.0f + l, 0.0f);
+            bodies->push_back(Body2D(anchor + vec2(0.5f, 0.0f), 1.0f, 0.1f));
+            int link = (int)bodies->size() - 1;
+            joints->AddRevolute(&(*bodies)[0], prev, link, anchor);
+            prev = link;
+        }
+    }
+}
+
+static void StepChains(std::vector<Body2D>& bodies, JointSolver2D& joints,
+                       float dt)
+{
+    const vec2 gravity(0.0f, -9.8f);
+    for (size_t i = 1; i < bodies.size(); i++) {
+        bodies[i].velocity = bodies[i].velocity + gravity * dt;
+    }
+    joints.Solve(&bodies[0], (int)bodies.size(), dt);
+    for (size_t i = 1; i < bodies.size(); i++) {
+        bodies[i].position = bodies[i].position + bodies[i].velocity * dt;
+        bodies[i].rotation += bodies[i].angularVelocity * dt;
+    }
+}
+
+static void TestJoints()
+{
+    // Enough chains that both colors span several JOINT_BATCH batches on
+    // the worker pool. Every chain swings down like a lone chain solved on
+    // its own, and the anchors of each joint stay together.
+    const int chains = 1200;
+    const int links = 4;
+    const float dt = 1.0f / 60.0f;
+    std::vector<Body2D> bodies, single;
+    JointSolver2D joints, singleJoints;
+    AddChains(chains, links, &bodies, &joints);
+    AddChains(1, links, &single, &singleJoints);
+    CHECK(joints.JointCount() == chains * links);
+
+    float maxGap = 0.0f;
+    float maxDrift = 0.0f;
+    float lowest = 0.0f;
+    for (int step = 0; step < 120; step++) {
+        StepChains(bodies, joints, dt);
+        StepChains(single, singleJoints, dt);
+        lowest = std::min(lowest, bodies[links].position.y);
+        for (int c = 0; c < chains; c++) {
+            for (int l = 0; l < links; l++) {
+                int link = 1 + c * links + l;
+                int prev = (l == 0) ? 0 : link - 1;
+                vec2 localA = (l == 0) ? vec2(c * 2.0f, 0.0f)
+                                       : vec2(0.5f, 0.0f);
+                vec2 gap = JointAnchor(bodies[link], vec2(-0.5f, 0.0f)) -
+                           JointAnchor(bodies[prev], localA);
+                maxGap = std::max(maxGap, Magnitude(gap));
+                vec2 drift = bodies[link].position - vec2(c * 2.0f, 0.0f) -
+                             single[1 + l].position;
+                maxDrift = std::max(maxDrift, Magnitude(drift));
+            }
+        }
+    }
+    CHECK(joints.ColorCount() == 2);
+    CHECK(maxGap < 0.05f);
+    CHECK(maxDrift < 1e-3f);
+    // The chains swung down from horizontal
+    CHECK(lowest < -3.0f);
+}
+
+static void TestSignedDistance()
+{
+    for (int n = 0; n < 2000; n++) {
+        Circle circle(Point2D(RandomFloat(0, 50), RandomFloat(0, 50)),
+                      RandomFloat(1, 10));
+        Rectangle2D rect(Point2D(RandomFloat(0, 50), RandomFloat(0, 50)),
+                         vec2(RandomFloat(1, 10), RandomFloat(1, 10)));
+        OrientedRectangle box(Point2D(RandomFloat(0, 50), RandomFloat(0, 50)),
+                              vec2(RandomFloat(1, 8), RandomFloat(1, 8)),
+                              RandomFloat(0, 360));
+        Point2D center(RandomFloat(0, 50), RandomFloat(0, 50));
+        vec2 vertices[6];
+        for (int i = 0; i < 6; i++) {
+            float angle = DEG2RAD(60.0f * i);
+            vertices[i] = center + vec2(cosf(angle), sinf(angle)) *
+                                   RandomFloat(3, 10);
+        }
+        Polygon2D polygon;
+        SetVertices(polygon, vertices, 6);
+
+        // Negative inside, as the PointIn tests say
+        for (int i = 0; i < 20; i++) {
+            Point2D point(RandomFloat(-10, 60), RandomFloat(-10, 60));
+            float d = SignedDistance(point, circle);
+            CHECK(fabsf(d) < 1e-3f || (d < 0.0f) == PointInCircle(point,
+                                                                 circle));
+            d = SignedDistance(point, rect);
+            CHECK(fabsf(d) < 1e-3f ||
+                  (d < 0.0f) == PointInRectangle2D(point, rect));
+            d = SignedDistance(point, box);
+            CHECK(fabsf(d) < 1e-3f ||
+                  (d < 0.0f) == PointInOrientedRectangle(point, box));
+            d = SignedDistance(point, polygon);
+            CHECK(fabsf(d) < 1e-3f ||
+                  (d < 0.0f) == PointInPolygon2D(point, polygon));
+        }
+
+        // Against the nearest of points sampled along the outline
+        Point2D point = box.origin + vec2(RandomFloat(-20, 20),
+                                          RandomFloat(-20, 20));
+        float angle = DEG2RAD(box.rotation);
+        vec2 axisX(cosf(angle), sinf(angle));
+        vec2 axisY(-sinf(angle), cosf(angle));
+        float nearest = FLT_MAX;
+        for (int i = 0; i < 1000; i++) {
+            float t = i / 250.0f;
+            float hx = box.halfExtents.x;
+            float hy = box.halfExtents.y;
+            vec2 local = (t < 1) ? vec2(-hx + 2 * hx * t, -hy) :
+                         (t < 2) ? vec2(hx, -hy + 2 * hy * (t - 1)) :
+                         (t < 3) ? vec2(hx - 2 * hx * (t - 2), hy) :
+                                   vec2(-hx, hy - 2 * hy * (t - 3));
+            Point2D outline = box.origin + axisX * local.x +
+                              axisY * local.y;
+            nearest = fminf(nearest, Magnitude(point - outline));
+        }
+        CHECK(Near(fabsf(SignedDistance(point, box)), nearest, 0.02f));
+    }
+}
+
+static void TestDistanceField()
+{
+    const int count = 40;
+    std::vector<Circle> circles(count);
+    std::vector<Line2D> lines(count);
+    std::vector<Rectangle2D> rects(count);
+    std::vector<OrientedRectangle> boxes(count);
+    std::vector<Polygon2D> polygons(count);
+    for (int i = 0; i < count; i++) {
+        // Some circles partly or wholly outside the area
+        circles[i] = Circle(Point2D(RandomFloat(-30, 230),
+                                    RandomFloat(-30, 230)),
+                            RandomFloat(1, 10));
+        Point2D start(RandomFloat(0, 200), RandomFloat(0, 200));
+        lines[i] = Line2D(start, start + vec2(RandomFloat(-15, 15),
+                                              RandomFloat(-15, 15)));
+        rects[i] = Rectangle2D(Point2D(RandomFloat(0, 200),
+                                       RandomFloat(0, 200)),
+                               vec2(RandomFloat(1, 15), RandomFloat(1, 15)));
+        boxes[i] = OrientedRectangle(Point2D(RandomFloat(0, 200),
+                                             RandomFloat(0, 200)),
+                                     vec2(RandomFloat(1, 8),
+                                          RandomFloat(1, 8)),
+                                     RandomFloat(0, 360));
+        Point2D center(RandomFloat(0, 200), RandomFloat(0, 200));
+        vec2 vertices[5];
+        for (int j = 0; j < 5; j++) {
+            float angle = DEG2RAD(72.0f * j);
+            vertices[j] = center + vec2(cosf(angle), sinf(angle)) *
+                                   RandomFloat(2, 8);
+        }
+        SetVertices(polygons[i], vertices, 5);
+    }
+    DistanceFieldShapes shapes;
+    shapes.circles = &circles[0];
+    shapes.circleCount = count;
+    shapes.lines = &lines[0];
+    shapes.lineCount = count;
+    shapes.rectangles = &rects[0];
+    shapes.rectangleCount = count;
+    shapes.orientedRectangles = &boxes[0];
+    shapes.orientedRectangleCount = count;
+    shapes.polygons = &polygons[0];
+    shapes.polygonCount = count;
+
+    const float cellSize = 2.0f;
+    DistanceField2D field;
+    CHECK(field.Bake(shapes, Rectangle2D(Point2D(0, 0), vec2(200, 190)),
+                     cellSize));
+    CHECK(field.Columns() == 100 && field.Rows() == 95);
+
+    // Exact near the shapes; elsewhere at most a cell off, in few cells
+    int wrong = 0;
+    for (int y = 0; y < field.Rows(); y++) {
+        for (int x = 0; x < field.Columns(); x++) {
+            Point2D point((x + 0.5f) * cellSize, (y + 0.5f) * cellSize);
+            float nearest = FLT_MAX;
+            for (int i = 0; i < count; i++) {
+                nearest = fminf(nearest, SignedDistance(point, circles[i]));
+                nearest = fminf(nearest, SignedDistance(point, lines[i]));
+                nearest = fminf(nearest, SignedDistance(point, rects[i]));
+                nearest = fminf(nearest, SignedDistance(point, boxes[i]));
+                nearest = fminf(nearest, SignedDistance(point, polygons[i]));
+            }
+            float value = field.Values()[y * field.Columns() + x];
+            CHECK(value >= nearest - 1e-4f);
+            CHECK(value <= nearest + cellSize);
+            if (nearest <= 0.7f * cellSize) {
+                CHECK(Near(value, nearest, 1e-4f));
+            }
+            wrong += !Near(value, nearest, 1e-4f);
+        }
+    }
+    CHECK(wrong <= field.Columns() * field.Rows() / 100);
+
+    // Cell centers sample their value; beyond the area the distance to it
+    // is added and the gradient points away
+    CHECK(Near(field.Sample(Point2D(101, 51)),
+               field.Values()[25 * field.Columns() + 50], 1e-4f));
+    CHECK(Near(field.Sample(Point2D(-10, -10)),
+               field.Values()[0] + Magnitude(vec2(11, 11)), 1e-3f));
+    vec2 outside = field.Gradient(Point2D(260, 100));
+    CHECK(Near(outside.x, 1.0f, 1e-4f) && Near(outside.y, 0.0f, 1e-4f));
+
+    DistanceField2D empty;
+    DistanceFieldShapes none;
+    CHECK(empty.Bake(none, Rectangle2D(Point2D(0, 0), vec2(10, 10)), 1.0f));
+    CHECK(empty.Values()[0] == FLT_MAX);
+    CHECK(!empty.Bake(none, Rectangle2D(Point2D(0, 0), vec2(0, 10)), 1.0f));
+    CHECK(!empty.Bake(none, Rectangle2D(Point2D(0, 0), vec2(1e6f, 1e6f)),
+                      0.01f));
+}
+
+typedef struct OccupancyTestShape
+{
+    int type;
+    Circle circle;
+    Rectangle2D rect;
+    OrientedRectangle oriented;
+    Line2D line;
+    bool alive;
+} OccupancyTestShape;
+
+static bool OccupancyTestContains(const OccupancyTestShape& shape,
+                                  const Point2D& point)
+{
+    if (shape.type == 0) {
+        return PointInCircle(point, shape.circle);
+    }
+    if (shape.type == 1) {
+        return PointInRectangle2D(point, shape.rect);
+    }
+    return PointInOrientedRectangle(point, shape.oriented);
+}
+
+static void TestOccupancyGrid()
+{
+    // Every cell against testing its center (or its square, for lines)
+    // with every shape. Within 1e-3 of a boundary either answer is fine.
+    const float cellSize = 1.7f;
+    Rectangle2D area(Point2D(-20, 10), vec2(300, 230));
+    OccupancyGrid2D grid;
+    CHECK(grid.Reset(area, cellSize, 5));
+    CHECK(grid.Levels() == 5);
+    CHECK(grid.Columns() == 177 && grid.Rows() == 136);
+
+    std::vector<OccupancyTestShape> shapes;
+    auto add = [&]() {
+        OccupancyTestShape shape;
+        shape.type = rand() % 4;
+        shape.alive = true;
+        // Some shapes partly outside the grid
+        Point2D p = area.origin + vec2(RandomFloat(-20, area.size.x + 20),
+                                       RandomFloat(-20, area.size.y + 20));
+        shape.circle = Circle(p, RandomFloat(0.2f, 15));
+        shape.rect = Rectangle2D(p, vec2(RandomFloat(0.1f, 20),
+                                         RandomFloat(0.1f, 20)));
+        shape.oriented = OrientedRectangle(p, vec2(RandomFloat(0.1f, 10),
+                                                   RandomFloat(0.1f, 10)),
+                                           RandomFloat(0, 360));
+        shape.line = Line2D(p, p + vec2(RandomFloat(-30, 30),
+                                        RandomFloat(-30, 30)));
+        if (rand() % 8 == 0) {
+            shape.line.end.x = shape.line.start.x;
+        }
+        if (rand() % 8 == 0) {
+            shape.line.end.y = shape.line.start.y;
+        }
+        int index = (shape.type == 0) ? grid.AddShape(shape.circle) :
+                    (shape.type == 1) ? grid.AddShape(shape.rect) :
+                    (shape.type == 2) ? grid.AddShape(shape.oriented) :
+                                        grid.AddShape(shape.line);
+        if (index >= (int)shapes.size()) {
+            shapes.resize(index + 1);
+        }
+        CHECK(!shapes[index].alive);
+        shapes[index] = shape;
+    };
+    for (int i = 0; i < 150; i++) {
+        add();
+    }
+
+    const float epsilon = 1e-3f;
+    for (int round = 0; round < 4; round++) {
+        grid.Update();
+        for (int y = 0; y < grid.Rows(); y++) {
+            for (int x = 0; x < grid.Columns(); x++) {
+                vec2 min = area.origin + vec2(x * cellSize, y * cellSize);
+                vec2 max = min + vec2(cellSize, cellSize);
+                Point2D center = min + vec2(cellSize, cellSize) * 0.5f;
+                bool mustBlock = false;
+                bool mayBlock = false;
+                for (size_t i = 0; i < shapes.size(); i++) {
+                    const OccupancyTestShape& shape = shapes[i];
+                    if (!shape.alive) {
+                        continue;
+                    }
+                    if (shape.type == 3) {
+                        vec2 shrink(epsilon, epsilon);
+                        mustBlock |= SegmentBox(shape.line, min + shrink,
+                                                max - shrink);
+                        mayBlock |= SegmentBox(shape.line, min - shrink,
+                                               max + shrink);
+                        continue;
+                    }
+                    bool all = OccupancyTestContains(shape, center);
+                    bool any = all;
+                    for (int k = 0; k < 4; k++) {
+                        vec2 nudge((k & 1) ? epsilon : -epsilon,
+                                   (k & 2) ? epsilon : -epsilon);
+                        bool inside = OccupancyTestContains(shape,
+                                                            center + nudge);
+                        all &= inside;
+                        any |= inside;
+                    }
+                    mustBlock |= all;
+                    mayBlock |= any;
+                }
+                bool blocked = grid.IsBlocked(x, y);
+                CHECK(!mustBlock || blocked);
+                CHECK(!blocked || mayBlock);
+                CHECK(grid.IsBlocked(center) == blocked);
+            }
+        }
+
+        // A coarse cell is blocked exactly when one of its 2 x 2 is, and
+        // the bits past the last column stay clear
+        for (int level = 1; level < grid.Levels(); level++) {
+            for (int y = 0; y < grid.Rows(level); y++) {
+                for (int x = 0; x < grid.Columns(level); x++) {
+                    bool any = false;
+                    for (int k = 0; k < 4; k++) {
+                        int fx = 2 * x + (k & 1);
+                        int fy = 2 * y + (k >> 1);
+                        if (fx < grid.Columns(level - 1) &&
+                            fy < grid.Rows(level - 1)) {
+                            any |= grid.IsBlocked(fx, fy, level - 1);
+                        }
+                    }
+                    CHECK(grid.IsBlocked(x, y, level) == any);
+                }
+            }
+        }
+        for (int level = 0; level < grid.Levels(); level++) {
+            int used = grid.Columns(level) % 64;
+            for (int y = 0; y < grid.Rows(level) && used; y++) {
+                uint64_t last = grid.Words(level)[(y + 1) *
+                                                  grid.WordsPerRow(level) - 1];
+                CHECK((last >> used) == 0);
+            }
+        }
+        CHECK(grid.IsBlocked(-1, 0) && grid.IsBlocked(0, grid.Rows()));
+
+        for (int i = 0; i < 25; i++) {
+            int index = rand() % (int)shapes.size();
+            if (shapes[index].alive) {
+                grid.RemoveShape(index);
+                shapes[index].alive = false;
+            }
+        }
+        for (int i = 0; i < 25; i++) {
+            add();
+        }
+    }
+
+    CHECK(!grid.Reset(Rectangle2D(Point2D(0, 0), vec2(0, 10)), 1.0f));
+    CHECK(!grid.Reset(area, 0.0f));
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1) {
+        s_filter = argv[1];
+    }
+
+    int failed = 0;
+    Test("matrices Inverse", TestMatrixInverse, &failed);
+    Test("Geometry2D CircleRectangle", TestCircleRectangle, &failed);
+    Test("Geometry2D LineRectangle", TestLineRectangle, &failed);
+    Test("FrameArena", TestFrameArena, &failed);
+    Test("SweptCircles", TestSweptCircles, &failed);
+    Test("CollisionFile walls", TestCollisionFileWalls, &failed);
+    Test("KdTree", TestKdTree, &failed);
+    Test("JointSolver2D", TestJoints, &failed);
+    Test("Geometry2D SignedDistance", TestSignedDistance, &failed);
+    Test("DistanceField2D", TestDistanceField, &failed);
+    Test("OccupancyGrid2D", TestOccupancyGrid, &failed);
+    Test("ParticleSystem2D", TestParticles, &failed);
+    Test("QueryWorld2D", TestQueryWorld, &failed);
+    Test("SoftBodySystem2D", TestSoftBody, &failed);
+    Test("TriangleMesh", TestTriangleMesh, &failed);
+    Test("Heightfield", TestHeightfield, &failed);
+    Test("TriggerSystem2D", TestTriggers, &failed);
+    Test("WorldPartition", TestWorldPartition, &failed);
+
+    printf("%d checks, %d failed, %d tests failed\n", s_checks, s_failures,
+           failed);
+    return failed;
+}
@@ -1,8 +1,13 @@
 #include "vectors.h"
+#include "Profiler.h"
 
 #include <cmath>
 #include <cfloat>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 /* For details on the float comparison, check
  * http://realtimecollisiondetection.net/pubs/Tolerances/
  */
@@ -14,135 +19,161 @@
 
 vec2 operator+(const vec2& l, const vec2& r)
 {
+    PROFILE_FUNCTION();
     return {l.x + r.x, l.y + r.y};
 }
 
 vec2 operator-(const vec2& l, const vec2& r)
 {
+    PROFILE_FUNCTION();
     return {l.x - r.x, l.y - r.y};
 }
 
 vec2 operator*(const vec2& l, const vec2& r)
 {
+    PROFILE_FUNCTION();
     return {l.x * r.x, l.y * r.y};
 }
 
 vec2 operator*(const vec2& l, float r)
 {
+    PROFILE_FUNCTION();
     return {l.x * r, l.y * r};
 }
 
 bool operator==(const vec2& l, const vec2& r)
 {
+    PROFILE_FUNCTION();
     return FLOAT_CMP(l.x, r.x) && FLOAT_CMP(l.y, r.y);
 }
 
 bool operator!=(const vec2& l, const vec2& r)
 {
+    PROFILE_FUNCTION();
     return !(l == r);
 }
 
 vec3 operator+(const vec3& l, const vec3& r)
 {
+    PROFILE_FUNCTION();
     return {l.x + r.x, l.y + r.y, l.z + r.z};
 }
 
 vec3 operator-(const vec3& l, const vec3& r)
 {
+    PROFILE_FUNCTION();
     return {l.x - r.x, l.y - r.y, l.z - r.z};
 }
 
 vec3 operator*(const vec3& l, const vec3& r)
 {
+    PROFILE_FUNCTION();
     return {l.x * r.x, l.y * r.y, l.z * r.z};
 }
 
 vec3 operator*(const vec3& l, float r)
 {
+    PROFILE_FUNCTION();
     return {l.x * r, l.y * r, l.z * r};
 }
 
 bool operator==(const vec3& l, const vec3& r)
 {
+    PROFILE_FUNCTION();
     return FLOAT_CMP(l.x, r.x) && FLOAT_CMP(l.y, r.y) && FLOAT_CMP(l.z, r.z);
 }
 
 bool operator!=(const vec3& l, const vec3& r)
 {
+    PROFILE_FUNCTION();
     return !(l == r);
 }
 
 float Dot(const vec2& l, const vec2& r)
 {
+    PROFILE_FUNCTION();
     return (l.x * r.x) + (l.y * r.y);
 }
 
 float Dot(const vec3& l, const vec3& r)
 {
+    PROFILE_FUNCTION();
     return (l.x * r.x) + (l.y * r.y) + (l.z * r.z);
 }
 
 float Magnitude(const vec2& vec)
 {
+    PROFILE_FUNCTION();
     return sqrtf(Dot(vec, vec));
 }
 
 float Magnitude(const vec3& vec)
 {
+    PROFILE_FUNCTION();
     return sqrtf(Dot(vec, vec));
 }
 
 float MagnitudeSqr(const vec2& vec)
 {
+    PROFILE_FUNCTION();
     return Dot(vec, vec);
 }
 
 float MagnitudeSqr(const vec3& vec)
 {
+    PROFILE_FUNCTION();
     return Dot(vec, vec);
 }
 
 float Distance(const vec2& v1, const vec2& v2)
 {
+    PROFILE_FUNCTION();
     return Magnitude(v1 - v2);
 }
 
 float Distance(const vec3& v1, const vec3& v2)
 {
+    PROFILE_FUNCTION();
     return Magnitude(v1 - v2);
 }
 
 void Normalize(vec2& v)
 {
+    PROFILE_FUNCTION();
     v = v * (1.0f / Magnitude(v));
 }
 
 void Normalize(vec3& v)
 {
+    PROFILE_FUNCTION();
     v = v * (1.0f / Magnitude(v));
 }
 
 vec2 Normalized(const vec2& v)
 {
+    PROFILE_FUNCTION();
     return v * (1.0f / Magnitude(v));
 }
 
 vec3 Normalized(const vec3& v)
 {
+    PROFILE_FUNCTION();
     return v * (1.0f / Magnitude(v));
 }
 
 vec3 Cross(const vec3& l, const vec3& r)
 {
+    PROFILE_FUNCTION();
     vec3 result;
-    result.x = (l.y * r.z) - (l.z - r.y);
-    result.y = (l.z * r.x) - (l.x - r.z);
-    result.z = (l.x * r.y) - (l.y - r.x);
+    result.x = (l.y * r.z) - (l.z * r.y);
+    result.y = (l.z * r.x) - (l.x * r.z);
+    result.z = (l.x * r.y) - (l.y * r.x);
     return result;
 }
 
 float Angle(const vec2& l, const vec2& r)
 {
+    PROFILE_FUNCTION();
     // cos theta = Dot(a, b) / |a||b|
     float m = sqrtf(MagnitudeSqr(l) * MagnitudeSqr(r));
     return acos(Dot(l, r) / m);
@@ -150,12 +181,14 @@ float Angle(const vec2& l, const vec2& r)
 
 float Angle(const vec3& l, const vec3& r)
 {
+    PROFILE_FUNCTION();
     float m = sqrtf(MagnitudeSqr(l) * MagnitudeSqr(r));
     return acos(Dot(l, r) / m);
 }
 
 vec2 Project(const vec2&len, const vec2& dir)
 {
+    PROFILE_FUNCTION();
     // |A|cos theta * unit vector of B
     // |A|cos theta * (B / |B|)
     // (|A| |B| cos theta) * (B / |B|^2)
@@ -166,27 +199,245 @@ vec2 Project(const vec2&len, const vec2& dir)
 
 vec2 Perpendicular(const vec2&len, const vec2& dir)
 {
+    PROFILE_FUNCTION();
     return len - Project(len, dir);
 }
 
 vec3 Project(const vec3&len, const vec3& dir)
 {
+    PROFILE_FUNCTION();
     vec3 proj = (dir * Dot(len, dir)) * (1.0f / (MagnitudeSqr(dir)));
     return proj;
 }
 
 vec3 Perpendicular(const vec3&len, const vec3& dir)
 {
+    PROFILE_FUNCTION();
     return len - Project(len, dir);
 }
 
 vec2 Reflection(const vec2& vec, const vec2& normal)
 {
+    PROFILE_FUNCTION();
     return vec - (Project(vec, normal)) * 2;
 }
 
 vec3 Reflection(const vec3& vec, const vec3& normal)
 {
+    PROFILE_FUNCTION();
     return vec - (Project(vec, normal)) * 2;
 }
 
+/* Aligned vectors
+ *
+ * The lane-wise operators are one aligned load per operand with SSE2. The
+ * pad lane of vec3a goes through them too and stays zero (0 op 0).
+ */
+
+// out = l op r over four floats; the pointers are 16 byte aligned
+#if defined(__SSE2__)
+static inline void Add4(const float* l, const float* r, float* out)
+{
+    _mm_store_ps(out, _mm_add_ps(_mm_load_ps(l), _mm_load_ps(r)));
+}
+
+static inline void Sub4(const float* l, const float* r, float* out)
+{
+    _mm_store_ps(out, _mm_sub_ps(_mm_load_ps(l), _mm_load_ps(r)));
+}
+
+static inline void Mul4(const float* l, const float* r, float* out)
+{
+    _mm_store_ps(out, _mm_mul_ps(_mm_load_ps(l), _mm_load_ps(r)));
+}
+
+static inline void Scale4(const float* l, float r, float* out)
+{
+    _mm_store_ps(out, _mm_mul_ps(_mm_load_ps(l), _mm_set1_ps(r)));
+}
+#else
+static inline void Add4(const float* l, const float* r, float* out)
+{
+    for (int i = 0; i < 4; i++) {
+        out[i] = l[i] + r[i];
+    }
+}
+
+static inline void Sub4(const float* l, const float* r, float* out)
+{
+    for (int i = 0; i < 4; i++) {
+        out[i] = l[i] - r[i];
+    }
+}
+
+static inline void Mul4(const float* l, const float* r, float* out)
+{
+    for (int i = 0; i < 4; i++) {
+        out[i] = l[i] * r[i];
+    }
+}
+
+static inline void Scale4(const float* l, float r, float* out)
+{
+    for (int i = 0; i < 4; i++) {
+        out[i] = l[i] * r;
+    }
+}
+#endif
+
+vec4 operator+(const vec4& l, const vec4& r)
+{
+    PROFILE_FUNCTION();
+    vec4 result;
+    Add4(l.asArray, r.asArray, result.asArray);
+    return result;
+}
+
+vec4 operator-(const vec4& l, const vec4& r)
+{
+    PROFILE_FUNCTION();
+    vec4 result;
+    Sub4(l.asArray, r.asArray, result.asArray);
+    return result;
+}
+
+vec4 operator*(const vec4& l, const vec4& r)
+{
+    PROFILE_FUNCTION();
+    vec4 result;
+    Mul4(l.asArray, r.asArray, result.asArray);
+    return result;
+}
+
+vec4 operator*(const vec4& l, float r)
+{
+    PROFILE_FUNCTION();
+    vec4 result;
+    Scale4(l.asArray, r, result.asArray);
+    return result;
+}
+
+bool operator==(const vec4& l, const vec4& r)
+{
+    PROFILE_FUNCTION();
+    return FLOAT_CMP(l.x, r.x) && FLOAT_CMP(l.y, r.y) &&
+           FLOAT_CMP(l.z, r.z) && FLOAT_CMP(l.w, r.w);
+}
+
+bool operator!=(const vec4& l, const vec4& r)
+{
+    PROFILE_FUNCTION();
+    return !(l == r);
+}
+
+vec3a operator+(const vec3a& l, const vec3a& r)
+{
+    PROFILE_FUNCTION();
+    vec3a result;
+    Add4(l.asArray, r.asArray, result.asArray);
+    return result;
+}
+
+vec3a operator-(const vec3a& l, const vec3a& r)
+{
+    PROFILE_FUNCTION();
+    vec3a result;
+    Sub4(l.asArray, r.asArray, result.asArray);
+    return result;
+}
+
+vec3a operator*(const vec3a& l, const vec3a& r)
+{
+    PROFILE_FUNCTION();
+    vec3a result;
+    Mul4(l.asArray, r.asArray, result.asArray);
+    return result;
+}
+
+vec3a operator*(const vec3a& l, float r)
+{
+    PROFILE_FUNCTION();
+    vec3a result;
+    Scale4(l.asArray, r, result.asArray);
+    return result;
+}
+
+bool operator==(const vec3a& l, const vec3a& r)
+{
+    PROFILE_FUNCTION();
+    return FLOAT_CMP(l.x, r.x) && FLOAT_CMP(l.y, r.y) && FLOAT_CMP(l.z, r.z);
+}
+
+bool operator!=(const vec3a& l, const vec3a& r)
+{
+    PROFILE_FUNCTION();
+    return !(l == r);
+}
+
+float Dot(const vec4& l, const vec4& r)
+{
+    PROFILE_FUNCTION();
+    return l.x * r.x + l.y * r.y + l.z * r.z + l.w * r.w;
+}
+
+float Dot(const vec3a& l, const vec3a& r)
+{
+    PROFILE_FUNCTION();
+    return l.x * r.x + l.y * r.y + l.z * r.z;
+}
+
+float Magnitude(const vec4& vec)
+{
+    PROFILE_FUNCTION();
+    return sqrtf(Dot(vec, vec));
+}
+
+float Magnitude(const vec3a& vec)
+{
+    PROFILE_FUNCTION();
+    return sqrtf(Dot(vec, vec));
+}
+
+float MagnitudeSqr(const vec4& vec)
+{
+    PROFILE_FUNCTION();
+    return Dot(vec, vec);
+}
+
+float MagnitudeSqr(const vec3a& vec)
+{
+    PROFILE_FUNCTION();
+    return Dot(vec, vec);
+}
+
+void Normalize(vec4& v)
+{
+    PROFILE_FUNCTION();
+    v = v * (1.0f / Magnitude(v));
+}
+
+void Normalize(vec3a& v)
+{
+    PROFILE_FUNCTION();
+    v = v * (1.0f / Magnitude(v));
+}
+
+vec4 Normalized(const vec4& v)
+{
+    PROFILE_FUNCTION();
+    return v * (1.0f / Magnitude(v));
+}
+
+vec3a Normalized(const vec3a& v)
+{
+    PROFILE_FUNCTION();
+    return v * (1.0f / Magnitude(v));
+}
+
+vec3a Cross(const vec3a& l, const vec3a& r)
+{
+    PROFILE_FUNCTION();
+    return vec3a((l.y * r.z) - (l.z * r.y),
+                 (l.z * r.x) - (l.x * r.z),
+                 (l.x * r.y) - (l.y * r.x));
+}
@@ -44,6 +44,63 @@ typedef struct vec3 {
     vec3(float _x, float _y, float _z) : x(_x), y(_y), z(_z) {}
 } vec3;
 
+/* 16 byte aligned vectors for SIMD code.
+ *
+ * vec4 and vec3a load and store as one aligned SSE/NEON register. vec3a is
+ * a vec3 padded to four floats; the pad is kept at zero by everything
+ * here. Use them for hot arrays and keep vec3 for packed data such as
+ * vertex buffers and baked files.
+ */
+typedef struct alignas(16) vec4 {
+    union {
+        struct {
+            float x;
+            float y;
+            float z;
+            float w;
+        };
+        float asArray[4];
+    };
+
+    float& operator[](int i)
+    {
+        return asArray[i];
+    }
+
+    vec4() : x(0.0f), y(0.0f), z(0.0f), w(0.0f) {}
+
+    vec4(float _x, float _y, float _z, float _w) :
+        x(_x), y(_y), z(_z), w(_w) {}
+    vec4(const vec3& v, float _w) : x(v.x), y(v.y), z(v.z), w(_w) {}
+} vec4;
+
+typedef struct alignas(16) vec3a {
+    union {
+        struct {
+            float x;
+            float y;
+            float z;
+            float pad;
+        };
+        float asArray[4];
+    };
+
+    float& operator[](int i)
+    {
+        return asArray[i];
+    }
+
+    vec3a() : x(0.0f), y(0.0f), z(0.0f), pad(0.0f) {}
+
+    vec3a(float _x, float _y, float _z) : x(_x), y(_y), z(_z), pad(0.0f) {}
+    explicit vec3a(const vec3& v) : x(v.x), y(v.y), z(v.z), pad(0.0f) {}
+} vec3a;
+
+inline vec3 ToVec3(const vec3a& v)
+{
+    return vec3(v.x, v.y, v.z);
+}
+
 vec2 operator+(const vec2& l, const vec2& r);
 vec2 operator-(const vec2& l, const vec2& r);
 vec2 operator*(const vec2& l, const vec2& r);
@@ -58,25 +115,50 @@ vec3 operator*(const vec3& l, float r);
 bool operator==(const vec3& l, const vec3& r);
 bool operator!=(const vec3& l, const vec3& r);
 
+vec4 operator+(const vec4& l, const vec4& r);
+vec4 operator-(const vec4& l, const vec4& r);
+vec4 operator*(const vec4& l, const vec4& r);
+vec4 operator*(const vec4& l, float r);
+bool operator==(const vec4& l, const vec4& r);
+bool operator!=(const vec4& l, const vec4& r);
+
+vec3a operator+(const vec3a& l, const vec3a& r);
+vec3a operator-(const vec3a& l, const vec3a& r);
+vec3a operator*(const vec3a& l, const vec3a& r);
+vec3a operator*(const vec3a& l, float r);
+bool operator==(const vec3a& l, const vec3a& r);
+bool operator!=(const vec3a& l, const vec3a& r);
+
 float Dot(const vec2& l, const vec2& r);
 float Dot(const vec3& l, const vec3& r);
+float Dot(const vec4& l, const vec4& r);
+float Dot(const vec3a& l, const vec3a& r);
 
 float Magnitude(const vec2& vec);
 float Magnitude(const vec3& vec);
+float Magnitude(const vec4& vec);
+float Magnitude(const vec3a& vec);
 
 float MagnitudeSqr(const vec2& vec);
 float MagnitudeSqr(const vec3& vec);
+float MagnitudeSqr(const vec4& vec);
+float MagnitudeSqr(const vec3a& vec);
 
 float Distance(const vec2& v1, const vec2& v2);
 float Distance(const vec3& v1, const vec3& v2);
 
 void Normalize(vec2& v);
 void Normalize(vec3& v);
+void Normalize(vec4& v);
+void Normalize(vec3a& v);
 
 vec2 Normalized(const vec2& v);
 vec3 Normalized(const vec3& v);
+vec4 Normalized(const vec4& v);
+vec3a Normalized(const vec3a& v);
 
 vec3 Cross(const vec3& l, const vec3& r);
+vec3a Cross(const vec3a& l, const vec3a& r);
 
 float Angle(const vec2& l, const vec2& r);
 float Angle(const vec3& l, const vec3& r);